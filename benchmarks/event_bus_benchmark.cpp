@@ -0,0 +1,147 @@
+// Times delivering key events to a game through WindowEvents against the path it replaced, where the window locked a
+// weak_ptr to the game and called a virtual callback on the window and then on the game for every event.
+
+#include <events.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+constexpr uint32_t EVENT_COUNT = 20000000;
+constexpr uint32_t FLUSH_INTERVAL = 64;
+
+/// The game side of the replaced path
+class VirtualGame
+{
+public:
+	virtual ~VirtualGame() = default;
+	virtual void OnKeyPressed(KeyEventArgs& e) = 0;
+	virtual void OnKeyReleased(KeyEventArgs& e) = 0;
+};
+
+class CountingVirtualGame : public VirtualGame
+{
+public:
+	void OnKeyPressed(KeyEventArgs& e) override { sum += e.Key; }
+	void OnKeyReleased(KeyEventArgs& e) override { sum -= e.Char; }
+	uint64_t sum = 0;
+};
+
+/// The window side of the replaced path
+class VirtualWindow
+{
+public:
+	virtual ~VirtualWindow() = default;
+	virtual void OnKeyPressed(KeyEventArgs& e)
+	{
+		if (auto game = m_game.lock())
+		{
+			game->OnKeyPressed(e);
+		}
+	}
+	virtual void OnKeyReleased(KeyEventArgs& e)
+	{
+		if (auto game = m_game.lock())
+		{
+			game->OnKeyReleased(e);
+		}
+	}
+
+	std::weak_ptr<VirtualGame> m_game;
+};
+
+/// A game subscribing its members to the bus, the way RotatableCube does
+class BusGame
+{
+public:
+	void OnKey(KeyEventArgs& e)
+	{
+		if (e.State == KeyEventArgs::Pressed)
+		{
+			sum += e.Key;
+		}
+		else
+		{
+			sum -= e.Char;
+		}
+	}
+	uint64_t sum = 0;
+};
+
+KeyEventArgs MakeEvent(uint32_t i)
+{
+	return KeyEventArgs(static_cast<KeyCode::Key>(i & 0x7f), i & 0xff, (i & 1) ? KeyEventArgs::Pressed : KeyEventArgs::Released,
+		false, false, false);
+}
+
+template <typename Function>
+double NanosecondsPerEvent(Function&& deliver)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < EVENT_COUNT; i++)
+	{
+		deliver(i);
+	}
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / EVENT_COUNT;
+}
+}
+
+int main()
+{
+	// behind pointers with dynamic types the compiler can not see through, as in the engine
+	std::shared_ptr<VirtualGame> virtualGame = std::make_shared<CountingVirtualGame>();
+	std::unique_ptr<VirtualWindow> window = std::make_unique<VirtualWindow>();
+	window->m_game = virtualGame;
+	VirtualWindow* volatile windowPointer = window.get();
+	const double virtualNs = NanosecondsPerEvent([&](uint32_t i)
+		{
+			KeyEventArgs e = MakeEvent(i);
+			VirtualWindow* target = windowPointer;
+			if (e.State == KeyEventArgs::Pressed)
+			{
+				target->OnKeyPressed(e);
+			}
+			else
+			{
+				target->OnKeyReleased(e);
+			}
+		});
+
+	WindowEvents events;
+	BusGame busGame;
+	events.Subscribe<KeyEventArgs, &BusGame::OnKey>(&busGame);
+	const double publishNs = NanosecondsPerEvent([&](uint32_t i)
+		{
+			KeyEventArgs e = MakeEvent(i);
+			events.Publish(e);
+		});
+
+	BusGame queuedGame;
+	WindowEvents queuedEvents;
+	queuedEvents.Subscribe<KeyEventArgs, &BusGame::OnKey>(&queuedGame);
+	const double queueNs = NanosecondsPerEvent([&](uint32_t i)
+		{
+			queuedEvents.Queue(MakeEvent(i));
+			if (i % FLUSH_INTERVAL == FLUSH_INTERVAL - 1)
+			{
+				queuedEvents.Flush();
+			}
+		});
+	queuedEvents.Flush();
+
+	const uint64_t expected = static_cast<CountingVirtualGame&>(*virtualGame).sum;
+	if (busGame.sum != expected || queuedGame.sum != expected)
+	{
+		std::printf("Delivery paths disagree\n");
+		return 1;
+	}
+
+	std::printf("%u key events, ns per event\n", EVENT_COUNT);
+	std::printf("%-40s %8.2f\n", "weak_ptr lock + virtual calls", virtualNs);
+	std::printf("%-40s %8.2f\n", "EventBus::Publish to a member", publishNs);
+	std::printf("%-40s %8.2f\n", "EventBus::Queue, Flush every 64", queueNs);
+	return 0;
+}
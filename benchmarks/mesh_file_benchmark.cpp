@@ -0,0 +1,148 @@
+// Times loading a mesh file the way the streaming thread does: open the view and decode the vertex and index sections
+// into destination memory, once for a file written uncompressed and once compressed. The file is read into memory up
+// front, standing in for the mapping whose pages are already in the file cache.
+
+#include <mesh_file.hpp>
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+// snorm16x4 position, snorm16x2 octahedral normal, unorm8x4 color
+constexpr uint32_t VERTEX_STRIDE = 16;
+
+/// A unit sphere of latitude/longitude quads with packed vertices, one LOD and its meshlets
+MeshFileContent MakeSphere(uint32_t rings, uint32_t segments)
+{
+	std::vector<float> positions;
+	for (uint32_t ring = 0; ring <= rings; ring++)
+	{
+		const float theta = 3.14159265f * static_cast<float>(ring) / static_cast<float>(rings);
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			const float phi = 6.28318531f * static_cast<float>(segment) / static_cast<float>(segments);
+			positions.push_back(std::sin(theta) * std::cos(phi));
+			positions.push_back(std::cos(theta));
+			positions.push_back(std::sin(theta) * std::sin(phi));
+		}
+	}
+	const size_t vertexCount = positions.size() / 3;
+	const MeshPositions meshPositions = { positions.data(), vertexCount, 3 * sizeof(float) };
+
+	MeshFileContent content = { };
+	content.vertexStride = VERTEX_STRIDE;
+	content.quantization = ComputePositionQuantization(meshPositions);
+	content.vertices.resize(vertexCount * VERTEX_STRIDE);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* position = &positions[v * 3];
+		int16_t packed[6];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packed[axis] = EncodeSnorm16((position[axis] - content.quantization.bias[axis]) / content.quantization.scale[axis]);
+		}
+		packed[3] = 0;
+		float octahedral[2];
+		EncodeOctahedral(position, octahedral);
+		packed[4] = EncodeSnorm16(octahedral[0]);
+		packed[5] = EncodeSnorm16(octahedral[1]);
+		const uint8_t color[4] = { EncodeUnorm8(position[0] * 0.5f + 0.5f), EncodeUnorm8(position[1] * 0.5f + 0.5f),
+			EncodeUnorm8(position[2] * 0.5f + 0.5f), 255 };
+		std::memcpy(&content.vertices[v * VERTEX_STRIDE], packed, sizeof(packed));
+		std::memcpy(&content.vertices[v * VERTEX_STRIDE + sizeof(packed)], color, sizeof(color));
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		content.boundsMin[axis] = -1.f;
+		content.boundsMax[axis] = 1.f;
+	}
+
+	for (uint32_t ring = 0; ring < rings; ring++)
+	{
+		for (uint32_t segment = 0; segment < segments; segment++)
+		{
+			const uint32_t a = ring * (segments + 1) + segment;
+			const uint32_t b = a + segments + 1;
+			content.indices.insert(content.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+	OptimizeVertexCache(content.indices, vertexCount);
+	content.lods.push_back({ 0, static_cast<uint32_t>(content.indices.size()), 0.f });
+	content.meshlets = BuildMeshlets(content.indices, vertexCount);
+	content.meshletBounds = ComputeMeshletBounds(content.meshlets, meshPositions);
+	return content;
+}
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// @returns Best seconds of decoding both sections, 0 if the file does not load
+double TimeLoad(const std::vector<uint8_t>& file, std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices)
+{
+	constexpr int REPEATS = 10;
+	double best = 1e9;
+	for (int repeat = 0; repeat < REPEATS; repeat++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		MeshFileView mesh;
+		if (!mesh.Open(file.data(), file.size()))
+		{
+			return 0.;
+		}
+		// the destination stays allocated between runs, like upload memory that is already mapped
+		vertices.resize(mesh.GetDecodedSize(MeshSection::Vertices));
+		indices.resize(mesh.GetDecodedSize(MeshSection::Indices));
+		if (!mesh.DecodeSection(MeshSection::Vertices, vertices.data()) || !mesh.DecodeSection(MeshSection::Indices, indices.data()))
+		{
+			return 0.;
+		}
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+}
+
+int main()
+{
+	const MeshFileContent content = MakeSphere(724, 1448);
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "mesh_file_benchmark.cmsh";
+
+	std::printf("%u vertices, %zu triangles\n", static_cast<uint32_t>(content.vertices.size() / VERTEX_STRIDE),
+		content.indices.size() / 3);
+	std::printf("%-12s %10s %12s %10s %10s\n", "file", "file MB", "decoded MB", "load ms", "GB/s");
+	for (bool compress : { false, true })
+	{
+		const std::vector<uint8_t> written = WriteMeshFile(content, compress);
+		std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(written.data()), written.size());
+		const std::vector<uint8_t> file = ReadFile(path);
+
+		std::vector<uint8_t> vertices;
+		std::vector<uint8_t> indices;
+		const double seconds = TimeLoad(file, vertices, indices);
+		if (seconds == 0. || vertices != content.vertices)
+		{
+			std::printf("The %s mesh file does not load back\n", compress ? "compressed" : "uncompressed");
+			std::filesystem::remove(path);
+			return 1;
+		}
+
+		const double decodedSize = static_cast<double>(vertices.size() + indices.size());
+		std::printf("%-12s %10.1f %12.1f %10.2f %10.2f\n", compress ? "compressed" : "uncompressed",
+			file.size() / (1024. * 1024.), decodedSize / (1024. * 1024.), seconds * 1e3, decodedSize / seconds * 1e-9);
+	}
+	std::filesystem::remove(path);
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Times splitting meshes into meshlets and computing their culling bounds, on vertex cache optimized spheres of
+// growing size as they come out of the import, and checks the meshlets stay within the mesh shader limits.
+
+#include <meshlet_builder.hpp>
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+struct Mesh
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+};
+
+/// A unit sphere of latitude/longitude quads, two triangles each
+Mesh MakeSphere(uint32_t rings, uint32_t segments)
+{
+	Mesh mesh;
+	for (uint32_t ring = 0; ring <= rings; ring++)
+	{
+		const float theta = 3.14159265f * static_cast<float>(ring) / static_cast<float>(rings);
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			const float phi = 6.28318531f * static_cast<float>(segment) / static_cast<float>(segments);
+			mesh.positions.push_back(std::sin(theta) * std::cos(phi));
+			mesh.positions.push_back(std::cos(theta));
+			mesh.positions.push_back(std::sin(theta) * std::sin(phi));
+		}
+	}
+	for (uint32_t ring = 0; ring < rings; ring++)
+	{
+		for (uint32_t segment = 0; segment < segments; segment++)
+		{
+			const uint32_t a = ring * (segments + 1) + segment;
+			const uint32_t b = a + segments + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+	return mesh;
+}
+
+bool IsWithinLimits(const MeshletData& data)
+{
+	for (const Meshlet& meshlet : data.meshlets)
+	{
+		if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.primitiveCount > MESHLET_MAX_PRIMITIVES)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+int main()
+{
+	constexpr uint32_t RING_COUNTS[] = { 64, 256, 724 };
+	constexpr int REPEATS = 5;
+
+	std::printf("%10s %10s %10s %12s %14s %14s %14s\n", "triangles", "meshlets", "tris/mlet", "verts/mlet",
+		"build Mtri/s", "bounds Mtri/s", "buffer MB/s");
+	for (uint32_t rings : RING_COUNTS)
+	{
+		Mesh mesh = MakeSphere(rings, rings * 2);
+		const size_t vertexCount = mesh.positions.size() / 3;
+		const size_t triangleCount = mesh.indices.size() / 3;
+		OptimizeVertexCache(mesh.indices, vertexCount);
+		const MeshPositions positions = { mesh.positions.data(), vertexCount, 3 * sizeof(float) };
+
+		// best of a few runs, the first one also pays for page faults of the output arrays
+		double buildSeconds = 1e9;
+		double boundsSeconds = 1e9;
+		double serializeSeconds = 1e9;
+		MeshletData data;
+		size_t bufferSize = 0;
+		for (int repeat = 0; repeat < REPEATS; repeat++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			data = BuildMeshlets(mesh.indices, vertexCount);
+			const auto built = std::chrono::steady_clock::now();
+			const std::vector<MeshletBounds> bounds = ComputeMeshletBounds(data, positions);
+			const auto bounded = std::chrono::steady_clock::now();
+			MeshletBufferLayout layout;
+			bufferSize = SerializeMeshlets(data, bounds, layout).size();
+			const auto serialized = std::chrono::steady_clock::now();
+
+			buildSeconds = std::min(buildSeconds, std::chrono::duration<double>(built - start).count());
+			boundsSeconds = std::min(boundsSeconds, std::chrono::duration<double>(bounded - built).count());
+			serializeSeconds = std::min(serializeSeconds, std::chrono::duration<double>(serialized - bounded).count());
+		}
+
+		if (!IsWithinLimits(data))
+		{
+			std::printf("A meshlet of the %zu triangle sphere exceeds the mesh shader limits\n", triangleCount);
+			return 1;
+		}
+
+		const double meshletCount = static_cast<double>(data.meshlets.size());
+		std::printf("%10zu %10zu %10.1f %12.1f %14.1f %14.1f %14.1f\n", triangleCount, data.meshlets.size(),
+			triangleCount / meshletCount, data.vertexIndices.size() / meshletCount, triangleCount / buildSeconds * 1e-6,
+			triangleCount / boundsSeconds * 1e-6, bufferSize / serializeSeconds / (1024. * 1024.));
+	}
+
+	return 0;
+}
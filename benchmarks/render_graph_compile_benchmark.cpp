@@ -0,0 +1,120 @@
+// Times RenderGraphCompiler::Compile on synthetic frames of growing size, declared the way RotatableCube declares its
+// frame every frame: reset, add resources and passes, compile.
+
+#include <render_graph_compiler.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+struct FrameStats
+{
+	size_t culledPasses;
+	size_t barriers;
+	size_t barrierBatches;
+	uint64_t transientMemory;
+	size_t asyncComputePasses;
+	size_t queueSyncs;
+};
+
+/// A frame of `chains` independent effect chains, e.g. shadow cascades or post effects, each a compute pass filling a
+/// buffer and graphics passes ping-ponging between render targets, all composited into the back buffer. Every fourth
+/// chain has a debug pass nobody reads, which is culled.
+void DeclareFrame(RenderGraphCompiler& compiler, uint32_t chains, uint32_t passesPerChain)
+{
+	const uint32_t backBuffer = compiler.AddImportedResource(RenderGraphStates::COMMON, RenderGraphStates::COMMON);
+	const uint32_t depthBuffer = compiler.AddImportedResource(RenderGraphStates::DEPTH_WRITE, RenderGraphStates::DEPTH_WRITE);
+	constexpr uint64_t TARGET_SIZE = 1920 * 1080 * 8;
+	constexpr uint64_t BUFFER_SIZE = 256 * 1024;
+
+	const uint32_t depthPass = compiler.AddPass();
+	compiler.AddAccess(depthPass, depthBuffer, RenderGraphStates::DEPTH_WRITE, true);
+
+	std::vector<uint32_t> chainOutputs;
+	for (uint32_t chain = 0; chain < chains; chain++)
+	{
+		const uint32_t buffer = compiler.AddTransientResource(RenderGraphCompiler::HEAP_KIND_BUFFERS, BUFFER_SIZE,
+			RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT);
+		const uint32_t fill = compiler.AddPass();
+		compiler.AddAccess(fill, buffer, RenderGraphStates::UNORDERED_ACCESS, true);
+		compiler.SetAsyncCompute(fill);
+
+		uint32_t previous = compiler.AddTransientResource(RenderGraphCompiler::HEAP_KIND_RT_DS_TEXTURES, TARGET_SIZE,
+			RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT);
+		const uint32_t first = compiler.AddPass();
+		compiler.AddAccess(first, buffer, RenderGraphStates::NON_PIXEL_SHADER_RESOURCE, false);
+		compiler.AddAccess(first, depthBuffer, RenderGraphStates::DEPTH_READ, false);
+		compiler.AddAccess(first, previous, RenderGraphStates::RENDER_TARGET, true);
+
+		for (uint32_t i = 1; i < passesPerChain; i++)
+		{
+			const uint32_t next = compiler.AddTransientResource(RenderGraphCompiler::HEAP_KIND_RT_DS_TEXTURES, TARGET_SIZE,
+				RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT);
+			const uint32_t pass = compiler.AddPass();
+			compiler.AddAccess(pass, previous, RenderGraphStates::PIXEL_SHADER_RESOURCE, false);
+			compiler.AddAccess(pass, next, RenderGraphStates::RENDER_TARGET, true);
+			previous = next;
+		}
+		chainOutputs.push_back(previous);
+
+		if (chain % 4 == 0)
+		{
+			const uint32_t debugTarget = compiler.AddTransientResource(RenderGraphCompiler::HEAP_KIND_RT_DS_TEXTURES,
+				TARGET_SIZE, RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT);
+			const uint32_t debug = compiler.AddPass();
+			compiler.AddAccess(debug, previous, RenderGraphStates::PIXEL_SHADER_RESOURCE, false);
+			compiler.AddAccess(debug, debugTarget, RenderGraphStates::RENDER_TARGET, true);
+		}
+	}
+
+	const uint32_t composite = compiler.AddPass();
+	for (uint32_t output : chainOutputs)
+	{
+		compiler.AddAccess(composite, output, RenderGraphStates::PIXEL_SHADER_RESOURCE, false);
+	}
+	compiler.AddAccess(composite, backBuffer, RenderGraphStates::RENDER_TARGET, true);
+}
+
+FrameStats GetStats(const RenderGraphCompiler& compiler)
+{
+	return { compiler.GetCulledPassCount(), compiler.GetBarrierCount(), compiler.GetBarrierBatchCount(),
+		compiler.GetTransientMemorySize(), compiler.GetAsyncComputePassCount(), compiler.GetQueueSyncCount() };
+}
+}
+
+int main()
+{
+	constexpr uint32_t PASSES_PER_CHAIN = 4;
+	constexpr uint32_t CHAIN_COUNTS[] = { 2, 8, 32, 128 };
+
+	std::printf("%8s %8s %14s %14s %8s %8s %10s %12s %6s %6s\n", "passes", "frames", "declare us", "compile us", "culled",
+		"barriers", "batches", "transient MB", "async", "syncs");
+	for (uint32_t chains : CHAIN_COUNTS)
+	{
+		RenderGraphCompiler compiler;
+		const uint32_t frames = 20000 / chains;
+		double declareSeconds = 0.;
+		double compileSeconds = 0.;
+		for (uint32_t frame = 0; frame < frames; frame++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			compiler.Reset();
+			DeclareFrame(compiler, chains, PASSES_PER_CHAIN);
+			const auto declared = std::chrono::steady_clock::now();
+			compiler.Compile(true);
+			const auto compiled = std::chrono::steady_clock::now();
+
+			declareSeconds += std::chrono::duration<double>(declared - start).count();
+			compileSeconds += std::chrono::duration<double>(compiled - declared).count();
+		}
+
+		const FrameStats stats = GetStats(compiler);
+		std::printf("%8zu %8u %14.2f %14.2f %8zu %8zu %10zu %12.1f %6zu %6zu\n", compiler.GetPassCount(), frames,
+			declareSeconds / frames * 1e6, compileSeconds / frames * 1e6, stats.culledPasses, stats.barriers,
+			stats.barrierBatches, static_cast<double>(stats.transientMemory) / (1024. * 1024.), stats.asyncComputePasses,
+			stats.queueSyncs);
+	}
+
+	return 0;
+}
@@ -1,7 +1,20 @@
 #include "application.hpp"
 
+#include <fstream>
+#include <string>
 #include <unordered_map>
+#include <vector>
+#include <asset_streamer.hpp>
 #include <command_queue.hpp>
+#include <frame_capture.hpp>
+#include <input_recording.hpp>
+#include <pipeline_cache.hpp>
+#include <pipeline_compiler.hpp>
+#include <profiler.hpp>
+#include <readback_ring.hpp>
+#include <shader_archive.hpp>
+#include <startup_graph.hpp>
+#include <upload_manager.hpp>
 #include <window.hpp>
 #include <game.hpp>
 
@@ -26,6 +39,52 @@ struct MakeWindow : public Window
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 
+namespace
+{
+// identifies the adapter picked last time, so it is not searched for by creating a device on every adapter
+const wchar_t* g_adapterCachePath = L"adapter.cache";
+const uint32_t g_adapterCacheVersion = 1;
+const wchar_t* g_pipelineCachePath = L"pipeline.cache";
+// written next to the executable by the shader compiler when the project is built
+const wchar_t* g_shaderArchivePath = L"shaders.pak";
+
+struct AdapterCache
+{
+	uint32_t version;
+	UINT vendorId;
+	UINT deviceId;
+	UINT subSysId;
+	UINT revision;
+	uint64_t dedicatedVideoMemory;
+};
+
+bool ReadAdapterCache(AdapterCache& cache)
+{
+	std::ifstream file(g_adapterCachePath, std::ios::binary);
+	return file.read(reinterpret_cast<char*>(&cache), sizeof(cache)) && cache.version == g_adapterCacheVersion;
+}
+
+void WriteAdapterCache(const DXGI_ADAPTER_DESC1& desc)
+{
+	const AdapterCache cache = { g_adapterCacheVersion, desc.VendorId, desc.DeviceId, desc.SubSysId, desc.Revision,
+		desc.DedicatedVideoMemory };
+	std::ofstream file(g_adapterCachePath, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&cache), sizeof(cache));
+}
+
+bool MatchesAdapterCache(const DXGI_ADAPTER_DESC1& desc, const AdapterCache& cache)
+{
+	// LUIDs change with every boot, the hardware and its memory do not
+	return desc.VendorId == cache.vendorId && desc.DeviceId == cache.deviceId && desc.SubSysId == cache.subSysId
+		&& desc.Revision == cache.revision && desc.DedicatedVideoMemory == cache.dedicatedVideoMemory;
+}
+
+bool SupportsDevice(IDXGIAdapter1* adapter)
+{
+	return SUCCEEDED(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_11_0, __uuidof(ID3D12Device2), nullptr));
+}
+}
+
 Application::~Application()
 {
 	Flush();
@@ -91,9 +150,22 @@ std::shared_ptr<Window> Application::CreateRenderWindow(const std::wstring& wind
 	}
 
 	WindowPtr window = std::make_shared<MakeWindow>(hWnd, windowName, width, height, vSync);
+	if (g_windows.empty())
+	{
+		if (m_inputPlayer)
+		{
+			window->ReplayInput(std::move(m_inputPlayer));
+		}
+		else if (!m_inputRecordingPath.empty())
+		{
+			window->RecordInput(m_inputRecordingPath);
+		}
+	}
 
 	g_windows.insert({ hWnd, window });
 	g_windowsByName.insert({ windowName, window });
+	// saves the window procedure a map lookup per message, the maps hold the window until WM_DESTROY clears this
+	::SetWindowLongPtrW(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(window.get()));
 
 	return window;
 }
@@ -129,13 +201,68 @@ void Application::Flush()
 
 int Application::Run(std::shared_ptr<Game> game)
 {
-	if (!game->Initialize())
+	return Run(std::vector<std::shared_ptr<Game>>{ game });
+}
+
+int Application::Run(const std::vector<std::shared_ptr<Game>>& games)
+{
+	Profiler::SetThreadName("Main");
+
+	// windows are created on this thread while content loads on a worker, windows are shown once both are done
+	std::vector<char> initialized(games.size(), false);
+	std::vector<char> loaded(games.size(), false);
+	StartupGraph startup;
+	std::vector<StartupGraph::TaskId> windows(games.size());
+	StartupGraph::TaskId previousContent = 0;
+	for (size_t i = 0; i < games.size(); i++)
 	{
-		return ErrorCode::GAME_NOT_INITIALIZED;
+		const std::string index = std::to_string(i);
+		windows[i] = startup.AddTask("Window " + index,
+			[&, i]()
+			{
+				PROFILE_SCOPE("Game::Initialize");
+				initialized[i] = games[i]->Initialize();
+			}, { }, true);
+
+		// content loads flush the shared command queues, so they run one after another
+		const auto load = [&, i]()
+			{
+				PROFILE_SCOPE("Game::LoadContent");
+				loaded[i] = games[i]->LoadContent();
+			};
+		const StartupGraph::TaskId content = (i == 0)
+			? startup.AddTask("Content " + index, load)
+			: startup.AddTask("Content " + index, load, { previousContent });
+		previousContent = content;
 	}
-	if (!game->LoadContent())
+
+	// showing a window resizes it, which flushes the shared command queues as well, so it waits for every content load
+	for (size_t i = 0; i < games.size(); i++)
 	{
-		return ErrorCode::GAME_CONTENT_NOT_LOADED;
+		startup.AddTask("Show " + std::to_string(i),
+			[&, i]()
+			{
+				if (initialized[i] && loaded[i] && !m_headless)
+				{
+					games[i]->Show();
+				}
+			}, { windows[i], previousContent }, true);
+	}
+	startup.Run();
+
+	std::string report = "Game startup:\n" + startup.GetReport();
+	::OutputDebugStringA(report.c_str());
+
+	for (size_t i = 0; i < games.size(); i++)
+	{
+		if (!initialized[i])
+		{
+			return ErrorCode::GAME_NOT_INITIALIZED;
+		}
+		if (!loaded[i])
+		{
+			return ErrorCode::GAME_CONTENT_NOT_LOADED;
+		}
 	}
 
 	MSG msg = { 0 };
@@ -143,23 +270,143 @@ int Application::Run(std::shared_ptr<Game> game)
 	{
 		if (::PeekMessageW(&msg, 0, 0, 0, PM_REMOVE))
 		{
+			PROFILE_SCOPE("Application::DispatchMessage");
 			::TranslateMessage(&msg);
 			::DispatchMessageW(&msg);
 		}
+		else if (!RenderFrame())
+		{
+			WaitForFrameOrMessage();
+		}
 	}
 
 	Flush();
-	game->UnloadContent();
-	game->Destroy();
+	// the zones of the last frames, so a profile written after Run has them
+	m_directCommandQueue->ResolveZones();
+	m_computeCommandQueue->ResolveZones();
+	m_copyCommandQueue->ResolveZones();
+	for (const auto& game : games)
+	{
+		PROFILE_SCOPE("Application::DestroyGame");
+		game->UnloadContent();
+		game->Destroy();
+	}
 
 	return static_cast<int>(msg.wParam);
 }
 
+bool Application::RenderFrame()
+{
+	// a window only renders once its own swapchain can take the frame, so a window waiting for vsync never holds
+	// back the others
+	std::vector<WindowPtr> readyWindows;
+	for (const auto& [hWnd, window] : g_windows)
+	{
+		if (window->HasGame() && window->IsFrameReady())
+		{
+			readyWindows.push_back(window);
+		}
+	}
+	if (readyWindows.empty())
+	{
+		return false;
+	}
+	PROFILE_SCOPE("Application::RenderFrame");
+
+	{
+		PROFILE_SCOPE("Application::UpdateStreaming");
+		// completions of streamed assets run before any window records, so their gpu waits precede this frame's work
+		m_assetStreamer->Update();
+		// everything queued since the last frame goes to the copy queue as one batch
+		m_uploadManager->Submit();
+		// reads of earlier frames the gpu has finished
+		m_readbackRing->Update();
+		// gpu zones of earlier frames, resolved the same way
+		m_directCommandQueue->ResolveZones();
+		m_computeCommandQueue->ResolveZones();
+		m_copyCommandQueue->ResolveZones();
+	}
+
+	for (const WindowPtr& window : readyWindows)
+	{
+		window->WaitForBackBuffer();
+		window->ProcessInput();
+
+		// delta time will be filled in by the window
+		UpdateEventArgs updateEventArgs(0.f, 0.f);
+		window->OnUpdate(updateEventArgs);
+		RenderEventArgs renderEventArgs(0.f, 0.f);
+		window->OnRender(renderEventArgs);
+	}
+
+	// one submission and one fence for the frames of all windows
+	const uint64_t fenceValue = m_directCommandQueue->ExecuteQueuedCommandLists();
+	m_readbackRing->Submit(fenceValue);
+	for (const WindowPtr& window : readyWindows)
+	{
+		window->Present(fenceValue);
+	}
+
+	if (!m_firstFramePresented)
+	{
+		m_firstFramePresented = true;
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+		char buffer[128];
+		sprintf_s(buffer, "First frame presented %.2f ms after startup\n", milliseconds);
+		::OutputDebugStringA(buffer);
+	}
+
+	return true;
+}
+
+void Application::WaitForFrameOrMessage()
+{
+	PROFILE_SCOPE("Application::WaitForFrameOrMessage");
+
+	std::vector<WindowPtr> windows;
+	std::vector<HANDLE> waitableObjects;
+	for (const auto& [hWnd, window] : g_windows)
+	{
+		if (window->HasGame())
+		{
+			windows.push_back(window);
+			waitableObjects.push_back(window->GetFrameLatencyWaitableObject());
+		}
+	}
+	assert(waitableObjects.size() < MAXIMUM_WAIT_OBJECTS && "Too many windows to wait for");
+
+	const DWORD count = static_cast<DWORD>(waitableObjects.size());
+	const DWORD result = ::MsgWaitForMultipleObjectsEx(count, waitableObjects.data(), INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+	// the wait consumed the signal of the window that woke us up
+	if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count)
+	{
+		windows[result - WAIT_OBJECT_0]->m_frameReady = true;
+	}
+}
+
 void Application::Quit(int exitCode)
 {
 	::PostQuitMessage(exitCode);
 }
 
+void Application::RecordInput(const std::wstring& path)
+{
+	m_inputRecordingPath = path;
+}
+
+bool Application::ReplayInput(const std::wstring& path, bool headless)
+{
+	auto player = std::make_unique<InputPlayer>();
+	if (!player->Load(path))
+	{
+		return false;
+	}
+	m_inputPlayer = std::move(player);
+	m_headless = headless;
+	return true;
+}
+
 Microsoft::WRL::ComPtr<ID3D12Device2> Application::GetDevice() const
 {
 	return m_device;
@@ -180,6 +427,41 @@ std::shared_ptr<CommandQueue> Application::GetCommandQueue(D3D12_COMMAND_LIST_TY
 	}
 }
 
+std::shared_ptr<UploadManager> Application::GetUploadManager() const
+{
+	return m_uploadManager;
+}
+
+std::shared_ptr<AssetStreamer> Application::GetAssetStreamer() const
+{
+	return m_assetStreamer;
+}
+
+std::shared_ptr<ReadbackRing> Application::GetReadbackRing() const
+{
+	return m_readbackRing;
+}
+
+std::shared_ptr<FrameCapture> Application::GetFrameCapture() const
+{
+	return m_frameCapture;
+}
+
+std::shared_ptr<PipelineCache> Application::GetPipelineCache() const
+{
+	return m_pipelineCache;
+}
+
+std::shared_ptr<ShaderArchive> Application::GetShaderArchive() const
+{
+	return m_shaderArchive;
+}
+
+std::shared_ptr<PipelineCompiler> Application::GetPipelineCompiler() const
+{
+	return m_pipelineCompiler;
+}
+
 Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Application::CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type)
 {
 	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
@@ -202,28 +484,60 @@ UINT Application::GetDescriptorandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE typ
 Application::Application(HINSTANCE hInst)
 	: m_hInstance(hInst)
 	, m_tearingSupported(false)
+	, m_headless(false)
+	, m_startTime(std::chrono::steady_clock::now())
+	, m_firstFramePresented(false)
 {
-	// using this awareness context allows the client area of the window to achieve 100% scaling 
-	// while still allowing non-client window content to be rendered in a DPI sensitive fashion.
-	SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
-
-	EnableDebugLayer();
-
-	RegisterWindowClass(hInst);
-
-	m_dxgiAdapter = GetAdapter(false);
-	if (m_dxgiAdapter)
-	{
-		m_device = CreateDevice(m_dxgiAdapter);
-	}
-	if (m_device)
-	{
-		m_computeCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COMPUTE);
-		m_copyCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COPY);
-		m_directCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
-
-		m_tearingSupported = CheckTearingSupport();
-	}
+	// the device is created on workers while the window class is registered, every object right after what it needs
+	StartupGraph startup;
+	startup.AddTask("Window Class",
+		[this, hInst]()
+		{
+			// using this awareness context allows the client area of the window to achieve 100% scaling 
+			// while still allowing non-client window content to be rendered in a DPI sensitive fashion.
+			// it is set per thread, so on the thread that creates the windows
+			SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+
+			RegisterWindowClass(hInst);
+		}, { }, true);
+
+	// has to be enabled before any device is created
+	const StartupGraph::TaskId debugLayer = startup.AddTask("Debug Layer", [this]() { EnableDebugLayer(); });
+	startup.AddTask("Tearing Support", [this]() { m_tearingSupported = CheckTearingSupport(); });
+	const StartupGraph::TaskId adapter = startup.AddTask("Adapter",
+		[this]()
+		{
+			m_dxgiAdapter = GetAdapter(false);
+			// nothing else can be created without it
+			ThrowIfFailed(m_dxgiAdapter ? S_OK : DXGI_ERROR_UNSUPPORTED);
+		}, { debugLayer });
+	const StartupGraph::TaskId device = startup.AddTask("Device", [this]() { m_device = CreateDevice(m_dxgiAdapter); }, { adapter });
+
+	startup.AddTask("Compute Queue",
+		[this]() { m_computeCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COMPUTE); }, { device });
+	const StartupGraph::TaskId copyQueue = startup.AddTask("Copy Queue",
+		[this]() { m_copyCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COPY); }, { device });
+	const StartupGraph::TaskId directQueue = startup.AddTask("Direct Queue",
+		[this]() { m_directCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT); }, { device });
+
+	const StartupGraph::TaskId uploadManager = startup.AddTask("Upload Manager",
+		[this]() { m_uploadManager = std::make_shared<UploadManager>(m_device, m_copyCommandQueue); }, { copyQueue });
+	startup.AddTask("Asset Streamer",
+		[this]() { m_assetStreamer = std::make_shared<AssetStreamer>(m_device, m_uploadManager); }, { uploadManager });
+	startup.AddTask("Frame Capture", [this]() { m_frameCapture = std::make_shared<FrameCapture>(); });
+	startup.AddTask("Shader Archive", [this]() { m_shaderArchive = std::make_shared<ShaderArchive>(g_shaderArchivePath); });
+	// reads and maps the cache file and loads the pipeline library while the queues are created
+	const StartupGraph::TaskId pipelineCache = startup.AddTask("Pipeline Cache",
+		[this]() { m_pipelineCache = std::make_shared<PipelineCache>(m_device, m_dxgiAdapter, g_pipelineCachePath); }, { device });
+	startup.AddTask("Pipeline Compiler",
+		[this]() { m_pipelineCompiler = std::make_shared<PipelineCompiler>(m_pipelineCache); }, { pipelineCache });
+	startup.AddTask("Readback Ring",
+		[this]() { m_readbackRing = std::make_shared<ReadbackRing>(m_device, m_directCommandQueue); }, { directQueue });
+
+	startup.Run();
+
+	std::string report = "Application startup:\n" + startup.GetReport();
+	::OutputDebugStringA(report.c_str());
 }
 
 void Application::EnableDebugLayer()
@@ -254,20 +568,48 @@ Microsoft::WRL::ComPtr<IDXGIAdapter4> Application::GetAdapter(bool useWarp)
 	}
 	else
 	{
-		SIZE_T maxDedicatedVideoMemory = 0;
+		std::vector<Microsoft::WRL::ComPtr<IDXGIAdapter1>> adapters;
 		for (UINT i = 0; dxgiFactory->EnumAdapters1(i, &dxgiAdapter1) != DXGI_ERROR_NOT_FOUND; i++)
+		{
+			adapters.push_back(dxgiAdapter1);
+		}
+
+		// creating a device on every adapter to test it is slow, the one picked last time is only checked by itself
+		AdapterCache cache = { };
+		if (ReadAdapterCache(cache))
+		{
+			for (const auto& adapter : adapters)
+			{
+				DXGI_ADAPTER_DESC1 dxgiAdapterDesc1;
+				adapter->GetDesc1(&dxgiAdapterDesc1);
+				if (MatchesAdapterCache(dxgiAdapterDesc1, cache) && SupportsDevice(adapter.Get()))
+				{
+					ThrowIfFailed(adapter.As(&dxgiAdapter4));
+					return dxgiAdapter4;
+				}
+			}
+		}
+
+		SIZE_T maxDedicatedVideoMemory = 0;
+		DXGI_ADAPTER_DESC1 selectedDesc = { };
+		for (const auto& adapter : adapters)
 		{
 			DXGI_ADAPTER_DESC1 dxgiAdapterDesc1;
-			dxgiAdapter1->GetDesc1(&dxgiAdapterDesc1);
+			adapter->GetDesc1(&dxgiAdapterDesc1);
 
 			if ((dxgiAdapterDesc1.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) == 0
-				&& SUCCEEDED(D3D12CreateDevice(dxgiAdapter1.Get(), D3D_FEATURE_LEVEL_11_0, __uuidof(ID3D12Device2), nullptr))
-				&& dxgiAdapterDesc1.DedicatedVideoMemory > maxDedicatedVideoMemory)
+				&& dxgiAdapterDesc1.DedicatedVideoMemory > maxDedicatedVideoMemory
+				&& SupportsDevice(adapter.Get()))
 			{
 				maxDedicatedVideoMemory = dxgiAdapterDesc1.DedicatedVideoMemory;
-				ThrowIfFailed(dxgiAdapter1.As(&dxgiAdapter4));
+				selectedDesc = dxgiAdapterDesc1;
+				ThrowIfFailed(adapter.As(&dxgiAdapter4));
 			}
 		}
+		if (dxgiAdapter4)
+		{
+			WriteAdapterCache(selectedDesc);
+		}
 	}
 
 	return dxgiAdapter4;
@@ -395,14 +737,25 @@ MouseButtonEventArgs::MouseButton DecodeMouseButton(UINT messageID)
 	return mouseButton;
 }
 
+InputEvent MakeMouseEvent(InputEventType::Type type, WPARAM keyStates, int x, int y)
+{
+	InputEvent event = { };
+	event.time = InputQueue::GetTime();
+	event.type = type;
+	event.modifiers |= (keyStates & MK_SHIFT) ? InputModifier::Shift : 0;
+	event.modifiers |= (keyStates & MK_CONTROL) ? InputModifier::Control : 0;
+	event.modifiers |= (keyStates & MK_LBUTTON) ? InputModifier::LeftButton : 0;
+	event.modifiers |= (keyStates & MK_MBUTTON) ? InputModifier::MiddleButton : 0;
+	event.modifiers |= (keyStates & MK_RBUTTON) ? InputModifier::RightButton : 0;
+	event.x = static_cast<int16_t>(x);
+	event.y = static_cast<int16_t>(y);
+	return event;
+}
+
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
-	WindowPtr window;
-	auto it = g_windows.find(hwnd);
-	if (it != g_windows.end())
-	{
-		window = it->second;
-	}
+	// set once the window is created, input messages are only queued here and handled by the game once per frame
+	Window* window = reinterpret_cast<Window*>(::GetWindowLongPtrW(hwnd, GWLP_USERDATA));
 
 	if (window)
 	{
@@ -411,40 +764,34 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
 		{
 		case WM_PAINT:
 		{
-			// delta time will be filled in by the window
-			UpdateEventArgs updateEventArgs(0.f, 0.f);
-			window->OnUpdate(updateEventArgs);
-			RenderEventArgs renderEventArgs(0.f, 0.f);
-			window->OnRender(renderEventArgs);
+			// frames are rendered by the application loop for all windows together
+			::ValidateRect(hwnd, nullptr);
 		}
 		break;
 		case WM_SYSKEYDOWN:
 		case WM_KEYDOWN:
 		{
+			InputEvent event = { };
+			event.time = InputQueue::GetTime();
+			event.type = InputEventType::KeyPressed;
+			event.code = static_cast<uint16_t>(wParam);
 			MSG charMsg;
 			// unicode char (UTF-16)
-			unsigned int c = 0;
 			if (::PeekMessage(&charMsg, hwnd, 0, 0, PM_NOREMOVE) && charMsg.message == WM_CHAR)
 			{
 				::GetMessage(&charMsg, hwnd, 0, 0);
-				c = static_cast<unsigned int>(charMsg.wParam);
+				event.character = static_cast<uint32_t>(charMsg.wParam);
 			}
-			bool shift = (GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0;
-			bool control = (GetAsyncKeyState(VK_CONTROL) & 0x8000) != 0;
-			bool alt = (GetAsyncKeyState(VK_MENU) & 0x8000) != 0;
-			KeyCode::Key key = (KeyCode::Key)wParam;
-			KeyEventArgs keyEventArgs(key, c, KeyEventArgs::Pressed, shift, control, alt);
-			window->OnKeyPressed(keyEventArgs);
+			window->PushInput(event);
 		}
 		break;
 		case WM_SYSKEYUP:
 		case WM_KEYUP:
 		{
-			bool shift = (GetAsyncKeyState(VK_SHIFT) & 0x8000) != 0;
-			bool control = (GetAsyncKeyState(VK_CONTROL) & 0x8000) != 0;
-			bool alt = (GetAsyncKeyState(VK_MENU) & 0x8000) != 0;
-			KeyCode::Key key = (KeyCode::Key)wParam;
-			unsigned int c = 0;
+			InputEvent event = { };
+			event.time = InputQueue::GetTime();
+			event.type = InputEventType::KeyReleased;
+			event.code = static_cast<uint16_t>(wParam);
 			unsigned int scanCode = (lParam & 0x00FF0000) >> 16;
 
 			// Determine which key was released by converting the key code and the scan code
@@ -455,90 +802,59 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
 			wchar_t translatedCharacters[4];
 			if (int result = ToUnicodeEx(static_cast<UINT>(wParam), scanCode, keyboardState, translatedCharacters, 4, 0, NULL) > 0)
 			{
-				c = translatedCharacters[0];
+				event.character = translatedCharacters[0];
 			}
-
-			KeyEventArgs keyEventArgs(key, c, KeyEventArgs::Released, shift, control, alt);
-			window->OnKeyReleased(keyEventArgs);
+			window->PushInput(event);
 		}
 		break;
 		// default window procedure will play system notification sound upon pressing alt+enter if this message is not handled
 		case WM_SYSCHAR:
 			break;
+		case WM_KILLFOCUS:
+		{
+			InputEvent event = { };
+			event.time = InputQueue::GetTime();
+			event.type = InputEventType::FocusLost;
+			window->PushInput(event);
+		}
+		break;
 		case WM_MOUSEMOVE:
 		{
-			bool lButton = (wParam & MK_LBUTTON) != 0;
-			bool rButton = (wParam & MK_RBUTTON) != 0;
-			bool mButton = (wParam & MK_MBUTTON) != 0;
-			bool shift = (wParam & MK_SHIFT) != 0;
-			bool control = (wParam & MK_CONTROL) != 0;
-
-			int x = ((int)(short)LOWORD(lParam));
-			int y = ((int)(short)HIWORD(lParam));
-
-			MouseMotionEventArgs mouseMotionEventArgs(lButton, mButton, rButton, control, shift, x, y);
-			window->OnMouseMoved(mouseMotionEventArgs);
+			window->PushInput(MakeMouseEvent(InputEventType::MouseMoved, wParam, (int)(short)LOWORD(lParam), (int)(short)HIWORD(lParam)));
 		}
 		break;
 		case WM_LBUTTONDOWN:
 		case WM_RBUTTONDOWN:
 		case WM_MBUTTONDOWN:
 		{
-			bool lButton = (wParam & MK_LBUTTON) != 0;
-			bool rButton = (wParam & MK_RBUTTON) != 0;
-			bool mButton = (wParam & MK_MBUTTON) != 0;
-			bool shift = (wParam & MK_SHIFT) != 0;
-			bool control = (wParam & MK_CONTROL) != 0;
-
-			int x = ((int)(short)LOWORD(lParam));
-			int y = ((int)(short)HIWORD(lParam));
-
-			MouseButtonEventArgs mouseButtonEventArgs(DecodeMouseButton(message), MouseButtonEventArgs::Pressed, lButton, mButton, rButton, control, shift, x, y);
-			window->OnMouseButtonPressed(mouseButtonEventArgs);
+			InputEvent event = MakeMouseEvent(InputEventType::MouseButtonPressed, wParam, (int)(short)LOWORD(lParam), (int)(short)HIWORD(lParam));
+			event.code = static_cast<uint16_t>(DecodeMouseButton(message));
+			window->PushInput(event);
 		}
 		break;
 		case WM_LBUTTONUP:
 		case WM_RBUTTONUP:
 		case WM_MBUTTONUP:
 		{
-			bool lButton = (wParam & MK_LBUTTON) != 0;
-			bool rButton = (wParam & MK_RBUTTON) != 0;
-			bool mButton = (wParam & MK_MBUTTON) != 0;
-			bool shift = (wParam & MK_SHIFT) != 0;
-			bool control = (wParam & MK_CONTROL) != 0;
-
-			int x = ((int)(short)LOWORD(lParam));
-			int y = ((int)(short)HIWORD(lParam));
-
-			MouseButtonEventArgs mouseButtonEventArgs(DecodeMouseButton(message), MouseButtonEventArgs::Released, lButton, mButton, rButton, control, shift, x, y);
-			window->OnMouseButtonReleased(mouseButtonEventArgs);
+			InputEvent event = MakeMouseEvent(InputEventType::MouseButtonReleased, wParam, (int)(short)LOWORD(lParam), (int)(short)HIWORD(lParam));
+			event.code = static_cast<uint16_t>(DecodeMouseButton(message));
+			window->PushInput(event);
 		}
 		break;
 		case WM_MOUSEWHEEL:
 		{
-			// The distance the mouse wheel is rotated.
-			// A positive value indicates the wheel was rotated to the right.
-			// A negative value indicates the wheel was rotated to the left.
-			float zDelta = ((int)(short)HIWORD(wParam)) / (float)WHEEL_DELTA;
-			short keyStates = (short)LOWORD(wParam);
-
-			bool lButton = (keyStates & MK_LBUTTON) != 0;
-			bool rButton = (keyStates & MK_RBUTTON) != 0;
-			bool mButton = (keyStates & MK_MBUTTON) != 0;
-			bool shift = (keyStates & MK_SHIFT) != 0;
-			bool control = (keyStates & MK_CONTROL) != 0;
-
-			int x = ((int)(short)LOWORD(lParam));
-			int y = ((int)(short)HIWORD(lParam));
-
 			// Convert the screen coordinates to client coordinates.
 			POINT clientToScreenPoint;
-			clientToScreenPoint.x = x;
-			clientToScreenPoint.y = y;
+			clientToScreenPoint.x = ((int)(short)LOWORD(lParam));
+			clientToScreenPoint.y = ((int)(short)HIWORD(lParam));
 			ScreenToClient(hwnd, &clientToScreenPoint);
 
-			MouseWheelEventArgs mouseWheelEventArgs(zDelta, lButton, mButton, rButton, control, shift, (int)clientToScreenPoint.x, (int)clientToScreenPoint.y);
-			window->OnMouseWheel(mouseWheelEventArgs);
+			InputEvent event = MakeMouseEvent(InputEventType::MouseWheel, LOWORD(wParam), clientToScreenPoint.x, clientToScreenPoint.y);
+			// The distance the mouse wheel is rotated.
+			// A positive value indicates the wheel was rotated to the right.
+			// A negative value indicates the wheel was rotated to the left.
+			event.wheelDelta = ((int)(short)HIWORD(wParam)) / (float)WHEEL_DELTA;
+			window->PushInput(event);
 		}
 		break;
 		case WM_SIZE:
@@ -554,6 +870,8 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
 		break;
 		case WM_DESTROY:
 		{
+			// the window may be destroyed with its last reference below
+			::SetWindowLongPtrW(hwnd, GWLP_USERDATA, 0);
 			RemoveWindow(hwnd);
 
 			if (g_windows.empty())
@@ -2,8 +2,20 @@
 
 #include <cheese_grater_common.hpp>
 
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class AssetStreamer;
 class CommandQueue;
+class FrameCapture;
 class Game;
+class InputPlayer;
+class PipelineCache;
+class PipelineCompiler;
+class ReadbackRing;
+class ShaderArchive;
+class UploadManager;
 class Window;
 
 class Application
@@ -36,10 +48,36 @@ public:
 	/// Run the application loop 
 	/// @returns Error code if error occured
 	int Run(std::shared_ptr<Game> game);
+	/// Run the application loop for several games, each rendering into its own window. The frames of all windows are
+	/// submitted together while every window keeps its own vsync and frame pacing. Windows are created while the
+	/// content of the games loads on a worker thread, the startup timeline is written to the debug output.
+	/// @returns Error code if error occured
+	int Run(const std::vector<std::shared_ptr<Game>>& games);
 	void Quit(int exitCode);
 
+	/// Record the input of the first window created into a file that ReplayInput plays back
+	void RecordInput(const std::wstring& path);
+	/// Play recorded input back in the first window created instead of live input, and quit once it is replayed
+	/// @param headless Never show the window
+	/// @returns False if the file is not a recording
+	bool ReplayInput(const std::wstring& path, bool headless);
+
 	Microsoft::WRL::ComPtr<ID3D12Device2> GetDevice() const;
 	std::shared_ptr<CommandQueue> GetCommandQueue(D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT) const;
+	/// Batched uploads on the copy queue, submitted at the start of every frame
+	std::shared_ptr<UploadManager> GetUploadManager() const;
+	/// Background loading through the upload manager, updated at the start of every frame
+	std::shared_ptr<AssetStreamer> GetAssetStreamer() const;
+	/// Reads back from the direct queue, resolved at the start of every frame once the gpu is done with them
+	std::shared_ptr<ReadbackRing> GetReadbackRing() const;
+	/// Image files written from read back frames on worker threads
+	std::shared_ptr<FrameCapture> GetFrameCapture() const;
+	/// Root signatures and pipelines, kept on disk between runs
+	std::shared_ptr<PipelineCache> GetPipelineCache() const;
+	/// Compiled shaders by name, mapped from the archive built with the shaders
+	std::shared_ptr<ShaderArchive> GetShaderArchive() const;
+	/// Compiles pipelines on worker threads, so loading never waits for the driver
+	std::shared_ptr<PipelineCompiler> GetPipelineCompiler() const;
 
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type);
 	UINT GetDescriptorandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE type) const;
@@ -58,6 +96,12 @@ private:
 	void RegisterWindowClass(HINSTANCE hInst);
 	void EnableDebugLayer();
 
+	/// Update and render every window whose swapchain accepts another frame, then submit and present them together
+	/// @returns False if no window was ready
+	bool RenderFrame();
+	/// Sleep until a window can take another frame or a message arrives
+	void WaitForFrameOrMessage();
+
 	HINSTANCE m_hInstance;
 
 	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
@@ -66,8 +110,27 @@ private:
 	std::shared_ptr<CommandQueue> m_computeCommandQueue;
 	std::shared_ptr<CommandQueue> m_copyCommandQueue;
 	std::shared_ptr<CommandQueue> m_directCommandQueue;
+	// declared after the queues so they are destroyed before them, the streamer before the uploads it queues
+	std::shared_ptr<UploadManager> m_uploadManager;
+	std::shared_ptr<AssetStreamer> m_assetStreamer;
+	// the ring resolves or drops its reads before the captures waiting for them are finished
+	std::shared_ptr<FrameCapture> m_frameCapture;
+	std::shared_ptr<ReadbackRing> m_readbackRing;
+	std::shared_ptr<PipelineCache> m_pipelineCache;
+	std::shared_ptr<ShaderArchive> m_shaderArchive;
+	// destroyed first, its workers use the cache and the shaders in the archive
+	std::shared_ptr<PipelineCompiler> m_pipelineCompiler;
 
 	bool m_tearingSupported;
 
+	// handed to the first window when it is created
+	std::wstring m_inputRecordingPath;
+	std::unique_ptr<InputPlayer> m_inputPlayer;
+	bool m_headless;
+
+	// startup is reported up to the first presented frame
+	std::chrono::steady_clock::time_point m_startTime;
+	bool m_firstFramePresented;
+
 };
 
@@ -0,0 +1,239 @@
+#include "asset_streamer.hpp"
+
+#include <resource_state_tracker.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+AssetStreamer::AssetStreamer(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<UploadManager> uploadManager,
+	uint32_t threadCount, uint64_t uploadBudget)
+	: m_device(device)
+	, m_uploadManager(uploadManager)
+	, m_uploadBudget(uploadBudget)
+	, m_quit(false)
+	, m_nextId(INVALID_REQUEST + 1)
+{
+	assert(threadCount > 0 && "Streaming needs at least one thread");
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&AssetStreamer::WorkerMain, this);
+	}
+}
+
+AssetStreamer::~AssetStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_workAvailable.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+AssetStreamer::RequestId AssetStreamer::Request(float priority, LoadFunction load, CompletionFunction completed)
+{
+	RequestId id;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		id = m_nextId++;
+		m_requests.emplace(id, StreamRequest{ RequestState::Queued, priority, false, std::move(load), std::move(completed), { } });
+		m_queued.insert({ priority, id });
+	}
+	m_workAvailable.notify_one();
+	return id;
+}
+
+void AssetStreamer::SetPriority(RequestId id, float priority)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_requests.find(id);
+	if (it == m_requests.end() || it->second.priority == priority)
+	{
+		return;
+	}
+
+	StreamRequest& request = it->second;
+	std::set<std::pair<float, RequestId>>* order = nullptr;
+	if (request.state == RequestState::Queued)
+	{
+		order = &m_queued;
+	}
+	else if (request.state == RequestState::Loaded)
+	{
+		order = &m_loaded;
+	}
+	if (order)
+	{
+		order->erase({ request.priority, id });
+		order->insert({ priority, id });
+	}
+	request.priority = priority;
+}
+
+void AssetStreamer::Cancel(RequestId id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_requests.find(id);
+	if (it == m_requests.end())
+	{
+		return;
+	}
+
+	StreamRequest& request = it->second;
+	switch (request.state)
+	{
+	case RequestState::Queued:
+		m_queued.erase({ request.priority, id });
+		m_requests.erase(it);
+		break;
+	case RequestState::Loading:
+		// the streaming thread drops it once the load returns
+		request.cancelled = true;
+		break;
+	case RequestState::Loaded:
+		m_loaded.erase({ request.priority, id });
+		m_requests.erase(it);
+		break;
+	case RequestState::Failed:
+		m_failed.erase(std::find(m_failed.begin(), m_failed.end(), id));
+		m_requests.erase(it);
+		break;
+	}
+}
+
+void AssetStreamer::Update()
+{
+	std::vector<CompletionFunction> failed;
+	std::vector<std::pair<CompletionFunction, std::vector<StagedBuffer>>> submitted;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (RequestId id : m_failed)
+		{
+			auto it = m_requests.find(id);
+			failed.push_back(std::move(it->second.completed));
+			m_requests.erase(it);
+		}
+		m_failed.clear();
+
+		uint64_t submittedBytes = 0;
+		while (!m_loaded.empty() && (submitted.empty() || submittedBytes < m_uploadBudget))
+		{
+			const RequestId id = m_loaded.begin()->second;
+			m_loaded.erase(m_loaded.begin());
+
+			auto it = m_requests.find(id);
+			for (const StagedBuffer& buffer : it->second.buffers)
+			{
+				submittedBytes += buffer.upload.size;
+			}
+			submitted.emplace_back(std::move(it->second.completed), std::move(it->second.buffers));
+			m_requests.erase(it);
+		}
+	}
+
+	// completions may queue new requests, so they run without the lock
+	for (CompletionFunction& completed : failed)
+	{
+		completed(false, 0);
+	}
+	if (submitted.empty())
+	{
+		return;
+	}
+
+	// buffers are created in the common state, which is what the upload batches expect
+	for (auto& [completed, buffers] : submitted)
+	{
+		uint64_t fenceValue = 0;
+		for (const StagedBuffer& buffer : buffers)
+		{
+			// only buffers that get uploaded are tracked, cancelled and failed loads leave nothing behind
+			ResourceStateTracker::AddGlobalResourceState(buffer.destination.Get(), D3D12_RESOURCE_STATE_COMMON);
+			fenceValue = std::max(fenceValue, m_uploadManager->CopyBuffer(buffer.destination.Get(), 0, buffer.upload));
+		}
+		completed(true, fenceValue);
+	}
+}
+
+size_t AssetStreamer::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requests.size();
+}
+
+void AssetStreamer::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_workAvailable.wait(lock, [this]() { return m_quit || !m_queued.empty(); });
+		if (m_quit)
+		{
+			return;
+		}
+
+		const RequestId id = m_queued.begin()->second;
+		m_queued.erase(m_queued.begin());
+		StreamRequest& request = m_requests.at(id);
+		request.state = RequestState::Loading;
+		LoadFunction load = std::move(request.load);
+
+		lock.unlock();
+		std::vector<StagedBuffer> staged;
+		const AllocateBufferFunction allocateBuffer = [this, &staged](uint64_t size, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer)
+			{
+				return AllocateBuffer(size, buffer, staged);
+			};
+		bool loaded;
+		try
+		{
+			loaded = load(allocateBuffer);
+		}
+		catch (...)
+		{
+			// e.g. a buffer that could not be created, the request fails instead of the streaming thread
+			loaded = false;
+		}
+		lock.lock();
+
+		// requests are only erased by Cancel while loading if they are marked, so it is still there
+		auto it = m_requests.find(id);
+		if (it->second.cancelled)
+		{
+			m_requests.erase(it);
+		}
+		else if (!loaded)
+		{
+			it->second.state = RequestState::Failed;
+			m_failed.push_back(id);
+		}
+		else
+		{
+			it->second.state = RequestState::Loaded;
+			it->second.buffers = std::move(staged);
+			m_loaded.insert({ it->second.priority, id });
+		}
+	}
+}
+
+void* AssetStreamer::AllocateBuffer(uint64_t size, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, std::vector<StagedBuffer>& staged)
+{
+	// the device is free threaded, resources can be created on the streaming threads
+	const CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+	const CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+	StagedBuffer stagedBuffer;
+	ThrowIfFailed(m_device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+		D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&stagedBuffer.destination)));
+	// upload memory is write combined: loaders only write it
+	stagedBuffer.upload = m_uploadManager->Allocate(size);
+
+	buffer = stagedBuffer.destination;
+	void* data = stagedBuffer.upload.data;
+	staged.push_back(std::move(stagedBuffer));
+	return data;
+}
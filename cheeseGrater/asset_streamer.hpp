@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <upload_manager.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Loads assets in the background and uploads them through the UploadManager. Streaming threads read and decode
+/// requests in priority order straight into upload memory; Update, called once per frame, queues the copies of loaded
+/// requests into the next upload batch. Every request completes with the upload fence value its buffers are ready
+/// at, queues using them wait for it on the gpu with UploadManager::GpuWait, so neither startup nor frames block.
+class AssetStreamer
+{
+public:
+	using RequestId = uint64_t;
+
+	/// Creates a default heap buffer in the common state and returns mapped upload memory for its contents, which the
+	/// streamer copies into it
+	using AllocateBufferFunction = std::function<void*(uint64_t size, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer)>;
+	/// Runs on a streaming thread: reads and decodes an asset, writing gpu data through allocateBuffer. Results on the
+	/// cpu side may be written to memory owned by the requester, it must not read them before the completion.
+	/// @returns False if the asset could not be loaded, the request also fails if the function throws
+	using LoadFunction = std::function<bool(const AllocateBufferFunction& allocateBuffer)>;
+	/// Runs on the main thread in Update. Queues using the buffers have to wait for fenceValue with UploadManager::GpuWait.
+	using CompletionFunction = std::function<void(bool loaded, uint64_t fenceValue)>;
+
+	static constexpr RequestId INVALID_REQUEST = 0;
+
+	/// @param uploadBudget Bytes submitted per Update, at least one request is always submitted
+	AssetStreamer(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<UploadManager> uploadManager,
+		uint32_t threadCount = 2, uint64_t uploadBudget = 32 * 1024 * 1024);
+	~AssetStreamer();
+
+	AssetStreamer(const AssetStreamer& other) = delete;
+	AssetStreamer& operator=(const AssetStreamer& other) = delete;
+
+	/// Requests with lower priority are loaded and uploaded first, e.g. the distance to the camera, increased for
+	/// objects that are not visible
+	RequestId Request(float priority, LoadFunction load, CompletionFunction completed);
+	/// Reorder a request that is waiting to be loaded or uploaded
+	void SetPriority(RequestId id, float priority);
+	/// Drop a request. A running load finishes, but nothing is uploaded and the completion is not called.
+	void Cancel(RequestId id);
+
+	/// Queue the uploads of loaded requests within the upload budget and report completions. Main thread only.
+	void Update();
+
+	/// @returns Requests that have not completed yet
+	size_t GetPendingCount() const;
+
+private:
+	enum class RequestState
+	{
+		Queued,
+		Loading,
+		Loaded,
+		Failed,
+	};
+
+	struct StagedBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> destination;
+		UploadManager::Allocation upload;
+	};
+
+	struct StreamRequest
+	{
+		RequestState state;
+		float priority;
+		bool cancelled;
+		LoadFunction load;
+		CompletionFunction completed;
+		std::vector<StagedBuffer> buffers;
+	};
+
+	void WorkerMain();
+	void* AllocateBuffer(uint64_t size, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, std::vector<StagedBuffer>& staged);
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+	std::shared_ptr<UploadManager> m_uploadManager;
+	uint64_t m_uploadBudget;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	bool m_quit;
+	RequestId m_nextId;
+	std::unordered_map<RequestId, StreamRequest> m_requests;
+	// ordered by priority, then by age
+	std::set<std::pair<float, RequestId>> m_queued;
+	std::set<std::pair<float, RequestId>> m_loaded;
+	std::vector<RequestId> m_failed;
+
+	std::vector<std::thread> m_workers;
+};
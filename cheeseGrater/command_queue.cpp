@@ -1,9 +1,13 @@
 #include "command_queue.hpp"
 
+#include <profiler.hpp>
+#include <resource_state_tracker.hpp>
+
 CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type)
 	: m_device(device)
 	, m_commandListType(type)
 	, m_fenceValue(0)
+	, m_timestampFrequency(0)
 {
 	D3D12_COMMAND_QUEUE_DESC desc = { };
 	desc.Type = type;
@@ -16,6 +20,31 @@ CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_C
 
 	m_fenceEvent = ::CreateEventW(NULL, FALSE, FALSE, NULL);
 	assert(m_fenceEvent && "Failed to create fence event");
+
+	// copy queues can only measure time on some hardware
+	bool timestampsSupported = true;
+	if (type == D3D12_COMMAND_LIST_TYPE_COPY)
+	{
+		D3D12_FEATURE_DATA_D3D12_OPTIONS3 options = { };
+		timestampsSupported = SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS3, &options, sizeof(options)))
+			&& options.CopyQueueTimestampQueriesSupported;
+	}
+	if (timestampsSupported && SUCCEEDED(m_d3d12commandQueue->GetTimestampFrequency(&m_timestampFrequency)))
+	{
+		D3D12_QUERY_HEAP_DESC queryHeapDesc = { };
+		queryHeapDesc.Type = (type == D3D12_COMMAND_LIST_TYPE_COPY) ? D3D12_QUERY_HEAP_TYPE_COPY_QUEUE_TIMESTAMP : D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		queryHeapDesc.Count = TIMESTAMP_QUERY_CAPACITY;
+		ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampQueryHeap)));
+
+		const CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+		const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(TIMESTAMP_QUERY_CAPACITY * sizeof(uint64_t));
+		ThrowIfFailed(device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_timestampReadbackBuffer)));
+
+		const char* trackName = (type == D3D12_COMMAND_LIST_TYPE_DIRECT) ? "GPU direct queue"
+			: (type == D3D12_COMMAND_LIST_TYPE_COMPUTE) ? "GPU compute queue" : "GPU copy queue";
+		m_gpuZones = std::make_unique<GpuTimestampZones>(TIMESTAMP_QUERY_CAPACITY, Profiler::AddTrack(trackName));
+	}
 }
 
 uint64_t CommandQueue::Signal()
@@ -24,10 +53,16 @@ uint64_t CommandQueue::Signal()
 	return m_fenceValue;
 }
 
+uint64_t CommandQueue::GetLastFenceValue() const
+{
+	return m_fenceValue;
+}
+
 void CommandQueue::WaitForFenceValue(uint64_t fenceValue)
 {
 	if (!IsFenceComplete(fenceValue))
 	{
+		PROFILE_SCOPE("CommandQueue::WaitForFenceValue");
 		m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent);
 		::WaitForSingleObject(m_fenceEvent, DWORD_MAX);
 	}
@@ -43,8 +78,15 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
 	return m_fence->GetCompletedValue() >= fenceValue;
 }
 
+void CommandQueue::Wait(const CommandQueue& other, uint64_t fenceValue)
+{
+	ThrowIfFailed(m_d3d12commandQueue->Wait(other.m_fence.Get(), fenceValue));
+}
+
 Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList()
 {
+	PROFILE_SCOPE("CommandQueue::GetCommandList");
+
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
 
@@ -79,28 +121,189 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 
 uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-	commandList->Close();
+	return ExecuteCommandLists({ commandList });
+}
+
+uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ResourceStateTracker& resourceStateTracker)
+{
+	PROFILE_SCOPE("CommandQueue::ExecuteCommandList");
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> commandLists;
+
+	uint64_t fenceValue;
+	{
+		const std::unique_lock<std::mutex> globalStateLock = ResourceStateTracker::LockGlobalState();
+
+		// transitions whose state before was unknown while recording are resolved now and run in their own command list first
+		if (resourceStateTracker.HasPendingResourceBarriers())
+		{
+			auto pendingCommandList = GetCommandList();
+			resourceStateTracker.FlushPendingResourceBarriers(pendingCommandList);
+			commandLists.push_back(pendingCommandList);
+		}
+		resourceStateTracker.FlushResourceBarriers(commandList);
+		commandLists.push_back(commandList);
+
+		fenceValue = ExecuteCommandLists(commandLists);
+		resourceStateTracker.CommitFinalResourceStates();
+	}
+
+	resourceStateTracker.Reset();
+	return fenceValue;
+}
+
+void CommandQueue::QueueCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ResourceStateTracker& resourceStateTracker)
+{
+	PROFILE_SCOPE("CommandQueue::QueueCommandList");
+
+	{
+		const std::unique_lock<std::mutex> globalStateLock = ResourceStateTracker::LockGlobalState();
+
+		if (resourceStateTracker.HasPendingResourceBarriers())
+		{
+			auto pendingCommandList = GetCommandList();
+			resourceStateTracker.FlushPendingResourceBarriers(pendingCommandList);
+			m_queuedCommandLists.push_back(pendingCommandList);
+		}
+		resourceStateTracker.FlushResourceBarriers(commandList);
+		m_queuedCommandLists.push_back(commandList);
+
+		// queued command lists run before anything executed after them, so the final states can be published right away
+		resourceStateTracker.CommitFinalResourceStates();
+	}
+
+	resourceStateTracker.Reset();
+}
+
+uint64_t CommandQueue::ExecuteQueuedCommandLists()
+{
+	return ExecuteCommandLists({ });
+}
+
+uint64_t CommandQueue::ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists)
+{
+	PROFILE_SCOPE("CommandQueue::ExecuteCommandLists");
+
+	// queued command lists were recorded earlier and have already published their resource states, so they go first
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> orderedCommandLists = std::move(m_queuedCommandLists);
+	m_queuedCommandLists.clear();
+	orderedCommandLists.insert(orderedCommandLists.end(), commandLists.begin(), commandLists.end());
+
+	if (m_gpuZones && !orderedCommandLists.empty())
+	{
+		// the zones of all command lists are resolved at the end of the last one, after every zone has ended
+		std::vector<const void*> zoneCommandLists;
+		for (const auto& commandList : orderedCommandLists)
+		{
+			zoneCommandLists.push_back(commandList.Get());
+		}
+		m_timestampResolveRanges.clear();
+		m_gpuZones->Submit(zoneCommandLists.data(), zoneCommandLists.size(), m_fenceValue + 1, m_timestampResolveRanges);
+		for (const GpuQueryRange& range : m_timestampResolveRanges)
+		{
+			orderedCommandLists.back()->ResolveQueryData(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, range.first,
+				range.count, m_timestampReadbackBuffer.Get(), range.first * sizeof(uint64_t));
+		}
+	}
+
+	std::vector<ID3D12CommandList*> d3d12CommandLists;
+	std::vector<ID3D12CommandAllocator*> commandAllocators;
 
-	ID3D12CommandAllocator* commandAllocator;
-	UINT dataSize = sizeof(commandAllocator);
-	ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+	for (const auto& commandList : orderedCommandLists)
+	{
+		commandList->Close();
 
-	ID3D12CommandList* const ppCommandLists[] = { commandList.Get() };
+		ID3D12CommandAllocator* commandAllocator;
+		UINT dataSize = sizeof(commandAllocator);
+		ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+
+		d3d12CommandLists.push_back(commandList.Get());
+		commandAllocators.push_back(commandAllocator);
+	}
 
-	m_d3d12commandQueue->ExecuteCommandLists(1, ppCommandLists);
+	if (!d3d12CommandLists.empty())
+	{
+		m_d3d12commandQueue->ExecuteCommandLists(static_cast<UINT>(d3d12CommandLists.size()), d3d12CommandLists.data());
+	}
 
 	uint64_t fenceValue = Signal();
 
-	m_commandAllocatorQueue.emplace(CommandAllocatorEntry(fenceValue, commandAllocator));
-	m_commandListQueue.emplace(commandList);
+	for (size_t i = 0; i < orderedCommandLists.size(); i++)
+	{
+		m_commandAllocatorQueue.emplace(CommandAllocatorEntry(fenceValue, commandAllocators[i]));
+		m_commandListQueue.emplace(orderedCommandLists[i]);
+
+		// The ownership of the command allocator has been transferred to the Microsoft::WRL::ComPtr
+		// in the command allocator queue. It is safe to release the reference 
+		// in this temporary COM pointer here.
+		commandAllocators[i]->Release();
+	}
 
-	// The ownership of the command allocator has been transferred to the Microsoft::WRL::ComPtr
-	// in the command allocator queue. It is safe to release the reference 
-	// in this temporary COM pointer here.
-	commandAllocator->Release();
 	return fenceValue;
 }
 
+uint32_t CommandQueue::BeginZone(ID3D12GraphicsCommandList2* commandList, const char* name)
+{
+	if (!m_gpuZones || !Profiler::IsEnabled())
+	{
+		return GpuTimestampZones::INVALID_ZONE;
+	}
+
+	const uint32_t zone = m_gpuZones->Begin(name, commandList);
+	if (zone != GpuTimestampZones::INVALID_ZONE)
+	{
+		commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, zone);
+	}
+	return zone;
+}
+
+uint32_t CommandQueue::BeginZone(ID3D12GraphicsCommandList2* commandList, const std::string& name)
+{
+	if (!m_gpuZones || !Profiler::IsEnabled())
+	{
+		return GpuTimestampZones::INVALID_ZONE;
+	}
+	return BeginZone(commandList, Profiler::InternName(name));
+}
+
+void CommandQueue::EndZone(ID3D12GraphicsCommandList2* commandList, uint32_t zone)
+{
+	if (zone != GpuTimestampZones::INVALID_ZONE)
+	{
+		commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, GpuTimestampZones::GetEndQuery(zone));
+	}
+}
+
+void CommandQueue::ResolveZones()
+{
+	const uint64_t completedFenceValue = m_fence->GetCompletedValue();
+	if (!m_gpuZones || !m_gpuZones->IsResolvable(completedFenceValue))
+	{
+		return;
+	}
+
+	// the calibration pairs the gpu timestamp with the performance counter, which is moved to the profiler's clock
+	UINT64 performanceCounter;
+	GpuClockCalibration calibration = { };
+	ThrowIfFailed(m_d3d12commandQueue->GetClockCalibration(&calibration.gpuTimestamp, &performanceCounter));
+	calibration.cpuTimestamp = Profiler::GetTimestamp();
+	LARGE_INTEGER now;
+	LARGE_INTEGER performanceFrequency;
+	::QueryPerformanceCounter(&now);
+	::QueryPerformanceFrequency(&performanceFrequency);
+	calibration.gpuFrequency = static_cast<double>(m_timestampFrequency);
+	calibration.cpuFrequency = Profiler::GetTimestampFrequency();
+	const double sinceCalibration = static_cast<double>(now.QuadPart - static_cast<LONGLONG>(performanceCounter)) / performanceFrequency.QuadPart;
+	calibration.cpuTimestamp -= static_cast<uint64_t>(sinceCalibration * calibration.cpuFrequency);
+
+	void* data;
+	const CD3DX12_RANGE readRange(0, TIMESTAMP_QUERY_CAPACITY * sizeof(uint64_t));
+	ThrowIfFailed(m_timestampReadbackBuffer->Map(0, &readRange, &data));
+	m_gpuZones->Resolve(completedFenceValue, static_cast<const uint64_t*>(data), calibration);
+	const CD3DX12_RANGE writeRange(0, 0);
+	m_timestampReadbackBuffer->Unmap(0, &writeRange);
+}
+
 Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandQueue::CreateCommandAllocator()
 {
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
@@ -1,22 +1,62 @@
 #pragma once
 #include <cheese_grater_common.hpp>
 
+#include <gpu_timestamp_zones.hpp>
+#include <profiler.hpp>
+
+#include <memory>
 #include <queue>
+#include <string>
+#include <vector>
+
+class ResourceStateTracker;
 
 class CommandQueue
 {
 public:
+	/// Timestamp queries of the gpu zones in flight, every zone takes two
+	static constexpr uint32_t TIMESTAMP_QUERY_CAPACITY = 4096;
+
 	CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type);
 	~CommandQueue() = default;
 
 	uint64_t Signal();
+	/// @returns Fence value of the last signal, all work submitted so far is done once the fence reaches it
+	uint64_t GetLastFenceValue() const;
 	void WaitForFenceValue(uint64_t fenceValue);
 	void Flush();
 	bool IsFenceComplete(uint64_t fenceValue);
+	/// Make this queue wait on the GPU until another queue has reached a fence value, the CPU does not block
+	void Wait(const CommandQueue& other, uint64_t fenceValue);
 
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 	/// @return Fence value to wait for this command list
 	uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+	/// Resolves the tracker's pending barriers against the global resource state, executes them right before
+	/// the command list and publishes the states the command list leaves its resources in
+	/// @return Fence value to wait for this command list
+	uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ResourceStateTracker& resourceStateTracker);
+	/// Execute command lists in order with a single ExecuteCommandLists call
+	/// @return Fence value to wait for all of the command lists
+	uint64_t ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists);
+	/// Like ExecuteCommandList with a tracker, but the command lists are held back and run at the start of the next
+	/// execution on this queue, so the frames of several windows reach the GPU with a single ExecuteCommandLists call
+	void QueueCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ResourceStateTracker& resourceStateTracker);
+	/// @return Fence value to wait for all queued command lists
+	uint64_t ExecuteQueuedCommandLists();
+
+	/// Start measuring the gpu time of the commands recorded into a command list of this queue from now on, up to
+	/// EndZone. Zones are added to the profiler's track of the queue a few frames after they executed; nothing is
+	/// measured while the profiler is disabled or if the queue can not measure time.
+	/// @param name Has to stay valid, a string literal
+	/// @returns The zone to end, GpuTimestampZones::INVALID_ZONE if it is not measured
+	uint32_t BeginZone(ID3D12GraphicsCommandList2* commandList, const char* name);
+	/// Like BeginZone with a string literal, for names that change, e.g. of render graph passes
+	uint32_t BeginZone(ID3D12GraphicsCommandList2* commandList, const std::string& name);
+	void EndZone(ID3D12GraphicsCommandList2* commandList, uint32_t zone);
+	/// Add the zones whose executions the gpu has finished to the profiler, called by the application at the start of
+	/// every frame
+	void ResolveZones();
 
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator();
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CreateCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator);
@@ -37,4 +77,42 @@ private:
 	uint64_t m_fenceValue;
 	std::queue<CommandAllocatorEntry> m_commandAllocatorQueue;
 	std::queue<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> m_commandListQueue;
+	// closed for execution but not submitted yet, see QueueCommandList
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> m_queuedCommandLists;
+
+	// null if the queue can not measure time; the readback buffer holds the resolved queries at their heap indices
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_timestampQueryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_timestampReadbackBuffer;
+	uint64_t m_timestampFrequency;
+	std::unique_ptr<GpuTimestampZones> m_gpuZones;
+	std::vector<GpuQueryRange> m_timestampResolveRanges;  // reused every execution
 };
+
+/// Measures the gpu time of the commands recorded into a command list during its lifetime as a zone of the queue
+class GpuProfileScope
+{
+public:
+	template <typename Name>
+	GpuProfileScope(CommandQueue& queue, ID3D12GraphicsCommandList2* commandList, const Name& name)
+		: m_queue(queue)
+		, m_commandList(commandList)
+		, m_zone(queue.BeginZone(commandList, name))
+	{
+	}
+
+	~GpuProfileScope()
+	{
+		m_queue.EndZone(m_commandList, m_zone);
+	}
+
+	GpuProfileScope(const GpuProfileScope& other) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope& other) = delete;
+
+private:
+	CommandQueue& m_queue;
+	ID3D12GraphicsCommandList2* m_commandList;
+	uint32_t m_zone;
+};
+
+/// Measure the gpu time of the commands recorded into the command list in the rest of the enclosing scope
+#define PROFILE_GPU_SCOPE(queue, commandList, name) GpuProfileScope PROFILE_CONCATENATE(gpuProfileScope, __LINE__)(queue, commandList, name)
@@ -0,0 +1,69 @@
+// layouts must match indirect_draw.hpp
+
+struct Instance
+{
+    matrix world;
+    float4 boundingSphere;
+    uint meshIndex;
+    uint3 padding;
+};
+
+struct MeshDraw
+{
+    uint indexCount;
+    uint startIndex;
+    int baseVertex;
+    uint padding;
+};
+
+struct IndirectCommand
+{
+    uint instanceIndex;
+    uint indexCountPerInstance;
+    uint instanceCount;
+    uint startIndexLocation;
+    int baseVertexLocation;
+    uint startInstanceLocation;
+};
+
+struct CullConstants
+{
+    float4 frustumPlanes[6];
+    uint instanceCount;
+};
+
+ConstantBuffer<CullConstants> CullConstantsCB : register(b0);
+StructuredBuffer<Instance> Instances : register(t0);
+StructuredBuffer<MeshDraw> MeshDraws : register(t1);
+AppendStructuredBuffer<IndirectCommand> IndirectCommands : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint instanceIndex = dispatchThreadID.x;
+    if (instanceIndex >= CullConstantsCB.instanceCount)
+    {
+        return;
+    }
+
+    Instance instance = Instances[instanceIndex];
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = CullConstantsCB.frustumPlanes[i];
+        if (dot(plane.xyz, instance.boundingSphere.xyz) + plane.w < -instance.boundingSphere.w)
+        {
+            return;
+        }
+    }
+
+    MeshDraw meshDraw = MeshDraws[instance.meshIndex];
+
+    IndirectCommand command;
+    command.instanceIndex = instanceIndex;
+    command.indexCountPerInstance = meshDraw.indexCount;
+    command.instanceCount = 1;
+    command.startIndexLocation = meshDraw.startIndex;
+    command.baseVertexLocation = meshDraw.baseVertex;
+    command.startInstanceLocation = 0;
+    IndirectCommands.Append(command);
+}
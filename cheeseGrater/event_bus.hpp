@@ -0,0 +1,215 @@
+#pragma once
+
+// Typed publish and subscribe for a fixed set of event types:
+//
+//     EventBus<KeyEventArgs, MouseWheelEventArgs> bus;
+//     const auto id = bus.Subscribe<KeyEventArgs, &Player::OnKey>(&player);
+//     bus.Publish(keyEventArgs);     // delivered now
+//     bus.Queue(mouseWheelEventArgs);  // delivered by the next Flush, in the order queued
+//
+// Every event type has its own contiguous array of subscribers. A subscriber is an object pointer and a function
+// generated for the member it subscribed, so delivery is a direct call through a plain function pointer: nothing is
+// virtual, reference counted or allocated per event. Queued events are kept in arrays per type that are reused, they
+// only allocate until they reach the largest batch seen.
+// Single threaded, subscribers may subscribe and unsubscribe while an event is delivered.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename... Events>
+class EventBus
+{
+	static_assert(sizeof...(Events) <= 256, "Queued events are ordered by an 8 bit type index");
+
+public:
+	/// Identifies a subscription to one event type, never 0
+	using SubscriptionId = uint32_t;
+
+	EventBus() = default;
+
+	EventBus(const EventBus& other) = delete;
+	EventBus& operator=(const EventBus& other) = delete;
+
+	/// Deliver an event type to a member function, void (Subscriber::*)(Event&), of an object that has to stay alive
+	/// until it unsubscribes. Subscribers are called in the order they subscribed.
+	template <typename Event, auto Method, typename Subscriber>
+	SubscriptionId Subscribe(Subscriber* subscriber)
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		Compact(channel);
+		const Handler<Event> handler = { subscriber, &Invoke<Event, Subscriber, Method>, ++channel.lastId };
+		channel.handlers.push_back(handler);
+		return handler.id;
+	}
+
+	/// Deliver an event type to a function, void (*)(void* context, Event&)
+	template <typename Event>
+	SubscriptionId Subscribe(void* context, void (*function)(void* context, Event& e))
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		Compact(channel);
+		const Handler<Event> handler = { context, function, ++channel.lastId };
+		channel.handlers.push_back(handler);
+		return handler.id;
+	}
+
+	/// The subscriber is not called again, not even for the event being delivered
+	template <typename Event>
+	void Unsubscribe(SubscriptionId id)
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		for (Handler<Event>& handler : channel.handlers)
+		{
+			if (handler.id == id)
+			{
+				// removed from the array once no event is delivered, delivery walks the array by index
+				handler.function = nullptr;
+				channel.removedCount++;
+				return;
+			}
+		}
+		assert(false && "Not subscribed");
+	}
+
+	/// Deliver an event to its subscribers now
+	template <typename Event>
+	void Publish(Event& e)
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		channel.depth++;
+		// subscribers added meanwhile get the next event, the array may grow under the loop
+		const size_t count = channel.handlers.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			const Handler<Event>& handler = channel.handlers[i];
+			if (handler.function)
+			{
+				handler.function(handler.context, e);
+			}
+		}
+		channel.depth--;
+		Compact(channel);
+	}
+
+	/// Keep a copy of an event for the next Flush
+	template <typename Event>
+	void Queue(const Event& e)
+	{
+		GetChannel<Event>().queued.push_back(e);
+		m_queueOrder.push_back(static_cast<uint8_t>(IndexOf<Event>()));
+	}
+
+	/// Deliver the queued events of every type in the order they were queued. Events queued by their subscribers
+	/// meanwhile are delivered by the same flush.
+	void Flush()
+	{
+		for (size_t i = 0; i < m_queueOrder.size(); i++)
+		{
+			DeliverQueued(m_queueOrder[i], std::index_sequence_for<Events...>());
+		}
+		m_queueOrder.clear();
+		(ClearQueued<Events>(), ...);
+	}
+
+	/// @returns Subscribers of an event type
+	template <typename Event>
+	size_t GetSubscriberCount() const
+	{
+		const Channel<Event>& channel = std::get<Channel<Event>>(m_channels);
+		return channel.handlers.size() - channel.removedCount;
+	}
+
+private:
+	template <typename Event>
+	struct Handler
+	{
+		void* context;
+		void (*function)(void* context, Event& e);
+		SubscriptionId id;
+	};
+
+	template <typename Event>
+	struct Channel
+	{
+		std::vector<Handler<Event>> handlers;
+		SubscriptionId lastId = 0;
+		// handlers unsubscribed that are still in the array
+		size_t removedCount = 0;
+		// nested deliveries in progress
+		uint32_t depth = 0;
+		std::vector<Event> queued;
+		// queued events already delivered by the running flush
+		size_t delivered = 0;
+	};
+
+	template <typename Event, typename Subscriber, auto Method>
+	static void Invoke(void* context, Event& e)
+	{
+		(static_cast<Subscriber*>(context)->*Method)(e);
+	}
+
+	template <typename Event>
+	static constexpr size_t IndexOf()
+	{
+		constexpr bool matches[] = { std::is_same_v<Event, Events>... };
+		for (size_t i = 0; i < sizeof...(Events); i++)
+		{
+			if (matches[i])
+			{
+				return i;
+			}
+		}
+		return sizeof...(Events);
+	}
+
+	template <typename Event>
+	Channel<Event>& GetChannel()
+	{
+		static_assert(IndexOf<Event>() < sizeof...(Events), "Event type is not one of the bus");
+		return std::get<Channel<Event>>(m_channels);
+	}
+
+	template <typename Event>
+	void Compact(Channel<Event>& channel)
+	{
+		if (channel.depth == 0 && channel.removedCount > 0)
+		{
+			channel.handlers.erase(std::remove_if(channel.handlers.begin(), channel.handlers.end(),
+				[](const Handler<Event>& handler) { return handler.function == nullptr; }), channel.handlers.end());
+			channel.removedCount = 0;
+		}
+	}
+
+	template <size_t... Indices>
+	void DeliverQueued(uint8_t index, std::index_sequence<Indices...>)
+	{
+		((index == Indices ? DeliverNext<std::tuple_element_t<Indices, std::tuple<Events...>>>() : void()), ...);
+	}
+
+	template <typename Event>
+	void DeliverNext()
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		// a copy, publishing may queue more events of the type and move the array
+		Event e = channel.queued[channel.delivered++];
+		Publish(e);
+	}
+
+	template <typename Event>
+	void ClearQueued()
+	{
+		Channel<Event>& channel = GetChannel<Event>();
+		channel.queued.clear();
+		channel.delivered = 0;
+	}
+
+	std::tuple<Channel<Events>...> m_channels;
+	// type index of every queued event, in queue order
+	std::vector<uint8_t> m_queueOrder;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "event_bus.hpp"
 #include "key_codes.hpp"
 
 // Base class for all event args
@@ -191,4 +192,7 @@ public:
     int     Code;
     void* Data1;
     void* Data2;
-};
\ No newline at end of file
+};
+
+// Events a window publishes to whoever subscribes, input once per frame and resizes as they happen
+using WindowEvents = EventBus<KeyEventArgs, MouseMotionEventArgs, MouseButtonEventArgs, MouseWheelEventArgs, ResizeEventArgs>;
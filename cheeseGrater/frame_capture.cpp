@@ -0,0 +1,124 @@
+#include "frame_capture.hpp"
+
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+FrameCapture::FrameCapture(uint32_t threadCount)
+	: m_quit(false)
+	, m_writing(0)
+{
+	assert(threadCount > 0 && "Capturing needs at least one thread");
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&FrameCapture::WorkerMain, this);
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_workAvailable.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void FrameCapture::Capture(std::future<ReadbackImage> image, const std::wstring& path, ImageFormat::Type format)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back({ std::move(image), path, format });
+	}
+	m_workAvailable.notify_one();
+}
+
+size_t FrameCapture::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size() + m_writing;
+}
+
+void FrameCapture::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		// queued captures are still written when quitting
+		m_workAvailable.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+		if (m_jobs.empty())
+		{
+			return;
+		}
+
+		CaptureJob job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		m_writing++;
+
+		lock.unlock();
+		try
+		{
+			ReadbackImage image = job.image.get();
+			Write(image, job.path, job.format);
+		}
+		catch (const std::future_error&)
+		{
+			// the read was never submitted before the readback ring went away
+			::OutputDebugStringA("Frame capture dropped, its readback was never submitted\n");
+		}
+		lock.lock();
+
+		m_writing--;
+	}
+}
+
+void FrameCapture::Write(ReadbackImage& image, const std::wstring& path, ImageFormat::Type format)
+{
+	switch (image.format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			uint8_t* row = image.data.data() + static_cast<size_t>(y) * image.rowPitch;
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				std::swap(row[x * 4], row[x * 4 + 2]);
+			}
+		}
+		break;
+	default:
+	{
+		char buffer[128];
+		sprintf_s(buffer, "Frame capture skipped, format %d is not an 8 bit RGBA format\n", static_cast<int>(image.format));
+		::OutputDebugStringA(buffer);
+		return;
+	}
+	}
+
+	// the swapchain ignores alpha, captures are written opaque so they look the way the window did
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		uint8_t* row = image.data.data() + static_cast<size_t>(y) * image.rowPitch;
+		for (uint32_t x = 0; x < image.width; x++)
+		{
+			row[x * 4 + 3] = 255;
+		}
+	}
+
+	const std::vector<uint8_t> file = EncodeImage(format, image.data.data(), image.width, image.height, image.rowPitch);
+	std::ofstream stream(std::filesystem::path(path), std::ios::binary);
+	stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+	if (!stream)
+	{
+		::OutputDebugStringA("Frame capture could not be written\n");
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <image_file.hpp>
+#include <readback_ring.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Writes read back frames to image files on worker threads. A capture is queued with the future of a
+/// ReadbackRing::ReadTexture; a worker waits for it, converts the texels to RGBA, encodes and writes the file, so
+/// neither the copy, the encoding nor the disk ever hold up a frame. Captures are never dropped, a sequence captured
+/// every frame only queues up if encoding falls behind.
+class FrameCapture
+{
+public:
+	explicit FrameCapture(uint32_t threadCount = 2);
+	/// Writes every capture still queued, the readback ring has to resolve or drop their reads first
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture& other) = delete;
+	FrameCapture& operator=(const FrameCapture& other) = delete;
+
+	/// @param path File to write, the extension is not changed to match the format
+	void Capture(std::future<ReadbackImage> image, const std::wstring& path, ImageFormat::Type format);
+
+	/// @returns Captures queued or being written
+	size_t GetPendingCount() const;
+
+private:
+	struct CaptureJob
+	{
+		std::future<ReadbackImage> image;
+		std::wstring path;
+		ImageFormat::Type format;
+	};
+
+	void WorkerMain();
+	static void Write(ReadbackImage& image, const std::wstring& path, ImageFormat::Type format);
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	bool m_quit;
+	std::deque<CaptureJob> m_jobs;
+	size_t m_writing;
+
+	std::vector<std::thread> m_workers;
+};
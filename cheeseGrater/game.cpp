@@ -27,17 +27,39 @@ bool Game::Initialize()
 
 	m_window = Application::Get().CreateRenderWindow(m_name, m_width, m_height, m_vSync);
 	m_window->RegisterCallbacks(shared_from_this());
-	m_window->Show();
+
+	// subscribed first, so derived games see the new client size when they are resized
+	SubscribeWindowEvent<ResizeEventArgs, &Game::OnResize>(this);
 
 	return true;
 }
 
+void Game::Show()
+{
+	m_window->Show();
+}
+
 void Game::Destroy()
 {
+	// the game outlives its subscriptions, they end before the window goes away
+	if (m_window)
+	{
+		WindowEvents& events = GetWindowEvents();
+		for (const Subscription& subscription : m_subscriptions)
+		{
+			subscription.unsubscribe(events, subscription.id);
+		}
+	}
+	m_subscriptions.clear();
 	Application::Get().DestroyWindow(m_window);
 	m_window.reset();
 }
 
+WindowEvents& Game::GetWindowEvents()
+{
+	return m_window->GetEvents();
+}
+
 void Game::OnResize(ResizeEventArgs& e)
 {
 	m_width = e.Width;
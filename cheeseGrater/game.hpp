@@ -4,6 +4,7 @@
 #include <events.hpp>
 
 #include <memory>  // std::enable_shared_from_this
+#include <vector>
 
 class Window;
 
@@ -19,11 +20,14 @@ public:
 	int GetClientWidth() const {return m_width;}
 	int GetClientHeight() const {return m_height;}
 	
-	/// Initialize DirectX runtime
+	/// Initialize DirectX runtime and create the window, which stays hidden until Show
 	/// @returns true if initialized, false otherwise
 	virtual bool Initialize();
+	/// Runs on a worker thread while Initialize creates the window, so it must not use the window
 	virtual bool LoadContent() = 0;
 	virtual void UnloadContent() = 0;
+	/// Show the window, called by the application once the content is loaded
+	void Show();
 
 	virtual void Destroy();
 protected:
@@ -31,23 +35,43 @@ protected:
 
 	virtual void OnUpdate(UpdateEventArgs& e) { };
 	virtual void OnRender(RenderEventArgs& e) { };
-	virtual void OnKeyPressed(KeyEventArgs& e) { };
-	virtual void OnKeyReleased(KeyEventArgs& e) { };
-	virtual void OnMouseMoved(MouseMotionEventArgs& e) { };
-	virtual void OnMouseButtonPressed(MouseButtonEventArgs& e) { };
-	virtual void OnMouseButtonReleased(MouseButtonEventArgs& e) { };
-	virtual void OnMouseWheel(MouseWheelEventArgs& e) { };
-	virtual void OnResize(ResizeEventArgs& e);
 	virtual void OnWindowDestroy();
 
+	/// Deliver a window event straight to a member of the derived game, void (DerivedGame::*)(Event&), until Destroy.
+	/// Call after Game::Initialize; subscribers of an event are called in the order they subscribed, after the game
+	/// has updated its client size for a resize.
+	template <typename Event, auto Method, typename DerivedGame>
+	void SubscribeWindowEvent(DerivedGame* game)
+	{
+		const WindowEvents::SubscriptionId id = GetWindowEvents().template Subscribe<Event, Method>(game);
+		m_subscriptions.push_back({ id, &UnsubscribeWindowEvent<Event> });
+	}
+
 	std::shared_ptr<Window> m_window;
 
 private:
+	struct Subscription
+	{
+		WindowEvents::SubscriptionId id;
+		void (*unsubscribe)(WindowEvents& events, WindowEvents::SubscriptionId id);
+	};
+
+	template <typename Event>
+	static void UnsubscribeWindowEvent(WindowEvents& events, WindowEvents::SubscriptionId id)
+	{
+		events.template Unsubscribe<Event>(id);
+	}
+
+	WindowEvents& GetWindowEvents();
+	void OnResize(ResizeEventArgs& e);
+
 	std::wstring m_name;
 	
 	int m_width;
 	int m_height;
 
 	bool m_vSync;
+
+	std::vector<Subscription> m_subscriptions;
 };
 
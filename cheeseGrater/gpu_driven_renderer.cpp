@@ -0,0 +1,325 @@
+#include "gpu_driven_renderer.hpp"
+
+#include <pipeline_cache.hpp>
+#include <resource_state_tracker.hpp>
+#include <shader_archive.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+static_assert(sizeof(IndirectDrawCommand) == sizeof(uint32_t) + sizeof(D3D12_DRAW_INDEXED_ARGUMENTS),
+	"IndirectDrawCommand must be one root constant followed by D3D12_DRAW_INDEXED_ARGUMENTS");
+
+namespace
+{
+enum CullRootParameter : UINT
+{
+	CULL_ROOT_CONSTANTS = 0,
+	CULL_ROOT_INSTANCES,
+	CULL_ROOT_MESH_DRAWS,
+	CULL_ROOT_COMMANDS,
+	CULL_ROOT_PARAMETER_COUNT
+};
+
+enum DrawRootParameter : UINT
+{
+	DRAW_ROOT_INSTANCE_INDEX = 0,  // set by the command signature
+	DRAW_ROOT_VIEW_PROJECTION,
+	DRAW_ROOT_INSTANCES,
+	DRAW_ROOT_PARAMETER_COUNT
+};
+
+enum UavDescriptor : UINT
+{
+	UAV_APPEND_COMMANDS = 0,
+	UAV_RAW_COUNTER,
+	UAV_DESCRIPTOR_COUNT
+};
+}
+
+GpuDrivenRenderer::GpuDrivenRenderer(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<PipelineCompiler> pipelineCompiler,
+	const ShaderArchive& shaders, uint32_t maxInstances, uint32_t maxMeshes, const D3D12_INPUT_LAYOUT_DESC& inputLayout,
+	DXGI_FORMAT rtvFormat, DXGI_FORMAT dsvFormat)
+	: m_device(device)
+	, m_pipelineCompiler(pipelineCompiler)
+	, m_maxInstances(std::max(1u, maxInstances))
+	, m_maxMeshes(std::max(1u, maxMeshes))
+	, m_counterOffset(GetIndirectCounterOffset(m_maxInstances))
+	, m_uploadBufferData{ nullptr }
+	, m_uavDescriptorSize(0)
+{
+	CreateBuffers();
+	CreateCullPipeline(shaders);
+	CreateDrawPipeline(shaders, inputLayout, rtvFormat, dsvFormat);
+}
+
+bool GpuDrivenRenderer::IsReady() const
+{
+	return m_cullPipeline.Get() && m_drawPipeline.Get();
+}
+
+void GpuDrivenRenderer::SetScene(const std::vector<SceneInstance>& instances, const std::vector<GpuMeshDraw>& meshDraws)
+{
+	assert(instances.size() <= m_maxInstances && meshDraws.size() <= m_maxMeshes && "Scene exceeds the gpu-driven renderer capacity");
+
+	PackInstances(instances, m_packedInstances);
+	m_meshDraws = meshDraws;
+}
+
+void GpuDrivenRenderer::RecordUpload(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, UINT frameIndex)
+{
+	const size_t instancesSize = m_packedInstances.size() * sizeof(GpuInstance);
+	const size_t meshDrawsSize = m_meshDraws.size() * sizeof(GpuMeshDraw);
+	const size_t meshDrawsOffset = m_maxInstances * sizeof(GpuInstance);
+
+	uint8_t* uploadData = m_uploadBufferData[frameIndex];
+	if (instancesSize > 0)
+	{
+		std::memcpy(uploadData, m_packedInstances.data(), instancesSize);
+		commandList->CopyBufferRegion(m_instanceBuffer.Get(), 0, m_uploadBuffers[frameIndex].Get(), 0, instancesSize);
+	}
+	if (meshDrawsSize > 0)
+	{
+		std::memcpy(uploadData + meshDrawsOffset, m_meshDraws.data(), meshDrawsSize);
+		commandList->CopyBufferRegion(m_meshDrawBuffer.Get(), 0, m_uploadBuffers[frameIndex].Get(), meshDrawsOffset, meshDrawsSize);
+	}
+}
+
+void GpuDrivenRenderer::RecordCulling(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, FXMMATRIX viewProjection)
+{
+	assert(IsReady() && "Culling recorded before the pipelines were compiled");
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { m_uavHeap.Get() };
+	commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	// reset the append counter
+	const UINT zeros[4] = { 0, 0, 0, 0 };
+	CD3DX12_GPU_DESCRIPTOR_HANDLE counterGpuHandle(m_uavHeap->GetGPUDescriptorHandleForHeapStart(), UAV_RAW_COUNTER, m_uavDescriptorSize);
+	commandList->ClearUnorderedAccessViewUint(counterGpuHandle, m_cpuUavHeap->GetCPUDescriptorHandleForHeapStart(),
+		m_argumentBuffer.Get(), zeros, 0, nullptr);
+	CD3DX12_RESOURCE_BARRIER clearBarrier = CD3DX12_RESOURCE_BARRIER::UAV(m_argumentBuffer.Get());
+	commandList->ResourceBarrier(1, &clearBarrier);
+
+	CullConstants constants = { };
+	XMFLOAT4X4 viewProjectionData;
+	XMStoreFloat4x4(&viewProjectionData, viewProjection);
+	ExtractFrustumPlanes(&viewProjectionData.m[0][0], constants.frustumPlanes);
+	constants.instanceCount = static_cast<uint32_t>(m_packedInstances.size());
+
+	commandList->SetComputeRootSignature(m_cullRootSignature.Get());
+	commandList->SetPipelineState(m_cullPipeline.Get());
+	commandList->SetComputeRoot32BitConstants(CULL_ROOT_CONSTANTS, sizeof(CullConstants) / 4, &constants, 0);
+	commandList->SetComputeRootShaderResourceView(CULL_ROOT_INSTANCES, m_instanceBuffer->GetGPUVirtualAddress());
+	commandList->SetComputeRootShaderResourceView(CULL_ROOT_MESH_DRAWS, m_meshDrawBuffer->GetGPUVirtualAddress());
+	commandList->SetComputeRootDescriptorTable(CULL_ROOT_COMMANDS,
+		CD3DX12_GPU_DESCRIPTOR_HANDLE(m_uavHeap->GetGPUDescriptorHandleForHeapStart(), UAV_APPEND_COMMANDS, m_uavDescriptorSize));
+
+	if (constants.instanceCount > 0)
+	{
+		commandList->Dispatch((constants.instanceCount + CULL_THREAD_GROUP_SIZE - 1) / CULL_THREAD_GROUP_SIZE, 1, 1);
+	}
+}
+
+void GpuDrivenRenderer::RecordDraw(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, FXMMATRIX viewProjection)
+{
+	assert(IsReady() && "Draw recorded before the pipelines were compiled");
+
+	commandList->SetGraphicsRootSignature(m_drawRootSignature.Get());
+	commandList->SetPipelineState(m_drawPipeline.Get());
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	XMMATRIX viewProjectionMatrix = viewProjection;
+	commandList->SetGraphicsRoot32BitConstants(DRAW_ROOT_VIEW_PROJECTION, sizeof(XMMATRIX) / 4, &viewProjectionMatrix, 0);
+	commandList->SetGraphicsRootShaderResourceView(DRAW_ROOT_INSTANCES, m_instanceBuffer->GetGPUVirtualAddress());
+
+	// the number of draws is read from the append counter written by the cull pass
+	commandList->ExecuteIndirect(m_commandSignature.Get(), m_maxInstances, m_argumentBuffer.Get(), 0,
+		m_argumentBuffer.Get(), m_counterOffset);
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuDrivenRenderer::GetInstanceBuffer() const
+{
+	return m_instanceBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuDrivenRenderer::GetMeshDrawBuffer() const
+{
+	return m_meshDrawBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuDrivenRenderer::GetArgumentBuffer() const
+{
+	return m_argumentBuffer;
+}
+
+void GpuDrivenRenderer::CreateBuffers()
+{
+	const uint64_t instancesSize = static_cast<uint64_t>(m_maxInstances) * sizeof(GpuInstance);
+	const uint64_t meshDrawsSize = static_cast<uint64_t>(m_maxMeshes) * sizeof(GpuMeshDraw);
+	const uint64_t argumentsSize = m_counterOffset + sizeof(uint32_t);
+
+	auto createBuffer = [this](uint64_t size, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES state,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& buffer)
+		{
+			auto heapProperties = CD3DX12_HEAP_PROPERTIES(heapType);
+			auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+			ThrowIfFailed(m_device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc, state,
+				nullptr, IID_PPV_ARGS(&buffer)));
+		};
+
+	createBuffer(instancesSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, m_instanceBuffer);
+	createBuffer(meshDrawsSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, m_meshDrawBuffer);
+	createBuffer(argumentsSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON, m_argumentBuffer);
+	m_instanceBuffer->SetName(L"GPU Driven Instances");
+	m_meshDrawBuffer->SetName(L"GPU Driven Mesh Draws");
+	m_argumentBuffer->SetName(L"GPU Driven Indirect Arguments");
+
+	ResourceStateTracker::AddGlobalResourceState(m_instanceBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+	ResourceStateTracker::AddGlobalResourceState(m_meshDrawBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+	ResourceStateTracker::AddGlobalResourceState(m_argumentBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+
+	for (int i = 0; i < Window::BUFFER_COUNT; i++)
+	{
+		createBuffer(instancesSize + meshDrawsSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ,
+			m_uploadBuffers[i]);
+
+		// the cpu never reads from upload buffers
+		CD3DX12_RANGE readRange(0, 0);
+		ThrowIfFailed(m_uploadBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_uploadBufferData[i])));
+	}
+
+	// descriptors for the append buffer and for clearing its counter
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = { };
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.NumDescriptors = UAV_DESCRIPTOR_COUNT;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(m_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_uavHeap)));
+
+	heapDesc.NumDescriptors = 1;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(m_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_cpuUavHeap)));
+
+	m_uavDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC appendDesc = { };
+	appendDesc.Format = DXGI_FORMAT_UNKNOWN;
+	appendDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	appendDesc.Buffer.FirstElement = 0;
+	appendDesc.Buffer.NumElements = m_maxInstances;
+	appendDesc.Buffer.StructureByteStride = sizeof(IndirectDrawCommand);
+	appendDesc.Buffer.CounterOffsetInBytes = m_counterOffset;
+	appendDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+	m_device->CreateUnorderedAccessView(m_argumentBuffer.Get(), m_argumentBuffer.Get(), &appendDesc,
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(m_uavHeap->GetCPUDescriptorHandleForHeapStart(), UAV_APPEND_COMMANDS, m_uavDescriptorSize));
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC counterDesc = { };
+	counterDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	counterDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	counterDesc.Buffer.FirstElement = m_counterOffset / sizeof(uint32_t);
+	counterDesc.Buffer.NumElements = 1;
+	counterDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+	m_device->CreateUnorderedAccessView(m_argumentBuffer.Get(), nullptr, &counterDesc,
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(m_uavHeap->GetCPUDescriptorHandleForHeapStart(), UAV_RAW_COUNTER, m_uavDescriptorSize));
+	m_device->CreateUnorderedAccessView(m_argumentBuffer.Get(), nullptr, &counterDesc, m_cpuUavHeap->GetCPUDescriptorHandleForHeapStart());
+}
+
+void GpuDrivenRenderer::CreateCullPipeline(const ShaderArchive& shaders)
+{
+	const D3D12_SHADER_BYTECODE computeShader = shaders.GetShader("cull_compute_shader");
+
+	CD3DX12_DESCRIPTOR_RANGE1 commandsRange;
+	commandsRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+
+	CD3DX12_ROOT_PARAMETER1 rootParameters[CULL_ROOT_PARAMETER_COUNT];
+	rootParameters[CULL_ROOT_CONSTANTS].InitAsConstants(sizeof(CullConstants) / 4, 0);
+	rootParameters[CULL_ROOT_INSTANCES].InitAsShaderResourceView(0);
+	rootParameters[CULL_ROOT_MESH_DRAWS].InitAsShaderResourceView(1);
+	rootParameters[CULL_ROOT_COMMANDS].InitAsDescriptorTable(1, &commandsRange);
+
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+	m_cullRootSignature = m_pipelineCompiler->GetPipelineCache()->CreateRootSignature(rootSignatureDesc);
+
+	// as a stream, which the pipeline cache keys and the compiler copies
+	struct PipelineStateStream
+	{
+		CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE pRootSignature;
+		CD3DX12_PIPELINE_STATE_STREAM_CS cs;
+	} pipelineStateStream;
+
+	pipelineStateStream.pRootSignature = m_cullRootSignature.Get();
+	pipelineStateStream.cs = computeShader;
+
+	D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
+		sizeof(pipelineStateStream), &pipelineStateStream
+	};
+	m_cullPipeline = m_pipelineCompiler->Compile(pipelineStateStreamDesc);
+}
+
+void GpuDrivenRenderer::CreateDrawPipeline(const ShaderArchive& shaders, const D3D12_INPUT_LAYOUT_DESC& inputLayout,
+	DXGI_FORMAT rtvFormat, DXGI_FORMAT dsvFormat)
+{
+	const D3D12_SHADER_BYTECODE vertexShader = shaders.GetShader<VertexShader, VertexShader::Indirect>();
+	const D3D12_SHADER_BYTECODE pixelShader = shaders.GetShader("pixel_shader");
+
+	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+
+	CD3DX12_ROOT_PARAMETER1 rootParameters[DRAW_ROOT_PARAMETER_COUNT];
+	rootParameters[DRAW_ROOT_INSTANCE_INDEX].InitAsConstants(1, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[DRAW_ROOT_VIEW_PROJECTION].InitAsConstants(sizeof(XMMATRIX) / 4, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[DRAW_ROOT_INSTANCES].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, rootSignatureFlags);
+	m_drawRootSignature = m_pipelineCompiler->GetPipelineCache()->CreateRootSignature(rootSignatureDesc);
+
+	struct PipelineStateStream
+	{
+		CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE pRootSignature;
+		CD3DX12_PIPELINE_STATE_STREAM_INPUT_LAYOUT inputLayout;
+		CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY primitiveTopologyType;
+		CD3DX12_PIPELINE_STATE_STREAM_VS vs;
+		CD3DX12_PIPELINE_STATE_STREAM_PS ps;
+		CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL_FORMAT dsvFormat;
+		CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS rtvFormats;
+	} pipelineStateStream;
+
+	D3D12_RT_FORMAT_ARRAY rtvFormats = {};
+	rtvFormats.NumRenderTargets = 1;
+	rtvFormats.RTFormats[0] = rtvFormat;
+
+	pipelineStateStream.pRootSignature = m_drawRootSignature.Get();
+	pipelineStateStream.inputLayout = inputLayout;
+	pipelineStateStream.primitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	pipelineStateStream.vs = vertexShader;
+	pipelineStateStream.ps = pixelShader;
+	pipelineStateStream.dsvFormat = dsvFormat;
+	pipelineStateStream.rtvFormats = rtvFormats;
+
+	D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
+		sizeof(pipelineStateStream), &pipelineStateStream
+	};
+	// the input layout points to the caller's elements, which have to outlive the compilation
+	m_drawPipeline = m_pipelineCompiler->Compile(pipelineStateStreamDesc);
+
+	// per draw: the instance index root constant followed by the draw arguments
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = { };
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[0].Constant.RootParameterIndex = DRAW_ROOT_INSTANCE_INDEX;
+	arguments[0].Constant.DestOffsetIn32BitValues = 0;
+	arguments[0].Constant.Num32BitValuesToSet = 1;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = { };
+	commandSignatureDesc.ByteStride = sizeof(IndirectDrawCommand);
+	commandSignatureDesc.NumArgumentDescs = _countof(arguments);
+	commandSignatureDesc.pArgumentDescs = arguments;
+	ThrowIfFailed(m_device->CreateCommandSignature(&commandSignatureDesc, m_drawRootSignature.Get(), IID_PPV_ARGS(&m_commandSignature)));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <indirect_draw.hpp>
+#include <pipeline_compiler.hpp>
+#include <window.hpp>
+
+#include <memory>
+#include <vector>
+
+class ShaderArchive;
+
+/// Gpu-driven drawing: instances live in a persistent gpu buffer, a compute pass frustum culls them and appends
+/// one indirect command per visible instance, and a single ExecuteIndirect draws them all. CPU cost does not
+/// depend on the number of instances.
+///
+/// Every frame: RecordUpload (writes instance and mesh buffers as copy destination), RecordCulling (reads them,
+/// writes the argument buffer as unordered access) and RecordDraw (reads the argument buffer as indirect argument
+/// and the instance buffer as shader resource). The caller is responsible for the transitions, e.g. through the render graph.
+class GpuDrivenRenderer
+{
+public:
+	/// @param pipelineCompiler Creates the pipelines in the background, its cache the root signatures
+	/// @param shaders Holds the cull, vertex and pixel shaders, only used while constructing
+	/// @param inputLayout Vertex layout of the shared vertex buffer, its elements have to outlive the renderer
+	GpuDrivenRenderer(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<PipelineCompiler> pipelineCompiler,
+		const ShaderArchive& shaders, uint32_t maxInstances, uint32_t maxMeshes,
+		const D3D12_INPUT_LAYOUT_DESC& inputLayout, DXGI_FORMAT rtvFormat, DXGI_FORMAT dsvFormat);
+	~GpuDrivenRenderer() = default;
+
+	GpuDrivenRenderer(const GpuDrivenRenderer& other) = delete;
+	GpuDrivenRenderer& operator=(const GpuDrivenRenderer& other) = delete;
+
+	/// @returns True once the cull and draw pipelines are compiled, nothing may be recorded before
+	bool IsReady() const;
+
+	void SetScene(const std::vector<SceneInstance>& instances, const std::vector<GpuMeshDraw>& meshDraws);
+
+	/// Copy the scene into this frame's upload buffer and from there into the persistent gpu buffers
+	/// @param frameIndex Index of a frame whose previous gpu work has completed (e.g. the current back buffer index)
+	void RecordUpload(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, UINT frameIndex);
+	void RecordCulling(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, DirectX::FXMMATRIX viewProjection);
+	/// Render targets, viewport and vertex/index buffers are expected to be bound already
+	void RecordDraw(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, DirectX::FXMMATRIX viewProjection);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> GetInstanceBuffer() const;
+	Microsoft::WRL::ComPtr<ID3D12Resource> GetMeshDrawBuffer() const;
+	Microsoft::WRL::ComPtr<ID3D12Resource> GetArgumentBuffer() const;
+
+private:
+	void CreateBuffers();
+	void CreateCullPipeline(const ShaderArchive& shaders);
+	void CreateDrawPipeline(const ShaderArchive& shaders, const D3D12_INPUT_LAYOUT_DESC& inputLayout, DXGI_FORMAT rtvFormat,
+		DXGI_FORMAT dsvFormat);
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+	std::shared_ptr<PipelineCompiler> m_pipelineCompiler;
+
+	uint32_t m_maxInstances;
+	uint32_t m_maxMeshes;
+	uint64_t m_counterOffset;
+
+	std::vector<GpuInstance> m_packedInstances;
+	std::vector<GpuMeshDraw> m_meshDraws;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceBuffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_meshDrawBuffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_argumentBuffer;  // commands followed by the append counter
+
+	// one persistently mapped upload buffer per frame in flight holding instances followed by mesh draws
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_uploadBuffers[Window::BUFFER_COUNT];
+	uint8_t* m_uploadBufferData[Window::BUFFER_COUNT];
+
+	// shader visible: append uav, raw counter uav; cpu only: raw counter uav (needed for clearing)
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_uavHeap;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_cpuUavHeap;
+	UINT m_uavDescriptorSize;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_cullRootSignature;
+	PipelineHandle m_cullPipeline;
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_drawRootSignature;
+	PipelineHandle m_drawPipeline;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_commandSignature;
+};
@@ -0,0 +1,88 @@
+#include "gpu_timestamp_zones.hpp"
+
+#include <profiler.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+uint64_t ToCpuTimestamp(const GpuClockCalibration& calibration, uint64_t gpuTimestamp)
+{
+	// signed, zones may start before the calibration
+	const double gpuTicks = static_cast<double>(static_cast<int64_t>(gpuTimestamp - calibration.gpuTimestamp));
+	const double cpuTicks = gpuTicks * calibration.cpuFrequency / calibration.gpuFrequency;
+	return calibration.cpuTimestamp + static_cast<uint64_t>(static_cast<int64_t>(cpuTicks));
+}
+
+GpuTimestampZones::GpuTimestampZones(uint32_t queryCapacity, uint32_t track)
+	: m_capacity(queryCapacity)
+	, m_track(track)
+	, m_allocated(0)
+	, m_released(0)
+{
+	assert(queryCapacity >= 2 && queryCapacity % 2 == 0 && "Zones take two queries");
+}
+
+uint32_t GpuTimestampZones::Begin(const char* name, const void* commandList)
+{
+	if (m_allocated - m_released + 2 > m_capacity)
+	{
+		return INVALID_ZONE;
+	}
+
+	// an even capacity never splits a zone's queries at the end of the ring
+	const uint32_t query = static_cast<uint32_t>(m_allocated % m_capacity);
+	m_allocated += 2;
+	m_zones.push_back({ name, commandList, query, 0 });
+	return query;
+}
+
+void GpuTimestampZones::Submit(const void* const* commandLists, size_t commandListCount, uint64_t fenceValue, std::vector<GpuQueryRange>& ranges)
+{
+	const void* const* commandListsEnd = commandLists + commandListCount;
+	for (Zone& zone : m_zones)
+	{
+		if (zone.fenceValue != 0 || std::find(commandLists, commandListsEnd, zone.commandList) == commandListsEnd)
+		{
+			continue;
+		}
+		zone.fenceValue = fenceValue;
+
+		// zones recorded one after another take consecutive queries, they are resolved with a single copy
+		if (!ranges.empty() && ranges.back().first + ranges.back().count == zone.query)
+		{
+			ranges.back().count += 2;
+		}
+		else
+		{
+			ranges.push_back({ zone.query, 2 });
+		}
+	}
+}
+
+bool GpuTimestampZones::IsResolvable(uint64_t completedFenceValue) const
+{
+	return !m_zones.empty() && m_zones.front().fenceValue != 0 && m_zones.front().fenceValue <= completedFenceValue;
+}
+
+void GpuTimestampZones::Resolve(uint64_t completedFenceValue, const uint64_t* timestamps, const GpuClockCalibration& calibration)
+{
+	// a zone still being recorded holds back the zones after it, their queries are released in order
+	while (IsResolvable(completedFenceValue))
+	{
+		const Zone& zone = m_zones.front();
+		const uint64_t start = timestamps[zone.query];
+		const uint64_t end = timestamps[GetEndQuery(zone.query)];
+		// the gpu clock may jump while the zone runs, e.g. when the gpu changes its power state
+		if (end >= start)
+		{
+			Profiler::AddZone(m_track, zone.name, ToCpuTimestamp(calibration, start), ToCpuTimestamp(calibration, end));
+		}
+		m_released += 2;
+		m_zones.pop_front();
+	}
+}
+
+size_t GpuTimestampZones::GetPendingCount() const
+{
+	return m_zones.size();
+}
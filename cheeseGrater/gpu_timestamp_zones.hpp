@@ -0,0 +1,87 @@
+#pragma once
+
+// Bookkeeping of gpu zones measured with timestamp queries, for one queue. A zone takes two consecutive queries of a
+// ring, one written where it begins and one where it ends in a command list. Its queries are resolved by the
+// execution of its command list and read back once the queue's fence has passed that execution, a few frames later;
+// the gpu timestamps are then converted to the cpu profiler's timestamps through a calibration of both clocks and the
+// zones are added to the profiler's track of the queue, so they show up in the same trace as the cpu zones.
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/// The timestamp of a gpu queue and the profiler's timestamp at the same moment
+struct GpuClockCalibration
+{
+	uint64_t gpuTimestamp;
+	uint64_t cpuTimestamp;
+	// ticks per second of both clocks
+	double gpuFrequency;
+	double cpuFrequency;
+};
+
+/// @returns The profiler timestamp of a gpu timestamp
+uint64_t ToCpuTimestamp(const GpuClockCalibration& calibration, uint64_t gpuTimestamp);
+
+/// Queries resolved together, at the same index of the readback memory as in the query heap
+struct GpuQueryRange
+{
+	uint32_t first;
+	uint32_t count;
+};
+
+class GpuTimestampZones
+{
+public:
+	static constexpr uint32_t INVALID_ZONE = UINT32_MAX;
+
+	/// @param queryCapacity Queries in the ring, even
+	/// @param track Profiler track the zones are added to
+	GpuTimestampZones(uint32_t queryCapacity, uint32_t track);
+
+	GpuTimestampZones(const GpuTimestampZones& other) = delete;
+	GpuTimestampZones& operator=(const GpuTimestampZones& other) = delete;
+
+	/// Start a zone recorded into a command list, the command list writes the zone's query where it begins
+	/// @param name Has to stay valid, a string literal or one of Profiler::InternName
+	/// @returns The zone, which is also the index of its first query; INVALID_ZONE if every query is in flight
+	uint32_t Begin(const char* name, const void* commandList);
+	/// @returns The query the command list writes where the zone ends
+	static uint32_t GetEndQuery(uint32_t zone)
+	{
+		return zone + 1;
+	}
+
+	/// Assign the zones recorded into command lists to their execution
+	/// @param fenceValue The fence value the execution completes at
+	/// @param ranges Receives the queries of the zones to resolve at the end of the execution
+	void Submit(const void* const* commandLists, size_t commandListCount, uint64_t fenceValue, std::vector<GpuQueryRange>& ranges);
+
+	/// @returns True if zones were executed by the time a fence value completed
+	bool IsResolvable(uint64_t completedFenceValue) const;
+	/// Add the zones executed by the time a fence value completed to the profiler and release their queries
+	/// @param timestamps Read back query data, indexed like the query heap
+	void Resolve(uint64_t completedFenceValue, const uint64_t* timestamps, const GpuClockCalibration& calibration);
+
+	/// @returns Zones begun and not resolved yet
+	size_t GetPendingCount() const;
+
+private:
+	struct Zone
+	{
+		const char* name;
+		const void* commandList;
+		uint32_t query;
+		// 0 until submitted, fence values start at 1
+		uint64_t fenceValue;
+	};
+
+	uint32_t m_capacity;
+	uint32_t m_track;
+	// running query counts, their difference is the part of the ring in use
+	uint64_t m_allocated;
+	uint64_t m_released;
+	// in allocation order, so queries are released in the order they were handed out
+	std::deque<Zone> m_zones;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+// Stable 64 bit FNV-1a hashing for keys that are written to disk or compared between runs: the result only depends
+// on the bytes hashed, never on pointers, padding or the platform.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+class Hasher
+{
+public:
+	Hasher& Add(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			m_hash = (m_hash ^ bytes[i]) * PRIME;
+		}
+		return *this;
+	}
+
+	/// Hashes the object representation, only for types without padding
+	template <typename T>
+	Hasher& Add(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>,
+			"Only types without padding can be hashed as a whole, hash their members instead");
+		return Add(&value, sizeof(value));
+	}
+
+	/// Hashes the characters and the terminator, so consecutive strings can not run into each other
+	Hasher& AddString(const char* string)
+	{
+		return Add(string, std::char_traits<char>::length(string) + 1);
+	}
+
+	uint64_t Get() const
+	{
+		return m_hash;
+	}
+
+private:
+	static constexpr uint64_t OFFSET_BASIS = 0xCBF29CE484222325ull;
+	static constexpr uint64_t PRIME = 0x100000001B3ull;
+
+	uint64_t m_hash = OFFSET_BASIS;
+};
+
+inline uint64_t HashBytes(const void* data, size_t size)
+{
+	return Hasher().Add(data, size).Get();
+}
@@ -0,0 +1,228 @@
+#include "image_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+// the largest block deflate can store uncompressed
+const uint32_t g_maxStoredBlockSize = 65535;
+
+void WriteBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+	static const std::array<uint32_t, 256> table = []()
+		{
+			std::array<uint32_t, 256> entries = { };
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				entries[i] = c;
+			}
+			return entries;
+		}();
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+void WritePngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+	WriteBigEndian(out, static_cast<uint32_t>(data.size()));
+	const size_t typeOffset = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	// the checksum covers the type and the data
+	WriteBigEndian(out, Crc32(out.data() + typeOffset, out.size() - typeOffset));
+}
+
+uint32_t QoiHash(const uint8_t* pixel)
+{
+	return (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+}
+}
+
+std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+	const size_t rowSize = static_cast<size_t>(width) * 4;
+
+	// every scanline starts with its filter type, none here: stored blocks would not get smaller from filtering
+	std::vector<uint8_t> scanlines;
+	scanlines.reserve((rowSize + 1) * height);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		scanlines.push_back(0);
+		const uint8_t* row = rgba + static_cast<size_t>(y) * rowPitch;
+		scanlines.insert(scanlines.end(), row, row + rowSize);
+	}
+
+	std::vector<uint8_t> zlib;
+	zlib.reserve(scanlines.size() + scanlines.size() / g_maxStoredBlockSize * 5 + 16);
+	// deflate with a 32k window, no preset dictionary, check bits making the header a multiple of 31
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t offset = 0;
+	do
+	{
+		const uint32_t blockSize = static_cast<uint32_t>(std::min<size_t>(scanlines.size() - offset, g_maxStoredBlockSize));
+		const bool last = offset + blockSize == scanlines.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(blockSize));
+		zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+		zlib.push_back(static_cast<uint8_t>(~blockSize));
+		zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	// adler32 of the uncompressed data, sums are reduced in blocks short enough not to overflow
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (size_t start = 0; start < scanlines.size(); start += 5552)
+	{
+		const size_t end = std::min(scanlines.size(), start + 5552);
+		for (size_t i = start; i < end; i++)
+		{
+			a += scanlines[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	WriteBigEndian(zlib, (b << 16) | a);
+
+	std::vector<uint8_t> header;
+	WriteBigEndian(header, width);
+	WriteBigEndian(header, height);
+	header.push_back(8);  // bits per channel
+	header.push_back(6);  // truecolor with alpha
+	header.push_back(0);  // deflate
+	header.push_back(0);  // adaptive filtering
+	header.push_back(0);  // not interlaced
+
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<uint8_t> png(signature, signature + sizeof(signature));
+	WritePngChunk(png, "IHDR", header);
+	WritePngChunk(png, "IDAT", zlib);
+	WritePngChunk(png, "IEND", { });
+	return png;
+}
+
+std::vector<uint8_t> EncodeQoi(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+	enum : uint8_t
+	{
+		QOI_OP_INDEX = 0x00,
+		QOI_OP_DIFF = 0x40,
+		QOI_OP_LUMA = 0x80,
+		QOI_OP_RUN = 0xC0,
+		QOI_OP_RGB = 0xFE,
+		QOI_OP_RGBA = 0xFF,
+	};
+
+	std::vector<uint8_t> qoi;
+	qoi.reserve(static_cast<size_t>(width) * height + 22);
+	qoi.insert(qoi.end(), { 'q', 'o', 'i', 'f' });
+	WriteBigEndian(qoi, width);
+	WriteBigEndian(qoi, height);
+	qoi.push_back(4);  // channels
+	qoi.push_back(0);  // srgb with linear alpha
+
+	uint8_t seen[64][4] = { };
+	uint8_t previous[4] = { 0, 0, 0, 255 };
+	uint32_t run = 0;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* row = rgba + static_cast<size_t>(y) * rowPitch;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* pixel = row + x * 4;
+			if (std::memcmp(pixel, previous, 4) == 0)
+			{
+				// runs are stored with a bias of -1 and may be 62 long, the two larger values are the RGB and RGBA tags
+				if (++run == 62)
+				{
+					qoi.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0)
+			{
+				qoi.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+				run = 0;
+			}
+
+			const uint32_t hash = QoiHash(pixel);
+			if (std::memcmp(seen[hash], pixel, 4) == 0)
+			{
+				qoi.push_back(static_cast<uint8_t>(QOI_OP_INDEX | hash));
+			}
+			else
+			{
+				std::memcpy(seen[hash], pixel, 4);
+				if (pixel[3] != previous[3])
+				{
+					qoi.insert(qoi.end(), { QOI_OP_RGBA, pixel[0], pixel[1], pixel[2], pixel[3] });
+				}
+				else
+				{
+					const int8_t dr = static_cast<int8_t>(pixel[0] - previous[0]);
+					const int8_t dg = static_cast<int8_t>(pixel[1] - previous[1]);
+					const int8_t db = static_cast<int8_t>(pixel[2] - previous[2]);
+					const int8_t drg = static_cast<int8_t>(dr - dg);
+					const int8_t dbg = static_cast<int8_t>(db - dg);
+
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+					{
+						qoi.push_back(static_cast<uint8_t>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+					}
+					else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+					{
+						qoi.push_back(static_cast<uint8_t>(QOI_OP_LUMA | (dg + 32)));
+						qoi.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+					}
+					else
+					{
+						qoi.insert(qoi.end(), { QOI_OP_RGB, pixel[0], pixel[1], pixel[2] });
+					}
+				}
+			}
+			std::memcpy(previous, pixel, 4);
+		}
+	}
+	if (run > 0)
+	{
+		qoi.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+	}
+
+	qoi.insert(qoi.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+	return qoi;
+}
+
+std::vector<uint8_t> EncodeImage(ImageFormat::Type format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+	return (format == ImageFormat::Qoi) ? EncodeQoi(rgba, width, height, rowPitch) : EncodePng(rgba, width, height, rowPitch);
+}
+
+const char* GetImageExtension(ImageFormat::Type format)
+{
+	return (format == ImageFormat::Qoi) ? ".qoi" : ".png";
+}
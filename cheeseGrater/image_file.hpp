@@ -0,0 +1,27 @@
+#pragma once
+
+// Encoders for 8 bit RGBA images, used to write captured frames. QOI compresses well and encodes in a single fast
+// pass; PNG is written with stored deflate blocks, which every viewer reads but which are not compressed.
+
+#include <cstdint>
+#include <vector>
+
+namespace ImageFormat
+{
+enum Type : uint8_t
+{
+	Png = 0,
+	Qoi,
+};
+}
+
+/// @param rgba Rows of width RGBA pixels, rowPitch bytes apart
+/// @returns Contents of a .png file
+std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch);
+/// @param rgba Rows of width RGBA pixels, rowPitch bytes apart
+/// @returns Contents of a .qoi file
+std::vector<uint8_t> EncodeQoi(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch);
+std::vector<uint8_t> EncodeImage(ImageFormat::Type format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t rowPitch);
+
+/// @returns File extension including the dot
+const char* GetImageExtension(ImageFormat::Type format);
@@ -0,0 +1,100 @@
+#include "indirect_draw.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void PackInstances(const std::vector<SceneInstance>& instances, std::vector<GpuInstance>& packedInstances)
+{
+	packedInstances.resize(instances.size());
+
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		const SceneInstance& instance = instances[i];
+		GpuInstance& packed = packedInstances[i];
+		const float* m = instance.world;
+
+		std::memcpy(packed.world, instance.world, sizeof(packed.world));
+
+		// row vector convention: the translation is in the last row and the rows are the scaled basis vectors
+		const float* c = instance.localBoundsCenter;
+		for (int column = 0; column < 3; column++)
+		{
+			packed.boundingSphere[column] = c[0] * m[column] + c[1] * m[4 + column] + c[2] * m[8 + column] + m[12 + column];
+		}
+
+		float maxScaleSquared = 0.f;
+		for (int row = 0; row < 3; row++)
+		{
+			const float* basis = &m[row * 4];
+			maxScaleSquared = std::max(maxScaleSquared, basis[0] * basis[0] + basis[1] * basis[1] + basis[2] * basis[2]);
+		}
+		packed.boundingSphere[3] = instance.localBoundsRadius * std::sqrt(maxScaleSquared);
+
+		packed.meshIndex = instance.meshIndex;
+		packed.padding[0] = packed.padding[1] = packed.padding[2] = 0;
+	}
+}
+
+void ExtractFrustumPlanes(const float viewProjection[16], float planes[6][4])
+{
+	// clip = v * M, so every clip coordinate is a dot product with a column of M
+	auto column = [viewProjection](int index, float sign, int base, float result[4])
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				const float baseValue = (base >= 0) ? viewProjection[row * 4 + base] : 0.f;
+				result[row] = baseValue + sign * viewProjection[row * 4 + index];
+			}
+		};
+
+	column(0, 1.f, 3, planes[0]);   // left:   w + x >= 0
+	column(0, -1.f, 3, planes[1]);  // right:  w - x >= 0
+	column(1, 1.f, 3, planes[2]);   // bottom: w + y >= 0
+	column(1, -1.f, 3, planes[3]);  // top:    w - y >= 0
+	column(2, 1.f, -1, planes[4]);  // near:   z >= 0
+	column(2, -1.f, 3, planes[5]);  // far:    w - z >= 0
+
+	for (int i = 0; i < 6; i++)
+	{
+		const float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+		if (length > 0.f)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				planes[i][j] /= length;
+			}
+		}
+	}
+}
+
+bool IsSphereInFrustum(const float planes[6][4], const float sphere[4])
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const float distance = planes[i][0] * sphere[0] + planes[i][1] * sphere[1] + planes[i][2] * sphere[2] + planes[i][3];
+		if (distance < -sphere[3])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+IndirectDrawCommand MakeIndirectDrawCommand(uint32_t instanceIndex, const GpuMeshDraw& meshDraw)
+{
+	IndirectDrawCommand command = { };
+	command.instanceIndex = instanceIndex;
+	command.indexCountPerInstance = meshDraw.indexCount;
+	command.instanceCount = 1;
+	command.startIndexLocation = meshDraw.startIndex;
+	command.baseVertexLocation = meshDraw.baseVertex;
+	command.startInstanceLocation = 0;
+	return command;
+}
+
+uint64_t GetIndirectCounterOffset(uint32_t capacity)
+{
+	const uint64_t commandsSize = static_cast<uint64_t>(capacity) * sizeof(IndirectDrawCommand);
+	return (commandsSize + INDIRECT_COUNTER_ALIGNMENT - 1) & ~(INDIRECT_COUNTER_ALIGNMENT - 1);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// CPU side of the gpu-driven path: scene packing and the layouts shared with cull_compute_shader.hlsl and the
+// INDIRECT permutation of vertex_shader.hlsl (VertexShader::Indirect).
+// Matrices are row-major and use the row-vector convention of DirectXMath (v' = v * M).
+
+#include <cstdint>
+#include <vector>
+
+/// Object placed in the scene by the application
+struct SceneInstance
+{
+	float world[16];
+	float localBoundsCenter[3];
+	float localBoundsRadius;
+	uint32_t meshIndex;
+};
+
+/// Per-instance data as read by the shaders
+struct GpuInstance
+{
+	float world[16];
+	float boundingSphere[4];  // world space center and radius
+	uint32_t meshIndex;
+	uint32_t padding[3];
+};
+static_assert(sizeof(GpuInstance) == 96, "GpuInstance must match the Instance struct in the shaders");
+
+/// Index range of one mesh inside the shared vertex and index buffers
+struct GpuMeshDraw
+{
+	uint32_t indexCount;
+	uint32_t startIndex;
+	int32_t baseVertex;
+	uint32_t padding;
+};
+static_assert(sizeof(GpuMeshDraw) == 16, "GpuMeshDraw must match the MeshDraw struct in the cull shader");
+
+/// One indirect command: the per-draw root constant followed by the layout of D3D12_DRAW_INDEXED_ARGUMENTS
+struct IndirectDrawCommand
+{
+	uint32_t instanceIndex;
+	uint32_t indexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startIndexLocation;
+	int32_t baseVertexLocation;
+	uint32_t startInstanceLocation;
+};
+static_assert(sizeof(IndirectDrawCommand) == 24, "IndirectDrawCommand must match the command signature");
+
+/// Root constants of the cull shader
+struct CullConstants
+{
+	float frustumPlanes[6][4];
+	uint32_t instanceCount;
+};
+static_assert(sizeof(CullConstants) == 25 * sizeof(uint32_t), "CullConstants must match the cull shader constant buffer");
+
+constexpr uint32_t CULL_THREAD_GROUP_SIZE = 64;
+// D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT
+constexpr uint64_t INDIRECT_COUNTER_ALIGNMENT = 4096;
+
+/// Transform local bounds to world space spheres and lay instances out for the gpu
+void PackInstances(const std::vector<SceneInstance>& instances, std::vector<GpuInstance>& packedInstances);
+
+/// Extract normalized frustum planes (xyz = normal pointing inwards, w = distance) from a view-projection matrix
+void ExtractFrustumPlanes(const float viewProjection[16], float planes[6][4]);
+
+/// CPU reference of the test done by the cull shader
+bool IsSphereInFrustum(const float planes[6][4], const float sphere[4]);
+
+IndirectDrawCommand MakeIndirectDrawCommand(uint32_t instanceIndex, const GpuMeshDraw& meshDraw);
+
+/// @returns Byte offset of the append counter placed behind `capacity` commands in the argument buffer
+uint64_t GetIndirectCounterOffset(uint32_t capacity);
@@ -0,0 +1,124 @@
+#include "input_queue.hpp"
+
+#include <chrono>
+
+static_assert(sizeof(InputEvent) == 24, "Input events are meant to stay small, they are copied per message");
+
+InputQueue::InputQueue()
+	: m_droppedCount(0)
+{
+}
+
+void InputQueue::Push(const InputEvent& event)
+{
+	if (event.type == InputEventType::MouseMoved && m_ring.GetSize() + MOTION_RESERVE >= CAPACITY)
+	{
+		m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (!m_ring.TryPush(event))
+	{
+		m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void InputQueue::Drain(std::vector<InputEvent>& input)
+{
+	InputEvent event;
+	while (m_ring.TryPop(event))
+	{
+		input.push_back(event);
+	}
+}
+
+uint32_t InputQueue::GetDroppedCount() const
+{
+	return m_droppedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t InputQueue::GetTime()
+{
+	const auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+void ApplyInput(InputState& state, const std::vector<InputEvent>& input, std::vector<InputEvent>& events)
+{
+	state.keysPressed.reset();
+	state.keysReleased.reset();
+	state.relativeX = 0;
+	state.relativeY = 0;
+	state.wheelDelta = 0.f;
+
+	for (InputEvent event : input)
+	{
+		state.time = event.time;
+		switch (event.type)
+		{
+		case InputEventType::KeyPressed:
+		case InputEventType::KeyReleased:
+		{
+			const size_t key = event.code & 0xFF;
+			if (event.type == InputEventType::KeyPressed)
+			{
+				state.keysDown.set(key);
+				state.keysPressed.set(key);
+			}
+			else
+			{
+				state.keysDown.reset(key);
+				state.keysReleased.set(key);
+			}
+			// taken from the keys seen so far instead of asking Windows for every key message
+			event.modifiers = state.mouseButtons;
+			event.modifiers |= state.keysDown[KeyCode::ShiftKey] ? InputModifier::Shift : 0;
+			event.modifiers |= state.keysDown[KeyCode::ControlKey] ? InputModifier::Control : 0;
+			event.modifiers |= state.keysDown[KeyCode::AltKey] ? InputModifier::Alt : 0;
+		}
+		break;
+		case InputEventType::MouseMoved:
+		case InputEventType::MouseButtonPressed:
+		case InputEventType::MouseButtonReleased:
+		case InputEventType::MouseWheel:
+		{
+			state.relativeX += event.x - state.x;
+			state.relativeY += event.y - state.y;
+			state.x = event.x;
+			state.y = event.y;
+			state.mouseButtons = event.modifiers & (InputModifier::LeftButton | InputModifier::MiddleButton | InputModifier::RightButton);
+			state.wheelDelta += event.wheelDelta;
+		}
+		break;
+		case InputEventType::FocusLost:
+		{
+			// reported as releases, so whoever handles releases never sees a key stuck down
+			for (size_t key = 0; key < state.keysDown.size(); key++)
+			{
+				if (state.keysDown[key])
+				{
+					InputEvent release = { };
+					release.time = event.time;
+					release.type = InputEventType::KeyReleased;
+					release.code = static_cast<uint16_t>(key);
+					release.x = event.x;
+					release.y = event.y;
+					events.push_back(release);
+				}
+			}
+			state.keysReleased |= state.keysDown;
+			state.keysDown.reset();
+			state.mouseButtons = 0;
+		}
+		break;
+		}
+
+		if (event.type == InputEventType::MouseMoved && !events.empty() && events.back().type == InputEventType::MouseMoved)
+		{
+			events.back() = event;
+		}
+		else
+		{
+			events.push_back(event);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+// Input of a window as compact timestamped events. The window procedure only translates a message into an event and
+// queues it; the game thread drains the queue once per frame, applies the events to a snapshot of the input state and
+// dispatches them, so a burst of mouse messages costs the message pump a copy per message and never runs game code.
+
+#include <events.hpp>
+#include <key_codes.hpp>
+#include <spsc_ring.hpp>
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace InputEventType
+{
+enum Type : uint8_t
+{
+	KeyPressed = 0,
+	KeyReleased,
+	MouseMoved,
+	MouseButtonPressed,
+	MouseButtonReleased,
+	MouseWheel,
+	// keys released while another window has the focus are never reported, they are all released instead
+	FocusLost,
+};
+}
+
+namespace InputModifier
+{
+enum Flags : uint8_t
+{
+	Shift = 1 << 0,
+	Control = 1 << 1,
+	Alt = 1 << 2,
+	LeftButton = 1 << 3,
+	MiddleButton = 1 << 4,
+	RightButton = 1 << 5,
+};
+}
+
+struct InputEvent
+{
+	// microseconds on the steady clock, taken when the window procedure handled the message
+	uint64_t time;
+	InputEventType::Type type;
+	// InputModifier flags. Mouse events carry the ones Windows reports with the message, key events get theirs from
+	// the key state when they are drained.
+	uint8_t modifiers;
+	// KeyCode::Key of key events, MouseButtonEventArgs::MouseButton of button events
+	uint16_t code;
+	// cursor in client coordinates
+	int16_t x;
+	int16_t y;
+	// UTF-16 character of key events, 0 if the key is not printable
+	uint32_t character;
+	// in notches, positive away from the user
+	float wheelDelta;
+};
+
+/// Input as of the start of a frame, every event drained up to then applied
+struct InputState
+{
+	std::bitset<256> keysDown;
+	// went down or up since the previous frame, a key can be in both if it was tapped within a frame
+	std::bitset<256> keysPressed;
+	std::bitset<256> keysReleased;
+	// InputModifier button flags
+	uint8_t mouseButtons;
+	int x;
+	int y;
+	// cursor movement and wheel notches since the previous frame
+	int relativeX;
+	int relativeY;
+	float wheelDelta;
+	// of the newest event applied, 0 before the first one
+	uint64_t time;
+};
+
+/// Queue between the window procedure, the only producer, and the game thread, the only consumer. Lock-free, a full
+/// queue drops events instead of blocking the message pump.
+class InputQueue
+{
+public:
+	static constexpr size_t CAPACITY = 1024;
+	// slots mouse motion can not take, so key and button events still get in while the mouse floods the queue
+	static constexpr size_t MOTION_RESERVE = 64;
+
+	InputQueue();
+
+	InputQueue(const InputQueue& other) = delete;
+	InputQueue& operator=(const InputQueue& other) = delete;
+
+	/// Producer only. Mouse motion is dropped once the queue is nearly full; it carries the absolute position, so the
+	/// next motion that fits makes up for it.
+	void Push(const InputEvent& event);
+	/// Consumer only
+	/// @param input Receives the queued events in order
+	void Drain(std::vector<InputEvent>& input);
+
+	/// @returns Events dropped because the queue was full, since the queue was created
+	uint32_t GetDroppedCount() const;
+
+	/// @returns Timestamp for an event handled now
+	static uint64_t GetTime();
+
+private:
+	SpscRing<InputEvent, CAPACITY> m_ring;
+	std::atomic<uint32_t> m_droppedCount;
+};
+
+/// Start a new frame of the state and apply a frame's input to it. Depends on nothing but its arguments, so recorded
+/// input gives the same state and events as it did live.
+/// @param events Receives the input in order: runs of mouse motion merged into their last event, key events with
+/// their modifiers filled in, and a release of every key down ahead of a lost focus
+void ApplyInput(InputState& state, const std::vector<InputEvent>& input, std::vector<InputEvent>& events);
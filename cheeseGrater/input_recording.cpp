@@ -0,0 +1,183 @@
+#include "input_recording.hpp"
+
+#include <hash.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+bool InputRecording::Load(const uint8_t* data, size_t size)
+{
+	Clear();
+
+	Header header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION
+		|| header.frameCount > (size - sizeof(header)) / sizeof(FrameRecord)
+		|| header.eventCount != (size - sizeof(header) - header.frameCount * sizeof(FrameRecord)) / sizeof(InputEvent)
+		|| header.checksum != HashBytes(data + sizeof(header), size - sizeof(header)))
+	{
+		return false;
+	}
+
+	const uint8_t* frames = data + sizeof(header);
+	const uint8_t* events = frames + header.frameCount * sizeof(FrameRecord);
+	m_events.resize(header.eventCount);
+	std::memcpy(m_events.data(), events, m_events.size() * sizeof(InputEvent));
+	for (uint64_t i = 0; i < header.frameCount; i++)
+	{
+		FrameRecord frame;
+		std::memcpy(&frame, frames + i * sizeof(FrameRecord), sizeof(frame));
+		if (frame.eventCount > m_events.size() - m_firstEvents.back())
+		{
+			Clear();
+			return false;
+		}
+		m_elapsedTimes.push_back(frame.elapsedTime);
+		m_firstEvents.push_back(m_firstEvents.back() + static_cast<size_t>(frame.eventCount));
+	}
+	return true;
+}
+
+void InputRecording::AddFrame(double elapsedTime, const InputEvent* events, size_t eventCount)
+{
+	m_elapsedTimes.push_back(elapsedTime);
+	m_events.insert(m_events.end(), events, events + eventCount);
+	m_firstEvents.push_back(m_events.size());
+}
+
+void InputRecording::Clear()
+{
+	m_elapsedTimes.clear();
+	m_firstEvents = { 0 };
+	m_events.clear();
+}
+
+size_t InputRecording::GetFrameCount() const
+{
+	return m_elapsedTimes.size();
+}
+
+InputRecording::Frame InputRecording::GetFrame(size_t index) const
+{
+	const size_t first = m_firstEvents[index];
+	return { m_elapsedTimes[index], m_events.data() + first, m_firstEvents[index + 1] - first };
+}
+
+std::vector<uint8_t> InputRecording::Serialize() const
+{
+	const size_t framesSize = m_elapsedTimes.size() * sizeof(FrameRecord);
+	std::vector<uint8_t> file(sizeof(Header) + framesSize + m_events.size() * sizeof(InputEvent));
+	for (size_t i = 0; i < m_elapsedTimes.size(); i++)
+	{
+		const FrameRecord frame = { m_elapsedTimes[i], m_firstEvents[i + 1] - m_firstEvents[i] };
+		std::memcpy(file.data() + sizeof(Header) + i * sizeof(FrameRecord), &frame, sizeof(frame));
+	}
+	if (!m_events.empty())
+	{
+		std::memcpy(file.data() + sizeof(Header) + framesSize, m_events.data(), m_events.size() * sizeof(InputEvent));
+	}
+
+	const Header header = { MAGIC, VERSION, m_elapsedTimes.size(), m_events.size(),
+		HashBytes(file.data() + sizeof(Header), file.size() - sizeof(Header)) };
+	std::memcpy(file.data(), &header, sizeof(header));
+	return file;
+}
+
+InputRecorder::InputRecorder(const std::filesystem::path& path)
+	: m_path(path)
+	, m_startTime(InputQueue::GetTime())
+{
+}
+
+void InputRecorder::AddFrame(double elapsedTime, const std::vector<InputEvent>& input)
+{
+	m_frameEvents = input;
+	for (InputEvent& event : m_frameEvents)
+	{
+		event.time = (event.time > m_startTime) ? event.time - m_startTime : 0;
+	}
+	m_recording.AddFrame(elapsedTime, m_frameEvents.data(), m_frameEvents.size());
+}
+
+bool InputRecorder::Write() const
+{
+	const std::vector<uint8_t> contents = m_recording.Serialize();
+	std::ofstream file(m_path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+	return static_cast<bool>(file);
+}
+
+size_t InputRecorder::GetFrameCount() const
+{
+	return m_recording.GetFrameCount();
+}
+
+const std::filesystem::path& InputRecorder::GetPath() const
+{
+	return m_path;
+}
+
+bool InputPlayer::Load(const std::filesystem::path& path)
+{
+	m_nextFrame = 0;
+	m_frameTimes.clear();
+
+	// a file that can not be read gives no contents, which are no valid recording
+	std::ifstream file(path, std::ios::binary);
+	const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return m_recording.Load(contents.data(), contents.size());
+}
+
+bool InputPlayer::NextFrame(double measuredTime, std::vector<InputEvent>& input, double& elapsedTime)
+{
+	if (m_nextFrame > m_frameTimes.size())
+	{
+		m_frameTimes.push_back(measuredTime);
+	}
+	if (m_nextFrame == m_recording.GetFrameCount())
+	{
+		return false;
+	}
+
+	const InputRecording::Frame frame = m_recording.GetFrame(m_nextFrame++);
+	input.assign(frame.events, frame.events + frame.eventCount);
+	elapsedTime = frame.elapsedTime;
+	return true;
+}
+
+size_t InputPlayer::GetFrameCount() const
+{
+	return m_recording.GetFrameCount();
+}
+
+std::string InputPlayer::GetReport() const
+{
+	if (m_frameTimes.empty())
+	{
+		return "No frames replayed\n";
+	}
+
+	std::vector<double> sorted = m_frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.;
+	for (double frameTime : sorted)
+	{
+		total += frameTime;
+	}
+	const auto percentile = [&sorted](double fraction)
+		{
+			return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+		};
+
+	char buffer[256];
+	std::snprintf(buffer, sizeof(buffer), "Replayed %zu frames: average %.3f ms, median %.3f ms, 99th percentile %.3f ms, slowest %.3f ms\n",
+		sorted.size(), total / sorted.size() * 1000., percentile(0.5) * 1000., percentile(0.99) * 1000., sorted.back() * 1000.);
+	return buffer;
+}
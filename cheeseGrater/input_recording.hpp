@@ -0,0 +1,114 @@
+#pragma once
+
+// Recorded input of a window for reproducible runs: the raw input events of every frame together with the frame's
+// time step. Replaying a recording gives the game the same input at the same frames with the same time steps, so
+// two runs, or two builds, render the same sequence of frames and their frame times can be compared. The file is
+// versioned and checksummed.
+
+#include <input_queue.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class InputRecording
+{
+public:
+	static constexpr uint32_t MAGIC = 0x52494743;  // "CGIR"
+	static constexpr uint32_t VERSION = 1;
+
+	struct Frame
+	{
+		// seconds the game advances by in this frame
+		double elapsedTime;
+		const InputEvent* events;
+		size_t eventCount;
+	};
+
+	/// Replace the contents with the frames of a serialized recording, the recording keeps its own copy
+	/// @returns False and leaves the recording empty if data is not a valid recording of this version
+	bool Load(const uint8_t* data, size_t size);
+
+	void AddFrame(double elapsedTime, const InputEvent* events, size_t eventCount);
+	void Clear();
+
+	size_t GetFrameCount() const;
+	/// @returns Frame that stays valid until the recording is changed
+	Frame GetFrame(size_t index) const;
+
+	/// @returns The file contents
+	std::vector<uint8_t> Serialize() const;
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t frameCount;
+		uint64_t eventCount;
+		// of everything after the header
+		uint64_t checksum;
+	};
+
+	struct FrameRecord
+	{
+		double elapsedTime;
+		uint64_t eventCount;
+	};
+
+	std::vector<double> m_elapsedTimes;
+	// index of every frame's first event, one more than frames so the last frame's events end at its last entry
+	std::vector<size_t> m_firstEvents = { 0 };
+	std::vector<InputEvent> m_events;
+};
+
+/// Records the input and time step of every frame from its construction on
+class InputRecorder
+{
+public:
+	explicit InputRecorder(const std::filesystem::path& path);
+
+	InputRecorder(const InputRecorder& other) = delete;
+	InputRecorder& operator=(const InputRecorder& other) = delete;
+
+	/// @param input Raw events of the frame as drained from the input queue
+	void AddFrame(double elapsedTime, const std::vector<InputEvent>& input);
+	/// Write the frames recorded so far to the file
+	/// @returns False if the file can not be written
+	bool Write() const;
+
+	size_t GetFrameCount() const;
+	const std::filesystem::path& GetPath() const;
+
+private:
+	std::filesystem::path m_path;
+	InputRecording m_recording;
+	// event times are stored relative to the start of the recording
+	uint64_t m_startTime;
+	// reused every frame
+	std::vector<InputEvent> m_frameEvents;
+};
+
+/// Feeds a recording back frame by frame and measures how long the replayed frames really take
+class InputPlayer
+{
+public:
+	/// @returns False if the file can not be read or is not a recording
+	bool Load(const std::filesystem::path& path);
+
+	/// Replace a frame's input and time step with the recorded ones
+	/// @param measuredTime Seconds the previous frame really took, the first frame's is ignored
+	/// @returns False once every frame was replayed, the input is left as it is then
+	bool NextFrame(double measuredTime, std::vector<InputEvent>& input, double& elapsedTime);
+
+	size_t GetFrameCount() const;
+	/// @returns Frame count and average, median, 99th percentile and slowest frame time of the replayed frames
+	std::string GetReport() const;
+
+private:
+	InputRecording m_recording;
+	size_t m_nextFrame = 0;
+	std::vector<double> m_frameTimes;
+};
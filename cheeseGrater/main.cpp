@@ -3,6 +3,7 @@
 #include <Shlwapi.h>
 
 #include "application.hpp"
+#include "profiler.hpp"
 #include "rotatable_cube.hpp"
 
 #include <dxgidebug.h>
@@ -30,10 +31,51 @@ int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdL
 	}
 
 	Application::Create(hInstance);
+
+	// --record <file> saves the input of a run, --replay <file> plays it back with the recorded time steps and quits,
+	// so runs of different builds render the same frames; --headless keeps the replaying window hidden;
+	// --profile <file> writes the zones of the whole run as a Chrome trace
+	int argc = 0;
+	LPWSTR* argv = ::CommandLineToArgvW(::GetCommandLineW(), &argc);
+	const wchar_t* replayPath = nullptr;
+	std::wstring profilePath;
+	bool headless = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (wcscmp(argv[i], L"--record") == 0 && i + 1 < argc)
+		{
+			Application::Get().RecordInput(argv[++i]);
+		}
+		else if (wcscmp(argv[i], L"--replay") == 0 && i + 1 < argc)
+		{
+			replayPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (wcscmp(argv[i], L"--profile") == 0 && i + 1 < argc)
+		{
+			profilePath = argv[++i];
+			Profiler::SetEnabled(true);
+		}
+	}
+	if (replayPath && !Application::Get().ReplayInput(replayPath, headless))
+	{
+		MessageBoxA(NULL, "The file to replay is not an input recording.", "Error", MB_OK | MB_ICONERROR);
+		retCode = 1;
+	}
+	::LocalFree(argv);
+
+	if (retCode == 0)
 	{
 		std::shared_ptr<RotatableCube> demo = std::make_shared<RotatableCube>(L"Rotatable Cube", 1280, 720);
 		retCode = Application::Get().Run(demo);
 	}
+	if (!profilePath.empty() && !Profiler::WriteChromeTrace(profilePath))
+	{
+		OutputDebugStringA("Failed to write the profile\n");
+	}
 	Application::Destroy();
 
 	atexit(&ReportLiveObjects);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <string>
+
+/// Read only mapping of a whole file. Pages are faulted in by the OS on first access, so data can be copied straight
+/// from the file cache to its destination without being read into a buffer first.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	/// Map a file, closing the previously mapped one
+	/// @returns False if the file does not exist, is empty or cannot be mapped
+	bool Open(const std::wstring& path);
+	void Close();
+
+	/// @returns Start of the mapping or nullptr if no file is open
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+
+private:
+	HANDLE m_file;
+	HANDLE m_mapping;
+	const uint8_t* m_data;
+	size_t m_size;
+};
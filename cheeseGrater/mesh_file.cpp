@@ -0,0 +1,336 @@
+#include "mesh_file.hpp"
+
+#include <mesh_optimizer.hpp>
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+// longest run of zero bytes a single run marker of the vertex codec covers
+const uint32_t g_maxZeroRun = 256;
+
+uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + MESH_FILE_ALIGNMENT - 1) & ~(MESH_FILE_ALIGNMENT - 1);
+}
+
+std::vector<uint8_t> EncodeIndices(const std::vector<uint32_t>& indices)
+{
+	std::vector<uint8_t> encoded;
+	encoded.reserve(indices.size() * 2);
+
+	uint32_t previous = 0;
+	for (uint32_t index : indices)
+	{
+		// zigzag keeps small negative differences small
+		const int32_t delta = static_cast<int32_t>(index - previous);
+		uint32_t value = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+		previous = index;
+
+		while (value >= 0x80)
+		{
+			encoded.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		encoded.push_back(static_cast<uint8_t>(value));
+	}
+	return encoded;
+}
+
+bool DecodeIndices(const uint8_t* source, uint64_t sourceSize, uint32_t indexCount, uint32_t indexSize, uint8_t* destination)
+{
+	const uint8_t* const end = source + sourceSize;
+	uint32_t previous = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t value = 0;
+		for (uint32_t shift = 0;; shift += 7)
+		{
+			if (source == end || shift > 28)
+			{
+				return false;
+			}
+			const uint8_t byte = *source++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				break;
+			}
+		}
+
+		const uint32_t index = previous + ((value >> 1) ^ (0u - (value & 1)));
+		previous = index;
+		if (indexSize == sizeof(uint16_t))
+		{
+			const uint16_t narrow = static_cast<uint16_t>(index);
+			std::memcpy(destination + i * sizeof(uint16_t), &narrow, sizeof(narrow));
+		}
+		else
+		{
+			std::memcpy(destination + i * sizeof(uint32_t), &index, sizeof(index));
+		}
+	}
+	return source == end;
+}
+
+// Neighbouring vertices of an optimized mesh differ little, so most byte differences are zero. Storing the bytes
+// column by column turns them into long runs.
+std::vector<uint8_t> EncodeVertices(const std::vector<uint8_t>& vertices, uint32_t stride)
+{
+	const size_t vertexCount = vertices.size() / stride;
+	std::vector<uint8_t> encoded;
+	encoded.reserve(vertices.size());
+
+	uint32_t zeroRun = 0;
+	auto flushZeroRun = [&]()
+		{
+			if (zeroRun > 0)
+			{
+				encoded.push_back(0);
+				encoded.push_back(static_cast<uint8_t>(zeroRun - 1));
+				zeroRun = 0;
+			}
+		};
+
+	for (uint32_t column = 0; column < stride; column++)
+	{
+		uint8_t previous = 0;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const uint8_t value = vertices[v * stride + column];
+			const uint8_t delta = static_cast<uint8_t>(value - previous);
+			previous = value;
+
+			if (delta == 0)
+			{
+				if (++zeroRun == g_maxZeroRun)
+				{
+					flushZeroRun();
+				}
+				continue;
+			}
+			flushZeroRun();
+			encoded.push_back(delta);
+		}
+	}
+	flushZeroRun();
+
+	return encoded;
+}
+
+bool DecodeVertices(const uint8_t* source, uint64_t sourceSize, uint32_t vertexCount, uint32_t stride, uint8_t* destination)
+{
+	const uint8_t* const end = source + sourceSize;
+	uint32_t zeroRun = 0;
+
+	for (uint32_t column = 0; column < stride; column++)
+	{
+		uint8_t previous = 0;
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			uint8_t delta = 0;
+			if (zeroRun > 0)
+			{
+				zeroRun--;
+			}
+			else
+			{
+				if (source == end)
+				{
+					return false;
+				}
+				delta = *source++;
+				if (delta == 0)
+				{
+					if (source == end)
+					{
+						return false;
+					}
+					// this zero is the first of the run
+					zeroRun = *source++;
+				}
+			}
+
+			previous = static_cast<uint8_t>(previous + delta);
+			destination[static_cast<size_t>(v) * stride + column] = previous;
+		}
+	}
+	return zeroRun == 0 && source == end;
+}
+}
+
+std::vector<uint8_t> WriteMeshFile(const MeshFileContent& content, bool compress)
+{
+	assert(content.vertexStride > 0 && content.vertices.size() % content.vertexStride == 0 && "Vertices must be whole");
+	assert(content.meshletBounds.size() == content.meshlets.meshlets.size() && "Every meshlet needs bounds");
+
+	MeshFileHeader header = { };
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>(content.vertices.size() / content.vertexStride);
+	header.vertexStride = content.vertexStride;
+	header.indexCount = static_cast<uint32_t>(content.indices.size());
+	header.indexSize = GetIndexSize(header.vertexCount);
+	header.lodCount = static_cast<uint32_t>(content.lods.size());
+	header.meshletCount = static_cast<uint32_t>(content.meshlets.meshlets.size());
+	header.quantization = content.quantization;
+	std::memcpy(header.boundsMin, content.boundsMin, sizeof(header.boundsMin));
+	std::memcpy(header.boundsMax, content.boundsMax, sizeof(header.boundsMax));
+
+	std::vector<uint8_t> file(AlignOffset(sizeof(MeshFileHeader)), 0);
+
+	auto addSection = [&](MeshSection::Type type, const void* data, size_t size, uint64_t decodedSize, MeshCompression::Type compression)
+		{
+			MeshFileSection& section = header.sections[type];
+			section.size = size;
+			section.decodedSize = decodedSize;
+			section.compression = compression;
+			if (size == 0)
+			{
+				return;
+			}
+			section.offset = file.size();
+			file.insert(file.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+			file.resize(AlignOffset(file.size()), 0);
+		};
+	auto addRawSection = [&](MeshSection::Type type, const void* data, size_t size)
+		{
+			addSection(type, data, size, size, MeshCompression::None);
+		};
+
+	const std::vector<uint8_t> encodedVertices = compress ? EncodeVertices(content.vertices, content.vertexStride) : std::vector<uint8_t>();
+	if (compress && encodedVertices.size() < content.vertices.size())
+	{
+		addSection(MeshSection::Vertices, encodedVertices.data(), encodedVertices.size(), content.vertices.size(), MeshCompression::VertexDelta);
+	}
+	else
+	{
+		addRawSection(MeshSection::Vertices, content.vertices.data(), content.vertices.size());
+	}
+
+	const std::vector<uint8_t> packedIndices = PackIndices(content.indices, header.indexSize);
+	const std::vector<uint8_t> encodedIndices = compress ? EncodeIndices(content.indices) : std::vector<uint8_t>();
+	if (compress && encodedIndices.size() < packedIndices.size())
+	{
+		addSection(MeshSection::Indices, encodedIndices.data(), encodedIndices.size(), packedIndices.size(), MeshCompression::IndexDelta);
+	}
+	else
+	{
+		addRawSection(MeshSection::Indices, packedIndices.data(), packedIndices.size());
+	}
+
+	addRawSection(MeshSection::Lods, content.lods.data(), content.lods.size() * sizeof(MeshLod));
+	addRawSection(MeshSection::Meshlets, content.meshlets.meshlets.data(), content.meshlets.meshlets.size() * sizeof(Meshlet));
+	addRawSection(MeshSection::MeshletVertexIndices, content.meshlets.vertexIndices.data(),
+		content.meshlets.vertexIndices.size() * sizeof(uint32_t));
+	addRawSection(MeshSection::MeshletPrimitives, content.meshlets.primitives.data(),
+		content.meshlets.primitives.size() * sizeof(uint32_t));
+	addRawSection(MeshSection::MeshletBounds, content.meshletBounds.data(), content.meshletBounds.size() * sizeof(MeshletBounds));
+
+	std::memcpy(file.data(), &header, sizeof(header));
+	return file;
+}
+
+MeshFileView::MeshFileView()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_header{ }
+{
+}
+
+bool MeshFileView::Open(const void* data, size_t size)
+{
+	m_data = nullptr;
+	m_size = 0;
+
+	if (!data || size < sizeof(MeshFileHeader))
+	{
+		return false;
+	}
+	std::memcpy(&m_header, data, sizeof(MeshFileHeader));
+	if (m_header.magic != MESH_FILE_MAGIC || m_header.version != MESH_FILE_VERSION)
+	{
+		return false;
+	}
+	if (m_header.vertexStride == 0 || (m_header.indexSize != sizeof(uint16_t) && m_header.indexSize != sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	// the decoded sizes have to match the counts, callers size their buffers from either
+	const uint64_t expectedSizes[MeshSection::Count] = {
+		static_cast<uint64_t>(m_header.vertexCount) * m_header.vertexStride,
+		static_cast<uint64_t>(m_header.indexCount) * m_header.indexSize,
+		static_cast<uint64_t>(m_header.lodCount) * sizeof(MeshLod),
+		static_cast<uint64_t>(m_header.meshletCount) * sizeof(Meshlet),
+		m_header.sections[MeshSection::MeshletVertexIndices].decodedSize,
+		m_header.sections[MeshSection::MeshletPrimitives].decodedSize,
+		static_cast<uint64_t>(m_header.meshletCount) * sizeof(MeshletBounds),
+	};
+
+	for (uint32_t i = 0; i < MeshSection::Count; i++)
+	{
+		const MeshFileSection& section = m_header.sections[i];
+		if (section.decodedSize != expectedSizes[i] || section.offset > size || section.size > size - section.offset)
+		{
+			return false;
+		}
+		if (section.size > 0 && (section.offset < sizeof(MeshFileHeader) || section.offset % MESH_FILE_ALIGNMENT != 0))
+		{
+			return false;
+		}
+		const bool validCompression = section.compression == MeshCompression::None
+			|| (i == MeshSection::Indices && section.compression == MeshCompression::IndexDelta)
+			|| (i == MeshSection::Vertices && section.compression == MeshCompression::VertexDelta);
+		if (!validCompression || (section.compression == MeshCompression::None && section.size != section.decodedSize))
+		{
+			return false;
+		}
+	}
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = size;
+	return true;
+}
+
+const MeshFileHeader& MeshFileView::GetHeader() const
+{
+	return m_header;
+}
+
+uint64_t MeshFileView::GetDecodedSize(MeshSection::Type section) const
+{
+	return m_header.sections[section].decodedSize;
+}
+
+bool MeshFileView::DecodeSection(MeshSection::Type section, void* destination) const
+{
+	assert(m_data && "Open the view first");
+
+	const MeshFileSection& entry = m_header.sections[section];
+	const uint8_t* source = m_data + entry.offset;
+	uint8_t* target = static_cast<uint8_t*>(destination);
+
+	switch (entry.compression)
+	{
+	case MeshCompression::IndexDelta:
+		return DecodeIndices(source, entry.size, m_header.indexCount, m_header.indexSize, target);
+	case MeshCompression::VertexDelta:
+		return DecodeVertices(source, entry.size, m_header.vertexCount, m_header.vertexStride, target);
+	default:
+		if (entry.size > 0)
+		{
+			std::memcpy(target, source, entry.size);
+		}
+		return true;
+	}
+}
+
+const void* MeshFileView::GetSectionData(MeshSection::Type section) const
+{
+	assert(m_data && "Open the view first");
+
+	const MeshFileSection& entry = m_header.sections[section];
+	return (entry.compression == MeshCompression::None) ? m_data + entry.offset : nullptr;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Versioned binary container for imported meshes. The file is a fixed header followed by aligned sections holding
+// exactly the bytes the gpu buffers need, so loading is a map of the file and a copy per section straight into
+// upload memory. Index and vertex sections can optionally be stored delta compressed; they are then decoded on the
+// way into the destination, still without an intermediate copy.
+
+#include <mesh_lod.hpp>
+#include <meshlet_builder.hpp>
+#include <vertex_quantization.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t MESH_FILE_MAGIC = 0x48534D43;  // "CMSH"
+// bump whenever the header, a section or a codec changes, older files are then reimported
+constexpr uint32_t MESH_FILE_VERSION = 1;
+// sections start on cache line boundaries
+constexpr uint64_t MESH_FILE_ALIGNMENT = 64;
+
+namespace MeshSection
+{
+enum Type : uint32_t
+{
+	Vertices = 0,          // vertexCount * vertexStride bytes
+	Indices,               // indexCount * indexSize bytes
+	Lods,                  // MeshLod per level, ranges into Indices
+	Meshlets,              // Meshlet per meshlet of LOD 0
+	MeshletVertexIndices,  // uint32_t, see MeshletData
+	MeshletPrimitives,     // uint32_t, see MeshletData
+	MeshletBounds,         // MeshletBounds per meshlet
+	Count
+};
+}
+
+namespace MeshCompression
+{
+enum Type : uint32_t
+{
+	None = 0,
+	IndexDelta,   // zigzag varints of the difference to the previous index
+	VertexDelta,  // per byte difference to the previous vertex, transposed and zero run length encoded
+};
+}
+
+struct MeshFileSection
+{
+	uint64_t offset;       // from the start of the file, 0 if the section is empty
+	uint64_t size;         // stored bytes
+	uint64_t decodedSize;  // bytes after decompression
+	uint32_t compression;  // MeshCompression::Type
+	uint32_t reserved;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	uint32_t indexSize;  // bytes per decoded index, 2 or 4
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	PositionQuantization quantization;
+	float boundsMin[3];
+	float boundsMax[3];
+	MeshFileSection sections[MeshSection::Count];
+};
+
+/// Everything WriteMeshFile stores, vertices already packed in their gpu format
+struct MeshFileContent
+{
+	std::vector<uint8_t> vertices;
+	uint32_t vertexStride;
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;
+	MeshletData meshlets;
+	std::vector<MeshletBounds> meshletBounds;
+	PositionQuantization quantization;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+/// Serialize a mesh. With compress set, index and vertex sections are compressed where that makes them smaller.
+std::vector<uint8_t> WriteMeshFile(const MeshFileContent& content, bool compress);
+
+/// Read only view of a mesh file in memory, usually a mapped file. The memory has to outlive the view.
+class MeshFileView
+{
+public:
+	MeshFileView();
+
+	/// Validate the header and the section table, the section contents are not touched
+	/// @returns False if the data is not a mesh file of this version
+	bool Open(const void* data, size_t size);
+
+	const MeshFileHeader& GetHeader() const;
+
+	/// @returns Number of bytes DecodeSection writes
+	uint64_t GetDecodedSize(MeshSection::Type section) const;
+
+	/// Copy a section from the file into destination, decompressing it on the way
+	/// @returns False if compressed data is corrupt
+	bool DecodeSection(MeshSection::Type section, void* destination) const;
+
+	/// @returns The stored bytes of an uncompressed section for use in place, nullptr if the section is compressed
+	const void* GetSectionData(MeshSection::Type section) const;
+
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+	MeshFileHeader m_header;
+};
@@ -0,0 +1,91 @@
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+// levels that remove less than this fraction of the previous level's indices are not worth their memory
+const float g_minLodReduction = 0.1f;
+// distances below this are treated as the camera touching the mesh
+const float g_minLodDistance = 1e-3f;
+}
+
+LodChain BuildLodChain(const MeshPositions& positions, const std::vector<uint32_t>& indices, uint32_t maxLodCount,
+	float reductionRatio, float maxError)
+{
+	assert(reductionRatio > 0.f && reductionRatio < 1.f && "Each LOD has to reduce the triangle count");
+
+	LodChain chain;
+	chain.indices = indices;
+	chain.lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.f });
+
+	size_t previousIndexCount = indices.size();
+	while (chain.lods.size() < maxLodCount)
+	{
+		const size_t targetIndexCount = static_cast<size_t>(previousIndexCount * reductionRatio) / 3 * 3;
+
+		// simplify from the original mesh each time so errors are measured against LOD 0
+		float error = 0.f;
+		std::vector<uint32_t> lodIndices = SimplifyMesh(positions, indices, targetIndexCount, maxError, &error);
+		if (lodIndices.empty() || lodIndices.size() > previousIndexCount * (1.f - g_minLodReduction))
+		{
+			break;
+		}
+
+		MeshLod lod;
+		lod.startIndex = static_cast<uint32_t>(chain.indices.size());
+		lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+		// never report less error than a finer level, selection relies on errors growing along the chain
+		lod.error = std::max(error, chain.lods.back().error);
+		chain.lods.push_back(lod);
+		chain.indices.insert(chain.indices.end(), lodIndices.begin(), lodIndices.end());
+
+		previousIndexCount = lodIndices.size();
+	}
+
+	return chain;
+}
+
+float ProjectErrorToScreen(float error, float distance, float fovY, float viewportHeight)
+{
+	const float projectedHeight = 2.f * std::max(distance, g_minLodDistance) * std::tan(fovY * 0.5f);
+	return error * viewportHeight / projectedHeight;
+}
+
+uint32_t SelectLod(const std::vector<MeshLod>& lods, uint32_t currentLod, float distance, float fovY, float viewportHeight,
+	float pixelThreshold, float hysteresis)
+{
+	if (lods.empty())
+	{
+		return 0;
+	}
+	currentLod = std::min(currentLod, static_cast<uint32_t>(lods.size() - 1));
+
+	auto coarsestBelow = [&](float threshold)
+		{
+			uint32_t lod = 0;
+			for (uint32_t i = 1; i < lods.size(); i++)
+			{
+				if (ProjectErrorToScreen(lods[i].error, distance, fovY, viewportHeight) <= threshold)
+				{
+					lod = i;
+				}
+			}
+			return lod;
+		};
+
+	const uint32_t coarser = coarsestBelow(pixelThreshold * (1.f - hysteresis));
+	if (coarser > currentLod)
+	{
+		return coarser;
+	}
+
+	if (ProjectErrorToScreen(lods[currentLod].error, distance, fovY, viewportHeight) > pixelThreshold * (1.f + hysteresis))
+	{
+		return coarsestBelow(pixelThreshold);
+	}
+
+	return currentLod;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// LOD chains built with the quadric simplifier and their runtime selection from projected screen-space error.
+
+#include <mesh_simplifier.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/// One level of detail: a range of the chain's index buffer
+struct MeshLod
+{
+	uint32_t startIndex;
+	uint32_t indexCount;
+	float error;  // largest object space deviation from LOD 0
+};
+
+/// All levels of one mesh, finest first. Indices of every level reference the original vertex buffer.
+struct LodChain
+{
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;
+};
+
+/// Build up to maxLodCount levels, each targeting reductionRatio of the previous level's triangles.
+/// Generation stops early once a level is out of the maxError budget or barely smaller than the previous one.
+LodChain BuildLodChain(const MeshPositions& positions, const std::vector<uint32_t>& indices, uint32_t maxLodCount,
+	float reductionRatio = 0.5f, float maxError = 1.f);
+
+/// @param fovY Vertical field of view in radians
+/// @returns Size in pixels of an object space error seen from `distance`
+float ProjectErrorToScreen(float error, float distance, float fovY, float viewportHeight);
+
+/// Pick the coarsest level whose projected error stays below pixelThreshold.
+/// To avoid popping back and forth at the threshold, a coarser level is only taken once its error is below
+/// pixelThreshold * (1 - hysteresis), and the current level is only refined once its error exceeds
+/// pixelThreshold * (1 + hysteresis).
+/// @param distance Distance from the camera to the mesh bounds, in the mesh's object space units
+/// @returns Index into lods
+uint32_t SelectLod(const std::vector<MeshLod>& lods, uint32_t currentLod, float distance, float fovY, float viewportHeight,
+	float pixelThreshold = 1.f, float hysteresis = 0.25f);
@@ -0,0 +1,400 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// tuning of Forsyth's scoring function, see "Linear-Speed Vertex Cache Optimisation"
+const uint32_t g_forsythCacheSize = 32;
+const float g_cacheDecayPower = 1.5f;
+const float g_lastTriangleScore = 0.75f;
+const float g_valenceBoostScale = 2.f;
+const float g_valenceBoostPower = 0.5f;
+
+const uint32_t INVALID_TRIANGLE = UINT32_MAX;
+const uint32_t INVALID_VERTEX = UINT32_MAX;
+
+float ForsythVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.f;
+	}
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// vertices of the last triangle get a fixed score so it is not simply repeated
+			score = g_lastTriangleScore;
+		}
+		else
+		{
+			const float scaler = 1.f / (g_forsythCacheSize - 3);
+			score = std::pow(1.f - (cachePosition - 3) * scaler, g_cacheDecayPower);
+		}
+	}
+
+	// favour vertices with few triangles left so they are finished instead of stranded
+	score += g_valenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -g_valenceBoostPower);
+	return score;
+}
+
+struct Float3
+{
+	float x, y, z;
+};
+
+Float3 LoadPosition(const MeshPositions& positions, uint32_t vertex)
+{
+	Float3 result;
+	std::memcpy(&result, reinterpret_cast<const uint8_t*>(positions.data) + vertex * positions.stride, sizeof(result));
+	return result;
+}
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// vertex to triangle adjacency, the live triangles of vertex v are the first remaining[v] entries of its range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		remaining[index]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = ForsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* triangle = &indices[t * 3];
+		triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+		{
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(g_forsythCacheSize + 3);
+	newCache.reserve(g_forsythCacheSize + 3);
+	uint32_t cursor = 0;
+
+	while (bestTriangle != INVALID_TRIANGLE)
+	{
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[bestTriangle] = true;
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t v = triangle[corner];
+			uint32_t* live = &adjacency[offsets[v]];
+			uint32_t* found = std::find(live, live + remaining[v], bestTriangle);
+			assert(found != live + remaining[v]);
+			std::swap(*found, live[remaining[v] - 1]);
+			remaining[v]--;
+		}
+
+		// the emitted triangle moves to the front of the LRU cache
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		// rescore every vertex whose cache position changed, including the ones that just fell out
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			const uint32_t v = newCache[i];
+			cachePositions[v] = (i < g_forsythCacheSize) ? static_cast<int>(i) : -1;
+			vertexScores[v] = ForsythVertexScore(cachePositions[v], remaining[v]);
+		}
+		for (uint32_t v : newCache)
+		{
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				const uint32_t t = adjacency[a];
+				const uint32_t* other = &indices[t * 3];
+				triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), g_forsythCacheSize));
+		std::swap(cache, newCache);
+
+		// the next triangle is the best one touching the cache
+		bestTriangle = INVALID_TRIANGLE;
+		float bestScore = -1.f;
+		for (uint32_t v : cache)
+		{
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				const uint32_t t = adjacency[a];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		// nothing left around the cache, continue with the next unvisited part of the mesh
+		if (bestTriangle == INVALID_TRIANGLE)
+		{
+			while (cursor < triangleCount && emitted[cursor])
+			{
+				cursor++;
+			}
+			if (cursor < triangleCount)
+			{
+				bestTriangle = cursor;
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const MeshPositions& positions, float threshold)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// split where the cache is cold anyway: reordering clusters there costs (almost) no extra transforms
+	std::vector<uint32_t> clusterStarts;
+	std::vector<uint32_t> cacheTimestamps(positions.vertexCount, 0);
+	uint32_t timestamp = DEFAULT_VERTEX_CACHE_SIZE + 1;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t v = indices[t * 3 + corner];
+			if (timestamp - cacheTimestamps[v] > DEFAULT_VERTEX_CACHE_SIZE)
+			{
+				cacheTimestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3)
+		{
+			clusterStarts.push_back(t);
+		}
+	}
+	if (clusterStarts.size() < 2)
+	{
+		return;
+	}
+	clusterStarts.push_back(triangleCount);
+
+	struct Cluster
+	{
+		uint32_t begin;
+		uint32_t end;
+		Float3 centroid;
+		Float3 normal;  // area weighted
+		float area;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters(clusterStarts.size() - 1);
+
+	Float3 meshCentroid = { 0.f, 0.f, 0.f };
+	float meshArea = 0.f;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		Cluster& cluster = clusters[c];
+		cluster = { clusterStarts[c], clusterStarts[c + 1], { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f }, 0.f, 0.f };
+
+		for (uint32_t t = cluster.begin; t < cluster.end; t++)
+		{
+			const Float3 p0 = LoadPosition(positions, indices[t * 3]);
+			const Float3 p1 = LoadPosition(positions, indices[t * 3 + 1]);
+			const Float3 p2 = LoadPosition(positions, indices[t * 3 + 2]);
+			const Float3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const Float3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			const Float3 normal = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+			const float area = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z) * 0.5f;
+
+			cluster.centroid.x += (p0.x + p1.x + p2.x) / 3.f * area;
+			cluster.centroid.y += (p0.y + p1.y + p2.y) / 3.f * area;
+			cluster.centroid.z += (p0.z + p1.z + p2.z) / 3.f * area;
+			cluster.normal.x += normal.x;
+			cluster.normal.y += normal.y;
+			cluster.normal.z += normal.z;
+			cluster.area += area;
+		}
+
+		meshCentroid.x += cluster.centroid.x;
+		meshCentroid.y += cluster.centroid.y;
+		meshCentroid.z += cluster.centroid.z;
+		meshArea += cluster.area;
+
+		if (cluster.area > 0.f)
+		{
+			cluster.centroid.x /= cluster.area;
+			cluster.centroid.y /= cluster.area;
+			cluster.centroid.z /= cluster.area;
+		}
+	}
+	if (meshArea <= 0.f)
+	{
+		return;
+	}
+	meshCentroid = { meshCentroid.x / meshArea, meshCentroid.y / meshArea, meshCentroid.z / meshArea };
+
+	// clusters far out along their own normal occlude the rest of the mesh from most directions
+	for (Cluster& cluster : clusters)
+	{
+		const float length = std::sqrt(cluster.normal.x * cluster.normal.x + cluster.normal.y * cluster.normal.y +
+			cluster.normal.z * cluster.normal.z);
+		if (length > 0.f)
+		{
+			cluster.sortKey = ((cluster.centroid.x - meshCentroid.x) * cluster.normal.x +
+				(cluster.centroid.y - meshCentroid.y) * cluster.normal.y +
+				(cluster.centroid.z - meshCentroid.z) * cluster.normal.z) / length;
+		}
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& lhs, const Cluster& rhs)
+		{
+			return lhs.sortKey > rhs.sortKey;
+		});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const Cluster& cluster : clusters)
+	{
+		result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	}
+
+	const float acmrBefore = AnalyzeVertexCache(indices, positions.vertexCount).acmr;
+	const float acmrAfter = AnalyzeVertexCache(result, positions.vertexCount).acmr;
+	if (acmrAfter <= acmrBefore * threshold)
+	{
+		indices.swap(result);
+	}
+}
+
+size_t OptimizeVertexFetch(std::vector<uint32_t>& indices, void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	std::vector<uint32_t> remap(vertexCount, INVALID_VERTEX);
+	uint32_t nextVertex = 0;
+	for (uint32_t& index : indices)
+	{
+		assert(index < vertexCount && "Index out of range");
+		if (remap[index] == INVALID_VERTEX)
+		{
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+
+	uint8_t* data = static_cast<uint8_t*>(vertices);
+	const std::vector<uint8_t> original(data, data + vertexCount * vertexSize);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != INVALID_VERTEX)
+		{
+			std::memcpy(data + remap[v] * vertexSize, original.data() + v * vertexSize, vertexSize);
+		}
+	}
+
+	return nextVertex;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics = { 0, 0.f, 0.f };
+	if (indices.empty())
+	{
+		return statistics;
+	}
+
+	// FIFO cache: a vertex is cached while fewer than cacheSize misses happened since it was transformed
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t timestamp = cacheSize + 1;
+	size_t uniqueVertices = 0;
+	for (uint32_t index : indices)
+	{
+		if (timestamp - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = timestamp++;
+			statistics.verticesTransformed++;
+		}
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+	}
+
+	statistics.acmr = static_cast<float>(statistics.verticesTransformed) / (indices.size() / 3);
+	statistics.atvr = static_cast<float>(statistics.verticesTransformed) / uniqueVertices;
+	return statistics;
+}
+
+uint32_t GetIndexSize(size_t vertexCount)
+{
+	return (vertexCount <= UINT16_MAX + 1) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<uint8_t> PackIndices(const std::vector<uint32_t>& indices, uint32_t indexSize)
+{
+	assert((indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t)) && "Indices are 16 or 32 bit");
+
+	std::vector<uint8_t> packed(indices.size() * indexSize);
+	if (indexSize == sizeof(uint32_t))
+	{
+		std::memcpy(packed.data(), indices.data(), packed.size());
+		return packed;
+	}
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		assert(indices[i] <= UINT16_MAX && "Index does not fit into 16 bits");
+		const uint16_t index = static_cast<uint16_t>(indices[i]);
+		std::memcpy(packed.data() + i * sizeof(index), &index, sizeof(index));
+	}
+	return packed;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Import-time reordering of triangle lists and vertex buffers for the gpu's post-transform cache, early depth
+// rejection and vertex fetch, plus cache analysis so the effect can be measured without a gpu.
+
+#include <mesh_simplifier.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Post-transform cache simulation results
+struct VertexCacheStatistics
+{
+	size_t verticesTransformed;
+	float acmr;  // average cache miss ratio: transformed vertices per triangle, 0.5 at best for large meshes, 3 at worst
+	float atvr;  // average transformed vertex ratio: transformed vertices per referenced vertex, 1 at best
+};
+
+/// Size of the FIFO cache simulated by AnalyzeVertexCache, close to what current hardware effectively provides
+constexpr uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+/// Reorder triangles for post-transform cache hits (Forsyth's linear-speed algorithm).
+/// Triangle winding is preserved.
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+/// Reorder clusters of cache-optimized triangles so outward facing ones are drawn first and hide the rest.
+/// The result is only kept when its ACMR is at most threshold times the input's, so run it after OptimizeVertexCache.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const MeshPositions& positions, float threshold = 1.05f);
+
+/// Reorder vertices into first use order so fetches stream linearly, and rewrite the indices to match.
+/// Unreferenced vertices are dropped.
+/// @param vertices vertexCount elements of vertexSize bytes, rewritten in place
+/// @returns Number of vertices left
+size_t OptimizeVertexFetch(std::vector<uint32_t>& indices, void* vertices, size_t vertexCount, size_t vertexSize);
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+	uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+/// @returns 2 if every index fits into 16 bits, 4 otherwise
+uint32_t GetIndexSize(size_t vertexCount);
+
+/// Narrow or copy indices into an index buffer of indexSize bytes per index
+std::vector<uint8_t> PackIndices(const std::vector<uint32_t>& indices, uint32_t indexSize);
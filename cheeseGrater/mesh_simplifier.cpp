@@ -0,0 +1,396 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+// boundary edges are protected by planes perpendicular to their triangle, weighted this much stronger
+const float g_boundaryWeight = 10.f;
+// a collapse is rejected when a triangle normal turns by more than ~75 degrees
+const float g_minNormalDot = 0.25f;
+
+struct Vector3
+{
+	float x, y, z;
+};
+
+Vector3 Subtract(const Vector3& a, const Vector3& b)
+{
+	return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+Vector3 Cross(const Vector3& a, const Vector3& b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+float Dot(const Vector3& a, const Vector3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float Length(const Vector3& v)
+{
+	return std::sqrt(Dot(v, v));
+}
+
+/// Sum of squared distances to a set of planes, stored as the upper triangle of a symmetric 4x4 matrix
+struct Quadric
+{
+	float a2, b2, c2, d2;
+	float ab, ac, ad;
+	float bc, bd;
+	float cd;
+	float weight;
+};
+
+Quadric MakePlaneQuadric(const Vector3& normal, float d, float weight)
+{
+	Quadric q;
+	q.a2 = normal.x * normal.x * weight;
+	q.b2 = normal.y * normal.y * weight;
+	q.c2 = normal.z * normal.z * weight;
+	q.d2 = d * d * weight;
+	q.ab = normal.x * normal.y * weight;
+	q.ac = normal.x * normal.z * weight;
+	q.ad = normal.x * d * weight;
+	q.bc = normal.y * normal.z * weight;
+	q.bd = normal.y * d * weight;
+	q.cd = normal.z * d * weight;
+	q.weight = weight;
+	return q;
+}
+
+void AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.a2 += other.a2;
+	q.b2 += other.b2;
+	q.c2 += other.c2;
+	q.d2 += other.d2;
+	q.ab += other.ab;
+	q.ac += other.ac;
+	q.ad += other.ad;
+	q.bc += other.bc;
+	q.bd += other.bd;
+	q.cd += other.cd;
+	q.weight += other.weight;
+}
+
+/// @returns Weighted mean squared distance of v to the planes of q
+float EvaluateQuadric(const Quadric& q, const Vector3& v)
+{
+	const float rx = q.a2 * v.x + q.ab * v.y + q.ac * v.z + q.ad;
+	const float ry = q.ab * v.x + q.b2 * v.y + q.bc * v.z + q.bd;
+	const float rz = q.ac * v.x + q.bc * v.y + q.c2 * v.z + q.cd;
+	const float rw = q.ad * v.x + q.bd * v.y + q.cd * v.z + q.d2;
+
+	const float error = rx * v.x + ry * v.y + rz * v.z + rw;
+	return (q.weight > 0.f) ? std::max(0.f, error / q.weight) : 0.f;
+}
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	float error;  // squared distance
+};
+
+Vector3 LoadPosition(const MeshPositions& positions, size_t vertex)
+{
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(positions.data) + vertex * positions.stride;
+	Vector3 result;
+	std::memcpy(&result, base, sizeof(result));
+	return result;
+}
+
+uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+	return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+/// Vertices sharing their position with another vertex carry a seam and must keep their place
+std::vector<bool> FindSeamVertices(const std::vector<Vector3>& vertices)
+{
+	struct PositionHash
+	{
+		size_t operator()(const Vector3& v) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &v, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+	struct PositionEqual
+	{
+		bool operator()(const Vector3& a, const Vector3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> firstVertex;
+	std::vector<bool> seam(vertices.size(), false);
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		auto inserted = firstVertex.emplace(vertices[i], i);
+		if (!inserted.second)
+		{
+			seam[i] = true;
+			seam[inserted.first->second] = true;
+		}
+	}
+	return seam;
+}
+
+std::vector<Quadric> ComputeVertexQuadrics(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices)
+{
+	std::vector<Quadric> quadrics(vertices.size(), Quadric{ });
+
+	// an edge is on the boundary when its opposite half edge does not exist
+	std::unordered_map<uint64_t, uint32_t> halfEdges;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const uint32_t a = indices[i];
+		const uint32_t b = indices[(i % 3 == 2) ? i - 2 : i + 1];
+		halfEdges[EdgeKey(a, b)]++;
+	}
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const uint32_t triangle[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		const Vector3& p0 = vertices[triangle[0]];
+		const Vector3 crossProduct = Cross(Subtract(vertices[triangle[1]], p0), Subtract(vertices[triangle[2]], p0));
+		const float doubleArea = Length(crossProduct);
+		if (doubleArea <= 0.f)
+		{
+			continue;
+		}
+
+		const Vector3 normal = { crossProduct.x / doubleArea, crossProduct.y / doubleArea, crossProduct.z / doubleArea };
+		const Quadric plane = MakePlaneQuadric(normal, -Dot(normal, p0), doubleArea * 0.5f);
+		for (uint32_t vertex : triangle)
+		{
+			AddQuadric(quadrics[vertex], plane);
+		}
+
+		for (int edge = 0; edge < 3; edge++)
+		{
+			const uint32_t a = triangle[edge];
+			const uint32_t b = triangle[(edge + 1) % 3];
+			if (halfEdges.count(EdgeKey(b, a)) > 0)
+			{
+				continue;
+			}
+
+			const Vector3 direction = Subtract(vertices[b], vertices[a]);
+			const float length = Length(direction);
+			if (length <= 0.f)
+			{
+				continue;
+			}
+
+			Vector3 edgeNormal = Cross(direction, normal);
+			edgeNormal = { edgeNormal.x / length, edgeNormal.y / length, edgeNormal.z / length };
+			const Quadric boundary = MakePlaneQuadric(edgeNormal, -Dot(edgeNormal, vertices[a]), length * length * g_boundaryWeight);
+			AddQuadric(quadrics[a], boundary);
+			AddQuadric(quadrics[b], boundary);
+		}
+	}
+
+	return quadrics;
+}
+
+/// @returns True if moving `from` onto `to` keeps the orientation of every remaining triangle around `from`
+bool IsCollapseValid(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& vertexTriangles, uint32_t trianglesBegin, uint32_t trianglesEnd, uint32_t from, uint32_t to)
+{
+	for (uint32_t t = trianglesBegin; t < trianglesEnd; t++)
+	{
+		const uint32_t* triangle = &indices[vertexTriangles[t] * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			// collapses to nothing
+			continue;
+		}
+
+		Vector3 before[3];
+		Vector3 after[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			before[corner] = vertices[triangle[corner]];
+			after[corner] = vertices[(triangle[corner] == from) ? to : triangle[corner]];
+		}
+
+		const Vector3 normalBefore = Cross(Subtract(before[1], before[0]), Subtract(before[2], before[0]));
+		const Vector3 normalAfter = Cross(Subtract(after[1], after[0]), Subtract(after[2], after[0]));
+		const float lengths = Length(normalBefore) * Length(normalAfter);
+		if (lengths <= 0.f || Dot(normalBefore, normalAfter) < g_minNormalDot * lengths)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+std::vector<uint32_t> SimplifyMesh(const MeshPositions& positions, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, float* resultError)
+{
+	assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+
+	std::vector<Vector3> vertices(positions.vertexCount);
+	for (size_t i = 0; i < positions.vertexCount; i++)
+	{
+		vertices[i] = LoadPosition(positions, i);
+	}
+
+	const std::vector<bool> seam = FindSeamVertices(vertices);
+	std::vector<Quadric> quadrics = ComputeVertexQuadrics(vertices, indices);
+
+	std::vector<uint32_t> result = indices;
+	const float maxErrorSquared = maxError * maxError;
+	float largestError = 0.f;
+
+	std::vector<uint32_t> remap(vertices.size());
+	std::vector<bool> locked(vertices.size());
+	std::vector<uint32_t> triangleOffsets(vertices.size() + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> collapses;
+	std::unordered_set<uint64_t> edges;
+
+	// every pass collapses a batch of independent edges, cheapest first, then rebuilds adjacency
+	while (result.size() > targetIndexCount)
+	{
+		// vertex to triangle adjacency as a compact list
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			triangleOffsets[index + 1]++;
+		}
+		for (size_t i = 1; i < triangleOffsets.size(); i++)
+		{
+			triangleOffsets[i] += triangleOffsets[i - 1];
+		}
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (uint32_t i = 0; i < result.size(); i++)
+		{
+			vertexTriangles[fill[result[i]]++] = i / 3;
+		}
+
+		// cheapest direction of every edge
+		collapses.clear();
+		edges.clear();
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			const uint32_t a = result[i];
+			const uint32_t b = result[(i % 3 == 2) ? i - 2 : i + 1];
+			if (!edges.insert(EdgeKey(std::min(a, b), std::max(a, b))).second)
+			{
+				continue;
+			}
+
+			Quadric combined = quadrics[a];
+			AddQuadric(combined, quadrics[b]);
+
+			Collapse collapse = { 0, 0, 0.f };
+			const float errorAtB = seam[a] ? INFINITY : EvaluateQuadric(combined, vertices[b]);
+			const float errorAtA = seam[b] ? INFINITY : EvaluateQuadric(combined, vertices[a]);
+			if (errorAtB <= errorAtA)
+			{
+				collapse = { a, b, errorAtB };
+			}
+			else
+			{
+				collapse = { b, a, errorAtA };
+			}
+
+			if (collapse.error <= maxErrorSquared)
+			{
+				collapses.push_back(collapse);
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& lhs, const Collapse& rhs)
+			{
+				return lhs.error < rhs.error;
+			});
+
+		for (uint32_t i = 0; i < remap.size(); i++)
+		{
+			remap[i] = i;
+		}
+		std::fill(locked.begin(), locked.end(), false);
+
+		// each collapse removes two triangles on closed meshes, one on boundaries
+		size_t remainingIndexCount = result.size();
+		size_t collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (remainingIndexCount <= targetIndexCount)
+			{
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to])
+			{
+				continue;
+			}
+
+			const uint32_t begin = triangleOffsets[collapse.from];
+			const uint32_t end = triangleOffsets[collapse.from + 1];
+			if (!IsCollapseValid(vertices, result, vertexTriangles, begin, end, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			// the one-ring of `from` changes, so none of it may take part in another collapse this pass
+			for (uint32_t t = begin; t < end; t++)
+			{
+				const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+				locked[triangle[0]] = locked[triangle[1]] = locked[triangle[2]] = true;
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					remainingIndexCount -= 3;
+				}
+			}
+
+			remap[collapse.from] = collapse.to;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			largestError = std::max(largestError, collapse.error);
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		// apply the collapses and drop the triangles that became degenerate
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const uint32_t a = remap[result[i]];
+			const uint32_t b = remap[result[i + 1]];
+			const uint32_t c = remap[result[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				result[writeIndex++] = a;
+				result[writeIndex++] = b;
+				result[writeIndex++] = c;
+			}
+		}
+		result.resize(writeIndex);
+	}
+
+	if (resultError)
+	{
+		*resultError = std::sqrt(largestError);
+	}
+	return result;
+}
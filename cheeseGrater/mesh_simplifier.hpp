@@ -0,0 +1,26 @@
+#pragma once
+
+// Quadric error metric mesh simplification used to build LOD chains at import time.
+// Only the index buffer is rewritten: every LOD references the vertices of the original mesh, so one vertex
+// buffer serves the whole chain.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Positions of a mesh with an arbitrary vertex layout
+struct MeshPositions
+{
+	const float* data;    // xyz of the first vertex
+	size_t vertexCount;
+	size_t stride;        // bytes between two consecutive positions
+};
+
+/// Collapse edges of the triangle list until it has at most targetIndexCount indices or any further collapse
+/// would move the surface by more than maxError (object space units).
+/// Vertices that share their position with another vertex (attribute seams) are never moved, and collapses that
+/// would flip a triangle are rejected, so the result can stop above the target.
+/// @param resultError If not null, receives the largest error introduced by the accepted collapses
+/// @returns Indices of the simplified triangle list
+std::vector<uint32_t> SimplifyMesh(const MeshPositions& positions, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, float* resultError = nullptr);
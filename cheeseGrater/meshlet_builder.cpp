@@ -0,0 +1,217 @@
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT, enough for structured buffer views of every section
+const uint64_t g_sectionAlignment = 16;
+const uint8_t INVALID_LOCAL_VERTEX = UINT8_MAX;
+
+uint64_t AlignSection(uint64_t offset)
+{
+	return (offset + g_sectionAlignment - 1) & ~(g_sectionAlignment - 1);
+}
+
+struct Float3
+{
+	float x, y, z;
+};
+
+Float3 LoadPosition(const MeshPositions& positions, uint32_t vertex)
+{
+	Float3 result;
+	std::memcpy(&result, reinterpret_cast<const uint8_t*>(positions.data) + vertex * positions.stride, sizeof(result));
+	return result;
+}
+}
+
+MeshletData BuildMeshlets(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+	static_assert(MESHLET_MAX_VERTICES <= (1 << 10) && MESHLET_MAX_VERTICES < INVALID_LOCAL_VERTEX,
+		"Local vertices must fit into the packed triangle and the lookup table");
+
+	MeshletData data;
+	data.meshlets.reserve(indices.size() / 3 / MESHLET_MAX_PRIMITIVES + 1);
+
+	// mesh vertex -> local vertex of the meshlet being built
+	std::vector<uint8_t> localVertices(vertexCount, INVALID_LOCAL_VERTEX);
+	Meshlet current = { 0, 0, 0, 0 };
+
+	auto finishMeshlet = [&]()
+		{
+			if (current.primitiveCount == 0)
+			{
+				return;
+			}
+			for (uint32_t i = 0; i < current.vertexCount; i++)
+			{
+				localVertices[data.vertexIndices[current.vertexOffset + i]] = INVALID_LOCAL_VERTEX;
+			}
+			data.meshlets.push_back(current);
+			current = { static_cast<uint32_t>(data.vertexIndices.size()), 0, static_cast<uint32_t>(data.primitives.size()), 0 };
+		};
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const uint32_t triangle[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+		uint32_t newVertices = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+			if (localVertices[triangle[corner]] == INVALID_LOCAL_VERTEX && !repeated)
+			{
+				newVertices++;
+			}
+		}
+
+		if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.primitiveCount + 1 > MESHLET_MAX_PRIMITIVES)
+		{
+			finishMeshlet();
+		}
+
+		uint32_t local[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint8_t& localVertex = localVertices[triangle[corner]];
+			if (localVertex == INVALID_LOCAL_VERTEX)
+			{
+				localVertex = static_cast<uint8_t>(current.vertexCount++);
+				data.vertexIndices.push_back(triangle[corner]);
+			}
+			local[corner] = localVertex;
+		}
+
+		data.primitives.push_back(PackMeshletTriangle(local[0], local[1], local[2]));
+		current.primitiveCount++;
+	}
+	finishMeshlet();
+
+	return data;
+}
+
+std::vector<MeshletBounds> ComputeMeshletBounds(const MeshletData& data, const MeshPositions& positions)
+{
+	std::vector<MeshletBounds> result(data.meshlets.size());
+	std::vector<Float3> normals;
+
+	for (size_t m = 0; m < data.meshlets.size(); m++)
+	{
+		const Meshlet& meshlet = data.meshlets[m];
+		const uint32_t* vertexIndices = &data.vertexIndices[meshlet.vertexOffset];
+		MeshletBounds& bounds = result[m];
+
+		// sphere around the bounding box, tight enough for clusters this small
+		Float3 minimum = LoadPosition(positions, vertexIndices[0]);
+		Float3 maximum = minimum;
+		for (uint32_t v = 1; v < meshlet.vertexCount; v++)
+		{
+			const Float3 p = LoadPosition(positions, vertexIndices[v]);
+			minimum = { std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z) };
+			maximum = { std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z) };
+		}
+		const Float3 center = { (minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f };
+		float radiusSquared = 0.f;
+		for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		{
+			const Float3 p = LoadPosition(positions, vertexIndices[v]);
+			const Float3 d = { p.x - center.x, p.y - center.y, p.z - center.z };
+			radiusSquared = std::max(radiusSquared, d.x * d.x + d.y * d.y + d.z * d.z);
+		}
+		bounds.center[0] = center.x;
+		bounds.center[1] = center.y;
+		bounds.center[2] = center.z;
+		bounds.radius = std::sqrt(radiusSquared);
+
+		// normal cone: the axis is the average normal, the cutoff follows from the normal furthest away from it
+		normals.clear();
+		Float3 axis = { 0.f, 0.f, 0.f };
+		for (uint32_t p = 0; p < meshlet.primitiveCount; p++)
+		{
+			const uint32_t packed = data.primitives[meshlet.primitiveOffset + p];
+			const Float3 p0 = LoadPosition(positions, vertexIndices[packed & 0x3FF]);
+			const Float3 p1 = LoadPosition(positions, vertexIndices[(packed >> 10) & 0x3FF]);
+			const Float3 p2 = LoadPosition(positions, vertexIndices[(packed >> 20) & 0x3FF]);
+			const Float3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const Float3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			Float3 normal = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+			const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			if (length <= 0.f)
+			{
+				continue;
+			}
+			normal = { normal.x / length, normal.y / length, normal.z / length };
+			normals.push_back(normal);
+			axis = { axis.x + normal.x, axis.y + normal.y, axis.z + normal.z };
+		}
+
+		const float axisLength = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+		float minDot = 1.f;
+		if (axisLength > 0.f)
+		{
+			axis = { axis.x / axisLength, axis.y / axisLength, axis.z / axisLength };
+			for (const Float3& normal : normals)
+			{
+				minDot = std::min(minDot, normal.x * axis.x + normal.y * axis.y + normal.z * axis.z);
+			}
+		}
+		else
+		{
+			minDot = -1.f;
+		}
+
+		bounds.coneAxis[0] = axis.x;
+		bounds.coneAxis[1] = axis.y;
+		bounds.coneAxis[2] = axis.z;
+		// a spread of 90 degrees or more can always be seen from some side
+		bounds.coneCutoff = (minDot <= 0.f) ? 1.f : std::sqrt(1.f - minDot * minDot);
+	}
+
+	return result;
+}
+
+bool IsMeshletBackfacing(const MeshletBounds& bounds, const float cameraPosition[3])
+{
+	const float toCenter[3] = {
+		bounds.center[0] - cameraPosition[0],
+		bounds.center[1] - cameraPosition[1],
+		bounds.center[2] - cameraPosition[2]
+	};
+	const float distance = std::sqrt(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+	const float alongAxis = toCenter[0] * bounds.coneAxis[0] + toCenter[1] * bounds.coneAxis[1] + toCenter[2] * bounds.coneAxis[2];
+
+	// the sphere keeps the test conservative for every point of the meshlet, not only its center
+	return alongAxis >= bounds.coneCutoff * distance + bounds.radius;
+}
+
+std::vector<uint8_t> SerializeMeshlets(const MeshletData& data, const std::vector<MeshletBounds>& bounds,
+	MeshletBufferLayout& layout)
+{
+	assert(bounds.size() == data.meshlets.size() && "Every meshlet needs bounds");
+
+	layout.meshletsOffset = 0;
+	layout.vertexIndicesOffset = AlignSection(layout.meshletsOffset + data.meshlets.size() * sizeof(Meshlet));
+	layout.primitivesOffset = AlignSection(layout.vertexIndicesOffset + data.vertexIndices.size() * sizeof(uint32_t));
+	layout.boundsOffset = AlignSection(layout.primitivesOffset + data.primitives.size() * sizeof(uint32_t));
+	layout.size = AlignSection(layout.boundsOffset + bounds.size() * sizeof(MeshletBounds));
+
+	std::vector<uint8_t> buffer(layout.size, 0);
+	auto copySection = [&buffer](uint64_t offset, const void* source, size_t size)
+		{
+			if (size > 0)
+			{
+				std::memcpy(buffer.data() + offset, source, size);
+			}
+		};
+	copySection(layout.meshletsOffset, data.meshlets.data(), data.meshlets.size() * sizeof(Meshlet));
+	copySection(layout.vertexIndicesOffset, data.vertexIndices.data(), data.vertexIndices.size() * sizeof(uint32_t));
+	copySection(layout.primitivesOffset, data.primitives.data(), data.primitives.size() * sizeof(uint32_t));
+	copySection(layout.boundsOffset, bounds.data(), bounds.size() * sizeof(MeshletBounds));
+
+	return buffer;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Splits triangle lists into meshlets, small clusters sized for mesh shader thread groups, and computes the data
+// needed to cull whole clusters: a bounding sphere and a cone containing all triangle normals.
+// The layout follows the usual mesh shader convention: every meshlet owns a range of unique vertex indices into the
+// mesh's vertex buffer and a range of triangles whose corners index into that range.
+
+#include <mesh_simplifier.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+// 124 instead of 128 keeps the primitive output of a mesh shader group under the recommended size
+constexpr uint32_t MESHLET_MAX_PRIMITIVES = 124;
+
+/// Ranges of one meshlet inside MeshletData
+struct Meshlet
+{
+	uint32_t vertexOffset;     // into MeshletData::vertexIndices
+	uint32_t vertexCount;
+	uint32_t primitiveOffset;  // into MeshletData::primitives
+	uint32_t primitiveCount;
+};
+static_assert(sizeof(Meshlet) == 16, "Meshlet is read as a structured buffer");
+
+/// Culling data of one meshlet
+struct MeshletBounds
+{
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;  // sine of the cone's half angle, 1 when the normals are too spread out to ever cull
+};
+static_assert(sizeof(MeshletBounds) == 32, "MeshletBounds is read as a structured buffer");
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertexIndices;  // meshlet local vertex -> mesh vertex
+	std::vector<uint32_t> primitives;     // three 10 bit meshlet local vertices per triangle, see PackMeshletTriangle
+};
+
+/// Byte offsets of the sections of a buffer written by SerializeMeshlets, each aligned for structured buffer views
+struct MeshletBufferLayout
+{
+	uint64_t meshletsOffset;
+	uint64_t vertexIndicesOffset;
+	uint64_t primitivesOffset;
+	uint64_t boundsOffset;
+	uint64_t size;
+};
+
+inline uint32_t PackMeshletTriangle(uint32_t a, uint32_t b, uint32_t c)
+{
+	return a | (b << 10) | (c << 20);
+}
+
+/// Greedily fill meshlets in triangle order. Run OptimizeVertexCache first: its locality is what keeps meshlets
+/// full and compact.
+MeshletData BuildMeshlets(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+std::vector<MeshletBounds> ComputeMeshletBounds(const MeshletData& data, const MeshPositions& positions);
+
+/// CPU reference of the cluster backface test: true if no triangle of the meshlet can face the camera
+bool IsMeshletBackfacing(const MeshletBounds& bounds, const float cameraPosition[3]);
+
+/// Pack meshlets, vertex indices, primitives and bounds into one buffer so they can be uploaded at once
+std::vector<uint8_t> SerializeMeshlets(const MeshletData& data, const std::vector<MeshletBounds>& bounds,
+	MeshletBufferLayout& layout);
@@ -0,0 +1,423 @@
+#include "pipeline_cache.hpp"
+
+#include <hash.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+// bump when the way streams are hashed changes, keys of older files would not match anymore
+const uint32_t g_keyVersion = 1;
+// the whole pipeline library is stored as a single entry, pipeline keys are never 0
+const uint64_t g_libraryKey = 0;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// a stream subobject is its type followed by the value at its natural alignment, each subobject is pointer aligned
+template <typename T>
+const T& ReadSubobject(const uint8_t* subobject)
+{
+	return *reinterpret_cast<const T*>(subobject + AlignUp(sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE), alignof(T)));
+}
+
+template <typename T>
+size_t GetSubobjectSize()
+{
+	return AlignUp(AlignUp(sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE), alignof(T)) + sizeof(T), sizeof(void*));
+}
+
+void HashStencilOp(Hasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& desc)
+{
+	hasher.Add(desc.StencilFailOp).Add(desc.StencilDepthFailOp).Add(desc.StencilPassOp).Add(desc.StencilFunc);
+}
+
+// member by member, the descriptions have padding after their 8 bit members
+void HashDepthStencil(Hasher& hasher, const D3D12_DEPTH_STENCIL_DESC& desc)
+{
+	hasher.Add(desc.DepthEnable).Add(desc.DepthWriteMask).Add(desc.DepthFunc).Add(desc.StencilEnable)
+		.Add(desc.StencilReadMask).Add(desc.StencilWriteMask);
+	HashStencilOp(hasher, desc.FrontFace);
+	HashStencilOp(hasher, desc.BackFace);
+}
+
+void HashBlend(Hasher& hasher, const D3D12_BLEND_DESC& desc)
+{
+	hasher.Add(desc.AlphaToCoverageEnable).Add(desc.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& target : desc.RenderTarget)
+	{
+		hasher.Add(target.BlendEnable).Add(target.LogicOpEnable).Add(target.SrcBlend).Add(target.DestBlend)
+			.Add(target.BlendOp).Add(target.SrcBlendAlpha).Add(target.DestBlendAlpha).Add(target.BlendOpAlpha)
+			.Add(target.LogicOp).Add(target.RenderTargetWriteMask);
+	}
+}
+
+void HashInputLayout(Hasher& hasher, const D3D12_INPUT_LAYOUT_DESC& desc)
+{
+	hasher.Add(desc.NumElements);
+	for (UINT i = 0; i < desc.NumElements; i++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = desc.pInputElementDescs[i];
+		hasher.AddString(element.SemanticName).Add(element.SemanticIndex).Add(element.Format).Add(element.InputSlot)
+			.Add(element.AlignedByteOffset).Add(element.InputSlotClass).Add(element.InstanceDataStepRate);
+	}
+}
+}
+
+PipelineCache::PipelineCache(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<IDXGIAdapter4> adapter,
+	const std::wstring& path)
+	: m_device(device)
+	, m_path(path)
+	, m_dirty(false)
+	, m_hitCount(0)
+	, m_missCount(0)
+{
+	// compiled pipelines only stay valid on the same hardware with the same user mode driver
+	DXGI_ADAPTER_DESC1 adapterDesc = { };
+	ThrowIfFailed(adapter->GetDesc1(&adapterDesc));
+	LARGE_INTEGER driverVersion = { };
+	adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+	m_identity = Hasher().Add(PipelineCacheFile::VERSION).Add(g_keyVersion).Add(adapterDesc.VendorId).Add(adapterDesc.DeviceId)
+		.Add(adapterDesc.SubSysId).Add(adapterDesc.Revision).Add(driverVersion.QuadPart).Get();
+
+	D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+	featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+	if (FAILED(m_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+	{
+		featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+	}
+	m_rootSignatureVersion = featureData.HighestVersion;
+
+	if (m_mappedFile.Open(m_path) && !m_file.Load(m_mappedFile.GetData(), m_mappedFile.GetSize(), m_identity))
+	{
+		::OutputDebugStringA("Pipeline cache was written for another adapter, driver or version, it is rebuilt\n");
+		m_mappedFile.Close();
+	}
+
+	// the library keeps using the serialized data it was created from, which stays mapped
+	PipelineCacheFile::Blob library = { };
+	if (m_file.Find(g_libraryKey, library)
+		&& FAILED(m_device->CreatePipelineLibrary(library.data, library.size, IID_PPV_ARGS(&m_library))))
+	{
+		m_library.Reset();
+	}
+	if (!m_library && FAILED(m_device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_library))))
+	{
+		::OutputDebugStringA("Pipeline libraries are not supported, pipelines are cached as blobs\n");
+		m_library.Reset();
+	}
+}
+
+PipelineCache::~PipelineCache()
+{
+	char buffer[128];
+	sprintf_s(buffer, "Pipeline cache: %u pipelines loaded, %u compiled\n", m_hitCount, m_missCount);
+	::OutputDebugStringA(buffer);
+
+	Save();
+}
+
+Microsoft::WRL::ComPtr<ID3D12RootSignature> PipelineCache::CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc)
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> rootSignatureBlob;
+	Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+	ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&desc, m_rootSignatureVersion, &rootSignatureBlob, &errorBlob));
+	const uint64_t key = HashBytes(rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Microsoft::WRL::ComPtr<ID3D12RootSignature>& rootSignature = m_rootSignatures[key];
+	if (!rootSignature)
+	{
+		ThrowIfFailed(m_device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(),
+			IID_PPV_ARGS(&rootSignature)));
+		m_rootSignatureKeys[rootSignature.Get()] = key;
+		m_rootSignatureIds[rootSignature.Get()] = static_cast<uint32_t>(m_rootSignatures.size());
+	}
+	return rootSignature;
+}
+
+uint32_t PipelineCache::GetRootSignatureId(ID3D12RootSignature* rootSignature) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rootSignatureIds.find(rootSignature);
+	return (it != m_rootSignatureIds.end()) ? it->second : 0;
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc)
+{
+	return CreatePipelineState(desc, GetPipelineKey(desc));
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key)
+{
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (key != 0)
+		{
+			pipelineState = m_library ? LoadFromLibrary(desc, key) : LoadFromBlob(desc, key);
+		}
+		if (pipelineState)
+		{
+			m_hitCount++;
+			return pipelineState;
+		}
+		m_missCount++;
+	}
+
+	// compiled without the lock, other threads keep loading and compiling meanwhile
+	ThrowIfFailed(m_device->CreatePipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+	if (key != 0)
+	{
+		Store(pipelineState, key);
+	}
+	return pipelineState;
+}
+
+uint64_t PipelineCache::GetPipelineKey(const D3D12_PIPELINE_STATE_STREAM_DESC& desc) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return HashStream(desc);
+}
+
+uint32_t PipelineCache::GetHitCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hitCount;
+}
+
+uint32_t PipelineCache::GetMissCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_missCount;
+}
+
+uint64_t PipelineCache::HashStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc) const
+{
+	Hasher hasher;
+	const uint8_t* subobject = static_cast<const uint8_t*>(desc.pPipelineStateSubobjectStream);
+	const uint8_t* const end = subobject + desc.SizeInBytes;
+	while (subobject < end)
+	{
+		const D3D12_PIPELINE_STATE_SUBOBJECT_TYPE type = *reinterpret_cast<const D3D12_PIPELINE_STATE_SUBOBJECT_TYPE*>(subobject);
+		hasher.Add(type);
+
+		size_t size = 0;
+		switch (type)
+		{
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
+		{
+			auto it = m_rootSignatureKeys.find(ReadSubobject<ID3D12RootSignature*>(subobject));
+			if (it == m_rootSignatureKeys.end())
+			{
+				return 0;
+			}
+			hasher.Add(it->second);
+			size = GetSubobjectSize<ID3D12RootSignature*>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+		{
+			const D3D12_SHADER_BYTECODE& bytecode = ReadSubobject<D3D12_SHADER_BYTECODE>(subobject);
+			hasher.Add(HashBytes(bytecode.pShaderBytecode, bytecode.BytecodeLength));
+			size = GetSubobjectSize<D3D12_SHADER_BYTECODE>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND:
+			HashBlend(hasher, ReadSubobject<D3D12_BLEND_DESC>(subobject));
+			size = GetSubobjectSize<D3D12_BLEND_DESC>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK:
+			hasher.Add(ReadSubobject<UINT>(subobject));
+			size = GetSubobjectSize<UINT>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER:
+		{
+			// only 32 bit members, no padding, floats are hashed by their bits
+			const D3D12_RASTERIZER_DESC& rasterizer = ReadSubobject<D3D12_RASTERIZER_DESC>(subobject);
+			hasher.Add(&rasterizer, sizeof(rasterizer));
+			size = GetSubobjectSize<D3D12_RASTERIZER_DESC>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL:
+			HashDepthStencil(hasher, ReadSubobject<D3D12_DEPTH_STENCIL_DESC>(subobject));
+			size = GetSubobjectSize<D3D12_DEPTH_STENCIL_DESC>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1:
+		{
+			const D3D12_DEPTH_STENCIL_DESC1& depthStencil = ReadSubobject<D3D12_DEPTH_STENCIL_DESC1>(subobject);
+			const D3D12_DEPTH_STENCIL_DESC common = { depthStencil.DepthEnable, depthStencil.DepthWriteMask,
+				depthStencil.DepthFunc, depthStencil.StencilEnable, depthStencil.StencilReadMask,
+				depthStencil.StencilWriteMask, depthStencil.FrontFace, depthStencil.BackFace };
+			HashDepthStencil(hasher, common);
+			hasher.Add(depthStencil.DepthBoundsTestEnable);
+			size = GetSubobjectSize<D3D12_DEPTH_STENCIL_DESC1>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
+			HashInputLayout(hasher, ReadSubobject<D3D12_INPUT_LAYOUT_DESC>(subobject));
+			size = GetSubobjectSize<D3D12_INPUT_LAYOUT_DESC>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE:
+			hasher.Add(ReadSubobject<D3D12_INDEX_BUFFER_STRIP_CUT_VALUE>(subobject));
+			size = GetSubobjectSize<D3D12_INDEX_BUFFER_STRIP_CUT_VALUE>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY:
+			hasher.Add(ReadSubobject<D3D12_PRIMITIVE_TOPOLOGY_TYPE>(subobject));
+			size = GetSubobjectSize<D3D12_PRIMITIVE_TOPOLOGY_TYPE>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS:
+		{
+			const D3D12_RT_FORMAT_ARRAY& formats = ReadSubobject<D3D12_RT_FORMAT_ARRAY>(subobject);
+			hasher.Add(formats.NumRenderTargets).Add(formats.RTFormats);
+			size = GetSubobjectSize<D3D12_RT_FORMAT_ARRAY>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT:
+			hasher.Add(ReadSubobject<DXGI_FORMAT>(subobject));
+			size = GetSubobjectSize<DXGI_FORMAT>();
+			break;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC:
+		{
+			const DXGI_SAMPLE_DESC& sampleDesc = ReadSubobject<DXGI_SAMPLE_DESC>(subobject);
+			hasher.Add(sampleDesc.Count).Add(sampleDesc.Quality);
+			size = GetSubobjectSize<DXGI_SAMPLE_DESC>();
+			break;
+		}
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS:
+			hasher.Add(ReadSubobject<D3D12_PIPELINE_STATE_FLAGS>(subobject));
+			size = GetSubobjectSize<D3D12_PIPELINE_STATE_FLAGS>();
+			break;
+		default:
+			// stream output, view instancing and cached blobs are not used by the engine, such pipelines are compiled
+			return 0;
+		}
+		subobject += size;
+	}
+
+	const uint64_t key = hasher.Get();
+	return (key != g_libraryKey) ? key : key + 1;
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::LoadFromLibrary(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key)
+{
+	wchar_t name[17];
+	swprintf_s(name, L"%016llx", static_cast<unsigned long long>(key));
+
+	// fails if the library has no pipeline of that name or it was stored with a different stream
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	if (FAILED(m_library->LoadPipeline(name, &desc, IID_PPV_ARGS(&pipelineState))))
+	{
+		return nullptr;
+	}
+	return pipelineState;
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::LoadFromBlob(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key)
+{
+	PipelineCacheFile::Blob blob = { };
+	if (!m_file.Find(key, blob))
+	{
+		return nullptr;
+	}
+
+	// the same stream with the cached blob appended, every subobject is pointer aligned so the copy keeps them aligned
+	CD3DX12_PIPELINE_STATE_STREAM_CACHED_PSO cachedPipeline = D3D12_CACHED_PIPELINE_STATE{ blob.data, blob.size };
+	std::vector<void*> stream((desc.SizeInBytes + sizeof(cachedPipeline) + sizeof(void*) - 1) / sizeof(void*));
+	std::memcpy(stream.data(), desc.pPipelineStateSubobjectStream, desc.SizeInBytes);
+	std::memcpy(reinterpret_cast<uint8_t*>(stream.data()) + desc.SizeInBytes, &cachedPipeline, sizeof(cachedPipeline));
+	const D3D12_PIPELINE_STATE_STREAM_DESC cachedDesc = { desc.SizeInBytes + sizeof(cachedPipeline), stream.data() };
+
+	// a blob the driver does not accept anymore is compiled again and replaced
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	if (FAILED(m_device->CreatePipelineState(&cachedDesc, IID_PPV_ARGS(&pipelineState))))
+	{
+		return nullptr;
+	}
+	return pipelineState;
+}
+
+void PipelineCache::Store(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState, uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_library)
+	{
+		wchar_t name[17];
+		swprintf_s(name, L"%016llx", static_cast<unsigned long long>(key));
+		// another thread may have compiled and stored the same pipeline meanwhile, the first one stays
+		m_dirty = SUCCEEDED(m_library->StorePipeline(name, pipelineState.Get())) || m_dirty;
+		return;
+	}
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (SUCCEEDED(pipelineState->GetCachedBlob(&blob)))
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+		m_file.Add(key, std::vector<uint8_t>(data, data + blob->GetBufferSize()));
+		m_dirty = true;
+	}
+}
+
+void PipelineCache::Save()
+{
+	std::vector<uint8_t> contents;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_dirty)
+		{
+			return;
+		}
+
+		if (m_library)
+		{
+			std::vector<uint8_t> library(m_library->GetSerializedSize());
+			if (FAILED(m_library->Serialize(library.data(), library.size())))
+			{
+				::OutputDebugStringA("Pipeline library could not be serialized\n");
+				return;
+			}
+			PipelineCacheFile file;
+			file.Add(g_libraryKey, std::move(library));
+			contents = file.Serialize(m_identity);
+		}
+		else
+		{
+			contents = m_file.Serialize(m_identity);
+		}
+
+		// a mapped file can not be replaced, nothing refers to the mapping anymore
+		m_library.Reset();
+		m_file.Clear();
+		m_mappedFile.Close();
+		m_dirty = false;
+	}
+
+	// written next to the old cache and moved over it, so a crash while writing never leaves a truncated cache behind
+	const std::wstring temporaryPath = m_path + L".tmp";
+	{
+		std::ofstream file(std::filesystem::path(temporaryPath), std::ios::binary);
+		file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		if (!file)
+		{
+			::OutputDebugStringA("Pipeline cache could not be written\n");
+			return;
+		}
+	}
+	if (!::MoveFileExW(temporaryPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		::OutputDebugStringA("Pipeline cache could not be replaced\n");
+	}
+}
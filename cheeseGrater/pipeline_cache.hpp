@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <mapped_file.hpp>
+#include <pipeline_cache_file.hpp>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// Keeps compiled pipeline states across runs. A pipeline is keyed by a stable hash of its whole state stream: the
+/// serialized root signature, the shader bytecode, the input layout, the fixed function state and the formats. The
+/// pipelines are stored in an ID3D12PipelineLibrary, or as cached blobs of the single pipelines where the driver has no
+/// library support, inside a memory mapped cache file that is rewritten when the cache is destroyed. The file is
+/// dropped when the adapter or its driver changes, so a warm start creates every known pipeline without compiling it.
+/// Thread safe, pipelines may be created from several threads at once.
+class PipelineCache
+{
+public:
+	PipelineCache(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<IDXGIAdapter4> adapter,
+		const std::wstring& path);
+	/// Writes the cache file if pipelines were added
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache& other) = delete;
+	PipelineCache& operator=(const PipelineCache& other) = delete;
+
+	/// Serialize a root signature at the highest version the device supports and create it. Pipelines are only cached
+	/// if their root signature was created here, it is keyed by its serialized contents. Root signatures live as long
+	/// as the cache, identical descriptions share one.
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc);
+	/// @returns Dense id of a root signature created here, counting from 1 in creation order, 0 for any other
+	uint32_t GetRootSignatureId(ID3D12RootSignature* rootSignature) const;
+
+	/// Create a graphics or compute pipeline, loaded from the cache if it was compiled before
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc);
+	/// @param key The stream's key, saves hashing it again
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key);
+	/// @returns Stable key of the whole stream, equal streams have equal keys. 0 if it holds something that can not be
+	/// keyed, such a pipeline is never cached.
+	uint64_t GetPipelineKey(const D3D12_PIPELINE_STATE_STREAM_DESC& desc) const;
+
+	/// @returns Pipelines created from the cache and pipelines that had to be compiled since startup
+	uint32_t GetHitCount() const;
+	uint32_t GetMissCount() const;
+
+private:
+	/// Called with the mutex held
+	uint64_t HashStream(const D3D12_PIPELINE_STATE_STREAM_DESC& desc) const;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> LoadFromLibrary(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key);
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> LoadFromBlob(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, uint64_t key);
+	void Store(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState, uint64_t key);
+	void Save();
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+	std::wstring m_path;
+	// everything that makes compiled pipelines invalid, the cache file is ignored if it was written with another
+	uint64_t m_identity;
+	D3D_ROOT_SIGNATURE_VERSION m_rootSignatureVersion;
+
+	mutable std::mutex m_mutex;
+	// the loaded library and blobs point into the mapping, it stays open until the cache is written
+	MappedFile m_mappedFile;
+	PipelineCacheFile m_file;
+	// nullptr if the driver does not support libraries, pipelines are stored as blobs in m_file then
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> m_library;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12RootSignature>> m_rootSignatures;
+	// held by m_rootSignatures, so an address is never reused for another root signature
+	std::unordered_map<ID3D12RootSignature*, uint64_t> m_rootSignatureKeys;
+	std::unordered_map<ID3D12RootSignature*, uint32_t> m_rootSignatureIds;
+	bool m_dirty;
+	uint32_t m_hitCount;
+	uint32_t m_missCount;
+};
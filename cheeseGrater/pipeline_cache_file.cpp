@@ -0,0 +1,94 @@
+#include "pipeline_cache_file.hpp"
+
+#include <hash.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+bool PipelineCacheFile::Load(const uint8_t* data, size_t size, uint64_t identity)
+{
+	Clear();
+
+	Header header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION || header.identity != identity
+		|| header.entryCount > (size - sizeof(header)) / sizeof(Entry)
+		|| header.checksum != HashBytes(data + sizeof(header), size - sizeof(header)))
+	{
+		return false;
+	}
+
+	const uint8_t* entries = data + sizeof(header);
+	for (uint64_t i = 0; i < header.entryCount; i++)
+	{
+		Entry entry;
+		std::memcpy(&entry, entries + i * sizeof(Entry), sizeof(entry));
+		if (entry.offset > size || entry.size > size - entry.offset)
+		{
+			Clear();
+			return false;
+		}
+		m_entries[entry.key] = { data + entry.offset, static_cast<size_t>(entry.size) };
+	}
+	return true;
+}
+
+bool PipelineCacheFile::Find(uint64_t key, Blob& blob) const
+{
+	auto it = m_entries.find(key);
+	if (it == m_entries.end())
+	{
+		return false;
+	}
+	blob = it->second;
+	return true;
+}
+
+void PipelineCacheFile::Add(uint64_t key, std::vector<uint8_t> blob)
+{
+	std::vector<uint8_t>& stored = m_added[key];
+	stored = std::move(blob);
+	m_entries[key] = { stored.data(), stored.size() };
+}
+
+void PipelineCacheFile::Clear()
+{
+	m_entries.clear();
+	m_added.clear();
+}
+
+size_t PipelineCacheFile::GetEntryCount() const
+{
+	return m_entries.size();
+}
+
+std::vector<uint8_t> PipelineCacheFile::Serialize(uint64_t identity) const
+{
+	// sorted, so the same contents always give the same file
+	std::vector<uint64_t> keys;
+	keys.reserve(m_entries.size());
+	for (const auto& [key, blob] : m_entries)
+	{
+		keys.push_back(key);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	uint64_t offset = sizeof(Header) + keys.size() * sizeof(Entry);
+	std::vector<uint8_t> file(offset);
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		const Blob& blob = m_entries.at(keys[i]);
+		const Entry entry = { keys[i], offset, blob.size };
+		std::memcpy(file.data() + sizeof(Header) + i * sizeof(Entry), &entry, sizeof(entry));
+		file.insert(file.end(), blob.data, blob.data + blob.size);
+		offset += blob.size;
+	}
+
+	const Header header = { MAGIC, VERSION, identity, keys.size(), HashBytes(file.data() + sizeof(Header), file.size() - sizeof(Header)) };
+	std::memcpy(file.data(), &header, sizeof(header));
+	return file;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// On-disk store of pipeline state blobs by 64 bit key. The file is versioned and carries an identity of whatever
+// invalidates its contents (adapter, driver version), plus a checksum, so a stale, foreign or truncated cache is
+// rejected as a whole instead of being handed to the driver.
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class PipelineCacheFile
+{
+public:
+	static constexpr uint32_t MAGIC = 0x43504743;  // "CGPC"
+	static constexpr uint32_t VERSION = 1;
+
+	struct Blob
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+
+	/// Replace the contents with the entries of a serialized cache. Loaded blobs point into data, which has to outlive
+	/// them, so a memory mapped file is never copied.
+	/// @param identity Has to match the identity the cache was serialized with
+	/// @returns False and leaves the store empty if data is not a valid cache of this version and identity
+	bool Load(const uint8_t* data, size_t size, uint64_t identity);
+
+	/// @returns False if there is no entry for the key
+	bool Find(uint64_t key, Blob& blob) const;
+	/// Add or replace an entry, the store keeps its own copy
+	void Add(uint64_t key, std::vector<uint8_t> blob);
+	void Clear();
+
+	size_t GetEntryCount() const;
+
+	/// @returns The file contents
+	std::vector<uint8_t> Serialize(uint64_t identity) const;
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t identity;
+		uint64_t entryCount;
+		// of everything after the header
+		uint64_t checksum;
+	};
+
+	struct Entry
+	{
+		uint64_t key;
+		// from the start of the file
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	std::unordered_map<uint64_t, Blob> m_entries;
+	// blobs added since Load, the entries point into them
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_added;
+};
@@ -0,0 +1,150 @@
+#include "pipeline_compiler.hpp"
+
+#include <pipeline_cache.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+bool PipelineHandle::IsReady() const
+{
+	return m_state && m_state->ready.load(std::memory_order_acquire);
+}
+
+ID3D12PipelineState* PipelineHandle::Get() const
+{
+	ID3D12PipelineState* pipelineState = GetReady(m_state.get());
+	return pipelineState ? pipelineState : GetReady(m_fallback.get());
+}
+
+uint32_t PipelineHandle::GetId() const
+{
+	return m_state ? m_state->id : 0;
+}
+
+ID3D12PipelineState* PipelineHandle::GetReady(const State* state)
+{
+	return (state && state->ready.load(std::memory_order_acquire)) ? state->pipelineState.Get() : nullptr;
+}
+
+PipelineCompiler::PipelineCompiler(std::shared_ptr<PipelineCache> pipelineCache, uint32_t threadCount)
+	: m_pipelineCache(pipelineCache)
+	, m_quit(false)
+	, m_runningCount(0)
+	, m_pipelineCount(0)
+{
+	for (uint32_t i = 0; i < std::max(1u, threadCount); i++)
+	{
+		m_workers.emplace_back(&PipelineCompiler::WorkerMain, this);
+	}
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+		m_queue.clear();
+	}
+	m_workAvailable.notify_all();
+	m_workDone.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+PipelineHandle PipelineCompiler::Compile(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, const PipelineHandle& fallback)
+{
+	// hashed on the calling thread, the shader bytecode is likely still in its caches
+	const uint64_t key = m_pipelineCache->GetPipelineKey(desc);
+
+	PipelineHandle handle;
+	handle.m_fallback = fallback.m_state;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = (key != 0) ? m_pipelines.find(key) : m_pipelines.end();
+		if (it != m_pipelines.end())
+		{
+			handle.m_state = it->second;
+			return handle;
+		}
+
+		Job job;
+		job.stream.resize((desc.SizeInBytes + sizeof(void*) - 1) / sizeof(void*));
+		job.streamSize = desc.SizeInBytes;
+		std::memcpy(job.stream.data(), desc.pPipelineStateSubobjectStream, desc.SizeInBytes);
+		job.key = key;
+		job.state = std::make_shared<PipelineHandle::State>();
+		job.state->id = ++m_pipelineCount;
+		if (key != 0)
+		{
+			m_pipelines[key] = job.state;
+		}
+
+		handle.m_state = job.state;
+		m_queue.push_back(std::move(job));
+	}
+	m_workAvailable.notify_one();
+	return handle;
+}
+
+void PipelineCompiler::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_workDone.wait(lock, [this]() { return m_queue.empty() && m_runningCount == 0; });
+}
+
+size_t PipelineCompiler::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queue.size() + m_runningCount;
+}
+
+size_t PipelineCompiler::GetPipelineCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pipelineCount;
+}
+
+std::shared_ptr<PipelineCache> PipelineCompiler::GetPipelineCache() const
+{
+	return m_pipelineCache;
+}
+
+void PipelineCompiler::WorkerMain()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workAvailable.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+			if (m_quit)
+			{
+				return;
+			}
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+			m_runningCount++;
+		}
+
+		const D3D12_PIPELINE_STATE_STREAM_DESC desc = { job.streamSize, job.stream.data() };
+		try
+		{
+			job.state->pipelineState = m_pipelineCache->CreatePipelineState(desc, job.key);
+		}
+		catch (const std::exception&)
+		{
+			// draws keep using the fallback, or stay skipped
+			::OutputDebugStringA("Compiling a pipeline failed\n");
+		}
+		job.state->ready.store(true, std::memory_order_release);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_runningCount--;
+		}
+		m_workDone.notify_all();
+	}
+}
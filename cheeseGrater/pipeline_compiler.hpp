@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class PipelineCache;
+
+/// A pipeline that is compiled in the background. Copies, and handles to pipelines with the same state, refer to the
+/// same pipeline. Draws use Get() every frame and are skipped while it returns nullptr, so content shows up as soon
+/// as its pipeline is ready instead of stalling the thread that created it.
+class PipelineHandle
+{
+public:
+	PipelineHandle() = default;
+
+	/// @returns True once compiling finished, also if it failed
+	bool IsReady() const;
+	/// @returns The compiled pipeline, the fallback's pipeline while compiling or if compiling failed, nullptr if there
+	/// is neither
+	ID3D12PipelineState* Get() const;
+	/// @returns Dense id of the pipeline, counting from 1 in the order pipelines were first requested, so it fits the
+	/// few bits a draw sort key has for it. 0 for an empty handle.
+	uint32_t GetId() const;
+
+private:
+	friend class PipelineCompiler;
+
+	struct State
+	{
+		uint32_t id = 0;
+		// set after pipelineState, which is never written again once ready
+		std::atomic<bool> ready = false;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	};
+
+	/// @returns The pipeline of a state that is ready and did not fail, nullptr otherwise
+	static ID3D12PipelineState* GetReady(const State* state);
+
+	std::shared_ptr<const State> m_state;
+	// per handle, requests of the same pipeline may fall back to different ones
+	std::shared_ptr<const State> m_fallback;
+};
+
+/// Creates pipelines through the pipeline cache on worker threads and registers them by the key of their state, so
+/// every distinct pipeline exists once no matter how many games or materials request it; together with the root
+/// signatures the cache deduplicates, driver objects grow with the distinct states, not with their users. Pipelines
+/// live as long as the compiler. Loading code queues its pipelines and carries on, a loading screen can wait for all
+/// of them with WaitForAll or show GetPendingCount.
+/// Thread safe.
+class PipelineCompiler
+{
+public:
+	PipelineCompiler(std::shared_ptr<PipelineCache> pipelineCache, uint32_t threadCount = 2);
+	/// Waits for the pipelines being compiled, queued ones are dropped and never become ready
+	~PipelineCompiler();
+
+	PipelineCompiler(const PipelineCompiler& other) = delete;
+	PipelineCompiler& operator=(const PipelineCompiler& other) = delete;
+
+	/// Queue a pipeline, or share the one requested earlier with the same state. The stream is copied, but whatever it
+	/// points to (root signature, shader bytecode, input layout) has to stay valid until the handle is ready.
+	/// @param fallback Used by draws until the pipeline is ready, e.g. a cheaper pipeline with the same root signature
+	PipelineHandle Compile(const D3D12_PIPELINE_STATE_STREAM_DESC& desc, const PipelineHandle& fallback = { });
+
+	/// Block until every queued pipeline is ready
+	void WaitForAll();
+	/// @returns Pipelines queued or being compiled
+	size_t GetPendingCount() const;
+	/// @returns Distinct pipelines requested so far
+	size_t GetPipelineCount() const;
+
+	std::shared_ptr<PipelineCache> GetPipelineCache() const;
+
+private:
+	struct Job
+	{
+		// pointer aligned like the subobjects in it
+		std::vector<void*> stream;
+		size_t streamSize;
+		uint64_t key;
+		std::shared_ptr<PipelineHandle::State> state;
+	};
+
+	void WorkerMain();
+
+	std::shared_ptr<PipelineCache> m_pipelineCache;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_workDone;
+	bool m_quit;
+	std::deque<Job> m_queue;
+	size_t m_runningCount;
+	// by stream key, pipelines whose stream can not be keyed are not shared
+	std::unordered_map<uint64_t, std::shared_ptr<PipelineHandle::State>> m_pipelines;
+	uint32_t m_pipelineCount;
+
+	std::vector<std::thread> m_workers;
+};
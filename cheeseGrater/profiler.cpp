@@ -0,0 +1,229 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+std::atomic<bool> Profiler::s_enabled(false);
+
+namespace
+{
+// written by the zone's thread only, read by exports on any thread
+struct ZoneSlot
+{
+	std::atomic<const char*> name;
+	std::atomic<uint64_t> start;
+	std::atomic<uint64_t> end;
+};
+
+struct ThreadZones
+{
+	// zones ever written, the newest THREAD_CAPACITY of them are in the ring
+	std::atomic<uint64_t> count;
+	std::array<ZoneSlot, Profiler::THREAD_CAPACITY> zones;
+	// guarded by g_threadsMutex
+	const char* name;
+	uint32_t id;
+};
+
+struct Zone
+{
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+};
+
+// timestamps are converted by comparing how far they and the steady clock have advanced since the start
+const uint64_t g_startTimestamp = Profiler::GetTimestamp();
+const std::chrono::steady_clock::time_point g_startTime = std::chrono::steady_clock::now();
+std::atomic<uint64_t> g_enabledTimestamp(0);
+
+// zones of threads and of tracks, kept after their threads exit so their zones are still exported
+std::mutex g_threadsMutex;
+std::vector<std::unique_ptr<ThreadZones>> g_threads;
+thread_local ThreadZones* g_threadZones = nullptr;
+// names of zones that are no string literals, a node keeps its string where it is
+std::unordered_set<std::string> g_names;
+
+/// Called with g_threadsMutex held
+ThreadZones& AddThreadZones(const char* name)
+{
+	g_threads.push_back(std::make_unique<ThreadZones>());
+	ThreadZones& zones = *g_threads.back();
+	zones.count.store(0, std::memory_order_relaxed);
+	zones.name = name;
+	zones.id = static_cast<uint32_t>(g_threads.size());
+	return zones;
+}
+
+ThreadZones& GetThreadZones()
+{
+	if (!g_threadZones)
+	{
+		std::lock_guard<std::mutex> lock(g_threadsMutex);
+		g_threadZones = &AddThreadZones(nullptr);
+	}
+	return *g_threadZones;
+}
+
+void WriteZone(ThreadZones& zones, const char* name, uint64_t start, uint64_t end)
+{
+	const uint64_t index = zones.count.load(std::memory_order_relaxed);
+	ZoneSlot& slot = zones.zones[index % Profiler::THREAD_CAPACITY];
+
+	// an export that reads any part of the zone also reads a count of at least index, see GetChromeTrace
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	zones.count.store(index + 1, std::memory_order_release);
+}
+
+void AppendJsonString(std::string& json, const char* text)
+{
+	json += '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			json += '\\';
+		}
+		json += *c;
+	}
+	json += '"';
+}
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+	if (enabled)
+	{
+		g_enabledTimestamp.store(GetTimestamp(), std::memory_order_relaxed);
+	}
+	s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadZones& zones = GetThreadZones();
+	std::lock_guard<std::mutex> lock(g_threadsMutex);
+	zones.name = name;
+}
+
+void Profiler::AddZone(const char* name, uint64_t start, uint64_t end)
+{
+	WriteZone(GetThreadZones(), name, start, end);
+}
+
+uint32_t Profiler::AddTrack(const char* name)
+{
+	std::lock_guard<std::mutex> lock(g_threadsMutex);
+	return AddThreadZones(name).id;
+}
+
+void Profiler::AddZone(uint32_t track, const char* name, uint64_t start, uint64_t end)
+{
+	ThreadZones* zones;
+	{
+		std::lock_guard<std::mutex> lock(g_threadsMutex);
+		zones = g_threads[track - 1].get();
+	}
+	WriteZone(*zones, name, start, end);
+}
+
+const char* Profiler::InternName(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(g_threadsMutex);
+	return g_names.insert(name).first->c_str();
+}
+
+double Profiler::GetTimestampFrequency()
+{
+	const uint64_t nowTimestamp = GetTimestamp();
+	const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - g_startTime).count();
+	return (elapsedSeconds > 0.) ? static_cast<double>(nowTimestamp - g_startTimestamp) / elapsedSeconds : 1.;
+}
+
+std::string Profiler::GetChromeTrace()
+{
+	const double ticksPerMicrosecond = GetTimestampFrequency() / 1000000.;
+	const uint64_t enabledTimestamp = g_enabledTimestamp.load(std::memory_order_relaxed);
+	const auto toMicroseconds = [ticksPerMicrosecond](uint64_t timestamp)
+		{
+			return static_cast<double>(static_cast<int64_t>(timestamp - g_startTimestamp)) / ticksPerMicrosecond;
+		};
+
+	std::string json = "{\"traceEvents\":[\n";
+	char buffer[256];
+	bool first = true;
+	std::vector<Zone> copied;
+
+	std::lock_guard<std::mutex> lock(g_threadsMutex);
+	for (const std::unique_ptr<ThreadZones>& zones : g_threads)
+	{
+		const uint64_t count = zones->count.load(std::memory_order_acquire);
+		const uint64_t oldest = (count > THREAD_CAPACITY) ? count - THREAD_CAPACITY : 0;
+		copied.clear();
+		for (uint64_t i = oldest; i < count; i++)
+		{
+			const ZoneSlot& slot = zones->zones[i % THREAD_CAPACITY];
+			copied.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+				slot.end.load(std::memory_order_relaxed) });
+		}
+
+		// the thread kept recording meanwhile: the zones it published overwrote the oldest slots, and the one it may
+		// be writing right now the slot after them
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t countAfter = zones->count.load(std::memory_order_relaxed);
+		const uint64_t oldestIntact = (countAfter >= THREAD_CAPACITY) ? countAfter - THREAD_CAPACITY + 1 : 0;
+		if (oldestIntact > oldest)
+		{
+			copied.erase(copied.begin(), copied.begin() + static_cast<ptrdiff_t>(std::min(oldestIntact - oldest, count - oldest)));
+		}
+		copied.erase(std::remove_if(copied.begin(), copied.end(),
+			[enabledTimestamp](const Zone& zone) { return zone.start < enabledTimestamp; }), copied.end());
+		// zones starting together are nested, the enclosing one ends last
+		std::sort(copied.begin(), copied.end(),
+			[](const Zone& a, const Zone& b) { return (a.start != b.start) ? a.start < b.start : a.end > b.end; });
+
+		if (!first)
+		{
+			json += ",\n";
+		}
+		first = false;
+		json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(zones->id) + ",\"args\":{\"name\":";
+		if (zones->name)
+		{
+			AppendJsonString(json, zones->name);
+		}
+		else
+		{
+			json += "\"Thread " + std::to_string(zones->id) + "\"";
+		}
+		json += "}}";
+
+		for (const Zone& zone : copied)
+		{
+			json += ",\n{\"name\":";
+			AppendJsonString(json, zone.name);
+			std::snprintf(buffer, sizeof(buffer), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				zones->id, toMicroseconds(zone.start), toMicroseconds(zone.end) - toMicroseconds(zone.start));
+			json += buffer;
+		}
+	}
+	json += "\n]}\n";
+	return json;
+}
+
+bool Profiler::WriteChromeTrace(const std::filesystem::path& path)
+{
+	const std::string trace = GetChromeTrace();
+	std::ofstream file(path, std::ios::binary);
+	file.write(trace.data(), static_cast<std::streamsize>(trace.size()));
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+// Scoped CPU zones for finding where a frame's time goes:
+//
+//     void CommandQueue::Flush()
+//     {
+//         PROFILE_SCOPE("CommandQueue::Flush");
+//         ...
+//     }
+//
+// A zone is written when its scope ends, into a ring of the thread it ran on: a name pointer and two timestamps, with
+// no lock, allocation or system call. Timestamps are cycle counts of the CPU's invariant time stamp counter where
+// there is one and the steady clock elsewhere; both are converted to microseconds only when the zones are exported
+// as a Chrome trace, which chrome://tracing and ui.perfetto.dev open. Gpu queues add the zones they measured to
+// tracks of their own, in the same timeline. While profiling is disabled a zone costs a relaxed load and a branch, so
+// zones can stay in shipped code.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+class Profiler
+{
+public:
+	/// Zones every thread keeps, a thread's oldest ones are overwritten once its ring is full
+	static constexpr size_t THREAD_CAPACITY = 16384;
+
+	/// Zones started from now on are recorded, exports then only contain zones from the last time profiling was enabled
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled()
+	{
+		return s_enabled.load(std::memory_order_relaxed);
+	}
+
+	/// Name the calling thread in exported traces, threads without one are numbered
+	/// @param name Has to stay valid, a string literal
+	static void SetThreadName(const char* name);
+
+	/// @returns Current time in the unit zones are recorded in
+	static uint64_t GetTimestamp()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	/// Record a zone of the calling thread
+	/// @param name Has to stay valid, a string literal
+	static void AddZone(const char* name, uint64_t start, uint64_t end);
+
+	/// Add a timeline for zones that do not run on a cpu thread, e.g. the work of a gpu queue
+	/// @param name Has to stay valid, a string literal
+	/// @returns Track to add zones to, from one thread at a time
+	static uint32_t AddTrack(const char* name);
+	static void AddZone(uint32_t track, const char* name, uint64_t start, uint64_t end);
+	/// @returns A copy of a zone name that is no string literal, valid until the process ends
+	static const char* InternName(const std::string& name);
+	/// @returns Timestamps per second, measured against the steady clock since the profiler started
+	static double GetTimestampFrequency();
+
+	/// Safe while other threads keep recording, a zone overwritten while it is copied is left out
+	/// @returns The zones recorded by every thread since profiling was last enabled in the Chrome trace event format
+	static std::string GetChromeTrace();
+	/// @returns False if the file can not be written
+	static bool WriteChromeTrace(const std::filesystem::path& path);
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+/// Records the time from its construction to its destruction as a zone, if profiling was enabled when it started
+class ProfileScope
+{
+public:
+	/// @param name Has to stay valid, a string literal
+	explicit ProfileScope(const char* name)
+		: m_name(Profiler::IsEnabled() ? name : nullptr)
+		, m_start(m_name ? Profiler::GetTimestamp() : 0)
+	{
+	}
+
+	~ProfileScope()
+	{
+		if (m_name)
+		{
+			Profiler::AddZone(m_name, m_start, Profiler::GetTimestamp());
+		}
+	}
+
+	ProfileScope(const ProfileScope& other) = delete;
+	ProfileScope& operator=(const ProfileScope& other) = delete;
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+/// Record the rest of the enclosing scope as a zone
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
@@ -0,0 +1,131 @@
+#include "queue_scheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+QueueSegment EmptySegment(GpuQueue::Type queue)
+{
+	QueueSegment segment = { };
+	segment.queue = queue;
+	std::fill(std::begin(segment.waitFor), std::end(segment.waitFor), NO_QUEUE_SEGMENT);
+	segment.signal = false;
+	return segment;
+}
+}
+
+std::vector<QueueSegment> ScheduleQueueSegments(const std::vector<QueueSchedulePass>& passes)
+{
+	// segment progress is counted as index + 1 so that 0 means nothing of a queue is known to be complete
+	using Progress = std::vector<uint32_t>;
+
+	std::vector<QueueSegment> segments;
+	// progress of every queue known to be complete when a segment starts, through its waits and the ones before it
+	std::vector<Progress> segmentProgress;
+	std::vector<uint32_t> segmentOfPass(passes.size(), NO_QUEUE_SEGMENT);
+
+	QueueSegment open[GpuQueue::Count];
+	Progress known[GpuQueue::Count];
+	uint32_t submitted[GpuQueue::Count] = { };
+	for (uint8_t queue = 0; queue < GpuQueue::Count; queue++)
+	{
+		open[queue] = EmptySegment(static_cast<GpuQueue::Type>(queue));
+		known[queue].assign(GpuQueue::Count, 0);
+	}
+
+	auto close = [&](GpuQueue::Type queue)
+		{
+			const uint32_t index = static_cast<uint32_t>(segments.size());
+			for (uint32_t pass : open[queue].passes)
+			{
+				segmentOfPass[pass] = index;
+			}
+			segments.push_back(std::move(open[queue]));
+			segmentProgress.push_back(known[queue]);
+			submitted[queue] = index + 1;
+			open[queue] = EmptySegment(queue);
+		};
+
+	// start a new segment on a queue if it has to wait for more than it already knows to be complete
+	auto waitFor = [&](GpuQueue::Type queue, const uint32_t (&needed)[GpuQueue::Count])
+		{
+			bool wait = false;
+			for (uint8_t other = 0; other < GpuQueue::Count; other++)
+			{
+				wait = wait || needed[other] > known[queue][other];
+			}
+			if (!wait)
+			{
+				return;
+			}
+
+			// a wait can only be placed between command lists
+			if (!open[queue].passes.empty())
+			{
+				close(queue);
+			}
+			for (uint8_t other = 0; other < GpuQueue::Count; other++)
+			{
+				if (needed[other] <= known[queue][other])
+				{
+					continue;
+				}
+				const uint32_t segment = needed[other] - 1;
+				open[queue].waitFor[other] = segment;
+				segments[segment].signal = true;
+
+				// whatever the awaited segment knows to be complete is complete for this queue as well
+				for (uint8_t transitive = 0; transitive < GpuQueue::Count; transitive++)
+				{
+					known[queue][transitive] = std::max(known[queue][transitive], segmentProgress[segment][transitive]);
+				}
+				known[queue][other] = needed[other];
+			}
+		};
+
+	for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++)
+	{
+		const QueueSchedulePass& pass = passes[passIndex];
+
+		uint32_t needed[GpuQueue::Count] = { };
+		for (uint32_t dependency : pass.dependencies)
+		{
+			assert(dependency < passIndex && "Dependencies must point to earlier passes");
+
+			const GpuQueue::Type other = passes[dependency].queue;
+			if (other == pass.queue)
+			{
+				continue;
+			}
+			// the other queue has to submit what this pass waits for first
+			if (segmentOfPass[dependency] == NO_QUEUE_SEGMENT)
+			{
+				close(other);
+			}
+			needed[other] = std::max(needed[other], segmentOfPass[dependency] + 1);
+		}
+
+		waitFor(pass.queue, needed);
+		open[pass.queue].passes.push_back(passIndex);
+	}
+
+	for (uint8_t queue = 0; queue < GpuQueue::Count; queue++)
+	{
+		if (queue != GpuQueue::Graphics && !open[queue].passes.empty())
+		{
+			close(static_cast<GpuQueue::Type>(queue));
+		}
+	}
+
+	// the graphics queue finishes the frame, after everything the other queues submitted
+	uint32_t needed[GpuQueue::Count] = { };
+	for (uint8_t queue = 0; queue < GpuQueue::Count; queue++)
+	{
+		needed[queue] = (queue == GpuQueue::Graphics) ? 0 : submitted[queue];
+	}
+	waitFor(GpuQueue::Graphics, needed);
+	close(GpuQueue::Graphics);
+
+	return segments;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Splits the passes of a frame into command list segments per gpu queue and places the cross-queue waits between
+// them. Each queue has its own fence timeline; a segment waits for the last segment of another queue it depends on,
+// and waits already implied by an earlier wait are left out.
+
+#include <cstdint>
+#include <vector>
+
+namespace GpuQueue
+{
+enum Type : uint8_t
+{
+	Graphics = 0,
+	Compute,
+	Count
+};
+}
+
+constexpr uint32_t NO_QUEUE_SEGMENT = UINT32_MAX;
+
+struct QueueSchedulePass
+{
+	GpuQueue::Type queue;
+	// indices of earlier passes whose gpu work has to finish before this pass starts
+	std::vector<uint32_t> dependencies;
+};
+
+struct QueueSegment
+{
+	GpuQueue::Type queue;
+	std::vector<uint32_t> passes;
+	// per queue, index of a segment this one waits for before it starts, NO_QUEUE_SEGMENT if none
+	uint32_t waitFor[GpuQueue::Count];
+	// another segment waits for this one
+	bool signal;
+};
+
+/// @param passes In execution order, dependencies only point to earlier passes
+/// @returns Segments in submission order. Every segment only waits for segments submitted before it, so submitting
+/// them in this order never stalls a queue on a signal that has not been submitted yet. The last segment is always a
+/// graphics segment, possibly without passes, which waits for all other queues, so the fence of the graphics queue
+/// covers the whole frame.
+std::vector<QueueSegment> ScheduleQueueSegments(const std::vector<QueueSchedulePass>& passes);
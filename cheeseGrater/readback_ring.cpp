@@ -0,0 +1,182 @@
+#include "readback_ring.hpp"
+
+#include <command_queue.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+// texture footprints have to start at this alignment, buffer reads use it as well so every offset in the ring does
+const uint64_t g_readbackAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> CreateReadbackBuffer(ID3D12Device2* device, uint64_t size)
+{
+	const CD3DX12_HEAP_PROPERTIES readbackHeap(D3D12_HEAP_TYPE_READBACK);
+	const CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&buffer)));
+	return buffer;
+}
+}
+
+ReadbackRing::ReadbackRing(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> queue, uint64_t size)
+	: m_device(device)
+	, m_queue(queue)
+	, m_size(AlignUp(size, g_readbackAlignment))
+	, m_allocated(0)
+	, m_released(0)
+{
+	m_buffer = CreateReadbackBuffer(m_device.Get(), m_size);
+	m_buffer->SetName(L"Readback Ring");
+}
+
+ReadbackRing::~ReadbackRing()
+{
+	uint64_t lastFenceValue = 0;
+	for (const Slot& slot : m_slots)
+	{
+		lastFenceValue = std::max(lastFenceValue, slot.fenceValue);
+	}
+	if (lastFenceValue > 0)
+	{
+		m_queue->WaitForFenceValue(lastFenceValue);
+		Update();
+	}
+}
+
+std::future<std::vector<uint8_t>> ReadbackRing::ReadBuffer(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+	ID3D12Resource* buffer, uint64_t offset, uint64_t size)
+{
+	assert(size > 0 && "Empty readback");
+
+	auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+	std::future<std::vector<uint8_t>> future = promise->get_future();
+
+	const auto [destination, destinationOffset] = Allocate(size, [promise, size](const uint8_t* data)
+		{
+			promise->set_value(std::vector<uint8_t>(data, data + size));
+		});
+	commandList->CopyBufferRegion(destination, destinationOffset, buffer, offset, size);
+
+	return future;
+}
+
+std::future<ReadbackImage> ReadbackRing::ReadTexture(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+	ID3D12Resource* texture, UINT subresource)
+{
+	const D3D12_RESOURCE_DESC desc = texture->GetDesc();
+	assert(desc.SampleDesc.Count == 1 && "Multisampled textures have to be resolved before they are read back");
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = { };
+	UINT rowCount = 0;
+	UINT64 rowSize = 0;
+	UINT64 totalSize = 0;
+	m_device->GetCopyableFootprints(&desc, subresource, 1, 0, &footprint, &rowCount, &rowSize, &totalSize);
+	assert(footprint.Footprint.Depth == 1 && "Volume textures are not supported");
+
+	auto promise = std::make_shared<std::promise<ReadbackImage>>();
+	std::future<ReadbackImage> future = promise->get_future();
+
+	const D3D12_SUBRESOURCE_FOOTPRINT layout = footprint.Footprint;
+	const auto [destination, destinationOffset] = Allocate(totalSize, [promise, layout, rowCount, rowSize](const uint8_t* data)
+		{
+			// rows in readback memory are padded to the pitch alignment, the image keeps them tightly packed
+			ReadbackImage image = { };
+			image.width = layout.Width;
+			image.height = layout.Height;
+			image.rowPitch = static_cast<uint32_t>(rowSize);
+			image.format = layout.Format;
+			image.data.resize(rowSize * rowCount);
+			for (UINT row = 0; row < rowCount; row++)
+			{
+				std::memcpy(image.data.data() + row * rowSize, data + static_cast<uint64_t>(row) * layout.RowPitch, rowSize);
+			}
+			promise->set_value(std::move(image));
+		});
+
+	footprint.Offset = destinationOffset;
+	const CD3DX12_TEXTURE_COPY_LOCATION destinationLocation(destination, footprint);
+	const CD3DX12_TEXTURE_COPY_LOCATION sourceLocation(texture, subresource);
+	commandList->CopyTextureRegion(&destinationLocation, 0, 0, 0, &sourceLocation, nullptr);
+
+	return future;
+}
+
+void ReadbackRing::Submit(uint64_t fenceValue)
+{
+	// unsubmitted reads are always the newest ones
+	for (auto it = m_slots.rbegin(); it != m_slots.rend() && it->fenceValue == 0; ++it)
+	{
+		it->fenceValue = fenceValue;
+	}
+}
+
+void ReadbackRing::Update()
+{
+	// fence values grow along the queue, the first read that is not complete holds back the ones after it anyway
+	while (!m_slots.empty() && m_slots.front().fenceValue > 0 && m_queue->IsFenceComplete(m_slots.front().fenceValue))
+	{
+		Resolve(m_slots.front());
+		m_released += m_slots.front().ringSize;
+		m_slots.pop_front();
+	}
+}
+
+size_t ReadbackRing::GetPendingCount() const
+{
+	return m_slots.size();
+}
+
+std::pair<ID3D12Resource*, uint64_t> ReadbackRing::Allocate(uint64_t size, std::function<void(const uint8_t* data)> resolve)
+{
+	Slot slot = { };
+	slot.size = size;
+	slot.resolve = std::move(resolve);
+
+	const uint64_t alignedSize = AlignUp(size, g_readbackAlignment);
+	const uint64_t head = m_allocated % m_size;
+	// an allocation never wraps, the rest of the ring is skipped instead
+	const uint64_t padding = (head + alignedSize > m_size) ? m_size - head : 0;
+
+	if (alignedSize <= m_size && m_allocated + padding + alignedSize - m_released <= m_size)
+	{
+		slot.ringSize = padding + alignedSize;
+		slot.offset = (head + padding) % m_size;
+		m_allocated += slot.ringSize;
+	}
+	else
+	{
+		// waiting for ring space would stall the frame on reads from earlier frames
+		slot.dedicated = CreateReadbackBuffer(m_device.Get(), size);
+		slot.dedicated->SetName(L"Readback Overflow");
+		slot.ringSize = 0;
+		slot.offset = 0;
+	}
+
+	ID3D12Resource* destination = slot.dedicated ? slot.dedicated.Get() : m_buffer.Get();
+	const uint64_t offset = slot.offset;
+	m_slots.push_back(std::move(slot));
+	return { destination, offset };
+}
+
+void ReadbackRing::Resolve(Slot& slot)
+{
+	ID3D12Resource* buffer = slot.dedicated ? slot.dedicated.Get() : m_buffer.Get();
+
+	// mapping with the read range makes the gpu writes visible to the cpu caches on every architecture
+	void* data = nullptr;
+	const CD3DX12_RANGE readRange(slot.offset, slot.offset + slot.size);
+	ThrowIfFailed(buffer->Map(0, &readRange, &data));
+	slot.resolve(static_cast<const uint8_t*>(data) + slot.offset);
+	const CD3DX12_RANGE writeRange(0, 0);
+	buffer->Unmap(0, &writeRange);
+}
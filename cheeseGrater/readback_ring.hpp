@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+/// Texels of a read back texture subresource, rows tightly packed
+struct ReadbackImage
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;
+	DXGI_FORMAT format;
+	std::vector<uint8_t> data;
+};
+
+/// Copies gpu resources back to the cpu without stalling. Copies are recorded into a caller's direct command list,
+/// targeting a persistently allocated readback buffer that is sub-allocated as a ring. Every read is tracked by the
+/// fence value of the frame it was submitted with and resolves its future a few frames later, once that fence has
+/// passed; nothing on the cpu ever waits for the gpu. When the ring is full a read gets a buffer of its own instead
+/// of waiting for space.
+/// Main thread only, the returned futures may be waited on from any thread.
+class ReadbackRing
+{
+public:
+	/// @param queue The queue the command lists passed to the reads are executed on
+	/// @param size Bytes in the ring, reads that do not fit get a dedicated buffer
+	ReadbackRing(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> queue,
+		uint64_t size = 16 * 1024 * 1024);
+	/// Waits for the reads in flight and resolves them, reads that were never submitted break their promise
+	~ReadbackRing();
+
+	ReadbackRing(const ReadbackRing& other) = delete;
+	ReadbackRing& operator=(const ReadbackRing& other) = delete;
+
+	/// Record a copy of a buffer range. The buffer must be in the copy source state when the command list runs.
+	std::future<std::vector<uint8_t>> ReadBuffer(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+		ID3D12Resource* buffer, uint64_t offset, uint64_t size);
+	/// Record a copy of a texture subresource. The texture must be in the copy source state when the command list runs.
+	std::future<ReadbackImage> ReadTexture(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+		ID3D12Resource* texture, UINT subresource = 0);
+
+	/// Assign the fence value the reads recorded since the last call complete at. Called by the application after
+	/// the frame's command lists were executed.
+	void Submit(uint64_t fenceValue);
+	/// Resolve every read whose fence value has completed, called by the application at the start of every frame
+	void Update();
+
+	/// @returns Reads recorded or in flight that have not resolved yet
+	size_t GetPendingCount() const;
+
+private:
+	struct Slot
+	{
+		// bytes of the ring this slot holds, including the padding skipped to wrap around, 0 for dedicated buffers
+		uint64_t ringSize;
+		uint64_t offset;
+		uint64_t size;
+		Microsoft::WRL::ComPtr<ID3D12Resource> dedicated;
+		// 0 until submitted, the queue's fence values start at 1
+		uint64_t fenceValue;
+		// copies the read back bytes out and fulfils the promise
+		std::function<void(const uint8_t* data)> resolve;
+	};
+
+	/// Reserve readback memory for a read and queue its slot
+	/// @returns The buffer the copy writes to and the offset into it
+	std::pair<ID3D12Resource*, uint64_t> Allocate(uint64_t size, std::function<void(const uint8_t* data)> resolve);
+	void Resolve(Slot& slot);
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+	std::shared_ptr<CommandQueue> m_queue;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_buffer;
+	uint64_t m_size;
+	// running byte counts, their difference is the part of the ring in use
+	uint64_t m_allocated;
+	uint64_t m_released;
+
+	// in allocation order, so ring memory is released in the order it was handed out
+	std::deque<Slot> m_slots;
+};
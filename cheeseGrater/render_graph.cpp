@@ -0,0 +1,444 @@
+#include "render_graph.hpp"
+
+#include <application.hpp>
+#include <command_queue.hpp>
+#include <window.hpp>
+
+#include <algorithm>
+
+// the compiler plans with the bits and sizes of D3D12
+static_assert(RenderGraphStates::INDEX_BUFFER == D3D12_RESOURCE_STATE_INDEX_BUFFER);
+static_assert(RenderGraphStates::RENDER_TARGET == D3D12_RESOURCE_STATE_RENDER_TARGET);
+static_assert(RenderGraphStates::UNORDERED_ACCESS == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+static_assert(RenderGraphStates::DEPTH_WRITE == D3D12_RESOURCE_STATE_DEPTH_WRITE);
+static_assert(RenderGraphStates::DEPTH_READ == D3D12_RESOURCE_STATE_DEPTH_READ);
+static_assert(RenderGraphStates::NON_PIXEL_SHADER_RESOURCE == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+static_assert(RenderGraphStates::PIXEL_SHADER_RESOURCE == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+static_assert(RenderGraphStates::STREAM_OUT == D3D12_RESOURCE_STATE_STREAM_OUT);
+static_assert(RenderGraphStates::INDIRECT_ARGUMENT == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+static_assert(RenderGraphStates::COPY_DEST == D3D12_RESOURCE_STATE_COPY_DEST);
+static_assert(RenderGraphStates::COPY_SOURCE == D3D12_RESOURCE_STATE_COPY_SOURCE);
+static_assert(RenderGraphStates::RESOLVE_DEST == D3D12_RESOURCE_STATE_RESOLVE_DEST);
+static_assert(RenderGraphStates::RESOLVE_SOURCE == D3D12_RESOURCE_STATE_RESOLVE_SOURCE);
+static_assert(RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT == D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+namespace
+{
+// placed resources which were not used for this many frames may no longer be referenced by the gpu
+constexpr uint32_t TRANSIENT_EVICTION_FRAMES = Window::BUFFER_COUNT + 1;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool IsSameDesc(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b)
+{
+	return a.Dimension == b.Dimension
+		&& a.Alignment == b.Alignment
+		&& a.Width == b.Width
+		&& a.Height == b.Height
+		&& a.DepthOrArraySize == b.DepthOrArraySize
+		&& a.MipLevels == b.MipLevels
+		&& a.Format == b.Format
+		&& a.SampleDesc.Count == b.SampleDesc.Count
+		&& a.SampleDesc.Quality == b.SampleDesc.Quality
+		&& a.Layout == b.Layout
+		&& a.Flags == b.Flags;
+}
+}
+
+RenderGraphBuilder::RenderGraphBuilder(RenderGraph& graph, uint32_t passIndex)
+	: m_graph(graph)
+	, m_passIndex(passIndex)
+{
+}
+
+RenderGraphResource RenderGraphBuilder::Read(RenderGraphResource resource, D3D12_RESOURCE_STATES state)
+{
+	m_graph.m_compiler.AddAccess(m_passIndex, resource, state, false);
+	return resource;
+}
+
+RenderGraphResource RenderGraphBuilder::Write(RenderGraphResource resource, D3D12_RESOURCE_STATES state)
+{
+	m_graph.m_compiler.AddAccess(m_passIndex, resource, state, true);
+	return resource;
+}
+
+RenderGraphResource RenderGraphBuilder::CreateTransient(const std::wstring& name, const D3D12_RESOURCE_DESC& desc)
+{
+	return m_graph.AddTransient(name, desc);
+}
+
+void RenderGraphBuilder::SetSideEffect()
+{
+	m_graph.m_compiler.SetSideEffect(m_passIndex);
+}
+
+void RenderGraphBuilder::SetAsyncCompute()
+{
+	m_graph.m_compiler.SetAsyncCompute(m_passIndex);
+}
+
+RenderGraph::RenderGraph(Microsoft::WRL::ComPtr<ID3D12Device2> device)
+	: m_device(device)
+	, m_compiled(false)
+{
+}
+
+void RenderGraph::EnableAsyncCompute(std::shared_ptr<CommandQueue> graphicsQueue, std::shared_ptr<CommandQueue> computeQueue)
+{
+	assert(graphicsQueue && computeQueue && "Async compute needs both queues");
+	m_graphicsQueue = graphicsQueue;
+	m_computeQueue = computeQueue;
+	m_compiled = false;
+}
+
+RenderGraphResource RenderGraph::ImportResource(const std::wstring& name, Microsoft::WRL::ComPtr<ID3D12Resource> resource,
+	D3D12_RESOURCE_STATES currentState, D3D12_RESOURCE_STATES finalState)
+{
+	assert(resource && "Imported render graph resources must exist");
+
+	m_resources.push_back({ name, resource, resource->GetDesc() });
+	return m_compiler.AddImportedResource(currentState, finalState);
+}
+
+void RenderGraph::AddPass(const std::string& name, const SetupCallback& setup, const ExecuteCallback& execute)
+{
+	m_passes.push_back({ name, execute });
+
+	RenderGraphBuilder builder(*this, m_compiler.AddPass());
+	setup(builder);
+
+	m_compiled = false;
+}
+
+void RenderGraph::Compile()
+{
+	m_compiler.Compile(m_computeQueue != nullptr);
+	m_compiled = true;
+}
+
+Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> RenderGraph::Execute(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+	ResourceStateTracker& resourceStateTracker)
+{
+	assert(m_compiled && "RenderGraph::Compile must be called before RenderGraph::Execute");
+
+	RealizeTransients();
+
+	// the tracker knows the actual states, the planned states before are only used for statistics
+	auto issueBarrier = [&](const RenderGraphCompiler::PlannedBarrier& planned, ResourceStateTracker& tracker)
+		{
+			ID3D12Resource* resource = m_resources[planned.resource].resource.Get();
+			switch (planned.type)
+			{
+			case RenderGraphCompiler::BarrierType::Transition:
+				tracker.TransitionResource(resource, static_cast<D3D12_RESOURCE_STATES>(planned.after));
+				break;
+			case RenderGraphCompiler::BarrierType::Aliasing:
+				// null before-resource: any transient previously placed at this memory, including last frame's
+				tracker.AliasBarrier(nullptr, resource);
+				break;
+			case RenderGraphCompiler::BarrierType::UAV:
+				tracker.UAVBarrier(resource);
+				break;
+			}
+		};
+
+	// without async compute this is a single graphics segment, recorded into the given command list
+	const std::vector<QueueSegment>& segments = m_compiler.GetSegments();
+	std::vector<uint64_t> fenceValues(segments.size(), 0);
+	bool commandListUsed = false;
+	// the graphics work of earlier frames is submitted by now but may still run: persistent resources it reads, e.g.
+	// indirect arguments, must not be rewritten by this frame's compute work before it is done, nor have their states
+	// changed under it by the compute queue's barriers
+	const uint64_t previousGraphicsFenceValue = m_graphicsQueue ? m_graphicsQueue->GetLastFenceValue() : 0;
+	bool computeWaitedForPreviousFrames = false;
+	for (uint32_t segmentIndex = 0; segmentIndex < segments.size(); segmentIndex++)
+	{
+		const QueueSegment& segment = segments[segmentIndex];
+		const bool graphics = segment.queue == GpuQueue::Graphics;
+		const bool last = segmentIndex + 1 == segments.size();
+		CommandQueue* queue = graphics ? m_graphicsQueue.get() : m_computeQueue.get();
+		ResourceStateTracker& tracker = graphics ? resourceStateTracker : m_computeResourceStateTracker;
+
+		if (!graphics && !computeWaitedForPreviousFrames)
+		{
+			queue->Wait(*m_graphicsQueue, previousGraphicsFenceValue);
+			computeWaitedForPreviousFrames = true;
+		}
+
+		// waits go between submissions, everything waited for has been submitted by an earlier segment
+		for (uint8_t other = 0; other < GpuQueue::Count; other++)
+		{
+			if (segment.waitFor[other] != NO_QUEUE_SEGMENT)
+			{
+				CommandQueue& otherQueue = (other == GpuQueue::Graphics) ? *m_graphicsQueue : *m_computeQueue;
+				queue->Wait(otherQueue, fenceValues[segment.waitFor[other]]);
+			}
+		}
+
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> segmentCommandList;
+		if (graphics && !commandListUsed)
+		{
+			segmentCommandList = commandList;
+			commandListUsed = true;
+		}
+		else
+		{
+			segmentCommandList = queue->GetCommandList();
+		}
+
+		// the passes of a batch in this segment share one flush of their barriers
+		for (size_t first = 0; first < segment.passes.size();)
+		{
+			const uint32_t level = m_compiler.GetPass(segment.passes[first]).level;
+			size_t end = first;
+			for (; end < segment.passes.size() && m_compiler.GetPass(segment.passes[end]).level == level; end++)
+			{
+				const uint32_t passIndex = segment.passes[end];
+				for (const RenderGraphCompiler::PlannedBarrier& planned : m_compiler.GetPass(passIndex).barriers)
+				{
+					issueBarrier(planned, tracker);
+				}
+
+				// the plan assumes transients start in their first-use state; reused placed resources may not be in it yet
+				for (RenderGraphResource resource = 0; resource < m_resources.size(); resource++)
+				{
+					const RenderGraphCompiler::ResourceNode& node = m_compiler.GetResource(resource);
+					if (!node.imported && node.firstBatch != UINT32_MAX && node.firstPass == passIndex)
+					{
+						tracker.TransitionResource(m_resources[resource].resource.Get(), static_cast<D3D12_RESOURCE_STATES>(node.initialState));
+					}
+				}
+			}
+
+			tracker.FlushResourceBarriers(segmentCommandList);
+
+			for (; first < end; first++)
+			{
+				const uint32_t passIndex = segment.passes[first];
+				if (!m_passes[passIndex].execute)
+				{
+					continue;
+				}
+
+				// without async compute the graph does not know the queue it is submitted to, its passes are not measured
+				if (queue)
+				{
+					PROFILE_GPU_SCOPE(*queue, segmentCommandList.Get(), m_passes[passIndex].name);
+					m_passes[passIndex].execute(segmentCommandList);
+				}
+				else
+				{
+					m_passes[passIndex].execute(segmentCommandList);
+				}
+			}
+		}
+
+		if (last)
+		{
+			// the last segment runs on the graphics queue after all other work of the graph
+			for (const RenderGraphCompiler::PlannedBarrier& planned : m_compiler.GetFinalBarriers())
+			{
+				issueBarrier(planned, tracker);
+			}
+			tracker.FlushResourceBarriers(segmentCommandList);
+			return segmentCommandList;
+		}
+
+		fenceValues[segmentIndex] = queue->ExecuteCommandList(segmentCommandList, tracker);
+	}
+
+	return commandList;
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_compiler.Reset();
+	m_compiled = false;
+}
+
+ID3D12Resource* RenderGraph::GetResource(RenderGraphResource resource) const
+{
+	assert(resource < m_resources.size() && "Invalid render graph resource");
+	return m_resources[resource].resource.Get();
+}
+
+const std::vector<uint32_t>& RenderGraph::GetExecutionOrder() const
+{
+	return m_compiler.GetExecutionOrder();
+}
+
+const std::string& RenderGraph::GetPassName(uint32_t passIndex) const
+{
+	return m_passes[passIndex].name;
+}
+
+size_t RenderGraph::GetCulledPassCount() const
+{
+	return m_compiler.GetCulledPassCount();
+}
+
+size_t RenderGraph::GetBarrierCount() const
+{
+	return m_compiler.GetBarrierCount();
+}
+
+size_t RenderGraph::GetBarrierBatchCount() const
+{
+	return m_compiler.GetBarrierBatchCount();
+}
+
+uint64_t RenderGraph::GetTransientMemorySize() const
+{
+	return m_compiler.GetTransientMemorySize();
+}
+
+size_t RenderGraph::GetAsyncComputePassCount() const
+{
+	return m_compiler.GetAsyncComputePassCount();
+}
+
+size_t RenderGraph::GetQueueSyncCount() const
+{
+	return m_compiler.GetQueueSyncCount();
+}
+
+RenderGraphResource RenderGraph::AddTransient(const std::wstring& name, const D3D12_RESOURCE_DESC& desc)
+{
+	RenderGraphCompiler::HeapKind heapKind;
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		heapKind = RenderGraphCompiler::HEAP_KIND_BUFFERS;
+	}
+	else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+	{
+		heapKind = RenderGraphCompiler::HEAP_KIND_RT_DS_TEXTURES;
+	}
+	else
+	{
+		heapKind = RenderGraphCompiler::HEAP_KIND_OTHER_TEXTURES;
+	}
+
+	D3D12_RESOURCE_ALLOCATION_INFO allocationInfo;
+	if (m_device)
+	{
+		allocationInfo = m_device->GetResourceAllocationInfo(0, 1, &desc);
+	}
+	else
+	{
+		// without a device use an upper bound for uncompressed formats, it is only used to time the planning
+		allocationInfo.SizeInBytes = AlignUp(desc.Width * desc.Height * desc.DepthOrArraySize * 16,
+			RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT);
+		allocationInfo.Alignment = RenderGraphCompiler::DEFAULT_PLACEMENT_ALIGNMENT;
+	}
+
+	m_resources.push_back({ name, nullptr, desc });
+	return m_compiler.AddTransientResource(heapKind, allocationInfo.SizeInBytes, allocationInfo.Alignment);
+}
+
+void RenderGraph::RealizeTransients()
+{
+	for (RealizedTransient& realized : m_realizedTransients)
+	{
+		realized.usedThisFrame = false;
+	}
+
+	for (RenderGraphResource resource = 0; resource < m_resources.size(); resource++)
+	{
+		ResourceNode& node = m_resources[resource];
+		const RenderGraphCompiler::ResourceNode& plan = m_compiler.GetResource(resource);
+		if (plan.imported || plan.firstBatch == UINT32_MAX)
+		{
+			continue;
+		}
+
+		assert(m_device && "A device is required to execute a render graph with transient resources");
+
+		auto heap = GetHeap(plan.heapKind, m_compiler.GetHeapSize(plan.heapKind));
+
+		auto it = std::find_if(m_realizedTransients.begin(), m_realizedTransients.end(), [&node, &plan](const RealizedTransient& realized)
+			{
+				return !realized.usedThisFrame && realized.heapKind == plan.heapKind
+					&& realized.heapOffset == plan.heapOffset && IsSameDesc(realized.desc, node.desc);
+			});
+
+		if (it == m_realizedTransients.end())
+		{
+			RealizedTransient realized = { };
+			realized.desc = node.desc;
+			realized.heapKind = plan.heapKind;
+			realized.heapOffset = plan.heapOffset;
+			const D3D12_RESOURCE_STATES initialState = static_cast<D3D12_RESOURCE_STATES>(plan.initialState);
+			ThrowIfFailed(m_device->CreatePlacedResource(heap.Get(), plan.heapOffset, &node.desc, initialState,
+				nullptr, IID_PPV_ARGS(&realized.resource)));
+			realized.resource->SetName(node.name.c_str());
+			ResourceStateTracker::AddGlobalResourceState(realized.resource.Get(), initialState);
+
+			m_realizedTransients.push_back(realized);
+			it = m_realizedTransients.end() - 1;
+		}
+
+		it->usedThisFrame = true;
+		it->framesUnused = 0;
+		node.resource = it->resource;
+	}
+
+	for (RealizedTransient& realized : m_realizedTransients)
+	{
+		realized.framesUnused += realized.usedThisFrame ? 0 : 1;
+	}
+	for (uint8_t kind = 0; kind < RenderGraphCompiler::HEAP_KIND_COUNT; kind++)
+	{
+		ReleaseTransients(static_cast<RenderGraphCompiler::HeapKind>(kind), true);
+	}
+}
+
+void RenderGraph::ReleaseTransients(RenderGraphCompiler::HeapKind kind, bool evictedOnly)
+{
+	auto it = std::remove_if(m_realizedTransients.begin(), m_realizedTransients.end(), [=](const RealizedTransient& realized)
+		{
+			return realized.heapKind == kind && (!evictedOnly || realized.framesUnused > TRANSIENT_EVICTION_FRAMES);
+		});
+	for (auto released = it; released != m_realizedTransients.end(); ++released)
+	{
+		ResourceStateTracker::RemoveGlobalResourceState(released->resource.Get());
+	}
+	m_realizedTransients.erase(it, m_realizedTransients.end());
+}
+
+Microsoft::WRL::ComPtr<ID3D12Heap> RenderGraph::GetHeap(RenderGraphCompiler::HeapKind kind, uint64_t size)
+{
+	if (m_heaps[kind] && m_heaps[kind]->GetDesc().SizeInBytes >= size
+		&& m_heaps[kind]->GetDesc().Alignment >= m_compiler.GetHeapAlignment(kind))
+	{
+		return m_heaps[kind];
+	}
+
+	// the old heap and everything placed in it may still be in use by frames in flight
+	if (m_heaps[kind])
+	{
+		Application::Get().Flush();
+		ReleaseTransients(kind, false);
+	}
+
+	constexpr D3D12_HEAP_FLAGS heapFlags[RenderGraphCompiler::HEAP_KIND_COUNT] =
+	{
+		D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+		D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+		D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+	};
+
+	D3D12_HEAP_DESC desc = { };
+	desc.SizeInBytes = AlignUp(size, m_compiler.GetHeapAlignment(kind));
+	desc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	desc.Alignment = m_compiler.GetHeapAlignment(kind);
+	desc.Flags = heapFlags[kind];
+	ThrowIfFailed(m_device->CreateHeap(&desc, IID_PPV_ARGS(&m_heaps[kind])));
+
+	return m_heaps[kind];
+}
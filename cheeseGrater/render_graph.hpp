@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <render_graph_compiler.hpp>
+#include <resource_state_tracker.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Handle to a resource declared in a render graph. Only valid for the frame it was declared in.
+using RenderGraphResource = uint32_t;
+constexpr RenderGraphResource INVALID_RENDER_GRAPH_RESOURCE = UINT32_MAX;
+
+class CommandQueue;
+class RenderGraph;
+
+/// Used inside RenderGraph::AddPass setup callbacks to declare what the pass reads and writes
+class RenderGraphBuilder
+{
+public:
+	/// Declare a read of the resource in the given state (read states of one pass are combined)
+	RenderGraphResource Read(RenderGraphResource resource,
+		D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	/// Declare a write of the resource in the given state
+	RenderGraphResource Write(RenderGraphResource resource, D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_RENDER_TARGET);
+	/// Create a transient resource which only lives for the duration of the graph. Its memory may alias other transients.
+	RenderGraphResource CreateTransient(const std::wstring& name, const D3D12_RESOURCE_DESC& desc);
+	/// Passes with side effects (e.g. readbacks) are never culled
+	void SetSideEffect();
+	/// Run the pass on the compute queue, overlapped with graphics work it does not depend on. It stays on the
+	/// graphics queue if the graph has no compute queue, or if it uses a resource in a state only graphics queues
+	/// support or together with a graphics pass of the same dependency level.
+	void SetAsyncCompute();
+
+private:
+	friend class RenderGraph;
+	RenderGraphBuilder(RenderGraph& graph, uint32_t passIndex);
+
+	RenderGraph& m_graph;
+	uint32_t m_passIndex;
+};
+
+/// Frame graph: passes declare their resource accesses, the graph culls unused passes, orders the rest,
+/// plans resource barriers and transient memory aliasing, and then records everything into a command list.
+/// With async compute enabled, compute passes are recorded into command lists of the compute queue and the graph
+/// places the gpu waits between the fence timelines of both queues.
+/// Compile() is done by a RenderGraphCompiler, which does not know about D3D12, so it can be timed in isolation.
+class RenderGraph
+{
+public:
+	using SetupCallback = std::function<void(RenderGraphBuilder& builder)>;
+	using ExecuteCallback = std::function<void(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)>;
+
+	/// @param device Used to size and create transient resources. Can be null if the graph is only compiled.
+	explicit RenderGraph(Microsoft::WRL::ComPtr<ID3D12Device2> device);
+	~RenderGraph() = default;
+
+	RenderGraph(const RenderGraph& other) = delete;
+	RenderGraph& operator=(const RenderGraph& other) = delete;
+
+	/// Run passes marked with SetAsyncCompute on the compute queue. Resources those passes use should be imported in
+	/// the state they are actually in, compute queues can not transition out of graphics only states. The compute
+	/// work of a frame starts once the graphics work of the previous frames is done, so it may rewrite resources
+	/// those frames read; it still overlaps the graphics work of its own frame.
+	/// @param graphicsQueue Queue the command list given to Execute is submitted to
+	void EnableAsyncCompute(std::shared_ptr<CommandQueue> graphicsQueue, std::shared_ptr<CommandQueue> computeQueue);
+
+	/// Register a resource owned outside of the graph. Imported resources are graph outputs, passes writing them are never culled.
+	/// @param currentState Expected state of the resource when the graph starts executing, used for planning only;
+	/// the actual state is resolved by the resource state tracker
+	/// @param finalState State the resource is transitioned to after the last pass
+	RenderGraphResource ImportResource(const std::wstring& name, Microsoft::WRL::ComPtr<ID3D12Resource> resource,
+		D3D12_RESOURCE_STATES currentState, D3D12_RESOURCE_STATES finalState);
+
+	void AddPass(const std::string& name, const SetupCallback& setup, const ExecuteCallback& execute);
+
+	/// Cull, schedule and plan barriers, transient memory and queue synchronization for all added passes
+	void Compile();
+	/// Record all surviving passes into the command list. Compile() must be called first.
+	/// Barriers go through the tracker, which flushes them as one batch before each dependency level.
+	/// With async compute, graphics work the compute queue waits for is submitted here, compute work as well.
+	/// @returns Command list holding the rest of the graphics work, to be submitted by the caller with the tracker.
+	/// It is the given one unless part of the graphics work had to be submitted early.
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> Execute(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
+		ResourceStateTracker& resourceStateTracker);
+	/// Remove all passes and resources declared this frame. Transient heaps are kept for reuse.
+	void Reset();
+
+	/// @returns The underlying resource. Transient resources are only valid inside execute callbacks.
+	ID3D12Resource* GetResource(RenderGraphResource resource) const;
+
+	/// @returns Indices of the passes in execution order (culled passes are left out)
+	const std::vector<uint32_t>& GetExecutionOrder() const;
+	const std::string& GetPassName(uint32_t passIndex) const;
+	size_t GetCulledPassCount() const;
+	/// @returns Number of barriers planned (all barriers in one batch are issued with a single ResourceBarrier call)
+	size_t GetBarrierCount() const;
+	size_t GetBarrierBatchCount() const;
+	/// @returns Bytes needed for all transient resources after aliasing
+	uint64_t GetTransientMemorySize() const;
+	/// @returns Passes running on the compute queue this frame
+	size_t GetAsyncComputePassCount() const;
+	/// @returns Gpu waits between the queues this frame
+	size_t GetQueueSyncCount() const;
+
+private:
+	friend class RenderGraphBuilder;
+
+	// D3D12 side of a resource, its plan is the compiler's resource of the same index
+	struct ResourceNode
+	{
+		std::wstring name;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;  // null for transients until they are realized
+		D3D12_RESOURCE_DESC desc;
+	};
+
+	struct PassNode
+	{
+		std::string name;
+		ExecuteCallback execute;
+	};
+
+	/// Placed resource kept alive across frames so that transients are not recreated every frame
+	struct RealizedTransient
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		D3D12_RESOURCE_DESC desc;
+		RenderGraphCompiler::HeapKind heapKind;
+		uint64_t heapOffset;
+		uint32_t framesUnused;
+		bool usedThisFrame;
+	};
+
+	RenderGraphResource AddTransient(const std::wstring& name, const D3D12_RESOURCE_DESC& desc);
+
+	void RealizeTransients();
+	void ReleaseTransients(RenderGraphCompiler::HeapKind kind, bool evictedOnly);
+	Microsoft::WRL::ComPtr<ID3D12Heap> GetHeap(RenderGraphCompiler::HeapKind kind, uint64_t size);
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	RenderGraphCompiler m_compiler;
+
+	std::shared_ptr<CommandQueue> m_graphicsQueue;
+	std::shared_ptr<CommandQueue> m_computeQueue;
+	ResourceStateTracker m_computeResourceStateTracker;
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> m_heaps[RenderGraphCompiler::HEAP_KIND_COUNT];
+	std::vector<RealizedTransient> m_realizedTransients;
+
+	bool m_compiled;
+};
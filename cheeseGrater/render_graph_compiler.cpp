@@ -0,0 +1,679 @@
+#include "render_graph_compiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+// states in which the gpu may write to a resource; everything else can be combined into one read-only state
+constexpr RenderGraphState WRITE_STATES_MASK =
+	RenderGraphStates::RENDER_TARGET |
+	RenderGraphStates::UNORDERED_ACCESS |
+	RenderGraphStates::DEPTH_WRITE |
+	RenderGraphStates::STREAM_OUT |
+	RenderGraphStates::COPY_DEST |
+	RenderGraphStates::RESOLVE_DEST;
+
+// states a compute queue can neither use nor transition out of
+constexpr RenderGraphState GRAPHICS_ONLY_STATES_MASK =
+	RenderGraphStates::INDEX_BUFFER |
+	RenderGraphStates::RENDER_TARGET |
+	RenderGraphStates::DEPTH_WRITE |
+	RenderGraphStates::DEPTH_READ |
+	RenderGraphStates::PIXEL_SHADER_RESOURCE |
+	RenderGraphStates::STREAM_OUT |
+	RenderGraphStates::RESOLVE_DEST |
+	RenderGraphStates::RESOLVE_SOURCE;
+
+bool IsReadOnlyState(RenderGraphState state)
+{
+	return state != RenderGraphStates::COMMON && (state & WRITE_STATES_MASK) == 0;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+RenderGraphCompiler::RenderGraphCompiler()
+	: m_heapSizes{ 0 }
+	, m_heapAlignments{ 0 }
+{
+}
+
+uint32_t RenderGraphCompiler::AddImportedResource(RenderGraphState currentState, RenderGraphState finalState)
+{
+	ResourceNode node = { };
+	node.initialState = currentState;
+	node.finalState = finalState;
+	node.imported = true;
+	m_resources.push_back(node);
+
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t RenderGraphCompiler::AddTransientResource(HeapKind heapKind, uint64_t size, uint64_t alignment)
+{
+	ResourceNode node = { };
+	node.imported = false;
+	node.heapKind = heapKind;
+	node.size = size;
+	node.alignment = alignment;
+	m_resources.push_back(node);
+
+	return static_cast<uint32_t>(m_resources.size() - 1);
+}
+
+uint32_t RenderGraphCompiler::AddPass()
+{
+	m_passes.push_back({ });
+	return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraphCompiler::AddAccess(uint32_t passIndex, uint32_t resource, RenderGraphState state, bool write)
+{
+	assert(resource < m_resources.size() && "Invalid render graph resource");
+
+	PassNode& pass = m_passes[passIndex];
+	for (ResourceAccess& access : pass.accesses)
+	{
+		if (access.resource == resource)
+		{
+			if (write || access.write)
+			{
+				// a write overrides any read of the same pass; the write state has to cover the read as well
+				access.state = write ? state : access.state;
+				access.write = true;
+			}
+			else
+			{
+				access.state |= state;
+			}
+			return;
+		}
+	}
+
+	pass.accesses.push_back({ resource, state, write });
+}
+
+void RenderGraphCompiler::SetSideEffect(uint32_t passIndex)
+{
+	m_passes[passIndex].sideEffect = true;
+}
+
+void RenderGraphCompiler::SetAsyncCompute(uint32_t passIndex)
+{
+	m_passes[passIndex].asyncCompute = true;
+}
+
+void RenderGraphCompiler::Compile(bool asyncCompute)
+{
+	CullPasses();
+	BuildDependencies();
+	ScheduleBatches();
+	PlanTransientMemory();
+	PlanBarriers(asyncCompute);
+	ScheduleQueues();
+}
+
+void RenderGraphCompiler::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_batches.clear();
+	m_finalBarriers.clear();
+	m_executionOrder.clear();
+	m_segments.clear();
+}
+
+const RenderGraphCompiler::ResourceNode& RenderGraphCompiler::GetResource(uint32_t resource) const
+{
+	return m_resources[resource];
+}
+
+size_t RenderGraphCompiler::GetResourceCount() const
+{
+	return m_resources.size();
+}
+
+const RenderGraphCompiler::PassNode& RenderGraphCompiler::GetPass(uint32_t passIndex) const
+{
+	return m_passes[passIndex];
+}
+
+size_t RenderGraphCompiler::GetPassCount() const
+{
+	return m_passes.size();
+}
+
+const std::vector<uint32_t>& RenderGraphCompiler::GetExecutionOrder() const
+{
+	return m_executionOrder;
+}
+
+const std::vector<RenderGraphCompiler::Batch>& RenderGraphCompiler::GetBatches() const
+{
+	return m_batches;
+}
+
+const std::vector<RenderGraphCompiler::PlannedBarrier>& RenderGraphCompiler::GetFinalBarriers() const
+{
+	return m_finalBarriers;
+}
+
+const std::vector<QueueSegment>& RenderGraphCompiler::GetSegments() const
+{
+	return m_segments;
+}
+
+uint64_t RenderGraphCompiler::GetHeapSize(HeapKind kind) const
+{
+	return m_heapSizes[kind];
+}
+
+uint64_t RenderGraphCompiler::GetHeapAlignment(HeapKind kind) const
+{
+	return m_heapAlignments[kind];
+}
+
+size_t RenderGraphCompiler::GetCulledPassCount() const
+{
+	return m_passes.size() - m_executionOrder.size();
+}
+
+size_t RenderGraphCompiler::GetBarrierCount() const
+{
+	size_t count = m_finalBarriers.size();
+	for (const PassNode& pass : m_passes)
+	{
+		count += pass.culled ? 0 : pass.barriers.size();
+	}
+	return count;
+}
+
+size_t RenderGraphCompiler::GetBarrierBatchCount() const
+{
+	size_t count = m_finalBarriers.empty() ? 0 : 1;
+	for (const Batch& batch : m_batches)
+	{
+		bool queueHasBarriers[GpuQueue::Count] = { };
+		for (uint32_t passIndex : batch.passes)
+		{
+			queueHasBarriers[m_passes[passIndex].queue] |= !m_passes[passIndex].barriers.empty();
+		}
+		for (bool hasBarriers : queueHasBarriers)
+		{
+			count += hasBarriers ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+uint64_t RenderGraphCompiler::GetTransientMemorySize() const
+{
+	uint64_t size = 0;
+	for (uint64_t heapSize : m_heapSizes)
+	{
+		size += heapSize;
+	}
+	return size;
+}
+
+size_t RenderGraphCompiler::GetAsyncComputePassCount() const
+{
+	size_t count = 0;
+	for (uint32_t passIndex : m_executionOrder)
+	{
+		count += (m_passes[passIndex].queue == GpuQueue::Compute) ? 1 : 0;
+	}
+	return count;
+}
+
+size_t RenderGraphCompiler::GetQueueSyncCount() const
+{
+	size_t count = 0;
+	for (const QueueSegment& segment : m_segments)
+	{
+		for (uint32_t waitFor : segment.waitFor)
+		{
+			count += (waitFor != NO_QUEUE_SEGMENT) ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+void RenderGraphCompiler::CullPasses()
+{
+	// walk backwards from the graph outputs; a pass survives if something later needs what it writes
+	std::vector<bool> needed(m_resources.size(), false);
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		needed[i] = m_resources[i].imported;
+	}
+
+	for (size_t i = m_passes.size(); i-- > 0;)
+	{
+		PassNode& pass = m_passes[i];
+
+		bool passNeeded = pass.sideEffect;
+		for (const ResourceAccess& access : pass.accesses)
+		{
+			passNeeded = passNeeded || (access.write && needed[access.resource]);
+		}
+
+		pass.culled = !passNeeded;
+		if (passNeeded)
+		{
+			for (const ResourceAccess& access : pass.accesses)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraphCompiler::BuildDependencies()
+{
+	constexpr uint32_t NO_WRITER = UINT32_MAX;
+	std::vector<uint32_t> lastWriter(m_resources.size(), NO_WRITER);
+	std::vector<std::vector<uint32_t>> readersSinceWrite(m_resources.size());
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		PassNode& pass = m_passes[passIndex];
+		pass.dependencies.clear();
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		auto addDependency = [&pass](uint32_t dependency)
+			{
+				if (std::find(pass.dependencies.begin(), pass.dependencies.end(), dependency) == pass.dependencies.end())
+				{
+					pass.dependencies.push_back(dependency);
+				}
+			};
+
+		for (const ResourceAccess& access : pass.accesses)
+		{
+			if (lastWriter[access.resource] != NO_WRITER)
+			{
+				addDependency(lastWriter[access.resource]);
+			}
+
+			if (access.write)
+			{
+				for (uint32_t reader : readersSinceWrite[access.resource])
+				{
+					if (reader != passIndex)
+					{
+						addDependency(reader);
+					}
+				}
+				readersSinceWrite[access.resource].clear();
+				lastWriter[access.resource] = passIndex;
+			}
+			else
+			{
+				readersSinceWrite[access.resource].push_back(passIndex);
+			}
+		}
+	}
+}
+
+void RenderGraphCompiler::ScheduleBatches()
+{
+	// dependencies always point to earlier passes, so one forward sweep assigns every pass its dependency level
+	m_batches.clear();
+	m_executionOrder.clear();
+
+	for (PassNode& pass : m_passes)
+	{
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		pass.level = 0;
+		for (uint32_t dependency : pass.dependencies)
+		{
+			pass.level = std::max(pass.level, m_passes[dependency].level + 1);
+		}
+
+		if (pass.level >= m_batches.size())
+		{
+			m_batches.resize(pass.level + 1);
+		}
+	}
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		if (!m_passes[passIndex].culled)
+		{
+			m_batches[m_passes[passIndex].level].passes.push_back(passIndex);
+		}
+	}
+
+	for (const Batch& batch : m_batches)
+	{
+		m_executionOrder.insert(m_executionOrder.end(), batch.passes.begin(), batch.passes.end());
+	}
+}
+
+void RenderGraphCompiler::PlanTransientMemory()
+{
+	for (ResourceNode& node : m_resources)
+	{
+		node.firstBatch = UINT32_MAX;
+		node.lastBatch = 0;
+		node.aliased = false;
+	}
+
+	for (uint32_t batchIndex = 0; batchIndex < m_batches.size(); batchIndex++)
+	{
+		for (uint32_t passIndex : m_batches[batchIndex].passes)
+		{
+			for (const ResourceAccess& access : m_passes[passIndex].accesses)
+			{
+				ResourceNode& node = m_resources[access.resource];
+				node.firstBatch = std::min(node.firstBatch, batchIndex);
+				node.lastBatch = std::max(node.lastBatch, batchIndex);
+			}
+		}
+	}
+
+	for (uint8_t kind = 0; kind < HEAP_KIND_COUNT; kind++)
+	{
+		std::vector<uint32_t> transients;
+		for (uint32_t i = 0; i < m_resources.size(); i++)
+		{
+			const ResourceNode& node = m_resources[i];
+			if (!node.imported && node.heapKind == kind && node.firstBatch != UINT32_MAX)
+			{
+				transients.push_back(i);
+			}
+		}
+
+		// place the biggest resources first, each at the lowest offset not used by a resource with an overlapping lifetime
+		std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b)
+			{
+				return m_resources[a].size > m_resources[b].size;
+			});
+
+		std::vector<uint32_t> placed;
+		uint64_t heapSize = 0;
+		uint64_t heapAlignment = DEFAULT_PLACEMENT_ALIGNMENT;
+		for (uint32_t resource : transients)
+		{
+			ResourceNode& node = m_resources[resource];
+			const uint64_t size = node.size;
+			const uint64_t alignment = std::max<uint64_t>(node.alignment, 1);
+			heapAlignment = std::max(heapAlignment, alignment);
+
+			std::vector<std::pair<uint64_t, uint64_t>> busyRanges;
+			for (uint32_t other : placed)
+			{
+				const ResourceNode& otherNode = m_resources[other];
+				if (otherNode.firstBatch <= node.lastBatch && node.firstBatch <= otherNode.lastBatch)
+				{
+					busyRanges.push_back({ otherNode.heapOffset, otherNode.heapOffset + otherNode.size });
+				}
+			}
+			std::sort(busyRanges.begin(), busyRanges.end());
+
+			uint64_t offset = 0;
+			for (const auto& range : busyRanges)
+			{
+				if (AlignUp(offset, alignment) + size <= range.first)
+				{
+					break;
+				}
+				offset = std::max(offset, range.second);
+			}
+			node.heapOffset = AlignUp(offset, alignment);
+			heapSize = std::max(heapSize, node.heapOffset + size);
+
+			for (uint32_t other : placed)
+			{
+				ResourceNode& otherNode = m_resources[other];
+				if (otherNode.heapOffset < node.heapOffset + size && node.heapOffset < otherNode.heapOffset + otherNode.size)
+				{
+					node.aliased = true;
+					otherNode.aliased = true;
+				}
+			}
+			placed.push_back(resource);
+		}
+
+		m_heapSizes[kind] = heapSize;
+		m_heapAlignments[kind] = heapAlignment;
+	}
+}
+
+void RenderGraphCompiler::AssignQueues(const Batch& batch, const std::vector<RenderGraphState>& currentStates, bool asyncCompute)
+{
+	for (uint32_t passIndex : batch.passes)
+	{
+		PassNode& pass = m_passes[passIndex];
+		pass.queue = (pass.asyncCompute && asyncCompute) ? GpuQueue::Compute : GpuQueue::Graphics;
+	}
+
+	// a pass moved to the graphics queue may share resources with another compute pass, so repeat until nothing moves
+	bool moved = true;
+	while (moved)
+	{
+		moved = false;
+		for (uint32_t passIndex : batch.passes)
+		{
+			PassNode& pass = m_passes[passIndex];
+			if (pass.queue != GpuQueue::Compute)
+			{
+				continue;
+			}
+
+			bool graphicsOnly = false;
+			for (const ResourceAccess& access : pass.accesses)
+			{
+				graphicsOnly = graphicsOnly || (access.state & GRAPHICS_ONLY_STATES_MASK) != 0
+					|| (currentStates[access.resource] & GRAPHICS_ONLY_STATES_MASK) != 0;
+
+				// the queues would have to agree on the barriers of a resource they use at the same time
+				for (uint32_t otherIndex : batch.passes)
+				{
+					const PassNode& other = m_passes[otherIndex];
+					graphicsOnly = graphicsOnly || (other.queue == GpuQueue::Graphics && std::any_of(other.accesses.begin(),
+						other.accesses.end(), [&access](const ResourceAccess& o) { return o.resource == access.resource; }));
+				}
+			}
+
+			if (graphicsOnly)
+			{
+				pass.queue = GpuQueue::Graphics;
+				moved = true;
+			}
+		}
+	}
+}
+
+void RenderGraphCompiler::PlanBarriers(bool asyncCompute)
+{
+	m_finalBarriers.clear();
+
+	std::vector<RenderGraphState> currentStates(m_resources.size());
+	std::vector<bool> touched(m_resources.size(), false);
+	// passes that used a resource since its last barrier; a barrier on another queue has to wait for them
+	std::vector<std::vector<uint32_t>> accessorsSinceBarrier(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		currentStates[i] = m_resources[i].initialState;
+	}
+
+	for (uint32_t batchIndex = 0; batchIndex < m_batches.size(); batchIndex++)
+	{
+		const Batch& batch = m_batches[batchIndex];
+		for (uint32_t passIndex : batch.passes)
+		{
+			m_passes[passIndex].barriers.clear();
+			m_passes[passIndex].queueDependencies.clear();
+		}
+
+		AssignQueues(batch, currentStates, asyncCompute);
+
+		// passes of one batch never conflict, so their accesses can be merged per resource and queue
+		struct BatchAccess
+		{
+			ResourceAccess access;
+			GpuQueue::Type queue;
+			std::vector<uint32_t> passes;
+		};
+		std::vector<BatchAccess> batchAccesses;
+		for (uint32_t passIndex : batch.passes)
+		{
+			const GpuQueue::Type queue = m_passes[passIndex].queue;
+			for (const ResourceAccess& access : m_passes[passIndex].accesses)
+			{
+				auto it = std::find_if(batchAccesses.begin(), batchAccesses.end(), [&access, queue](const BatchAccess& other)
+					{
+						return other.access.resource == access.resource && other.queue == queue;
+					});
+				if (it == batchAccesses.end())
+				{
+					batchAccesses.push_back({ access, queue, { passIndex } });
+				}
+				else
+				{
+					it->access.state |= access.state;
+					it->passes.push_back(passIndex);
+				}
+			}
+		}
+
+		auto addQueueDependencies = [this](const BatchAccess& batchAccess, const std::vector<uint32_t>& accessors)
+			{
+				for (uint32_t passIndex : batchAccess.passes)
+				{
+					for (uint32_t accessor : accessors)
+					{
+						if (m_passes[accessor].queue != batchAccess.queue)
+						{
+							m_passes[passIndex].queueDependencies.push_back(accessor);
+						}
+					}
+				}
+			};
+
+		for (const BatchAccess& batchAccess : batchAccesses)
+		{
+			const ResourceAccess& access = batchAccess.access;
+			ResourceNode& node = m_resources[access.resource];
+			RenderGraphState& current = currentStates[access.resource];
+			// barriers of a resource are issued before the first pass of the batch using it on that queue
+			std::vector<PlannedBarrier>& barriers = m_passes[batchAccess.passes.front()].barriers;
+			const size_t barrierCount = barriers.size();
+
+			if (!node.imported && !touched[access.resource])
+			{
+				// transients are created in (or fixed up to) the state of their first use
+				node.initialState = access.state;
+				node.firstPass = batchAccess.passes.front();
+				current = access.state;
+				if (node.aliased)
+				{
+					barriers.push_back({ BarrierType::Aliasing, access.resource, current, current });
+
+					// the memory is reused only after the transients placed there before are done on every queue
+					for (uint32_t other = 0; other < m_resources.size(); other++)
+					{
+						const ResourceNode& otherNode = m_resources[other];
+						if (!otherNode.imported && otherNode.heapKind == node.heapKind && otherNode.firstBatch != UINT32_MAX
+							&& otherNode.lastBatch < batchIndex
+							&& otherNode.heapOffset < node.heapOffset + node.size
+							&& node.heapOffset < otherNode.heapOffset + otherNode.size)
+						{
+							addQueueDependencies(batchAccess, accessorsSinceBarrier[other]);
+						}
+					}
+				}
+			}
+			else if (current == access.state)
+			{
+				if (access.write && current == RenderGraphStates::UNORDERED_ACCESS)
+				{
+					barriers.push_back({ BarrierType::UAV, access.resource, current, current });
+				}
+			}
+			else if (!access.write && IsReadOnlyState(current) && (current & access.state) == access.state)
+			{
+				// already readable in the requested way
+			}
+			else
+			{
+				barriers.push_back({ BarrierType::Transition, access.resource, current, access.state });
+				current = access.state;
+			}
+
+			if (barriers.size() != barrierCount)
+			{
+				addQueueDependencies(batchAccess, accessorsSinceBarrier[access.resource]);
+				accessorsSinceBarrier[access.resource].clear();
+			}
+			accessorsSinceBarrier[access.resource].insert(accessorsSinceBarrier[access.resource].end(),
+				batchAccess.passes.begin(), batchAccess.passes.end());
+			touched[access.resource] = true;
+		}
+	}
+
+	// issued on the graphics queue, which waits for all other queues at the end of the graph
+	for (uint32_t i = 0; i < m_resources.size(); i++)
+	{
+		ResourceNode& node = m_resources[i];
+		if (node.imported)
+		{
+			if (currentStates[i] != node.finalState)
+			{
+				m_finalBarriers.push_back({ BarrierType::Transition, i, currentStates[i], node.finalState });
+			}
+		}
+		else
+		{
+			node.finalState = currentStates[i];
+		}
+	}
+}
+
+void RenderGraphCompiler::ScheduleQueues()
+{
+	std::vector<uint32_t> orderOfPass(m_passes.size(), UINT32_MAX);
+	for (uint32_t i = 0; i < m_executionOrder.size(); i++)
+	{
+		orderOfPass[m_executionOrder[i]] = i;
+	}
+
+	std::vector<QueueSchedulePass> schedulePasses;
+	schedulePasses.reserve(m_executionOrder.size());
+	for (uint32_t passIndex : m_executionOrder)
+	{
+		const PassNode& pass = m_passes[passIndex];
+		QueueSchedulePass schedulePass = { pass.queue, { } };
+		for (uint32_t dependency : pass.dependencies)
+		{
+			schedulePass.dependencies.push_back(orderOfPass[dependency]);
+		}
+		for (uint32_t dependency : pass.queueDependencies)
+		{
+			schedulePass.dependencies.push_back(orderOfPass[dependency]);
+		}
+		schedulePasses.push_back(std::move(schedulePass));
+	}
+
+	m_segments = ScheduleQueueSegments(schedulePasses);
+	for (QueueSegment& segment : m_segments)
+	{
+		for (uint32_t& pass : segment.passes)
+		{
+			pass = m_executionOrder[pass];
+		}
+	}
+}
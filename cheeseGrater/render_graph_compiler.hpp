@@ -0,0 +1,178 @@
+#pragma once
+
+// Compilation of a frame graph from the resource accesses its passes declared: passes whose results are never used
+// are culled, the rest are grouped into dependency levels, transient resources are placed in heap memory they share
+// with transients of disjoint lifetimes, passes are assigned to gpu queues, the barriers before every pass are
+// planned and the passes are split into queue segments. Works on sizes and state bits only, so the cost of compiling
+// a graph can be measured without a device; RenderGraph records the result.
+
+#include <queue_scheduler.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Resource states, with the bits of D3D12_RESOURCE_STATES
+using RenderGraphState = uint32_t;
+
+namespace RenderGraphStates
+{
+constexpr RenderGraphState COMMON = 0;
+constexpr RenderGraphState INDEX_BUFFER = 0x2;
+constexpr RenderGraphState RENDER_TARGET = 0x4;
+constexpr RenderGraphState UNORDERED_ACCESS = 0x8;
+constexpr RenderGraphState DEPTH_WRITE = 0x10;
+constexpr RenderGraphState DEPTH_READ = 0x20;
+constexpr RenderGraphState NON_PIXEL_SHADER_RESOURCE = 0x40;
+constexpr RenderGraphState PIXEL_SHADER_RESOURCE = 0x80;
+constexpr RenderGraphState STREAM_OUT = 0x100;
+constexpr RenderGraphState INDIRECT_ARGUMENT = 0x200;
+constexpr RenderGraphState COPY_DEST = 0x400;
+constexpr RenderGraphState COPY_SOURCE = 0x800;
+constexpr RenderGraphState RESOLVE_DEST = 0x1000;
+constexpr RenderGraphState RESOLVE_SOURCE = 0x2000;
+}
+
+class RenderGraphCompiler
+{
+public:
+	/// Alignment of placed resources, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+	static constexpr uint64_t DEFAULT_PLACEMENT_ALIGNMENT = 65536;
+
+	// transients are grouped by heap kind since resource heap tier 1 hardware cannot mix them in one heap
+	enum HeapKind : uint8_t
+	{
+		HEAP_KIND_BUFFERS = 0,
+		HEAP_KIND_RT_DS_TEXTURES,
+		HEAP_KIND_OTHER_TEXTURES,
+		HEAP_KIND_COUNT
+	};
+
+	enum class BarrierType : uint8_t
+	{
+		Transition,
+		Aliasing,
+		UAV,
+	};
+
+	struct ResourceNode
+	{
+		RenderGraphState initialState;
+		RenderGraphState finalState;
+		bool imported;
+		// transients only
+		HeapKind heapKind;
+		uint64_t size;
+		uint64_t alignment;
+
+		// filled in by Compile()
+		uint64_t heapOffset;
+		uint32_t firstBatch;
+		uint32_t lastBatch;
+		uint32_t firstPass;  // transitions a transient into its first-use state
+		bool aliased;  // shares memory with another transient and needs an aliasing barrier on first use
+	};
+
+	struct ResourceAccess
+	{
+		uint32_t resource;
+		RenderGraphState state;
+		bool write;
+	};
+
+	struct PlannedBarrier
+	{
+		BarrierType type;
+		uint32_t resource;
+		RenderGraphState before;
+		RenderGraphState after;
+	};
+
+	struct PassNode
+	{
+		std::vector<ResourceAccess> accesses;
+		bool sideEffect;
+		bool asyncCompute;
+
+		// filled in by Compile()
+		bool culled;
+		uint32_t level;
+		std::vector<uint32_t> dependencies;
+		GpuQueue::Type queue;
+		std::vector<PlannedBarrier> barriers;  // issued before the pass on its queue
+		// earlier passes on other queues that have to finish before barriers of this pass may be issued
+		std::vector<uint32_t> queueDependencies;
+	};
+
+	/// Passes in one batch have no dependencies between each other; their barriers are issued together per queue before the batch
+	struct Batch
+	{
+		std::vector<uint32_t> passes;
+	};
+
+	RenderGraphCompiler();
+
+	/// Imported resources are graph outputs, passes writing them are never culled
+	/// @param currentState Expected state of the resource when the graph starts executing
+	/// @param finalState State the resource is transitioned to after the last pass
+	uint32_t AddImportedResource(RenderGraphState currentState, RenderGraphState finalState);
+	uint32_t AddTransientResource(HeapKind heapKind, uint64_t size, uint64_t alignment);
+
+	uint32_t AddPass();
+	/// Declare an access of a pass; reads of one pass are combined, a write overrides them
+	void AddAccess(uint32_t passIndex, uint32_t resource, RenderGraphState state, bool write);
+	/// Passes with side effects (e.g. readbacks) are never culled
+	void SetSideEffect(uint32_t passIndex);
+	void SetAsyncCompute(uint32_t passIndex);
+
+	/// @param asyncCompute Run passes marked with SetAsyncCompute on the compute queue where it can
+	void Compile(bool asyncCompute);
+	/// Remove all passes and resources
+	void Reset();
+
+	const ResourceNode& GetResource(uint32_t resource) const;
+	size_t GetResourceCount() const;
+	const PassNode& GetPass(uint32_t passIndex) const;
+	size_t GetPassCount() const;
+
+	/// @returns Indices of the passes in execution order (culled passes are left out)
+	const std::vector<uint32_t>& GetExecutionOrder() const;
+	const std::vector<Batch>& GetBatches() const;
+	/// @returns Barriers issued on the graphics queue after the last pass
+	const std::vector<PlannedBarrier>& GetFinalBarriers() const;
+	/// @returns Command list segments in submission order, pass indices refer to GetPass
+	const std::vector<QueueSegment>& GetSegments() const;
+	uint64_t GetHeapSize(HeapKind kind) const;
+	uint64_t GetHeapAlignment(HeapKind kind) const;
+
+	size_t GetCulledPassCount() const;
+	/// @returns Number of barriers planned (all barriers in one batch are issued with a single ResourceBarrier call)
+	size_t GetBarrierCount() const;
+	size_t GetBarrierBatchCount() const;
+	/// @returns Bytes needed for all transient resources after aliasing
+	uint64_t GetTransientMemorySize() const;
+	/// @returns Passes running on the compute queue
+	size_t GetAsyncComputePassCount() const;
+	/// @returns Gpu waits between the queues
+	size_t GetQueueSyncCount() const;
+
+private:
+	void CullPasses();
+	void BuildDependencies();
+	void ScheduleBatches();
+	void PlanTransientMemory();
+	/// Move async compute passes the compute queue can not run back to the graphics queue
+	void AssignQueues(const Batch& batch, const std::vector<RenderGraphState>& currentStates, bool asyncCompute);
+	void PlanBarriers(bool asyncCompute);
+	void ScheduleQueues();
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	std::vector<Batch> m_batches;
+	std::vector<PlannedBarrier> m_finalBarriers;
+	std::vector<uint32_t> m_executionOrder;
+	std::vector<QueueSegment> m_segments;
+
+	uint64_t m_heapSizes[HEAP_KIND_COUNT];
+	uint64_t m_heapAlignments[HEAP_KIND_COUNT];
+};
@@ -0,0 +1,293 @@
+#include "resource_state_tracker.hpp"
+
+#include <algorithm>
+
+ResourceStateTracker::ResourceStateMap ResourceStateTracker::s_globalResourceStates;
+std::mutex ResourceStateTracker::s_globalMutex;
+
+namespace
+{
+/// @returns Mips times array slices times planes of the resource
+UINT GetSubresourceCount(ID3D12Resource* resource)
+{
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	ThrowIfFailed(resource->GetDevice(IID_PPV_ARGS(&device)));
+	return CD3DX12_RESOURCE_DESC(resource->GetDesc()).Subresources(device.Get());
+}
+}
+
+void ResourceStateTracker::ResourceState::SetSubresourceState(UINT subresource, D3D12_RESOURCE_STATES subresourceState)
+{
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		state = subresourceState;
+		stateKnown = true;
+		subresourceStates.clear();
+	}
+	else
+	{
+		subresourceStates[subresource] = subresourceState;
+	}
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::ResourceState::GetSubresourceState(UINT subresource) const
+{
+	auto it = subresourceStates.find(subresource);
+	return (it != subresourceStates.end()) ? it->second : state;
+}
+
+bool ResourceStateTracker::ResourceState::IsSubresourceStateKnown(UINT subresource) const
+{
+	return stateKnown || subresourceStates.find(subresource) != subresourceStates.end();
+}
+
+void ResourceStateTracker::TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+	if (!resource)
+	{
+		return;
+	}
+
+	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COMMON,
+		stateAfter, subresource);
+
+	auto it = m_finalResourceStates.find(resource);
+	if (it != m_finalResourceStates.end())
+	{
+		std::vector<D3D12_RESOURCE_BARRIER> resolvedBarriers;
+		// subresources this command list did not use yet are transitioned before it, like on first use
+		ResolveTransition(it->second, barrier, resolvedBarriers, &m_pendingResourceBarriers);
+		for (const D3D12_RESOURCE_BARRIER& resolved : resolvedBarriers)
+		{
+			AddTransitionBarrier(resource, resolved.Transition.StateBefore, resolved.Transition.StateAfter, resolved.Transition.Subresource);
+		}
+		it->second.SetSubresourceState(subresource, stateAfter);
+	}
+	else
+	{
+		// first use in this command list, the state before is only known once the command list is submitted
+		m_pendingResourceBarriers.push_back(barrier);
+		ResourceState& finalState = m_finalResourceStates.emplace(resource, ResourceState(D3D12_RESOURCE_STATE_COMMON, false)).first->second;
+		finalState.SetSubresourceState(subresource, stateAfter);
+	}
+}
+
+void ResourceStateTracker::UAVBarrier(ID3D12Resource* resource)
+{
+	m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void ResourceStateTracker::AliasBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter)
+{
+	m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(resourceBefore, resourceAfter));
+}
+
+void ResourceStateTracker::BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+	assert(resource && "Split transitions need a resource");
+
+	SplitTransition split = { resource, subresource, D3D12_RESOURCE_STATE_COMMON, stateAfter, false };
+
+	auto it = m_finalResourceStates.find(resource);
+	const bool uniformState = (it != m_finalResourceStates.end())
+		&& (subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES || it->second.subresourceStates.empty())
+		&& it->second.IsSubresourceStateKnown(subresource);
+	if (uniformState)
+	{
+		split.stateBefore = it->second.GetSubresourceState(subresource);
+		if (split.stateBefore == stateAfter)
+		{
+			return;
+		}
+
+		m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, split.stateBefore, stateAfter,
+			subresource, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+		split.started = true;
+	}
+
+	m_splitTransitions.push_back(split);
+}
+
+void ResourceStateTracker::EndTransition(ID3D12Resource* resource, UINT subresource)
+{
+	auto it = std::find_if(m_splitTransitions.begin(), m_splitTransitions.end(), [=](const SplitTransition& split)
+		{
+			return split.resource == resource && split.subresource == subresource;
+		});
+	if (it == m_splitTransitions.end())
+	{
+		// BeginTransition found the resource already in the requested state
+		return;
+	}
+
+	SplitTransition split = *it;
+	m_splitTransitions.erase(it);
+
+	if (split.started)
+	{
+		m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, split.stateBefore, split.stateAfter,
+			subresource, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+		m_finalResourceStates[resource].SetSubresourceState(subresource, split.stateAfter);
+	}
+	else
+	{
+		TransitionResource(resource, split.stateAfter, subresource);
+	}
+}
+
+void ResourceStateTracker::FlushResourceBarriers(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+{
+	if (!m_resourceBarriers.empty())
+	{
+		commandList->ResourceBarrier(static_cast<UINT>(m_resourceBarriers.size()), m_resourceBarriers.data());
+		m_resourceBarriers.clear();
+	}
+}
+
+bool ResourceStateTracker::HasPendingResourceBarriers() const
+{
+	return !m_pendingResourceBarriers.empty();
+}
+
+uint32_t ResourceStateTracker::FlushPendingResourceBarriers(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+{
+	// resources which were never registered are assumed to be in the common state
+	static const ResourceState commonState;
+
+	std::vector<D3D12_RESOURCE_BARRIER> resolvedBarriers;
+	for (const D3D12_RESOURCE_BARRIER& pending : m_pendingResourceBarriers)
+	{
+		auto it = s_globalResourceStates.find(pending.Transition.pResource);
+		ResolveTransition((it != s_globalResourceStates.end()) ? it->second : commonState, pending, resolvedBarriers);
+	}
+
+	if (!resolvedBarriers.empty())
+	{
+		commandList->ResourceBarrier(static_cast<UINT>(resolvedBarriers.size()), resolvedBarriers.data());
+	}
+
+	m_pendingResourceBarriers.clear();
+	return static_cast<uint32_t>(resolvedBarriers.size());
+}
+
+void ResourceStateTracker::CommitFinalResourceStates()
+{
+	for (const auto& [resource, finalState] : m_finalResourceStates)
+	{
+		ResourceState& globalState = s_globalResourceStates[resource];
+		// subresources the command list did not use keep their global state
+		if (finalState.stateKnown)
+		{
+			globalState.SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, finalState.state);
+		}
+		for (const auto& [subresource, state] : finalState.subresourceStates)
+		{
+			globalState.SetSubresourceState(subresource, state);
+		}
+	}
+
+	m_finalResourceStates.clear();
+}
+
+void ResourceStateTracker::Reset()
+{
+	assert(m_splitTransitions.empty() && "Every BeginTransition needs a matching EndTransition");
+
+	m_resourceBarriers.clear();
+	m_pendingResourceBarriers.clear();
+	m_splitTransitions.clear();
+	m_finalResourceStates.clear();
+}
+
+std::unique_lock<std::mutex> ResourceStateTracker::LockGlobalState()
+{
+	return std::unique_lock<std::mutex>(s_globalMutex);
+}
+
+void ResourceStateTracker::AddGlobalResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+	if (resource)
+	{
+		std::lock_guard<std::mutex> lock(s_globalMutex);
+		s_globalResourceStates[resource].SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, state);
+	}
+}
+
+void ResourceStateTracker::RemoveGlobalResourceState(ID3D12Resource* resource)
+{
+	if (resource)
+	{
+		std::lock_guard<std::mutex> lock(s_globalMutex);
+		s_globalResourceStates.erase(resource);
+	}
+}
+
+void ResourceStateTracker::ResolveTransition(const ResourceState& knownState, const D3D12_RESOURCE_BARRIER& barrier,
+	std::vector<D3D12_RESOURCE_BARRIER>& resolvedBarriers, std::vector<D3D12_RESOURCE_BARRIER>* unknownBarriers)
+{
+	const UINT subresource = barrier.Transition.Subresource;
+	const D3D12_RESOURCE_STATES stateAfter = barrier.Transition.StateAfter;
+
+	const auto resolve = [&](UINT resolvedSubresource)
+		{
+			D3D12_RESOURCE_BARRIER resolved = barrier;
+			resolved.Transition.Subresource = resolvedSubresource;
+			if (!knownState.IsSubresourceStateKnown(resolvedSubresource))
+			{
+				assert(unknownBarriers && "Only states of the tracked command list can be partially known");
+				unknownBarriers->push_back(resolved);
+				return;
+			}
+
+			resolved.Transition.StateBefore = knownState.GetSubresourceState(resolvedSubresource);
+			if (resolved.Transition.StateBefore != stateAfter)
+			{
+				resolvedBarriers.push_back(resolved);
+			}
+		};
+
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && !knownState.subresourceStates.empty())
+	{
+		// subresources are in different states, transition every one of them separately, not only those with a state of their own
+		const UINT subresourceCount = GetSubresourceCount(barrier.Transition.pResource);
+		for (UINT i = 0; i < subresourceCount; i++)
+		{
+			resolve(i);
+		}
+	}
+	else
+	{
+		resolve(subresource);
+	}
+}
+
+void ResourceStateTracker::AddTransitionBarrier(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateBefore,
+	D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+	// nothing can use the resource between two unflushed barriers, so A->B followed by B->C becomes A->C
+	for (auto it = m_resourceBarriers.rbegin(); it != m_resourceBarriers.rend(); ++it)
+	{
+		const bool refersToResource =
+			(it->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && it->Transition.pResource == resource) ||
+			(it->Type == D3D12_RESOURCE_BARRIER_TYPE_UAV && it->UAV.pResource == resource) ||
+			(it->Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING && (it->Aliasing.pResourceBefore == resource || it->Aliasing.pResourceAfter == resource));
+		if (!refersToResource)
+		{
+			continue;
+		}
+
+		if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && it->Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE
+			&& it->Transition.Subresource == subresource)
+		{
+			it->Transition.StateAfter = stateAfter;
+			if (it->Transition.StateBefore == stateAfter)
+			{
+				m_resourceBarriers.erase(std::next(it).base());
+			}
+			return;
+		}
+		break;
+	}
+
+	m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter, subresource));
+}
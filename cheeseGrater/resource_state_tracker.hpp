@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// Tracks resource states for a single command list. Transitions only need the state after; the state before is taken
+/// from what the command list did earlier, or resolved from the global state when the command list is submitted.
+/// Barriers are collected and issued with one ResourceBarrier call by FlushResourceBarriers, which should be called
+/// right before the next draw, dispatch or copy.
+class ResourceStateTracker
+{
+public:
+	ResourceStateTracker() = default;
+	~ResourceStateTracker() = default;
+
+	ResourceStateTracker(const ResourceStateTracker& other) = delete;
+	ResourceStateTracker& operator=(const ResourceStateTracker& other) = delete;
+
+	void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	/// @param resource Resource to wait for, or nullptr for all UAV accesses
+	void UAVBarrier(ID3D12Resource* resource = nullptr);
+	void AliasBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter);
+
+	/// Start a split transition. The resource must not be used until the matching EndTransition.
+	void BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	void EndTransition(ID3D12Resource* resource, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+	/// Issue all collected barriers with a single ResourceBarrier call
+	void FlushResourceBarriers(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+
+	bool HasPendingResourceBarriers() const;
+	/// Resolve transitions whose state before was unknown while recording against the global state and record them
+	/// into a command list that is executed right before the tracked one. Must be called while the global state is locked.
+	/// @returns Number of barriers recorded
+	uint32_t FlushPendingResourceBarriers(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+	/// Publish the states this command list leaves its resources in. Must be called while the global state is locked.
+	void CommitFinalResourceStates();
+
+	void Reset();
+
+	/// Lock the global state while command lists are being submitted
+	/// @returns The lock, which is released when it goes out of scope, also if the submission throws
+	static std::unique_lock<std::mutex> LockGlobalState();
+
+	/// Register the state a resource is created in
+	static void AddGlobalResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+	/// Forget a resource before it is released
+	static void RemoveGlobalResourceState(ID3D12Resource* resource);
+
+private:
+	struct ResourceState
+	{
+		explicit ResourceState(D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON, bool stateKnown = true)
+			: state(state)
+			, stateKnown(stateKnown)
+		{}
+
+		void SetSubresourceState(UINT subresource, D3D12_RESOURCE_STATES subresourceState);
+		D3D12_RESOURCE_STATES GetSubresourceState(UINT subresource) const;
+		bool IsSubresourceStateKnown(UINT subresource) const;
+
+		D3D12_RESOURCE_STATES state;
+		// false while a command list only used the subresources in subresourceStates, the state of the others is
+		// resolved on submit
+		bool stateKnown;
+		// only used while subresources are in different states
+		std::map<UINT, D3D12_RESOURCE_STATES> subresourceStates;
+	};
+
+	struct SplitTransition
+	{
+		ID3D12Resource* resource;
+		UINT subresource;
+		D3D12_RESOURCE_STATES stateBefore;
+		D3D12_RESOURCE_STATES stateAfter;
+		bool started;  // false if the state before was unknown and a regular transition is issued at the end instead
+	};
+
+	using ResourceStateMap = std::unordered_map<ID3D12Resource*, ResourceState>;
+
+	/// Append the barriers needed to move a resource from its known state(s) to the state after of the barrier
+	/// @param unknownBarriers Receives the transitions of subresources whose state is not known yet, their state before
+	/// is left unset. Only needed if knownState is not fully known.
+	static void ResolveTransition(const ResourceState& knownState, const D3D12_RESOURCE_BARRIER& barrier,
+		std::vector<D3D12_RESOURCE_BARRIER>& resolvedBarriers, std::vector<D3D12_RESOURCE_BARRIER>* unknownBarriers = nullptr);
+
+	void AddTransitionBarrier(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter,
+		UINT subresource);
+
+	// barriers with a known state before, issued by FlushResourceBarriers
+	std::vector<D3D12_RESOURCE_BARRIER> m_resourceBarriers;
+	// transitions of resources first used by this command list, resolved on submit
+	std::vector<D3D12_RESOURCE_BARRIER> m_pendingResourceBarriers;
+	std::vector<SplitTransition> m_splitTransitions;
+	ResourceStateMap m_finalResourceStates;
+
+	// states of all resources as of the last submitted command list
+	static ResourceStateMap s_globalResourceStates;
+	static std::mutex s_globalMutex;
+};
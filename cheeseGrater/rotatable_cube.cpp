@@ -2,9 +2,26 @@
 
 #include <application.hpp>
 #include <command_queue.hpp>
+#include <frame_capture.hpp>
+#include <mapped_file.hpp>
+#include <mesh_file.hpp>
+#include <mesh_optimizer.hpp>
+#include <meshlet_builder.hpp>
+#include <pipeline_cache.hpp>
+#include <profiler.hpp>
+#include <shader_archive.hpp>
+#include <upload_manager.hpp>
+#include <vertex_format.hpp>
 #include <window.hpp>
 
 #include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
 
 using namespace DirectX;
 
@@ -44,40 +61,304 @@ WORD g_cubeIndices[36] =
 };
 
 const float g_magicMult = 0.01f;
+
+// snorm16 positions and unorm8 colors, 12 bytes per vertex instead of the 24 of VertexInput
+using CubeVertexFormat = VertexFormat<
+    VertexAttribute<VertexSemantic::Position, VertexEncoding::Snorm16Position>,
+    VertexAttribute<VertexSemantic::Color, VertexEncoding::Unorm8Color>>;
+
+// radius of the sphere around the cube's corners
+const float g_cubeBoundingRadius = 1.7320508f;
+const uint32_t g_maxGpuDrivenInstances = 1024;
+
+const uint32_t g_maxLodCount = 4;
+// largest deviation from the original mesh, in object space units, a LOD may introduce
+const float g_maxLodError = 1.f;
+// LOD error allowed on screen, in pixels
+const float g_lodPixelThreshold = 1.f;
+
+const XMVECTORF32 g_eyePosition = { 0.f, 0.f, -10.f, 1.f };
+
+const wchar_t* g_cubeMeshPath = L"cube.cgmesh";
+// screenshots and captured sequences, relative to the working directory
+const wchar_t* g_captureDirectory = L"captures";
+
+// size of the software occlusion depth buffer
+const uint32_t g_occlusionWidth = 256;
+const uint32_t g_occlusionHeight = 128;
+const uint32_t g_maxOcclusionWorkers = 3;
+
+// reorder the triangles of every LOD for the vertex cache and overdraw, reporting the cache efficiency
+void OptimizeLodChain(LodChain& chain, const MeshPositions& positions)
+{
+    for (size_t i = 0; i < chain.lods.size(); i++)
+    {
+        const MeshLod& lod = chain.lods[i];
+        auto lodBegin = chain.indices.begin() + lod.startIndex;
+        std::vector<uint32_t> lodIndices(lodBegin, lodBegin + lod.indexCount);
+
+        const VertexCacheStatistics before = AnalyzeVertexCache(lodIndices, positions.vertexCount);
+        OptimizeVertexCache(lodIndices, positions.vertexCount);
+        OptimizeOverdraw(lodIndices, positions);
+        const VertexCacheStatistics after = AnalyzeVertexCache(lodIndices, positions.vertexCount);
+
+        std::copy(lodIndices.begin(), lodIndices.end(), lodBegin);
+
+        char buffer[256];
+        sprintf_s(buffer, "LOD %zu: %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", i, lod.indexCount / 3,
+            before.acmr, after.acmr, before.atvr, after.atvr);
+        OutputDebugStringA(buffer);
+    }
+}
+
+// the import steps, whose result is cached in the mesh file: LOD chain, triangle and vertex order, quantization and
+// meshlets
+std::vector<uint8_t> ImportCube()
+{
+    const MeshPositions cubePositions = { &g_cubeVertices[0].position.x, _countof(g_cubeVertices), sizeof(VertexInput) };
+    LodChain lodChain = BuildLodChain(cubePositions, std::vector<uint32_t>(std::begin(g_cubeIndices), std::end(g_cubeIndices)),
+        g_maxLodCount, 0.5f, g_maxLodError);
+    OptimizeLodChain(lodChain, cubePositions);
+
+    // vertices in first use order, LOD 0 comes first so it streams linearly
+    std::vector<VertexInput> vertices(std::begin(g_cubeVertices), std::end(g_cubeVertices));
+    vertices.resize(OptimizeVertexFetch(lodChain.indices, vertices.data(), vertices.size(), sizeof(VertexInput)));
+    const MeshPositions positions = { &vertices[0].position.x, vertices.size(), sizeof(VertexInput) };
+
+    MeshFileContent content;
+    content.quantization = ComputePositionQuantization(positions);
+    content.vertexStride = CubeVertexFormat::STRIDE;
+    content.vertices.resize(vertices.size() * CubeVertexFormat::STRIDE);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        content.boundsMin[axis] = FLT_MAX;
+        content.boundsMax[axis] = -FLT_MAX;
+    }
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        CubeVertexFormat::Pack(&content.vertices[i * CubeVertexFormat::STRIDE], content.quantization, vertices[i].position, vertices[i].color);
+
+        const float* position = &vertices[i].position.x;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            content.boundsMin[axis] = std::min(content.boundsMin[axis], position[axis]);
+            content.boundsMax[axis] = std::max(content.boundsMax[axis], position[axis]);
+        }
+    }
+
+    const std::vector<uint32_t> lod0Indices(lodChain.indices.begin(), lodChain.indices.begin() + lodChain.lods[0].indexCount);
+    content.meshlets = BuildMeshlets(lod0Indices, vertices.size());
+    content.meshletBounds = ComputeMeshletBounds(content.meshlets, positions);
+
+    content.indices = std::move(lodChain.indices);
+    content.lods = std::move(lodChain.lods);
+
+    return WriteMeshFile(content, true);
+}
+
+bool OpenCubeMesh(MappedFile& file, MeshFileView& mesh)
+{
+    return file.Open(g_cubeMeshPath) && mesh.Open(file.GetData(), file.GetSize())
+        && mesh.GetHeader().vertexStride == CubeVertexFormat::STRIDE;
+}
+
+// CPU access to a section: in place when it is stored uncompressed, decoded into storage otherwise
+// @returns nullptr if the section is corrupt
+const uint8_t* ReadMeshSection(const MeshFileView& mesh, MeshSection::Type section, std::vector<uint8_t>& storage)
+{
+    if (const void* data = mesh.GetSectionData(section))
+    {
+        return static_cast<const uint8_t*>(data);
+    }
+    storage.resize(mesh.GetDecodedSize(section));
+    return mesh.DecodeSection(section, storage.data()) ? storage.data() : nullptr;
+}
+
+// several windows may stream the cube at the same time, only one of them imports it
+std::mutex g_importMutex;
+
+// filled on a streaming thread, handed over to the game in the completion
+struct CubeMeshData
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
+    MeshFileHeader header;
+    std::vector<MeshLod> lods;
+    std::vector<XMFLOAT3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+};
+
+// runs on a streaming thread: maps the mesh file, importing it first if needed, and decodes vertices and indices
+// straight from the mapped pages into upload memory
+bool LoadCubeMesh(const AssetStreamer::AllocateBufferFunction& allocateBuffer, CubeMeshData& data)
+{
+    MappedFile meshFile;
+    MeshFileView mesh;
+    {
+        std::lock_guard<std::mutex> lock(g_importMutex);
+        if (!OpenCubeMesh(meshFile, mesh))
+        {
+            meshFile.Close();
+            const std::vector<uint8_t> imported = ImportCube();
+            std::ofstream(g_cubeMeshPath, std::ios::binary).write(reinterpret_cast<const char*>(imported.data()), imported.size());
+            if (!OpenCubeMesh(meshFile, mesh))
+            {
+                return false;
+            }
+        }
+    }
+    data.header = mesh.GetHeader();
+    const MeshFileHeader& header = data.header;
+
+    data.lods.resize(header.lodCount);
+    if (header.lodCount == 0 || !mesh.DecodeSection(MeshSection::Lods, data.lods.data()))
+    {
+        return false;
+    }
+
+    // LOD 0 never reaches past the real surface, so it is a safe occluder. It is unpacked from the file, so the
+    // occluder is exactly the geometry that is drawn.
+    std::vector<uint8_t> decodedVertices;
+    const uint8_t* packedVertices = ReadMeshSection(mesh, MeshSection::Vertices, decodedVertices);
+    std::vector<uint8_t> decodedIndices;
+    const uint8_t* packedIndices = ReadMeshSection(mesh, MeshSection::Indices, decodedIndices);
+    if (!packedVertices || !packedIndices)
+    {
+        return false;
+    }
+
+    data.occluderPositions.resize(header.vertexCount);
+    for (uint32_t i = 0; i < header.vertexCount; i++)
+    {
+        XMFLOAT3 color;
+        CubeVertexFormat::Unpack(packedVertices + i * CubeVertexFormat::STRIDE, header.quantization, data.occluderPositions[i], color);
+    }
+
+    const MeshLod& lod0 = data.lods[0];
+    data.occluderIndices.resize(lod0.indexCount);
+    for (uint32_t i = 0; i < lod0.indexCount; i++)
+    {
+        const uint8_t* index = packedIndices + static_cast<size_t>(lod0.startIndex + i) * header.indexSize;
+        if (header.indexSize == sizeof(uint16_t))
+        {
+            uint16_t narrow;
+            std::memcpy(&narrow, index, sizeof(narrow));
+            data.occluderIndices[i] = narrow;
+        }
+        else
+        {
+            std::memcpy(&data.occluderIndices[i], index, sizeof(uint32_t));
+        }
+    }
+
+    // cluster culling data for a mesh shader pipeline, only reported until one exists
+    {
+        char buffer[256];
+        sprintf_s(buffer, "Meshlets: %u, %llu vertex indices\n", header.meshletCount,
+            header.sections[MeshSection::MeshletVertexIndices].decodedSize / sizeof(uint32_t));
+        OutputDebugStringA(buffer);
+    }
+
+    const uint64_t vertexDataSize = mesh.GetDecodedSize(MeshSection::Vertices);
+    const uint64_t indexDataSize = mesh.GetDecodedSize(MeshSection::Indices);
+    if (!mesh.DecodeSection(MeshSection::Vertices, allocateBuffer(vertexDataSize, data.vertexBuffer))
+        || !mesh.DecodeSection(MeshSection::Indices, allocateBuffer(indexDataSize, data.indexBuffer)))
+    {
+        return false;
+    }
+
+    return true;
+}
 }
 
 
 RotatableCube::RotatableCube(const std::wstring& name, int width, int height, bool vSync)
     : Game(name, width, height, vSync)
+    , m_vertexBufferView{ }
+    , m_indexBufferView{ }
     , m_scissorRect(CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX))
     , m_viewport(CD3DX12_VIEWPORT(0.f, 0.f, static_cast<float>(width), static_cast<float>(height)))
     , m_fov(45.f)
+    , m_gpuDriven(false)
+    , m_captureScreenshot(false)
+    , m_captureSequence(false)
+    , m_captureIndex(0)
+    , m_profileIndex(0)
+    , m_meshRequest(AssetStreamer::INVALID_REQUEST)
+    , m_meshLoaded(false)
+    , m_currentLod(0)
     , m_contentLoaded(false)
-    , m_fenceValues{0}
     , m_rotationDirection({0.f})
 {
 }
 
-bool RotatableCube::LoadContent()
+bool RotatableCube::Initialize()
 {
-    auto device = Application::Get().GetDevice();
-    auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
-    auto commandList = commandQueue->GetCommandList();
-
-    Microsoft::WRL::ComPtr<ID3D12Resource> intermediateVertexBuffer;
-    UpdateBufferResource(commandList.Get(), &m_vertexBuffer, &intermediateVertexBuffer, _countof(g_cubeVertices), sizeof(VertexInput), g_cubeVertices);
+    if (!Game::Initialize())
+    {
+        return false;
+    }
 
-    m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-    m_vertexBufferView.SizeInBytes = sizeof(g_cubeVertices);
-    m_vertexBufferView.StrideInBytes = sizeof(VertexInput);
+    SubscribeWindowEvent<KeyEventArgs, &RotatableCube::OnKey>(this);
+    SubscribeWindowEvent<MouseWheelEventArgs, &RotatableCube::OnMouseWheel>(this);
+    SubscribeWindowEvent<ResizeEventArgs, &RotatableCube::OnResize>(this);
+    return true;
+}
 
-    Microsoft::WRL::ComPtr<ID3D12Resource> intermediateIndexBuffer;
-    UpdateBufferResource(commandList.Get(), &m_indexBuffer,
-        &intermediateIndexBuffer, _countof(g_cubeIndices), sizeof(WORD), g_cubeIndices);
+bool RotatableCube::LoadContent()
+{
+    auto device = Application::Get().GetDevice();
 
-    m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-    m_indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-    m_indexBufferView.SizeInBytes = sizeof(g_cubeIndices);
+    // geometry streams in through the upload batches while the first frames are already rendered
+    auto meshData = std::make_shared<CubeMeshData>();
+    const float distance = XMVectorGetX(XMVector3Length(g_eyePosition));
+    m_meshRequest = Application::Get().GetAssetStreamer()->Request(distance,
+        [meshData](const AssetStreamer::AllocateBufferFunction& allocateBuffer)
+        {
+            return LoadCubeMesh(allocateBuffer, *meshData);
+        },
+        [this, meshData](bool loaded, uint64_t fenceValue)
+        {
+            m_meshRequest = AssetStreamer::INVALID_REQUEST;
+            if (!loaded)
+            {
+                OutputDebugStringA("Loading the cube mesh failed\n");
+                return;
+            }
+
+            // draws wait for the copy on the gpu, the cpu does not block
+            Application& app = Application::Get();
+            app.GetUploadManager()->GpuWait(*app.GetCommandQueue(), fenceValue);
+
+            const MeshFileHeader& header = meshData->header;
+            m_vertexBuffer = meshData->vertexBuffer;
+            m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+            m_vertexBufferView.SizeInBytes = header.vertexCount * header.vertexStride;
+            m_vertexBufferView.StrideInBytes = header.vertexStride;
+
+            m_indexBuffer = meshData->indexBuffer;
+            m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+            m_indexBufferView.Format = (header.indexSize == sizeof(uint16_t)) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+            m_indexBufferView.SizeInBytes = header.indexCount * header.indexSize;
+
+            // all LODs share the vertex buffer and are packed into one index buffer
+            m_lods = std::move(meshData->lods);
+            m_currentLod = 0;
+
+            // quantized relative to the mesh bounds, the shaders get the dequantization through the model matrix
+            m_positionQuantization = header.quantization;
+            m_dequantizationMatrix = XMMatrixMultiply(
+                XMMatrixScaling(m_positionQuantization.scale[0], m_positionQuantization.scale[1], m_positionQuantization.scale[2]),
+                XMMatrixTranslation(m_positionQuantization.bias[0], m_positionQuantization.bias[1], m_positionQuantization.bias[2]));
+
+            m_occluderPositions = std::move(meshData->occluderPositions);
+            m_occluderIndices = std::move(meshData->occluderIndices);
+
+            m_meshLoaded = true;
+        });
+
+    const uint32_t occlusionWorkers = std::min(g_maxOcclusionWorkers, std::max(1u, std::thread::hardware_concurrency()) - 1);
+    m_occlusionCuller = std::make_unique<SoftwareOcclusionCuller>(g_occlusionWidth, g_occlusionHeight, occlusionWorkers);
 
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
     dsvHeapDesc.NumDescriptors = 1;
@@ -86,28 +367,15 @@ bool RotatableCube::LoadContent()
     ThrowIfFailed(device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
 
     // load shaders
-    Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob;
-    ThrowIfFailed(D3DReadFileToBlob(L"vertex_shader.cso", &vertexShaderBlob));
-    Microsoft::WRL::ComPtr<ID3DBlob> pixelShaderBlob;
-    ThrowIfFailed(D3DReadFileToBlob(L"pixel_shader.cso", &pixelShaderBlob));
-
-    // create vertex input layout 
-    D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,
-            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    };
+    auto shaderArchive = Application::Get().GetShaderArchive();
+    const D3D12_SHADER_BYTECODE vertexShader = shaderArchive->GetShader<VertexShader>();
+    const D3D12_SHADER_BYTECODE pixelShader = shaderArchive->GetShader("pixel_shader");
 
-    // TODO: create functions to make this function cleaner
-    // create root signature
-    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
-    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
-    if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
-    {
-        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
-    }
+    // create vertex input layout
+    static constexpr auto inputElements = CubeVertexFormat::GetInputElements();
+    const D3D12_INPUT_LAYOUT_DESC inputLayout = { inputElements.data(), static_cast<UINT>(inputElements.size()) };
 
+    // create root signature
     D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
         D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
@@ -121,13 +389,9 @@ bool RotatableCube::LoadContent()
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
     rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, rootSignatureFlags);
 
-    // serialize the root signature
-    Microsoft::WRL::ComPtr<ID3DBlob> rootSignatureBlob;
-    Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
-    ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
-
-    // create the root signature
-    ThrowIfFailed(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+    // serialized at the version the device supports, pipelines using it can be loaded from the cache
+    auto pipelineCompiler = Application::Get().GetPipelineCompiler();
+    m_rootSignature = pipelineCompiler->GetPipelineCache()->CreateRootSignature(rootSignatureDesc);
 
     // create pipeline state object
     struct PipelineStateStream
@@ -146,20 +410,26 @@ bool RotatableCube::LoadContent()
     rtvFormats.RTFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 
     pipelineStateStream.pRootSignature = m_rootSignature.Get();
-    pipelineStateStream.inputLayout = { inputLayout, _countof(inputLayout) };
+    pipelineStateStream.inputLayout = inputLayout;
     pipelineStateStream.primitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    pipelineStateStream.vs = CD3DX12_SHADER_BYTECODE(vertexShaderBlob.Get());
-    pipelineStateStream.ps = CD3DX12_SHADER_BYTECODE(pixelShaderBlob.Get());
+    pipelineStateStream.vs = vertexShader;
+    pipelineStateStream.ps = pixelShader;
     pipelineStateStream.dsvFormat = DXGI_FORMAT_D32_FLOAT;
     pipelineStateStream.rtvFormats = rtvFormats;
 
     D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
         sizeof(pipelineStateStream), &pipelineStateStream
     };
-    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_pipelineState)));
+    // compiled in the background, the cube is drawn from the first frame its pipeline is ready
+    m_pipeline = pipelineCompiler->Compile(pipelineStateStreamDesc);
 
-    uint64_t fenceValue = commandQueue->ExecuteCommandList(commandList);
-    commandQueue->WaitForFenceValue(fenceValue);
+    m_gpuDrivenRenderer = std::make_unique<GpuDrivenRenderer>(device, pipelineCompiler, *shaderArchive, g_maxGpuDrivenInstances, g_maxLodCount,
+        inputLayout, DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
+
+    m_renderGraph = std::make_unique<RenderGraph>(device);
+    // culling runs on the compute queue while the graphics queue clears
+    m_renderGraph->EnableAsyncCompute(Application::Get().GetCommandQueue(),
+        Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE));
 
     m_contentLoaded = true;
 
@@ -170,6 +440,12 @@ bool RotatableCube::LoadContent()
 
 void RotatableCube::UnloadContent()
 {
+    // the completion refers to this game
+    if (m_meshRequest != AssetStreamer::INVALID_REQUEST)
+    {
+        Application::Get().GetAssetStreamer()->Cancel(m_meshRequest);
+        m_meshRequest = AssetStreamer::INVALID_REQUEST;
+    }
 }
 
 void RotatableCube::OnUpdate(UpdateEventArgs& e)
@@ -203,15 +479,25 @@ void RotatableCube::OnUpdate(UpdateEventArgs& e)
     m_modelMatrix = XMMatrixMultiply(XMMatrixRotationX(xRot), XMMatrixRotationY(yRot));
 
     // view matrix
-    const XMVECTOR eyePosition = XMVectorSet(0, 0, -10, 1);
     const XMVECTOR focusPoint = XMVectorSet(0, 0, 0, 1);
     const XMVECTOR upDirection = XMVectorSet(0, 1, 0, 0);
-    m_viewMatrix = XMMatrixLookAtLH(eyePosition, focusPoint, upDirection);
+    m_viewMatrix = XMMatrixLookAtLH(g_eyePosition, focusPoint, upDirection);
 
     // projection
     float aspectRatio = GetClientWidth() / static_cast<float>(GetClientHeight());
     m_projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(m_fov), aspectRatio, g_nearPlane, g_farPlane);
 
+    // level of detail, measured from the closest point of the cube's bounds (the model matrix does not scale)
+    const XMVECTOR cubeCenter = m_modelMatrix.r[3];
+    const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(g_eyePosition, cubeCenter))) - g_cubeBoundingRadius;
+    m_currentLod = SelectLod(m_lods, m_currentLod, distance, XMConvertToRadians(m_fov), m_viewport.Height, g_lodPixelThreshold);
+
+    // nearer assets stream in first
+    if (m_meshRequest != AssetStreamer::INVALID_REQUEST)
+    {
+        Application::Get().GetAssetStreamer()->SetPriority(m_meshRequest, distance);
+    }
+
 }
 
 void RotatableCube::OnRender(RenderEventArgs& e)
@@ -222,55 +508,212 @@ void RotatableCube::OnRender(RenderEventArgs& e)
     auto commandList = commandQueue->GetCommandList();
 
     UINT currentBackBufferIndex = m_window->GetCurrentBackBufferIndex();
-    auto backBuffer = m_window->GetCurrentBackBuffer();
     auto rtv = m_window->GetCurrentRenderTargetView();
     auto dsv = m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
 
-    // clear render targets
+    m_renderGraph->Reset();
+    RenderGraphResource backBuffer = m_renderGraph->ImportResource(L"Back Buffer", m_window->GetCurrentBackBuffer(),
+        D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+    RenderGraphResource depthBuffer = m_renderGraph->ImportResource(L"Depth Buffer", m_depthBuffer,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+    const XMMATRIX viewProjection = XMMatrixMultiply(m_viewMatrix, m_projectionMatrix);
+
+    // software occlusion culling before any draw is recorded. The cube is the only occluder and the only occludee
+    // here, which is safe: an object can never hide its own bounds.
+    bool cubeVisible = false;
+    if (m_meshLoaded)
     {
-        TransitionResource(commandList, backBuffer,
-            D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        ClearRTV(commandList, rtv, g_clearColor);
-        ClearDepth(commandList, dsv);
+        XMFLOAT4X4 viewProjectionData;
+        XMFLOAT4X4 modelData;
+        XMStoreFloat4x4(&viewProjectionData, viewProjection);
+        XMStoreFloat4x4(&modelData, m_modelMatrix);
+        m_occlusionCuller->BeginFrame(&viewProjectionData.m[0][0]);
+        m_occlusionCuller->AddOccluder({ &m_occluderPositions[0].x, m_occluderPositions.size(), sizeof(XMFLOAT3) },
+            m_occluderIndices.data(), m_occluderIndices.size(), &modelData.m[0][0]);
+        m_occlusionCuller->Rasterize();
+
+        float boundsMin[3];
+        float boundsMax[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            boundsMin[axis] = m_positionQuantization.bias[axis] - m_positionQuantization.scale[axis];
+            boundsMax[axis] = m_positionQuantization.bias[axis] + m_positionQuantization.scale[axis];
+        }
+        cubeVisible = m_occlusionCuller->IsBoxVisible(boundsMin, boundsMax, &modelData.m[0][0]);
     }
+    // until the mesh has streamed in only the clear runs, until the gpu-driven pipelines are compiled the cube is drawn directly
+    const bool gpuDriven = m_gpuDriven && m_meshLoaded && m_gpuDrivenRenderer->IsReady();
+    ID3D12PipelineState* pipelineState = m_pipeline.Get();
+
+    RenderGraphResource instanceBuffer = INVALID_RENDER_GRAPH_RESOURCE;
+    RenderGraphResource meshDrawBuffer = INVALID_RENDER_GRAPH_RESOURCE;
+    RenderGraphResource argumentBuffer = INVALID_RENDER_GRAPH_RESOURCE;
+    if (gpuDriven)
+    {
+        // bounds in the quantized space the vertices are stored in
+        SceneInstance cube = { };
+        XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(cube.world), XMMatrixMultiply(m_dequantizationMatrix, m_modelMatrix));
+        float maxScale = 0.f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            cube.localBoundsCenter[axis] = -m_positionQuantization.bias[axis] / m_positionQuantization.scale[axis];
+            maxScale = std::max(maxScale, m_positionQuantization.scale[axis]);
+        }
+        cube.localBoundsRadius = g_cubeBoundingRadius / maxScale;
+        cube.meshIndex = m_currentLod;
 
-    // set pipeline state and root signature
-    commandList->SetPipelineState(m_pipelineState.Get());
-    commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-
-    // set up the input assembler
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-    commandList->IASetIndexBuffer(&m_indexBufferView);
+        // one mesh draw per LOD, instances select theirs through meshIndex
+        std::vector<GpuMeshDraw> meshDraws;
+        for (const MeshLod& lod : m_lods)
+        {
+            meshDraws.push_back({ lod.indexCount, lod.startIndex, 0, 0 });
+        }
+        m_gpuDrivenRenderer->SetScene(cubeVisible ? std::vector<SceneInstance>{ cube } : std::vector<SceneInstance>{ }, meshDraws);
+
+        instanceBuffer = m_renderGraph->ImportResource(L"Instances", m_gpuDrivenRenderer->GetInstanceBuffer(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        meshDrawBuffer = m_renderGraph->ImportResource(L"Mesh Draws", m_gpuDrivenRenderer->GetMeshDrawBuffer(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        argumentBuffer = m_renderGraph->ImportResource(L"Indirect Arguments", m_gpuDrivenRenderer->GetArgumentBuffer(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+
+        m_renderGraph->AddPass("Upload Instances",
+            [&](RenderGraphBuilder& builder)
+            {
+                builder.SetAsyncCompute();
+                builder.Write(instanceBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+                builder.Write(meshDrawBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+            },
+            [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+            {
+                m_gpuDrivenRenderer->RecordUpload(commandList, currentBackBufferIndex);
+            });
+
+        m_renderGraph->AddPass("GPU Culling",
+            [&](RenderGraphBuilder& builder)
+            {
+                builder.SetAsyncCompute();
+                builder.Read(instanceBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+                builder.Read(meshDrawBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+                builder.Write(argumentBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+            },
+            [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+            {
+                m_gpuDrivenRenderer->RecordCulling(commandList, viewProjection);
+            });
+    }
 
-    // set up the rasterizer state
-    commandList->RSSetViewports(1, &m_viewport);
-    commandList->RSSetScissorRects(1, &m_scissorRect);
+    // a pass of its own, so the clears do not wait for the culling on the compute queue
+    m_renderGraph->AddPass("Clear",
+        [&](RenderGraphBuilder& builder)
+        {
+            builder.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+            builder.Write(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+        },
+        [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+        {
+            // clear render targets
+            ClearRTV(commandList, rtv, g_clearColor);
+            ClearDepth(commandList, dsv);
+        });
 
-    // bind the render targets
-    commandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+    m_renderGraph->AddPass("Cube",
+        [&](RenderGraphBuilder& builder)
+        {
+            builder.Write(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+            builder.Write(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+            if (gpuDriven)
+            {
+                builder.Read(argumentBuffer, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+                builder.Read(instanceBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            }
+        },
+        [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+        {
+            // set up the input assembler
+            commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+            commandList->IASetIndexBuffer(&m_indexBufferView);
+
+            // set up the rasterizer state
+            commandList->RSSetViewports(1, &m_viewport);
+            commandList->RSSetScissorRects(1, &m_scissorRect);
+
+            // bind the render targets
+            commandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+
+            if (gpuDriven)
+            {
+                // draws whatever survived the culling pass
+                m_gpuDrivenRenderer->RecordDraw(commandList, viewProjection);
+                return;
+            }
+
+            if (!cubeVisible || !pipelineState)
+            {
+                return;
+            }
+
+            // set pipeline state and root signature
+            commandList->SetPipelineState(pipelineState);
+            commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+            commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+            // update mvp
+            XMMATRIX mvp = XMMatrixMultiply(XMMatrixMultiply(m_dequantizationMatrix, m_modelMatrix), viewProjection);
+            commandList->SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &mvp, 0);
+
+            // draw
+            const MeshLod& lod = m_lods[m_currentLod];
+            commandList->DrawIndexedInstanced(lod.indexCount, 1, lod.startIndex, 0, 0);
+        });
+
+    if (m_captureScreenshot || m_captureSequence)
+    {
+        // the copy is recorded after the cube, the image arrives a few frames later and is written on a worker thread
+        m_renderGraph->AddPass("Capture",
+            [&](RenderGraphBuilder& builder)
+            {
+                builder.Read(backBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+                builder.SetSideEffect();
+            },
+            [&](Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+            {
+                Application& app = Application::Get();
+                // sequences favour the faster encoder, single screenshots the format every viewer opens
+                const ImageFormat::Type format = m_captureSequence ? ImageFormat::Qoi : ImageFormat::Png;
+                wchar_t path[MAX_PATH];
+                swprintf_s(path, L"%s/%s_%05u%hs", g_captureDirectory, m_captureSequence ? L"frame" : L"screenshot",
+                    m_captureIndex++, GetImageExtension(format));
+
+                app.GetFrameCapture()->Capture(
+                    app.GetReadbackRing()->ReadTexture(commandList, m_window->GetCurrentBackBuffer().Get()), path, format);
+            });
+        m_captureScreenshot = false;
+    }
 
-    // update mvp
-    XMMATRIX mvp = XMMatrixMultiply(m_modelMatrix, m_viewMatrix);
-    mvp = XMMatrixMultiply(mvp, m_projectionMatrix);
-    commandList->SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &mvp, 0);
+    // barriers around the pass and waits between the queues are generated by the graph
+    m_renderGraph->Compile();
+    commandList = m_renderGraph->Execute(commandList, m_resourceStateTracker);
 
-    // draw
-    commandList->DrawIndexedInstanced(_countof(g_cubeIndices), 1, 0, 0, 0);
+    // submitted together with the other windows' frames and presented by the application
+    commandQueue->QueueCommandList(commandList, m_resourceStateTracker);
+}
 
-    // present
+void RotatableCube::OnKey(KeyEventArgs& e)
+{
+    if (e.State == KeyEventArgs::Pressed)
+    {
+        OnKeyPressed(e);
+    }
+    else
     {
-        TransitionResource(commandList, backBuffer,
-            D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-        m_fenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandList(commandList);
-        currentBackBufferIndex = m_window->Present();
-        commandQueue->WaitForFenceValue(m_fenceValues[currentBackBufferIndex]);
+        OnKeyReleased(e);
     }
 }
 
 void RotatableCube::OnKeyPressed(KeyEventArgs& e)
 {
-    Game::OnKeyPressed(e);
     switch (e.Key)
     {
     case KeyCode::Escape:
@@ -286,6 +729,36 @@ void RotatableCube::OnKeyPressed(KeyEventArgs& e)
     case KeyCode::V:
         m_window->ToggleVSync();
         break;
+    case KeyCode::G:
+        m_gpuDriven = !m_gpuDriven;
+        break;
+    case KeyCode::F12:
+        m_captureScreenshot = true;
+        std::filesystem::create_directories(g_captureDirectory);
+        break;
+    case KeyCode::C:
+        m_captureSequence = !m_captureSequence;
+        std::filesystem::create_directories(g_captureDirectory);
+        ::OutputDebugStringA(m_captureSequence ? "Capturing every frame\n" : "Frame capture stopped\n");
+        break;
+    case KeyCode::P:
+    {
+        // the zones of every thread in between two presses are written as a Chrome trace
+        const bool profiling = !Profiler::IsEnabled();
+        Profiler::SetEnabled(profiling);
+        if (profiling)
+        {
+            ::OutputDebugStringA("Profiling\n");
+        }
+        else
+        {
+            std::filesystem::create_directories(g_captureDirectory);
+            wchar_t path[MAX_PATH];
+            swprintf_s(path, L"%s/profile_%05u.json", g_captureDirectory, m_profileIndex++);
+            ::OutputDebugStringA(Profiler::WriteChromeTrace(path) ? "Profile written\n" : "Failed to write the profile\n");
+        }
+    }
+    break;
     case KeyCode::W:
     case KeyCode::S:
     case KeyCode::A:
@@ -299,7 +772,6 @@ void RotatableCube::OnKeyPressed(KeyEventArgs& e)
 
 void RotatableCube::OnKeyReleased(KeyEventArgs& e)
 {
-    Game::OnKeyReleased(e);
     switch (e.Key)
     {
     case KeyCode::W:
@@ -324,25 +796,15 @@ void RotatableCube::OnMouseWheel(MouseWheelEventArgs& e)
 
 void RotatableCube::OnResize(ResizeEventArgs& e)
 {
-    if (e.Width != GetClientWidth() || e.Height != GetClientHeight())
+    // the game's client size is already updated, the viewport still has the previous one
+    if (e.Width != static_cast<int>(m_viewport.Width) || e.Height != static_cast<int>(m_viewport.Height))
     {
-        Game::OnResize(e);
         m_viewport = CD3DX12_VIEWPORT(0.f, 0.f, static_cast<float>(e.Width),
             static_cast<float>(e.Height), 0.0f, 1.0f);
         ResizeDepthBuffer(e.Width, e.Height);
     }
 }
 
-void RotatableCube::TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-    Microsoft::WRL::ComPtr<ID3D12Resource> resource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState)
-{
-    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        resource.Get(),
-        beforeState, afterState);
-
-    commandList->ResourceBarrier(1, &barrier);
-}
-
 void RotatableCube::ClearRTV(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, D3D12_CPU_DESCRIPTOR_HANDLE rtv,
     FLOAT* clearColor)
 {
@@ -355,47 +817,6 @@ void RotatableCube::ClearDepth(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2
     commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
 }
 
-void RotatableCube::UpdateBufferResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ID3D12Resource** pDestinationResource,
-                                         ID3D12Resource** pIntermediateResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags)
-{
-    auto device = Application::Get().GetDevice();
-    size_t bufferSize = numElements * elementSize;
-
-    auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
-    
-    ThrowIfFailed(device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(pDestinationResource)));
-
-    if (bufferData)
-    {
-        auto heapProperties1 = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        auto resourceDesc1 = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-        
-        ThrowIfFailed(device->CreateCommittedResource(
-            &heapProperties1,
-            D3D12_HEAP_FLAG_NONE,
-            &resourceDesc1,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(pIntermediateResource)
-            ));
-
-        D3D12_SUBRESOURCE_DATA subresourceData = {};
-        subresourceData.pData = bufferData;
-        subresourceData.RowPitch = bufferSize;
-        subresourceData.SlicePitch = subresourceData.RowPitch;
-
-        UpdateSubresources(commandList.Get(), *pDestinationResource, *pIntermediateResource,
-            0, 0, 1, &subresourceData);
-    }
-}
-
 void RotatableCube::ResizeDepthBuffer(int width, int height)
 {
     // TODO: this can also be split into 2 functions - create ds, and update dsv
@@ -421,6 +842,7 @@ void RotatableCube::ResizeDepthBuffer(int width, int height)
     auto resourceDescTex = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, width, height, 1,
         0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
     
+    ResourceStateTracker::RemoveGlobalResourceState(m_depthBuffer.Get());
     ThrowIfFailed(device->CreateCommittedResource(
         &heapProperties,
         D3D12_HEAP_FLAG_NONE,
@@ -429,6 +851,7 @@ void RotatableCube::ResizeDepthBuffer(int width, int height)
         &optimizedClearValue,
         IID_PPV_ARGS(&m_depthBuffer)
         ));
+    ResourceStateTracker::AddGlobalResourceState(m_depthBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
 
     // update depth-stencil view
     D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
@@ -2,8 +2,17 @@
 
 #include <cheese_grater_common.hpp>
 
+#include <asset_streamer.hpp>
 #include <game.hpp>
+#include <gpu_driven_renderer.hpp>
 #include <map>
+#include <memory>
+#include <mesh_lod.hpp>
+#include <pipeline_compiler.hpp>
+#include <render_graph.hpp>
+#include <resource_state_tracker.hpp>
+#include <software_occlusion.hpp>
+#include <vertex_quantization.hpp>
 #include <window.hpp>
 
 class RotatableCube : public Game
@@ -11,31 +20,28 @@ class RotatableCube : public Game
 public:
 	RotatableCube(const std::wstring& name, int width, int height, bool vSync = true);
 
+	/// Initialize the game and subscribe the input and resize handlers to the window's events
+	virtual bool Initialize() override;
 	virtual bool LoadContent() override;
 	virtual void UnloadContent() override;
 
 protected:
 	virtual void OnUpdate(UpdateEventArgs& e) override;
 	virtual void OnRender(RenderEventArgs& e) override;
-	virtual void OnKeyPressed(KeyEventArgs& e) override;
-	virtual void OnKeyReleased(KeyEventArgs& e) override;
-	virtual void OnMouseWheel(MouseWheelEventArgs& e) override;
-	virtual void OnResize(ResizeEventArgs& e) override;
 
 private:
-	void TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, Microsoft::WRL::ComPtr<ID3D12Resource> resource,
-		D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState);
+	void OnKey(KeyEventArgs& e);
+	void OnKeyPressed(KeyEventArgs& e);
+	void OnKeyReleased(KeyEventArgs& e);
+	void OnMouseWheel(MouseWheelEventArgs& e);
+	void OnResize(ResizeEventArgs& e);
+
 	void ClearRTV(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, D3D12_CPU_DESCRIPTOR_HANDLE rtv, FLOAT* clearColor);
 	void ClearDepth(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth = 1.0f);
-	void UpdateBufferResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ID3D12Resource** pDestinationResource,
-		ID3D12Resource** pIntermediateResource, size_t numElements, size_t elementSize, const void* bufferData,
-		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 	void ResizeDepthBuffer(int width, int height);
 
 	void UpdateRotation(KeyCode::Key key, bool released = false);
 	
-	uint64_t m_fenceValues[Window::BUFFER_COUNT];
-
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
 
@@ -46,13 +52,39 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState;
+	PipelineHandle m_pipeline;
+
+	std::unique_ptr<RenderGraph> m_renderGraph;
+	ResourceStateTracker m_resourceStateTracker;
 
 	D3D12_VIEWPORT m_viewport;
 	D3D12_RECT m_scissorRect;
 
 	float m_fov;
 
+	std::unique_ptr<GpuDrivenRenderer> m_gpuDrivenRenderer;
+	bool m_gpuDriven;  // toggled with G
+
+	// frames are read back and written by the application's frame capture
+	bool m_captureScreenshot;  // requested with F12
+	bool m_captureSequence;  // toggled with C, every frame is written
+	uint32_t m_captureIndex;
+	uint32_t m_profileIndex;  // numbers the profiles written with P
+
+	// the mesh streams in after LoadContent, nothing is drawn until it has
+	AssetStreamer::RequestId m_meshRequest;
+	bool m_meshLoaded;
+
+	std::vector<MeshLod> m_lods;
+	uint32_t m_currentLod;
+
+	std::unique_ptr<SoftwareOcclusionCuller> m_occlusionCuller;
+	std::vector<DirectX::XMFLOAT3> m_occluderPositions;
+	std::vector<uint32_t> m_occluderIndices;
+
+	PositionQuantization m_positionQuantization;
+	DirectX::XMMATRIX m_dequantizationMatrix;  // applied before the model matrix
+
 	DirectX::XMMATRIX m_modelMatrix;
 	DirectX::XMMATRIX m_viewMatrix;
 	DirectX::XMMATRIX m_projectionMatrix;
@@ -0,0 +1,53 @@
+#include "shader_archive.hpp"
+
+ShaderArchive::ShaderArchive(const std::wstring& path)
+{
+	if (!m_mappedFile.Open(path) || !m_file.Load(m_mappedFile.GetData(), m_mappedFile.GetSize()))
+	{
+		::OutputDebugStringA("Shader archive is missing or was written by another version of the shader compiler\n");
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_INVALID));
+	}
+
+	// looking permutations up by name would build and hash a string per lookup
+	m_permutations.resize(ShaderPermutations::COUNT);
+	for (size_t i = 0; i < ShaderPermutations::COUNT; i++)
+	{
+		const ShaderPermutationDesc& shader = ShaderPermutations::DESCS[i];
+		m_permutations[i].resize(size_t(1) << shader.featureCount);
+		for (ShaderFeatures features = 0; features < m_permutations[i].size(); features++)
+		{
+			ShaderArchiveFile::Blob blob = { };
+			if (m_file.Find(GetPermutationName(shader, features), blob))
+			{
+				m_permutations[i][features] = { blob.data, blob.size };
+			}
+		}
+	}
+}
+
+D3D12_SHADER_BYTECODE ShaderArchive::GetShader(const std::string& name) const
+{
+	ShaderArchiveFile::Blob blob = { };
+	if (!m_file.Find(name, blob))
+	{
+		char buffer[256];
+		sprintf_s(buffer, "Shader %s is not in the shader archive\n", name.c_str());
+		::OutputDebugStringA(buffer);
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_FOUND));
+	}
+	return { blob.data, blob.size };
+}
+
+D3D12_SHADER_BYTECODE ShaderArchive::GetPermutation(size_t shader, ShaderFeatures features) const
+{
+	const D3D12_SHADER_BYTECODE& bytecode = m_permutations[shader][features];
+	if (bytecode.BytecodeLength == 0)
+	{
+		char buffer[256];
+		sprintf_s(buffer, "Shader permutation %s is not in the shader manifest\n",
+			GetPermutationName(ShaderPermutations::DESCS[shader], features).c_str());
+		::OutputDebugStringA(buffer);
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_FOUND));
+	}
+	return bytecode;
+}
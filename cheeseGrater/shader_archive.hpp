@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <mapped_file.hpp>
+#include <shader_archive_file.hpp>
+#include <shader_permutation.hpp>
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+/// Compiled shaders of the engine, memory mapped from the archive the offline shader compiler writes at build time.
+/// Bytecode is handed to pipeline creation straight from the mapping, nothing is read or copied per shader.
+/// Immutable after construction, may be used from any thread.
+class ShaderArchive
+{
+public:
+	/// Throws if the archive is missing or invalid, shaders have to be built before the engine runs
+	explicit ShaderArchive(const std::wstring& path);
+
+	ShaderArchive(const ShaderArchive& other) = delete;
+	ShaderArchive& operator=(const ShaderArchive& other) = delete;
+
+	/// @param name Name of the shader in the shader manifest
+	/// @returns Bytecode that stays valid as long as the archive, throws if the archive has no such shader
+	D3D12_SHADER_BYTECODE GetShader(const std::string& name) const;
+	/// Permutation of a shader with features chosen at compile time
+	/// @returns Bytecode that stays valid as long as the archive, throws if the manifest does not list the permutation
+	template <typename Shader, ShaderFeatures Features = 0>
+	D3D12_SHADER_BYTECODE GetShader() const
+	{
+		static_assert(ShaderPermutations::IndexOf<Shader>() < ShaderPermutations::COUNT, "Shader is not in ShaderPermutations");
+		static_assert(ShaderPermutations::IsValid<Shader>(Features), "Feature of another shader");
+		return GetPermutation(ShaderPermutations::IndexOf<Shader>(), Features);
+	}
+	/// Permutation of a shader with features chosen at runtime, a table lookup
+	template <typename Shader>
+	D3D12_SHADER_BYTECODE GetShader(ShaderFeatures features) const
+	{
+		static_assert(ShaderPermutations::IndexOf<Shader>() < ShaderPermutations::COUNT, "Shader is not in ShaderPermutations");
+		assert(ShaderPermutations::IsValid<Shader>(features) && "Feature of another shader");
+		return GetPermutation(ShaderPermutations::IndexOf<Shader>(), features);
+	}
+
+private:
+	D3D12_SHADER_BYTECODE GetPermutation(size_t shader, ShaderFeatures features) const;
+
+	MappedFile m_mappedFile;
+	ShaderArchiveFile m_file;
+	// bytecode of every permutation by shader in ShaderPermutations and feature bits, empty if it was not compiled
+	std::vector<std::vector<D3D12_SHADER_BYTECODE>> m_permutations;
+};
@@ -0,0 +1,107 @@
+#include "shader_archive_file.hpp"
+
+#include <hash.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+bool ShaderArchiveFile::Load(const uint8_t* data, size_t size)
+{
+	m_shaders.clear();
+	m_added.clear();
+
+	Header header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION
+		|| header.shaderCount > (size - sizeof(header)) / sizeof(Entry)
+		|| header.checksum != HashBytes(data + sizeof(header), size - sizeof(header)))
+	{
+		return false;
+	}
+
+	const uint8_t* entries = data + sizeof(header);
+	m_shaders.reserve(header.shaderCount);
+	for (uint64_t i = 0; i < header.shaderCount; i++)
+	{
+		Entry entry;
+		std::memcpy(&entry, entries + i * sizeof(Entry), sizeof(entry));
+		if (entry.offset > size || entry.size > size - entry.offset
+			|| (!m_shaders.empty() && m_shaders.back().nameHash >= entry.nameHash))
+		{
+			m_shaders.clear();
+			return false;
+		}
+		m_shaders.push_back({ entry.nameHash, { data + entry.offset, static_cast<size_t>(entry.size) } });
+	}
+	return true;
+}
+
+bool ShaderArchiveFile::Find(const std::string& name, Blob& blob) const
+{
+	const uint64_t nameHash = HashName(name);
+	auto it = std::lower_bound(m_shaders.begin(), m_shaders.end(), nameHash,
+		[](const Shader& shader, uint64_t hash) { return shader.nameHash < hash; });
+	if (it == m_shaders.end() || it->nameHash != nameHash)
+	{
+		return false;
+	}
+	blob = it->blob;
+	return true;
+}
+
+bool ShaderArchiveFile::Add(const std::string& name, std::vector<uint8_t> bytecode)
+{
+	const uint64_t nameHash = HashName(name);
+	auto it = std::lower_bound(m_shaders.begin(), m_shaders.end(), nameHash,
+		[](const Shader& shader, uint64_t hash) { return shader.nameHash < hash; });
+	if (it != m_shaders.end() && it->nameHash == nameHash)
+	{
+		return false;
+	}
+
+	// moving the vector keeps its buffer, so blobs stay valid while m_added grows
+	m_added.push_back(std::move(bytecode));
+	m_shaders.insert(it, { nameHash, { m_added.back().data(), m_added.back().size() } });
+	return true;
+}
+
+size_t ShaderArchiveFile::GetShaderCount() const
+{
+	return m_shaders.size();
+}
+
+std::vector<uint8_t> ShaderArchiveFile::Serialize() const
+{
+	uint64_t offset = AlignUp(sizeof(Header) + m_shaders.size() * sizeof(Entry), BLOB_ALIGNMENT);
+	std::vector<uint8_t> file(offset);
+	for (size_t i = 0; i < m_shaders.size(); i++)
+	{
+		const Shader& shader = m_shaders[i];
+		const Entry entry = { shader.nameHash, offset, shader.blob.size };
+		std::memcpy(file.data() + sizeof(Header) + i * sizeof(Entry), &entry, sizeof(entry));
+		file.insert(file.end(), shader.blob.data, shader.blob.data + shader.blob.size);
+		offset = AlignUp(offset + shader.blob.size, BLOB_ALIGNMENT);
+		file.resize(offset);
+	}
+
+	const Header header = { MAGIC, VERSION, m_shaders.size(), HashBytes(file.data() + sizeof(Header), file.size() - sizeof(Header)) };
+	std::memcpy(file.data(), &header, sizeof(header));
+	return file;
+}
+
+uint64_t ShaderArchiveFile::HashName(const std::string& name)
+{
+	return Hasher().AddString(name.c_str()).Get();
+}
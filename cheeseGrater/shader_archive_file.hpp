@@ -0,0 +1,71 @@
+#pragma once
+
+// Packed shader bytecode by name, written by the offline shader compiler and memory mapped by the engine. Blobs are
+// stored back to back at an alignment the runtime can hand straight to the driver, behind a sorted table of name
+// hashes. The file is versioned and checksummed, so an archive from an older compiler is rejected instead of loaded.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ShaderArchiveFile
+{
+public:
+	static constexpr uint32_t MAGIC = 0x41534743;  // "CGSA"
+	static constexpr uint32_t VERSION = 1;
+	// of every blob from the start of the file
+	static constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+	struct Blob
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+
+	/// Replace the contents with the shaders of a serialized archive. Blobs point into data, which has to outlive them.
+	/// @returns False and leaves the archive empty if data is not a valid archive of this version
+	bool Load(const uint8_t* data, size_t size);
+
+	/// @returns False if there is no shader of that name
+	bool Find(const std::string& name, Blob& blob) const;
+	/// Add a shader, the archive keeps its own copy
+	/// @returns False if a shader of that name, or one whose name hashes the same, is in the archive already
+	bool Add(const std::string& name, std::vector<uint8_t> bytecode);
+
+	size_t GetShaderCount() const;
+
+	/// @returns The file contents
+	std::vector<uint8_t> Serialize() const;
+
+	static uint64_t HashName(const std::string& name);
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t shaderCount;
+		// of everything after the header
+		uint64_t checksum;
+	};
+
+	struct Entry
+	{
+		uint64_t nameHash;
+		// from the start of the file
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct Shader
+	{
+		uint64_t nameHash;
+		Blob blob;
+	};
+
+	// sorted by name hash
+	std::vector<Shader> m_shaders;
+	// bytecode added since Load, the shaders point into it
+	std::vector<std::vector<uint8_t>> m_added;
+};
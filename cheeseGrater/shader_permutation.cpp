@@ -0,0 +1,15 @@
+#include "shader_permutation.hpp"
+
+std::string GetPermutationName(const ShaderPermutationDesc& shader, ShaderFeatures features)
+{
+	std::string name = shader.name;
+	for (uint32_t i = 0; i < shader.featureCount; i++)
+	{
+		if (features & (1u << i))
+		{
+			name += '+';
+			name += shader.defines[i];
+		}
+	}
+	return name;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Shaders that come in permutations declare their features once, as bits with the HLSL define that selects each:
+//
+//     struct MyShader
+//     {
+//         static constexpr const char* NAME = "my_shader";
+//         enum Feature : ShaderFeatures
+//         {
+//             Skinned = 1 << 0,
+//             AlphaTest = 1 << 1,
+//         };
+//         static constexpr std::array<const char*, 2> DEFINES = { "SKINNED", "ALPHA_TEST" };
+//     };
+//
+// and are listed in ShaderPermutations. Every permutation is compiled with each of the shader's defines set to 1 or 0,
+// so the shader selects features with #if instead of branching at runtime. The shader manifest lists the permutations
+// that are used, naming the shader with the defines of its features; the offline compiler builds only those, and the
+// engine finds them by feature bits in a table filled when the archive is loaded.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/// Feature bits of a shader, the index of its permutation
+using ShaderFeatures = uint32_t;
+
+struct ShaderPermutationDesc
+{
+	const char* name;
+	// define of every feature, lowest bit first
+	const char* const* defines;
+	uint32_t featureCount;
+};
+
+template <typename... Shaders>
+struct ShaderPermutationList
+{
+	static constexpr size_t COUNT = sizeof...(Shaders);
+	static constexpr std::array<ShaderPermutationDesc, COUNT> DESCS = { {
+		{ Shaders::NAME, Shaders::DEFINES.data(), static_cast<uint32_t>(Shaders::DEFINES.size()) }...
+	} };
+
+	/// @returns Position of the shader in the list, COUNT if it is not listed
+	template <typename Shader>
+	static constexpr size_t IndexOf()
+	{
+		constexpr bool matches[] = { std::is_same_v<Shader, Shaders>... };
+		for (size_t i = 0; i < COUNT; i++)
+		{
+			if (matches[i])
+			{
+				return i;
+			}
+		}
+		return COUNT;
+	}
+
+	/// @returns True if the features are all features of the shader
+	template <typename Shader>
+	static constexpr bool IsValid(ShaderFeatures features)
+	{
+		static_assert(Shader::DEFINES.size() < 32, "Too many features for the permutation bits");
+		return (features >> Shader::DEFINES.size()) == 0;
+	}
+};
+
+/// Vertex shader of the cube, and of the gpu driven renderer with its per instance transforms
+struct VertexShader
+{
+	static constexpr const char* NAME = "vertex_shader";
+	enum Feature : ShaderFeatures
+	{
+		// reads its world matrix from the instance buffer, indexed by a root constant the indirect draw writes
+		Indirect = 1 << 0,
+	};
+	static constexpr std::array<const char*, 1> DEFINES = { "INDIRECT" };
+};
+
+using ShaderPermutations = ShaderPermutationList<VertexShader>;
+
+/// @returns Name of a permutation in the shader archive, the shader's name followed by the define of each feature
+std::string GetPermutationName(const ShaderPermutationDesc& shader, ShaderFeatures features);
@@ -0,0 +1,479 @@
+#include "software_occlusion.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <emmintrin.h>
+
+namespace
+{
+// triangles smaller than this (in pixels squared) cannot cover a pixel center reliably
+const float g_minTriangleArea = 1e-6f;
+
+void MultiplyMatrices(const float a[16], const float b[16], float result[16])
+{
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			result[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] +
+				a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+		}
+	}
+}
+
+void TransformPoint(const float m[16], const float p[3], float result[4])
+{
+	for (int column = 0; column < 4; column++)
+	{
+		result[column] = p[0] * m[column] + p[1] * m[4 + column] + p[2] * m[8 + column] + m[12 + column];
+	}
+}
+}
+
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height, uint32_t workerCount)
+	: m_width(width)
+	, m_height(height)
+	, m_tilesX(width / TILE_WIDTH)
+	, m_tilesY(height / TILE_HEIGHT)
+	, m_viewProjection{ 0.f }
+	, m_statistics{ 0, 0, 0, 0 }
+	, m_generation(0)
+	, m_busyWorkers(0)
+	, m_quit(false)
+	, m_nextTile(0)
+{
+	assert(width % TILE_WIDTH == 0 && height % TILE_HEIGHT == 0 && "Depth buffer size must be a multiple of the tile size");
+
+	m_tileBins.resize(m_tilesX * m_tilesY);
+
+	uint32_t levelWidth = m_width;
+	uint32_t levelHeight = m_height;
+	m_levels.emplace_back(levelWidth * levelHeight, 1.f);
+	while (levelWidth > 1 || levelHeight > 1)
+	{
+		levelWidth = std::max(1u, levelWidth / 2);
+		levelHeight = std::max(1u, levelHeight / 2);
+		m_levels.emplace_back(levelWidth * levelHeight, 1.f);
+	}
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back(&SoftwareOcclusionCuller::WorkerMain, this);
+	}
+}
+
+SoftwareOcclusionCuller::~SoftwareOcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_workAvailable.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void SoftwareOcclusionCuller::BeginFrame(const float viewProjection[16])
+{
+	std::memcpy(m_viewProjection, viewProjection, sizeof(m_viewProjection));
+
+	m_triangles.clear();
+	for (std::vector<uint32_t>& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+	std::fill(m_levels[0].begin(), m_levels[0].end(), 1.f);
+	m_statistics = { 0, 0, 0, 0 };
+}
+
+void SoftwareOcclusionCuller::AddOccluder(const MeshPositions& positions, const uint32_t* indices, size_t indexCount,
+	const float world[16])
+{
+	float worldViewProjection[16];
+	MultiplyMatrices(world, m_viewProjection, worldViewProjection);
+
+	m_clipPositions.resize(positions.vertexCount * 4);
+	for (size_t v = 0; v < positions.vertexCount; v++)
+	{
+		float position[3];
+		std::memcpy(position, reinterpret_cast<const uint8_t*>(positions.data) + v * positions.stride, sizeof(position));
+		TransformPoint(worldViewProjection, position, &m_clipPositions[v * 4]);
+	}
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const float* corners[3] = {
+			&m_clipPositions[indices[i] * 4],
+			&m_clipPositions[indices[i + 1] * 4],
+			&m_clipPositions[indices[i + 2] * 4]
+		};
+
+		// trivially reject triangles completely outside one of the side or far planes
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; axis++)
+		{
+			outside = (corners[0][axis] > corners[0][3] && corners[1][axis] > corners[1][3] && corners[2][axis] > corners[2][3]);
+			if (axis < 2)
+			{
+				outside = outside ||
+					(corners[0][axis] < -corners[0][3] && corners[1][axis] < -corners[1][3] && corners[2][axis] < -corners[2][3]);
+			}
+		}
+		if (outside)
+		{
+			continue;
+		}
+
+		// clip against the near plane (z >= 0), which leaves a polygon of up to four corners
+		float polygon[4][4];
+		int cornerCount = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const float* current = corners[corner];
+			const float* next = corners[(corner + 1) % 3];
+			if (current[2] >= 0.f)
+			{
+				std::memcpy(polygon[cornerCount++], current, sizeof(float) * 4);
+			}
+			if ((current[2] >= 0.f) != (next[2] >= 0.f))
+			{
+				const float t = current[2] / (current[2] - next[2]);
+				for (int component = 0; component < 4; component++)
+				{
+					polygon[cornerCount][component] = current[component] + (next[component] - current[component]) * t;
+				}
+				cornerCount++;
+			}
+		}
+
+		for (int corner = 2; corner < cornerCount; corner++)
+		{
+			const float triangle[3][4] = {
+				{ polygon[0][0], polygon[0][1], polygon[0][2], polygon[0][3] },
+				{ polygon[corner - 1][0], polygon[corner - 1][1], polygon[corner - 1][2], polygon[corner - 1][3] },
+				{ polygon[corner][0], polygon[corner][1], polygon[corner][2], polygon[corner][3] }
+			};
+			BinTriangle(triangle);
+		}
+	}
+}
+
+void SoftwareOcclusionCuller::Rasterize()
+{
+	m_nextTile = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+		m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+	}
+	m_workAvailable.notify_all();
+
+	// the calling thread takes tiles as well instead of only waiting
+	RasterizeTiles();
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_workDone.wait(lock, [this]() { return m_busyWorkers == 0; });
+	}
+
+	BuildHierarchy();
+}
+
+bool SoftwareOcclusionCuller::IsBoxVisible(const float boxMin[3], const float boxMax[3], const float world[16])
+{
+	m_statistics.testedBoxes++;
+
+	float worldViewProjection[16];
+	MultiplyMatrices(world, m_viewProjection, worldViewProjection);
+
+	float minX = 1.f;
+	float maxX = -1.f;
+	float minY = 1.f;
+	float maxY = -1.f;
+	float minZ = 1.f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const float position[3] = {
+			(corner & 1) ? boxMax[0] : boxMin[0],
+			(corner & 2) ? boxMax[1] : boxMin[1],
+			(corner & 4) ? boxMax[2] : boxMin[2]
+		};
+		float clip[4];
+		TransformPoint(worldViewProjection, position, clip);
+
+		// boxes reaching in front of the near plane cannot be projected, and are close enough to be drawn anyway
+		if (clip[2] < 0.f || clip[3] <= 0.f)
+		{
+			return true;
+		}
+
+		const float x = clip[0] / clip[3];
+		const float y = clip[1] / clip[3];
+		minX = (corner == 0) ? x : std::min(minX, x);
+		maxX = (corner == 0) ? x : std::max(maxX, x);
+		minY = (corner == 0) ? y : std::min(minY, y);
+		maxY = (corner == 0) ? y : std::max(maxY, y);
+		minZ = (corner == 0) ? clip[2] / clip[3] : std::min(minZ, clip[2] / clip[3]);
+	}
+
+	if (maxX < -1.f || minX > 1.f || maxY < -1.f || minY > 1.f || minZ > 1.f)
+	{
+		m_statistics.occludedBoxes++;
+		return false;
+	}
+
+	// screen rectangle in pixels, y points down
+	const int x0 = std::clamp(static_cast<int>((minX * 0.5f + 0.5f) * m_width), 0, static_cast<int>(m_width) - 1);
+	const int x1 = std::clamp(static_cast<int>((maxX * 0.5f + 0.5f) * m_width), 0, static_cast<int>(m_width) - 1);
+	const int y0 = std::clamp(static_cast<int>((0.5f - maxY * 0.5f) * m_height), 0, static_cast<int>(m_height) - 1);
+	const int y1 = std::clamp(static_cast<int>((0.5f - minY * 0.5f) * m_height), 0, static_cast<int>(m_height) - 1);
+
+	// the finest level at which the rectangle covers at most 4x4 texels
+	uint32_t level = 0;
+	while (level + 1 < m_levels.size() && (((x1 >> level) - (x0 >> level)) > 3 || ((y1 >> level) - (y0 >> level)) > 3))
+	{
+		level++;
+	}
+
+	const uint32_t levelWidth = std::max(1u, m_width >> level);
+	const std::vector<float>& depth = m_levels[level];
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+	{
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+		{
+			if (depth[y * levelWidth + x] >= minZ)
+			{
+				return true;
+			}
+		}
+	}
+
+	m_statistics.occludedBoxes++;
+	return false;
+}
+
+const OcclusionStatistics& SoftwareOcclusionCuller::GetStatistics() const
+{
+	return m_statistics;
+}
+
+uint32_t SoftwareOcclusionCuller::GetLevelCount() const
+{
+	return static_cast<uint32_t>(m_levels.size());
+}
+
+const std::vector<float>& SoftwareOcclusionCuller::GetDepthLevel(uint32_t level) const
+{
+	return m_levels[level];
+}
+
+void SoftwareOcclusionCuller::BinTriangle(const float clip[3][4])
+{
+	ScreenTriangle triangle;
+	for (int corner = 0; corner < 3; corner++)
+	{
+		const float inverseW = 1.f / clip[corner][3];
+		triangle.x[corner] = (clip[corner][0] * inverseW * 0.5f + 0.5f) * m_width;
+		triangle.y[corner] = (0.5f - clip[corner][1] * inverseW * 0.5f) * m_height;
+		triangle.z[corner] = clip[corner][2] * inverseW;
+	}
+
+	// occluders are rasterized regardless of facing, so orient every triangle the same way
+	const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+		(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (std::fabs(area) < g_minTriangleArea)
+	{
+		return;
+	}
+	if (area < 0.f)
+	{
+		std::swap(triangle.x[1], triangle.x[2]);
+		std::swap(triangle.y[1], triangle.y[2]);
+		std::swap(triangle.z[1], triangle.z[2]);
+	}
+
+	const float minX = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+	const float maxX = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+	const float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+	const float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+	if (maxX < 0.f || maxY < 0.f || minX >= m_width || minY >= m_height)
+	{
+		return;
+	}
+
+	const uint32_t triangleIndex = static_cast<uint32_t>(m_triangles.size());
+	m_triangles.push_back(triangle);
+	m_statistics.occluderTriangles++;
+
+	const int tileX0 = std::max(0, static_cast<int>(minX) / static_cast<int>(TILE_WIDTH));
+	const int tileX1 = std::min(static_cast<int>(m_tilesX) - 1, static_cast<int>(maxX) / static_cast<int>(TILE_WIDTH));
+	const int tileY0 = std::max(0, static_cast<int>(minY) / static_cast<int>(TILE_HEIGHT));
+	const int tileY1 = std::min(static_cast<int>(m_tilesY) - 1, static_cast<int>(maxY) / static_cast<int>(TILE_HEIGHT));
+	for (int tileY = tileY0; tileY <= tileY1; tileY++)
+	{
+		for (int tileX = tileX0; tileX <= tileX1; tileX++)
+		{
+			m_tileBins[tileY * m_tilesX + tileX].push_back(triangleIndex);
+			m_statistics.binnedTriangles++;
+		}
+	}
+}
+
+void SoftwareOcclusionCuller::RasterizeTiles()
+{
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	for (uint32_t tile = m_nextTile++; tile < tileCount; tile = m_nextTile++)
+	{
+		RasterizeTile(tile);
+	}
+}
+
+void SoftwareOcclusionCuller::RasterizeTile(uint32_t tile)
+{
+	const int tileX0 = (tile % m_tilesX) * TILE_WIDTH;
+	const int tileY0 = (tile / m_tilesX) * TILE_HEIGHT;
+	const int tileX1 = tileX0 + TILE_WIDTH - 1;
+	const int tileY1 = tileY0 + TILE_HEIGHT - 1;
+	float* depth = m_levels[0].data();
+
+	const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t triangleIndex : m_tileBins[tile])
+	{
+		const ScreenTriangle& triangle = m_triangles[triangleIndex];
+
+		// edge i is opposite corner i: e(x, y) = a * x + b * y + c, positive inside
+		float a[3];
+		float b[3];
+		float c[3];
+		__m128 ownsEdge[3];
+		for (int edge = 0; edge < 3; edge++)
+		{
+			const int from = (edge + 1) % 3;
+			const int to = (edge + 2) % 3;
+			a[edge] = triangle.y[from] - triangle.y[to];
+			b[edge] = triangle.x[to] - triangle.x[from];
+			// evaluated at the same endpoint for both triangles sharing the edge, so their edge functions are exact
+			// negatives of each other and no pixel center falls between them
+			const bool fromFirst = (triangle.x[from] < triangle.x[to]) ||
+				(triangle.x[from] == triangle.x[to] && triangle.y[from] < triangle.y[to]);
+			const int anchor = fromFirst ? from : to;
+			c[edge] = -(a[edge] * triangle.x[anchor] + b[edge] * triangle.y[anchor]);
+
+			// pixel centers exactly on a shared edge belong to exactly one of the two triangles
+			const bool owned = (a[edge] > 0.f) || (a[edge] == 0.f && b[edge] > 0.f);
+			ownsEdge[edge] = _mm_castsi128_ps(_mm_set1_epi32(owned ? -1 : 0));
+		}
+
+		// depth is linear in screen space after the perspective divide
+		const float area = c[0] + a[0] * triangle.x[0] + b[0] * triangle.y[0];
+		const float inverseArea = 1.f / area;
+		const float zA = (a[0] * triangle.z[0] + a[1] * triangle.z[1] + a[2] * triangle.z[2]) * inverseArea;
+		const float zB = (b[0] * triangle.z[0] + b[1] * triangle.z[1] + b[2] * triangle.z[2]) * inverseArea;
+		const float zC = (c[0] * triangle.z[0] + c[1] * triangle.z[1] + c[2] * triangle.z[2]) * inverseArea;
+
+		// bounding box inside the tile, starting on a multiple of four pixels
+		const int x0 = std::max(tileX0, static_cast<int>(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] }))) & ~3;
+		const int x1 = std::min(tileX1, static_cast<int>(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] })));
+		const int y0 = std::max(tileY0, static_cast<int>(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] })));
+		const int y1 = std::min(tileY1, static_cast<int>(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] })));
+
+		const __m128 a0 = _mm_set1_ps(a[0]);
+		const __m128 a1 = _mm_set1_ps(a[1]);
+		const __m128 a2 = _mm_set1_ps(a[2]);
+		const __m128 zStepX = _mm_set1_ps(zA);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			const float pixelY = y + 0.5f;
+			const __m128 row0 = _mm_set1_ps(b[0] * pixelY + c[0]);
+			const __m128 row1 = _mm_set1_ps(b[1] * pixelY + c[1]);
+			const __m128 row2 = _mm_set1_ps(b[2] * pixelY + c[2]);
+			const __m128 rowZ = _mm_set1_ps(zB * pixelY + zC);
+			float* depthRow = depth + y * m_width;
+
+			for (int x = x0; x <= x1; x += 4)
+			{
+				const __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixelOffsets);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, pixelX), row0);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, pixelX), row1);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, pixelX), row2);
+				const __m128 inside0 = _mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_and_ps(_mm_cmpeq_ps(e0, zero), ownsEdge[0]));
+				const __m128 inside1 = _mm_or_ps(_mm_cmpgt_ps(e1, zero), _mm_and_ps(_mm_cmpeq_ps(e1, zero), ownsEdge[1]));
+				const __m128 inside2 = _mm_or_ps(_mm_cmpgt_ps(e2, zero), _mm_and_ps(_mm_cmpeq_ps(e2, zero), ownsEdge[2]));
+				const __m128 inside = _mm_and_ps(_mm_and_ps(inside0, inside1), inside2);
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(zStepX, pixelX), rowZ);
+				const __m128 previous = _mm_loadu_ps(depthRow + x);
+				const __m128 closest = _mm_min_ps(previous, z);
+				_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, previous)));
+			}
+		}
+	}
+}
+
+void SoftwareOcclusionCuller::BuildHierarchy()
+{
+	uint32_t sourceWidth = m_width;
+	uint32_t sourceHeight = m_height;
+	for (size_t level = 1; level < m_levels.size(); level++)
+	{
+		const uint32_t width = std::max(1u, sourceWidth / 2);
+		const uint32_t height = std::max(1u, sourceHeight / 2);
+		const std::vector<float>& source = m_levels[level - 1];
+		std::vector<float>& destination = m_levels[level];
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t sourceX0 = std::min(x * 2, sourceWidth - 1);
+				const uint32_t sourceX1 = std::min(x * 2 + 1, sourceWidth - 1);
+				const uint32_t sourceY0 = std::min(y * 2, sourceHeight - 1);
+				const uint32_t sourceY1 = std::min(y * 2 + 1, sourceHeight - 1);
+				destination[y * width + x] = std::max(
+					std::max(source[sourceY0 * sourceWidth + sourceX0], source[sourceY0 * sourceWidth + sourceX1]),
+					std::max(source[sourceY1 * sourceWidth + sourceX0], source[sourceY1 * sourceWidth + sourceX1]));
+			}
+		}
+
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+}
+
+void SoftwareOcclusionCuller::WorkerMain()
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workAvailable.wait(lock, [&]() { return m_quit || m_generation != seenGeneration; });
+			if (m_quit)
+			{
+				return;
+			}
+			seenGeneration = m_generation;
+		}
+
+		RasterizeTiles();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+		}
+		m_workDone.notify_one();
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// Software occlusion culling: selected occluders are rasterized on the CPU into a small depth buffer, which is
+// reduced into a hierarchy of farthest depths that occludee bounding boxes are tested against before any draw is
+// recorded. Triangles are binned into screen tiles and the tiles are rasterized by a small pool of threads, four
+// pixels at a time with SSE2.
+// Matrices are row-major and use the row-vector convention of DirectXMath (v' = v * M), depth follows D3D (0 = near).
+
+#include <mesh_simplifier.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct OcclusionStatistics
+{
+	uint32_t occluderTriangles;  // after clipping
+	uint32_t binnedTriangles;    // summed over tiles
+	uint32_t testedBoxes;
+	uint32_t occludedBoxes;      // hidden or off screen
+};
+
+class SoftwareOcclusionCuller
+{
+public:
+	static constexpr uint32_t TILE_WIDTH = 64;
+	static constexpr uint32_t TILE_HEIGHT = 32;
+
+	/// @param width Depth buffer width, a multiple of TILE_WIDTH
+	/// @param height Depth buffer height, a multiple of TILE_HEIGHT
+	/// @param workerCount Threads that help the calling thread rasterize tiles
+	SoftwareOcclusionCuller(uint32_t width = 256, uint32_t height = 128, uint32_t workerCount = 3);
+	~SoftwareOcclusionCuller();
+
+	SoftwareOcclusionCuller(const SoftwareOcclusionCuller& other) = delete;
+	SoftwareOcclusionCuller& operator=(const SoftwareOcclusionCuller& other) = delete;
+
+	/// Clear the depth buffer and the binned occluders
+	void BeginFrame(const float viewProjection[16]);
+
+	/// Transform, clip and bin the triangles of an occluder. Occluders must be opaque and must not extend past the
+	/// object they stand for; simple and large ones give the best return.
+	void AddOccluder(const MeshPositions& positions, const uint32_t* indices, size_t indexCount, const float world[16]);
+
+	/// Rasterize everything binned since BeginFrame and build the depth hierarchy
+	void Rasterize();
+
+	/// Conservative test of an object space box
+	/// @returns False only if the box is completely hidden behind occluders or outside the screen
+	bool IsBoxVisible(const float boxMin[3], const float boxMax[3], const float world[16]);
+
+	const OcclusionStatistics& GetStatistics() const;
+
+	/// Level 0 holds the rasterized depth, every further level the farthest depth of 2x2 texels of the previous one
+	uint32_t GetLevelCount() const;
+	const std::vector<float>& GetDepthLevel(uint32_t level) const;
+
+private:
+	struct ScreenTriangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+
+	void BinTriangle(const float clip[3][4]);
+	void RasterizeTiles();
+	void RasterizeTile(uint32_t tile);
+	void BuildHierarchy();
+	void WorkerMain();
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+
+	float m_viewProjection[16];
+
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_tileBins;
+	std::vector<float> m_clipPositions;  // scratch for AddOccluder
+
+	// m_levels[0] is the depth buffer
+	std::vector<std::vector<float>> m_levels;
+
+	OcclusionStatistics m_statistics;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_workDone;
+	uint64_t m_generation;
+	uint32_t m_busyWorkers;
+	bool m_quit;
+	std::atomic<uint32_t> m_nextTile;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread. Each side owns one index and
+// only reads the other's, so a push or pop is a copy and two atomic operations; nothing ever blocks or allocates.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+template <typename T, size_t CAPACITY>
+class SpscRing
+{
+	static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "Capacity has to be a power of two");
+	static_assert(std::is_trivially_copyable_v<T>, "Elements are copied in and out of the ring");
+
+public:
+	/// Producer only
+	/// @returns False if the ring is full, the element is not added then
+	bool TryPush(const T& element)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) == CAPACITY)
+		{
+			return false;
+		}
+		m_elements[head & (CAPACITY - 1)] = element;
+		// publishes the element to the consumer
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Consumer only
+	/// @returns False if the ring is empty
+	bool TryPop(T& element)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		element = m_elements[tail & (CAPACITY - 1)];
+		// hands the slot back to the producer
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// @returns Elements in the ring. Exact on either side when the other is idle, otherwise the producer may see
+	/// more and the consumer fewer elements than there are.
+	size_t GetSize() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+	static constexpr size_t GetCapacity()
+	{
+		return CAPACITY;
+	}
+
+private:
+	// running counts, wrapped into the array when indexing; on separate cache lines so the two sides do not
+	// invalidate each other's line on every operation
+	alignas(64) std::atomic<size_t> m_head = 0;
+	alignas(64) std::atomic<size_t> m_tail = 0;
+	alignas(64) std::array<T, CAPACITY> m_elements;
+};
@@ -0,0 +1,220 @@
+#include "startup_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct StartupGraph::RunState
+{
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::deque<TaskId> workerQueue;
+	std::deque<TaskId> callingThreadQueue;
+	size_t completed = 0;
+};
+
+StartupGraph::TaskId StartupGraph::AddTask(const std::string& name, std::function<void()> task,
+	std::initializer_list<TaskId> dependencies, bool callingThread)
+{
+	const TaskId id = static_cast<TaskId>(m_tasks.size());
+	Task entry = { };
+	entry.name = name;
+	entry.function = std::move(task);
+	entry.callingThread = callingThread;
+	for (TaskId dependency : dependencies)
+	{
+		// only earlier tasks can be depended on, which rules out cycles
+		assert(dependency < id && "Dependencies must be added before the tasks depending on them");
+		entry.dependencies.push_back(dependency);
+		m_tasks[dependency].dependents.push_back(id);
+	}
+	m_tasks.push_back(std::move(entry));
+	return id;
+}
+
+void StartupGraph::Run(uint32_t threadCount)
+{
+	RunState state;
+	m_startTime = std::chrono::steady_clock::now();
+	m_exception = nullptr;
+
+	size_t workerTasks = 0;
+	for (TaskId id = 0; id < m_tasks.size(); id++)
+	{
+		Task& task = m_tasks[id];
+		task.remainingDependencies = static_cast<uint32_t>(task.dependencies.size());
+		task.failed = false;
+		workerTasks += task.callingThread ? 0 : 1;
+		if (task.remainingDependencies == 0)
+		{
+			(task.callingThread ? state.callingThreadQueue : state.workerQueue).push_back(id);
+		}
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threadCount = static_cast<uint32_t>(std::min<size_t>(threadCount, workerTasks));
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back([this, &state, thread = i + 1]()
+			{
+				std::unique_lock<std::mutex> lock(state.mutex);
+				while (true)
+				{
+					state.taskReady.wait(lock, [&]() { return !state.workerQueue.empty() || state.completed == m_tasks.size(); });
+					if (state.workerQueue.empty())
+					{
+						return;
+					}
+					const TaskId id = state.workerQueue.front();
+					state.workerQueue.pop_front();
+
+					lock.unlock();
+					Execute(id, thread, state);
+					lock.lock();
+				}
+			});
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(state.mutex);
+		while (true)
+		{
+			state.taskReady.wait(lock, [&]() { return !state.callingThreadQueue.empty() || state.completed == m_tasks.size(); });
+			if (state.callingThreadQueue.empty())
+			{
+				break;
+			}
+			const TaskId id = state.callingThreadQueue.front();
+			state.callingThreadQueue.pop_front();
+
+			lock.unlock();
+			Execute(id, 0, state);
+			lock.lock();
+		}
+	}
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	m_duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+
+	if (m_exception)
+	{
+		std::rethrow_exception(m_exception);
+	}
+}
+
+double StartupGraph::GetDuration() const
+{
+	return m_duration;
+}
+
+std::string StartupGraph::GetReport() const
+{
+	std::vector<TaskId> order(m_tasks.size());
+	for (TaskId id = 0; id < m_tasks.size(); id++)
+	{
+		order[id] = id;
+	}
+	std::sort(order.begin(), order.end(), [this](TaskId a, TaskId b) { return m_tasks[a].start < m_tasks[b].start; });
+
+	std::string report;
+	char line[256];
+	for (TaskId id : order)
+	{
+		const Task& task = m_tasks[id];
+		snprintf(line, sizeof(line), "%8.2f - %8.2f ms  %-8s %s%s\n", task.start, task.end,
+			(task.thread == 0) ? "main" : ("worker " + std::to_string(task.thread)).c_str(), task.name.c_str(),
+			task.failed ? " (failed)" : "");
+		report += line;
+	}
+
+	// walk back from the task that finished last through the dependency that finished last
+	std::vector<TaskId> criticalPath;
+	if (!m_tasks.empty())
+	{
+		TaskId id = order.front();
+		for (TaskId candidate : order)
+		{
+			id = (m_tasks[candidate].end > m_tasks[id].end) ? candidate : id;
+		}
+		while (true)
+		{
+			criticalPath.push_back(id);
+			const std::vector<TaskId>& dependencies = m_tasks[id].dependencies;
+			if (dependencies.empty())
+			{
+				break;
+			}
+			id = *std::max_element(dependencies.begin(), dependencies.end(),
+				[this](TaskId a, TaskId b) { return m_tasks[a].end < m_tasks[b].end; });
+		}
+	}
+
+	snprintf(line, sizeof(line), "%8.2f ms total, critical path:", m_duration);
+	report += line;
+	for (auto it = criticalPath.rbegin(); it != criticalPath.rend(); ++it)
+	{
+		report += (it == criticalPath.rbegin()) ? " " : " -> ";
+		report += m_tasks[*it].name;
+	}
+	report += "\n";
+	return report;
+}
+
+void StartupGraph::Execute(TaskId id, uint32_t thread, RunState& state)
+{
+	Task& task = m_tasks[id];
+	task.thread = thread;
+
+	// dependencies finished before this task was queued, reading their result needs no lock
+	bool skip = false;
+	for (TaskId dependency : task.dependencies)
+	{
+		skip = skip || m_tasks[dependency].failed;
+	}
+
+	std::exception_ptr exception;
+	task.start = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+	if (!skip)
+	{
+		try
+		{
+			task.function();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+	}
+	task.end = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		task.failed = skip || exception;
+		if (exception && !m_exception)
+		{
+			m_exception = exception;
+		}
+		for (TaskId dependent : task.dependents)
+		{
+			Task& next = m_tasks[dependent];
+			if (--next.remainingDependencies == 0)
+			{
+				(next.callingThread ? state.callingThreadQueue : state.workerQueue).push_back(dependent);
+			}
+		}
+		state.completed++;
+	}
+	state.taskReady.notify_all();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Runs the steps of application startup as a dependency graph, every step as soon as the steps it depends on are
+// done: worker steps in parallel on a thread pool, steps bound to the calling thread (e.g. creating windows, which
+// belong to the thread that pumps their messages) in between on that thread. Start and end of every step are
+// recorded, so startup can be reported as a timeline together with its critical path.
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+class StartupGraph
+{
+public:
+	using TaskId = uint32_t;
+
+	/// @param dependencies Tasks added earlier that have to finish before this one starts
+	/// @param callingThread Run the task on the thread calling Run instead of a worker
+	TaskId AddTask(const std::string& name, std::function<void()> task, std::initializer_list<TaskId> dependencies = { },
+		bool callingThread = false);
+
+	/// Run every task and return once all of them are done. If a task throws, the tasks depending on it are skipped
+	/// and the first exception is rethrown here after the others have finished.
+	/// @param threadCount Worker threads, 0 for one per hardware thread
+	void Run(uint32_t threadCount = 0);
+
+	/// @returns Milliseconds from the start to the end of the last Run
+	double GetDuration() const;
+	/// @returns One line per task with its start and end in milliseconds and its thread, followed by the critical path
+	std::string GetReport() const;
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<void()> function;
+		std::vector<TaskId> dependencies;
+		std::vector<TaskId> dependents;
+		bool callingThread;
+		// set while running
+		uint32_t remainingDependencies;
+		bool failed;
+		double start;
+		double end;
+		uint32_t thread;  // 0 is the calling thread
+	};
+
+	struct RunState;
+
+	/// Run or skip a task and queue the dependents it unblocks, called without the lock held
+	void Execute(TaskId id, uint32_t thread, RunState& state);
+
+	std::vector<Task> m_tasks;
+	std::chrono::steady_clock::time_point m_startTime;
+	double m_duration = 0.;
+	std::exception_ptr m_exception;
+};
@@ -0,0 +1,242 @@
+#include "upload_manager.hpp"
+
+#include <command_queue.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+UploadManager::UploadManager(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> copyQueue, uint64_t pageSize)
+	: m_device(device)
+	, m_copyQueue(copyQueue)
+	, m_pageSize(pageSize)
+	, m_currentOffset(0)
+	, m_pendingFenceValue(1)
+{
+	ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+
+	m_fenceEvent = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+	assert(m_fenceEvent && "Failed to create fence event");
+}
+
+UploadManager::~UploadManager()
+{
+	// copies that were queued but never submitted are dropped
+	WaitForFenceValue(m_pendingFenceValue - 1);
+	::CloseHandle(m_fenceEvent);
+}
+
+UploadManager::Allocation UploadManager::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(size > 0 && "Empty upload");
+	assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (size > m_pageSize)
+	{
+		// not pooled, released as soon as its copy has landed
+		std::shared_ptr<UploadPage> page = CreatePage(AlignUp(size, alignment));
+		return { page, 0, page->data, size };
+	}
+
+	uint64_t offset = AlignUp(m_currentOffset, alignment);
+	if (!m_currentPage || offset + size > m_currentPage->size)
+	{
+		// dropping the current page first lets it be found again once its copies have landed
+		m_currentPage.reset();
+		m_currentPage = FindFreePage();
+		if (!m_currentPage)
+		{
+			m_currentPage = CreatePage(m_pageSize);
+			m_pages.push_back(m_currentPage);
+		}
+		offset = 0;
+	}
+	m_currentOffset = offset + size;
+
+	return { m_currentPage, offset, m_currentPage->data + offset, size };
+}
+
+uint64_t UploadManager::CopyBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const Allocation& source)
+{
+	PendingCopy copy = { };
+	copy.destination = destination;
+	copy.page = source.page;
+	copy.destinationOffset = destinationOffset;
+	copy.sourceOffset = source.offset;
+	copy.size = source.size;
+	return QueueCopy(std::move(copy));
+}
+
+uint64_t UploadManager::UploadBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const void* data, uint64_t size)
+{
+	const Allocation allocation = Allocate(size);
+	std::memcpy(allocation.data, data, size);
+	return CopyBuffer(destination, destinationOffset, allocation);
+}
+
+uint64_t UploadManager::UploadTexture(ID3D12Resource* destination, uint32_t firstSubresource, uint32_t subresourceCount,
+	const D3D12_SUBRESOURCE_DATA* subresources)
+{
+	const D3D12_RESOURCE_DESC desc = destination->GetDesc();
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(subresourceCount);
+	std::vector<UINT> rowCounts(subresourceCount);
+	std::vector<UINT64> rowSizes(subresourceCount);
+	UINT64 totalSize = 0;
+	m_device->GetCopyableFootprints(&desc, firstSubresource, subresourceCount, 0, footprints.data(), rowCounts.data(),
+		rowSizes.data(), &totalSize);
+
+	const Allocation allocation = Allocate(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	uint8_t* const pageData = static_cast<uint8_t*>(allocation.data);
+
+	uint64_t fenceValue = 0;
+	for (uint32_t i = 0; i < subresourceCount; i++)
+	{
+		const D3D12_SUBRESOURCE_FOOTPRINT& footprint = footprints[i].Footprint;
+		const uint8_t* const source = static_cast<const uint8_t*>(subresources[i].pData);
+		const uint64_t slicePitch = static_cast<uint64_t>(footprint.RowPitch) * rowCounts[i];
+
+		// rows in upload memory are padded to the pitch alignment, the source rows usually are not
+		for (UINT z = 0; z < footprint.Depth; z++)
+		{
+			for (UINT row = 0; row < rowCounts[i]; row++)
+			{
+				std::memcpy(pageData + footprints[i].Offset + z * slicePitch + row * footprint.RowPitch,
+					source + z * subresources[i].SlicePitch + row * subresources[i].RowPitch, rowSizes[i]);
+			}
+		}
+
+		PendingCopy copy = { };
+		copy.destination = destination;
+		copy.page = allocation.page;
+		copy.subresource = firstSubresource + i;
+		copy.footprint = footprints[i];
+		copy.footprint.Offset += allocation.offset;
+		// a Submit on the main thread may split the subresources over two batches, the later fence covers both
+		fenceValue = std::max(fenceValue, QueueCopy(std::move(copy)));
+	}
+	return fenceValue;
+}
+
+uint64_t UploadManager::Submit()
+{
+	while (!m_inFlight.empty() && IsFenceComplete(m_inFlight.front().fenceValue))
+	{
+		m_inFlight.pop_front();
+	}
+
+	Batch batch;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pendingCopies.empty())
+		{
+			return m_pendingFenceValue - 1;
+		}
+		batch.fenceValue = m_pendingFenceValue++;
+		batch.copies = std::move(m_pendingCopies);
+		m_pendingCopies.clear();
+	}
+
+	// copy queues promote resources in the common state on their own and they decay back after the batch
+	auto commandList = m_copyQueue->GetCommandList();
+	{
+		PROFILE_GPU_SCOPE(*m_copyQueue, commandList.Get(), "Upload batch");
+		for (const PendingCopy& copy : batch.copies)
+		{
+			if (copy.size > 0)
+			{
+				commandList->CopyBufferRegion(copy.destination.Get(), copy.destinationOffset, copy.page->resource.Get(),
+					copy.sourceOffset, copy.size);
+			}
+			else
+			{
+				const CD3DX12_TEXTURE_COPY_LOCATION destination(copy.destination.Get(), copy.subresource);
+				const CD3DX12_TEXTURE_COPY_LOCATION source(copy.page->resource.Get(), copy.footprint);
+				commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+			}
+		}
+	}
+	m_copyQueue->ExecuteCommandList(commandList);
+	ThrowIfFailed(m_copyQueue->GetD3D12CommandQueue()->Signal(m_fence.Get(), batch.fenceValue));
+
+	const uint64_t fenceValue = batch.fenceValue;
+	m_inFlight.push_back(std::move(batch));
+	return fenceValue;
+}
+
+void UploadManager::GpuWait(CommandQueue& queue, uint64_t fenceValue)
+{
+	bool submitted;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		submitted = fenceValue < m_pendingFenceValue;
+	}
+	// the signal has to be submitted before the wait, a wait for a value never signalled would hang the queue
+	if (!submitted)
+	{
+		Submit();
+	}
+	ThrowIfFailed(queue.GetD3D12CommandQueue()->Wait(m_fence.Get(), fenceValue));
+}
+
+bool UploadManager::IsFenceComplete(uint64_t fenceValue) const
+{
+	return m_fence->GetCompletedValue() >= fenceValue;
+}
+
+void UploadManager::WaitForFenceValue(uint64_t fenceValue)
+{
+	if (!IsFenceComplete(fenceValue))
+	{
+		ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+		::WaitForSingleObject(m_fenceEvent, DWORD_MAX);
+	}
+}
+
+std::shared_ptr<UploadManager::UploadPage> UploadManager::CreatePage(uint64_t size)
+{
+	const CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+	const CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+	auto page = std::make_shared<UploadPage>();
+	page->size = size;
+	ThrowIfFailed(m_device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&page->resource)));
+
+	// upload heaps may stay mapped for their whole lifetime
+	void* data = nullptr;
+	const CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(page->resource->Map(0, &readRange, &data));
+	page->data = static_cast<uint8_t*>(data);
+
+	return page;
+}
+
+std::shared_ptr<UploadManager::UploadPage> UploadManager::FindFreePage()
+{
+	// references are only handed out under the lock, so a page nobody else holds can not be picked up concurrently
+	for (const std::shared_ptr<UploadPage>& page : m_pages)
+	{
+		if (page.use_count() == 1)
+		{
+			return page;
+		}
+	}
+	return nullptr;
+}
+
+uint64_t UploadManager::QueueCopy(PendingCopy copy)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingCopies.push_back(std::move(copy));
+	return m_pendingFenceValue;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CommandQueue;
+
+/// Coalesces buffer and texture uploads into one copy queue command list per Submit. Data is written into large
+/// persistently mapped upload pages that are sub-allocated and reused, instead of a committed upload resource and a
+/// command list per upload. Every batch signals the next value of the manager's own fence, so the fence value of an
+/// upload is known as soon as it is queued; consumers wait for it on the gpu with GpuWait.
+/// Uploads may be queued from any thread, Submit and GpuWait record on the copy queue and are main thread only.
+class UploadManager
+{
+public:
+	struct UploadPage
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		uint8_t* data;
+		uint64_t size;
+	};
+
+	/// Mapped upload memory. The page stays alive as long as an allocation or a copy in flight refers to it.
+	struct Allocation
+	{
+		std::shared_ptr<UploadPage> page;
+		uint64_t offset;
+		void* data;
+		uint64_t size;
+	};
+
+	/// @param pageSize Bytes per upload page, larger uploads get a page of their own
+	UploadManager(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> copyQueue,
+		uint64_t pageSize = 4 * 1024 * 1024);
+	/// Waits for the copies in flight, their pages are released with the manager
+	~UploadManager();
+
+	UploadManager(const UploadManager& other) = delete;
+	UploadManager& operator=(const UploadManager& other) = delete;
+
+	/// Upload memory for the caller to write, copied later with CopyBuffer. Write only, it is write combined.
+	Allocation Allocate(uint64_t size, uint64_t alignment = 16);
+
+	/// Queue a copy from upload memory into a buffer. The destination must be in the common state when the batch runs,
+	/// which buffers decay to after every ExecuteCommandLists.
+	/// @returns Fence value the destination is ready at
+	uint64_t CopyBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const Allocation& source);
+	/// Allocate, copy the data and queue the copy in one go
+	/// @returns Fence value the destination is ready at
+	uint64_t UploadBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const void* data, uint64_t size);
+	/// Upload consecutive subresources of a texture in the common state, laid out with the placement alignment the
+	/// copy queue requires
+	/// @returns Fence value the texture is ready at
+	uint64_t UploadTexture(ID3D12Resource* destination, uint32_t firstSubresource, uint32_t subresourceCount,
+		const D3D12_SUBRESOURCE_DATA* subresources);
+
+	/// Record every queued copy into one command list on the copy queue and signal the batch fence after it.
+	/// Called once per frame by the application, and by GpuWait for copies that have not been submitted yet.
+	/// @returns Fence value of the submitted batch, the last submitted one if nothing was queued
+	uint64_t Submit();
+
+	/// Make a queue wait on the gpu until the uploads of a fence value have landed, submitting them first if needed
+	void GpuWait(CommandQueue& queue, uint64_t fenceValue);
+	bool IsFenceComplete(uint64_t fenceValue) const;
+	/// Block the cpu until an upload has landed, for loading code that can not continue without it
+	void WaitForFenceValue(uint64_t fenceValue);
+
+private:
+	struct PendingCopy
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> destination;
+		std::shared_ptr<UploadPage> page;
+		uint64_t destinationOffset;
+		uint64_t sourceOffset;
+		uint64_t size;
+		// texture copies carry their footprint inside the page, size is 0 for them
+		UINT subresource;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	};
+
+	struct Batch
+	{
+		uint64_t fenceValue;
+		// keeps destinations and pages alive until the gpu has copied them
+		std::vector<PendingCopy> copies;
+	};
+
+	std::shared_ptr<UploadPage> CreatePage(uint64_t size);
+	/// @returns A standard page no allocation or copy refers to anymore, nullptr if all of them are in use
+	std::shared_ptr<UploadPage> FindFreePage();
+	uint64_t QueueCopy(PendingCopy copy);
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+	std::shared_ptr<CommandQueue> m_copyQueue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_fenceEvent;
+	uint64_t m_pageSize;
+
+	std::mutex m_mutex;
+	// every standard sized page, a page is free again once this is the only reference to it
+	std::vector<std::shared_ptr<UploadPage>> m_pages;
+	std::shared_ptr<UploadPage> m_currentPage;
+	uint64_t m_currentOffset;
+	std::vector<PendingCopy> m_pendingCopies;
+	// fence value the queued copies will be signalled with
+	uint64_t m_pendingFenceValue;
+
+	std::deque<Batch> m_inFlight;  // main thread only
+};
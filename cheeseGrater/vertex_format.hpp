@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cheese_grater_common.hpp>
+
+#include <vertex_quantization.hpp>
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+// Vertex formats are described once as a list of attributes; the input layout, the stride and the code that packs
+// and unpacks vertices are all derived from that list at compile time, so they cannot disagree.
+//
+//     using MyVertexFormat = VertexFormat<
+//         VertexAttribute<VertexSemantic::Position, VertexEncoding::Snorm16Position>,
+//         VertexAttribute<VertexSemantic::Color, VertexEncoding::Unorm8Color>>;
+//
+// Attributes are tightly packed in declaration order into a single stream.
+
+namespace VertexSemantic
+{
+struct Position
+{
+	static constexpr const char* NAME = "POSITION";
+};
+
+struct Normal
+{
+	static constexpr const char* NAME = "NORMAL";
+};
+
+struct Color
+{
+	static constexpr const char* NAME = "COLOR";
+};
+}
+
+namespace VertexEncoding
+{
+/// Full precision position or direction
+struct Float3
+{
+	using Source = DirectX::XMFLOAT3;
+	static constexpr DXGI_FORMAT FORMAT = DXGI_FORMAT_R32G32B32_FLOAT;
+	static constexpr UINT SIZE = 12;
+
+	static void Encode(const Source& value, const PositionQuantization& /*quantization*/, uint8_t* destination)
+	{
+		std::memcpy(destination, &value, SIZE);
+	}
+
+	static Source Decode(const uint8_t* source, const PositionQuantization& /*quantization*/)
+	{
+		Source value;
+		std::memcpy(&value, source, SIZE);
+		return value;
+	}
+};
+
+/// Position relative to the mesh bounds. The shader reads it in [-1, 1]: fold the PositionQuantization scale and bias
+/// into the model matrix. w is stored as 1.
+struct Snorm16Position
+{
+	using Source = DirectX::XMFLOAT3;
+	static constexpr DXGI_FORMAT FORMAT = DXGI_FORMAT_R16G16B16A16_SNORM;  // there is no three component 16 bit format
+	static constexpr UINT SIZE = 8;
+
+	static void Encode(const Source& value, const PositionQuantization& quantization, uint8_t* destination)
+	{
+		const int16_t encoded[4] = {
+			EncodeSnorm16((value.x - quantization.bias[0]) / quantization.scale[0]),
+			EncodeSnorm16((value.y - quantization.bias[1]) / quantization.scale[1]),
+			EncodeSnorm16((value.z - quantization.bias[2]) / quantization.scale[2]),
+			INT16_MAX
+		};
+		std::memcpy(destination, encoded, SIZE);
+	}
+
+	static Source Decode(const uint8_t* source, const PositionQuantization& quantization)
+	{
+		int16_t encoded[4];
+		std::memcpy(encoded, source, SIZE);
+		return Source(
+			DecodeSnorm16(encoded[0]) * quantization.scale[0] + quantization.bias[0],
+			DecodeSnorm16(encoded[1]) * quantization.scale[1] + quantization.bias[1],
+			DecodeSnorm16(encoded[2]) * quantization.scale[2] + quantization.bias[2]);
+	}
+};
+
+/// RGB color in [0, 1], alpha is stored as 1
+struct Unorm8Color
+{
+	using Source = DirectX::XMFLOAT3;
+	static constexpr DXGI_FORMAT FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM;
+	static constexpr UINT SIZE = 4;
+
+	static void Encode(const Source& value, const PositionQuantization& /*quantization*/, uint8_t* destination)
+	{
+		destination[0] = EncodeUnorm8(value.x);
+		destination[1] = EncodeUnorm8(value.y);
+		destination[2] = EncodeUnorm8(value.z);
+		destination[3] = UINT8_MAX;
+	}
+
+	static Source Decode(const uint8_t* source, const PositionQuantization& /*quantization*/)
+	{
+		return Source(DecodeUnorm8(source[0]), DecodeUnorm8(source[1]), DecodeUnorm8(source[2]));
+	}
+};
+
+/// Unit vector in octahedral mapping, the shader has to decode it the way DecodeOctahedral does
+struct OctahedralNormal
+{
+	using Source = DirectX::XMFLOAT3;
+	static constexpr DXGI_FORMAT FORMAT = DXGI_FORMAT_R16G16_SNORM;
+	static constexpr UINT SIZE = 4;
+
+	static void Encode(const Source& value, const PositionQuantization& /*quantization*/, uint8_t* destination)
+	{
+		float octahedral[2];
+		EncodeOctahedral(&value.x, octahedral);
+		const int16_t encoded[2] = { EncodeSnorm16(octahedral[0]), EncodeSnorm16(octahedral[1]) };
+		std::memcpy(destination, encoded, SIZE);
+	}
+
+	static Source Decode(const uint8_t* source, const PositionQuantization& /*quantization*/)
+	{
+		int16_t encoded[2];
+		std::memcpy(encoded, source, SIZE);
+		const float octahedral[2] = { DecodeSnorm16(encoded[0]), DecodeSnorm16(encoded[1]) };
+		Source value;
+		DecodeOctahedral(octahedral, &value.x);
+		return value;
+	}
+};
+}
+
+/// One attribute of a vertex format: what it means to the shader and how it is stored
+template <typename Semantic, typename Encoding, UINT SemanticIndex = 0>
+struct VertexAttribute : Encoding
+{
+	static constexpr const char* SEMANTIC = Semantic::NAME;
+	static constexpr UINT SEMANTIC_INDEX = SemanticIndex;
+};
+
+template <typename... Attributes>
+class VertexFormat
+{
+public:
+	static constexpr UINT ATTRIBUTE_COUNT = sizeof...(Attributes);
+	static constexpr UINT STRIDE = (Attributes::SIZE + ...);
+
+	/// @returns Byte offset of an attribute inside a vertex
+	static constexpr UINT GetOffset(size_t attribute)
+	{
+		constexpr UINT sizes[] = { Attributes::SIZE... };
+		UINT offset = 0;
+		for (size_t i = 0; i < attribute; i++)
+		{
+			offset += sizes[i];
+		}
+		return offset;
+	}
+
+	static constexpr std::array<D3D12_INPUT_ELEMENT_DESC, ATTRIBUTE_COUNT> GetInputElements(UINT inputSlot = 0)
+	{
+		return MakeInputElements(inputSlot, std::index_sequence_for<Attributes...>());
+	}
+
+	/// Encode one vertex into STRIDE bytes, values are given in attribute order
+	static void Pack(uint8_t* destination, const PositionQuantization& quantization, const typename Attributes::Source&... values)
+	{
+		PackAttributes(destination, quantization, std::index_sequence_for<Attributes...>(), values...);
+	}
+
+	/// Decode one vertex, values are written in attribute order
+	static void Unpack(const uint8_t* source, const PositionQuantization& quantization, typename Attributes::Source&... values)
+	{
+		UnpackAttributes(source, quantization, std::index_sequence_for<Attributes...>(), values...);
+	}
+
+private:
+	template <size_t... Indices>
+	static constexpr std::array<D3D12_INPUT_ELEMENT_DESC, ATTRIBUTE_COUNT> MakeInputElements(UINT inputSlot, std::index_sequence<Indices...>)
+	{
+		return { {
+			{ Attributes::SEMANTIC, Attributes::SEMANTIC_INDEX, Attributes::FORMAT, inputSlot, GetOffset(Indices),
+				D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }...
+		} };
+	}
+
+	template <size_t... Indices>
+	static void PackAttributes(uint8_t* destination, const PositionQuantization& quantization, std::index_sequence<Indices...>,
+		const typename Attributes::Source&... values)
+	{
+		(Attributes::Encode(values, quantization, destination + GetOffset(Indices)), ...);
+	}
+
+	template <size_t... Indices>
+	static void UnpackAttributes(const uint8_t* source, const PositionQuantization& quantization, std::index_sequence<Indices...>,
+		typename Attributes::Source&... values)
+	{
+		((values = Attributes::Decode(source + GetOffset(Indices), quantization)), ...);
+	}
+};
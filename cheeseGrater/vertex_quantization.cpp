@@ -0,0 +1,109 @@
+#include "vertex_quantization.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// keeps flat meshes from dividing by zero
+const float g_minQuantizationExtent = 1e-6f;
+
+float SignNotZero(float value)
+{
+	return (value >= 0.f) ? 1.f : -1.f;
+}
+}
+
+PositionQuantization ComputePositionQuantization(const MeshPositions& positions)
+{
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < positions.vertexCount; v++)
+	{
+		float position[3];
+		std::memcpy(position, reinterpret_cast<const uint8_t*>(positions.data) + v * positions.stride, sizeof(position));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], position[axis]);
+			maximum[axis] = std::max(maximum[axis], position[axis]);
+		}
+	}
+
+	PositionQuantization quantization = { { 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f } };
+	if (positions.vertexCount == 0)
+	{
+		return quantization;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		quantization.scale[axis] = std::max((maximum[axis] - minimum[axis]) * 0.5f, g_minQuantizationExtent);
+		quantization.bias[axis] = (maximum[axis] + minimum[axis]) * 0.5f;
+	}
+	return quantization;
+}
+
+int16_t EncodeSnorm16(float value)
+{
+	return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * INT16_MAX));
+}
+
+float DecodeSnorm16(int16_t value)
+{
+	// both -32768 and -32767 map to -1
+	return std::max(static_cast<float>(value) / INT16_MAX, -1.f);
+}
+
+uint8_t EncodeUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::lround(std::clamp(value, 0.f, 1.f) * UINT8_MAX));
+}
+
+float DecodeUnorm8(uint8_t value)
+{
+	return static_cast<float>(value) / UINT8_MAX;
+}
+
+void EncodeOctahedral(const float normal[3], float encoded[2])
+{
+	const float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	if (length <= 0.f)
+	{
+		encoded[0] = encoded[1] = 0.f;
+		return;
+	}
+
+	float x = normal[0] / length;
+	float y = normal[1] / length;
+	if (normal[2] < 0.f)
+	{
+		const float foldedX = (1.f - std::fabs(y)) * SignNotZero(x);
+		const float foldedY = (1.f - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = x;
+	encoded[1] = y;
+}
+
+void DecodeOctahedral(const float encoded[2], float normal[3])
+{
+	float x = encoded[0];
+	float y = encoded[1];
+	const float z = 1.f - std::fabs(x) - std::fabs(y);
+	if (z < 0.f)
+	{
+		const float unfoldedX = (1.f - std::fabs(y)) * SignNotZero(x);
+		const float unfoldedY = (1.f - std::fabs(x)) * SignNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	const float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
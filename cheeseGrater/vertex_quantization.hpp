@@ -0,0 +1,29 @@
+#pragma once
+
+// Scalar encodings used by the quantized vertex formats in vertex_format.hpp. Decoding follows the D3D conversion
+// rules, so Decode* returns exactly what the input assembler hands to the vertex shader.
+
+#include <mesh_simplifier.hpp>
+
+#include <cstdint>
+
+/// Maps positions into [-1, 1] per axis: position = stored * scale + bias
+struct PositionQuantization
+{
+	float scale[3];
+	float bias[3];
+};
+
+/// Fit the quantization range tightly around the bounding box of a mesh
+PositionQuantization ComputePositionQuantization(const MeshPositions& positions);
+
+int16_t EncodeSnorm16(float value);
+float DecodeSnorm16(int16_t value);
+
+uint8_t EncodeUnorm8(float value);
+float DecodeUnorm8(uint8_t value);
+
+/// Map a unit vector onto the [-1, 1] square by projecting it on an octahedron and unfolding the lower half
+void EncodeOctahedral(const float normal[3], float encoded[2]);
+/// Inverse of EncodeOctahedral, writes a normalized vector
+void DecodeOctahedral(const float encoded[2], float normal[3]);
@@ -10,6 +10,35 @@ struct VSOutput
     float4 position : SV_Position;
 };
 
+// features are always defined, to 1 or 0, by the shader compiler, see VertexShader in shader_permutation.hpp
+#if INDIRECT
+
+// layout must match indirect_draw.hpp
+struct Instance
+{
+    matrix world;
+    float4 boundingSphere;
+    uint meshIndex;
+    uint3 padding;
+};
+
+struct DrawConstants
+{
+    uint instanceIndex;
+};
+
+struct ViewProjection
+{
+    matrix viewProjMatrix;
+};
+
+// written per draw by the command signature
+ConstantBuffer<DrawConstants> DrawConstantsCB : register(b0);
+ConstantBuffer<ViewProjection> ViewProjectionCB : register(b1);
+StructuredBuffer<Instance> Instances : register(t0);
+
+#else
+
 struct ModelViewProjection
 {
     matrix modelViewProjMatrix;
@@ -17,10 +46,18 @@ struct ModelViewProjection
 
 ConstantBuffer<ModelViewProjection> ModelViewProjectionCB : register(b0);
 
+#endif
+
 VSOutput main(VSInput i)
 {
     VSOutput o;
+#if INDIRECT
+    Instance instance = Instances[DrawConstantsCB.instanceIndex];
+    float4 worldPosition = mul(instance.world, float4(i.position, 1.f));
+    o.position = mul(ViewProjectionCB.viewProjMatrix, worldPosition);
+#else
     o.position = mul(ModelViewProjectionCB.modelViewProjMatrix, float4(i.position, 1.f));
+#endif
     o.color = float4(i.color, 1.f);
     return o;
-}
+}
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <application.hpp>
 #include <command_queue.hpp>
 #include <game.hpp>
+#include <input_recording.hpp>
+#include <profiler.hpp>
+#include <resource_state_tracker.hpp>
 
 
 Window::Window(HWND hwnd, const std::wstring& windowName, int width, int height, bool vSync)
@@ -13,6 +16,13 @@ Window::Window(HWND hwnd, const std::wstring& windowName, int width, int height,
 	, m_frameCounter(0)
 	, m_fullscreen(false)
 	, m_vSync(vSync)
+	, m_fenceValues{ 0 }
+	, m_frameLatencyWaitableObject(nullptr)
+	, m_frameReady(false)
+	, m_inputState{ }
+	, m_reportedInputDrops(0)
+	, m_elapsedTime(0.)
+	, m_totalTime(0.)
 {
 	Application& app = Application::Get();
 
@@ -37,68 +47,145 @@ void Window::RegisterCallbacks(std::shared_ptr<Game> game)
 
 void Window::OnUpdate(UpdateEventArgs& e)
 {
+	e.ElapsedTime = m_elapsedTime;
+	e.TotalTime = m_totalTime;
 	if (auto game = m_game.lock())
 	{
 		m_frameCounter++;
 
+		PROFILE_SCOPE("Game::OnUpdate");
 		game->OnUpdate(e);
 	}
 }
 
 void Window::OnRender(RenderEventArgs& e)
 {
+	e.ElapsedTime = m_elapsedTime;
+	e.TotalTime = m_totalTime;
 	if (auto game = m_game.lock())
 	{
+		PROFILE_SCOPE("Game::OnRender");
 		game->OnRender(e);
 	}
 }
 
-void Window::OnKeyPressed(KeyEventArgs& e)
+void Window::PushInput(const InputEvent& event)
 {
-	if (auto game = m_game.lock())
-	{
-		game->OnKeyPressed(e);
-	}
+	m_inputQueue.Push(event);
 }
 
-void Window::OnKeyReleased(KeyEventArgs& e)
+void Window::ProcessInput()
 {
-	if (auto game = m_game.lock())
+	PROFILE_SCOPE("Window::ProcessInput");
+
+	const auto now = std::chrono::steady_clock::now();
+	const double measuredTime = (m_lastFrameTime == std::chrono::steady_clock::time_point()) ? 0.
+		: std::chrono::duration<double>(now - m_lastFrameTime).count();
+	m_lastFrameTime = now;
+	m_elapsedTime = measuredTime;
+
+	m_rawInput.clear();
+	m_inputQueue.Drain(m_rawInput);
+	if (m_inputPlayer)
+	{
+		// live input is dropped, the game only sees the recording
+		if (!m_inputPlayer->NextFrame(measuredTime, m_rawInput, m_elapsedTime))
+		{
+			::OutputDebugStringA(m_inputPlayer->GetReport().c_str());
+			m_inputPlayer.reset();
+			m_rawInput.clear();
+			Application::Get().Quit(0);
+		}
+	}
+	else if (m_inputRecorder)
 	{
-		game->OnKeyReleased(e);
+		m_inputRecorder->AddFrame(m_elapsedTime, m_rawInput);
 	}
-}
+	m_totalTime += m_elapsedTime;
 
-void Window::OnMouseMoved(MouseMotionEventArgs& e)
-{
-	if (auto game = m_game.lock())
+	int lastX = m_inputState.x;
+	int lastY = m_inputState.y;
+	m_inputEvents.clear();
+	ApplyInput(m_inputState, m_rawInput, m_inputEvents);
+
+	const uint32_t droppedCount = m_inputQueue.GetDroppedCount();
+	if (droppedCount != m_reportedInputDrops)
 	{
-		game->OnMouseMoved(e);
+		char buffer[128];
+		sprintf_s(buffer, "Input queue was full, %u input events dropped\n", droppedCount - m_reportedInputDrops);
+		::OutputDebugStringA(buffer);
+		m_reportedInputDrops = droppedCount;
 	}
-}
 
-void Window::OnMouseButtonPressed(MouseButtonEventArgs& e)
-{
-	if (auto game = m_game.lock())
+	for (const InputEvent& event : m_inputEvents)
 	{
-		game->OnMouseButtonPressed(e);
+		const bool shift = (event.modifiers & InputModifier::Shift) != 0;
+		const bool control = (event.modifiers & InputModifier::Control) != 0;
+		const bool alt = (event.modifiers & InputModifier::Alt) != 0;
+		const bool lButton = (event.modifiers & InputModifier::LeftButton) != 0;
+		const bool mButton = (event.modifiers & InputModifier::MiddleButton) != 0;
+		const bool rButton = (event.modifiers & InputModifier::RightButton) != 0;
+
+		switch (event.type)
+		{
+		case InputEventType::KeyPressed:
+		case InputEventType::KeyReleased:
+		{
+			const auto state = (event.type == InputEventType::KeyPressed) ? KeyEventArgs::Pressed : KeyEventArgs::Released;
+			KeyEventArgs keyEventArgs(static_cast<KeyCode::Key>(event.code), event.character, state, control, shift, alt);
+			m_events.Publish(keyEventArgs);
+		}
+		break;
+		case InputEventType::MouseMoved:
+		{
+			MouseMotionEventArgs mouseMotionEventArgs(lButton, mButton, rButton, control, shift, event.x, event.y);
+			mouseMotionEventArgs.RelX = event.x - lastX;
+			mouseMotionEventArgs.RelY = event.y - lastY;
+			lastX = event.x;
+			lastY = event.y;
+			m_events.Publish(mouseMotionEventArgs);
+		}
+		break;
+		case InputEventType::MouseButtonPressed:
+		case InputEventType::MouseButtonReleased:
+		{
+			const auto button = static_cast<MouseButtonEventArgs::MouseButton>(event.code);
+			const auto state = (event.type == InputEventType::MouseButtonPressed) ? MouseButtonEventArgs::Pressed : MouseButtonEventArgs::Released;
+			MouseButtonEventArgs mouseButtonEventArgs(button, state, lButton, mButton, rButton, control, shift, event.x, event.y);
+			m_events.Publish(mouseButtonEventArgs);
+		}
+		break;
+		case InputEventType::MouseWheel:
+		{
+			MouseWheelEventArgs mouseWheelEventArgs(event.wheelDelta, lButton, mButton, rButton, control, shift, event.x, event.y);
+			m_events.Publish(mouseWheelEventArgs);
+		}
+		break;
+		default:
+			break;
+		}
 	}
 }
 
-void Window::OnMouseButtonReleased(MouseButtonEventArgs& e)
+WindowEvents& Window::GetEvents()
 {
-	if (auto game = m_game.lock())
-	{
-		game->OnMouseButtonReleased(e);
-	}
+	return m_events;
 }
 
-void Window::OnMouseWheel(MouseWheelEventArgs& e)
+const InputState& Window::GetInputState() const
 {
-	if (auto game = m_game.lock())
-	{
-		game->OnMouseWheel(e);
-	}
+	return m_inputState;
+}
+
+void Window::RecordInput(const std::wstring& path)
+{
+	m_inputRecorder = std::make_unique<InputRecorder>(path);
+}
+
+void Window::ReplayInput(std::unique_ptr<InputPlayer> player)
+{
+	m_inputPlayer = std::move(player);
+	m_inputRecorder.reset();
 }
 
 void Window::OnResize(ResizeEventArgs& e)
@@ -112,6 +199,7 @@ void Window::OnResize(ResizeEventArgs& e)
 
 		for (int i = 0; i < BUFFER_COUNT; i++)
 		{
+			ResourceStateTracker::RemoveGlobalResourceState(m_backBuffers[i].Get());
 			m_backBuffers[i].Reset();
 		}
 
@@ -123,10 +211,7 @@ void Window::OnResize(ResizeEventArgs& e)
 		UpdateRenderTargetViews();
 	}
 
-	if (auto game = m_game.lock())
-	{
-		game->OnResize(e);
-	}
+	m_events.Publish(e);
 }
 
 Microsoft::WRL::ComPtr<IDXGISwapChain4> Window::CreateSwapChain()
@@ -155,6 +240,8 @@ Microsoft::WRL::ComPtr<IDXGISwapChain4> Window::CreateSwapChain()
 	swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
 	// it's recommended to always allow tearing if tearing support is enabled
 	swapChainDesc.Flags = m_isTearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+	// frames are paced per window with the waitable object instead of blocking in Present
+	swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
 	ID3D12CommandQueue* commandQueue = app.GetCommandQueue()->GetD3D12CommandQueue().Get();
 	Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain1;
@@ -166,6 +253,9 @@ Microsoft::WRL::ComPtr<IDXGISwapChain4> Window::CreateSwapChain()
 	ThrowIfFailed(swapChain1.As(&dxgiSwapChain4));
 	m_currentBackBufferIndex = dxgiSwapChain4->GetCurrentBackBufferIndex();
 
+	ThrowIfFailed(dxgiSwapChain4->SetMaximumFrameLatency(MAX_FRAME_LATENCY));
+	m_frameLatencyWaitableObject = dxgiSwapChain4->GetFrameLatencyWaitableObject();
+
 	return dxgiSwapChain4;
 }
 
@@ -179,6 +269,7 @@ void Window::UpdateRenderTargetViews()
 		Microsoft::WRL::ComPtr<ID3D12Resource> backBuffer;
 		ThrowIfFailed(m_swapChain->GetBuffer(i, IID_PPV_ARGS(&backBuffer)));
 		device->CreateRenderTargetView(backBuffer.Get(), nullptr, rtvHandle);
+		ResourceStateTracker::AddGlobalResourceState(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
 		m_backBuffers[i] = backBuffer;
 		rtvHandle.Offset(m_rtvDescriptorSize);
 	}
@@ -195,6 +286,19 @@ void Window::Destroy()
 	{
 		game->OnWindowDestroy();
 	}
+	if (m_inputRecorder)
+	{
+		char buffer[512];
+		sprintf_s(buffer, m_inputRecorder->Write() ? "Recorded %zu frames of input to %s\n" : "Recording of %zu frames can not be written to %s\n",
+			m_inputRecorder->GetFrameCount(), m_inputRecorder->GetPath().string().c_str());
+		::OutputDebugStringA(buffer);
+		m_inputRecorder.reset();
+	}
+	if (m_frameLatencyWaitableObject)
+	{
+		::CloseHandle(m_frameLatencyWaitableObject);
+		m_frameLatencyWaitableObject = nullptr;
+	}
 	if (m_hwnd)
 	{
 		::DestroyWindow(m_hwnd);
@@ -295,16 +399,46 @@ UINT Window::GetCurrentBackBufferIndex() const
 	return m_currentBackBufferIndex;
 }
 
-UINT Window::Present()
+UINT Window::Present(uint64_t fenceValue)
 {
+	PROFILE_SCOPE("Window::Present");
+
+	m_fenceValues[m_currentBackBufferIndex] = fenceValue;
+
 	UINT syncInterval = m_vSync ? 1 : 0;
 	UINT presentFlags = m_isTearingSupported && !m_vSync ? DXGI_PRESENT_ALLOW_TEARING : 0;
 	ThrowIfFailed(m_swapChain->Present(syncInterval, presentFlags));
 	m_currentBackBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+	m_frameReady = false;
 
 	return m_currentBackBufferIndex;
 }
 
+bool Window::IsFrameReady()
+{
+	// a successful wait consumes the signal, so it is remembered until the frame is presented
+	if (!m_frameReady)
+	{
+		m_frameReady = ::WaitForSingleObjectEx(m_frameLatencyWaitableObject, 0, FALSE) == WAIT_OBJECT_0;
+	}
+	return m_frameReady;
+}
+
+HANDLE Window::GetFrameLatencyWaitableObject() const
+{
+	return m_frameLatencyWaitableObject;
+}
+
+void Window::WaitForBackBuffer()
+{
+	Application::Get().GetCommandQueue()->WaitForFenceValue(m_fenceValues[m_currentBackBufferIndex]);
+}
+
+bool Window::HasGame() const
+{
+	return !m_game.expired();
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE Window::GetCurrentRenderTargetView() const
 {
 	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_currentBackBufferIndex, m_rtvDescriptorSize);
@@ -3,6 +3,14 @@
 #include <cheese_grater_common.hpp>
 
 #include <events.hpp>
+#include <input_queue.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class InputPlayer;
+class InputRecorder;
 
 class Game;
 
@@ -10,6 +18,7 @@ class Window
 {
 public:
 	static constexpr uint8_t BUFFER_COUNT = 3;  // number of swapchain buffers
+	static constexpr UINT MAX_FRAME_LATENCY = BUFFER_COUNT - 1;  // frames queued for presentation before the window waits
 	
 	/// @returns Handle to the window or nullptr if it is not a valid window
 	HWND GetWindowHandle() const;
@@ -34,11 +43,22 @@ public:
 
 	UINT GetCurrentBackBufferIndex() const;
 	/// Present swapchain's backbuffer to the screen 
+	/// @param fenceValue Direct queue fence value that completes the frame rendered into the backbuffer
 	/// @returns Current backbuffer index after the present
-	UINT Present();
+	UINT Present(uint64_t fenceValue);
 	
 	D3D12_CPU_DESCRIPTOR_HANDLE GetCurrentRenderTargetView() const;
 	Microsoft::WRL::ComPtr<ID3D12Resource> GetCurrentBackBuffer() const;
+
+	/// Input events and resizes, subscribers are called on the game thread
+	WindowEvents& GetEvents();
+	/// @returns Input as of the start of the current frame
+	const InputState& GetInputState() const;
+	/// Record the input and time step of every frame from now on, the file is written when the window is destroyed
+	void RecordInput(const std::wstring& path);
+	/// Replace live input and measured time steps with a recording, the application quits once it is replayed and
+	/// the replayed frame times are written to the debug output
+	void ReplayInput(std::unique_ptr<InputPlayer> player);
 protected:
 	friend LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 	// only application can create a window
@@ -53,17 +73,25 @@ protected:
 
 	virtual void OnUpdate(UpdateEventArgs& e);
 	virtual void OnRender(RenderEventArgs& e);
-	virtual void OnKeyPressed(KeyEventArgs& e);
-	virtual void OnKeyReleased(KeyEventArgs& e);
-	virtual void OnMouseMoved(MouseMotionEventArgs& e);
-	virtual void OnMouseButtonPressed(MouseButtonEventArgs& e);
-	virtual void OnMouseButtonReleased(MouseButtonEventArgs& e);
-	virtual void OnMouseWheel(MouseWheelEventArgs& e);
+
+	/// Queue an input event, called by the window procedure for every input message
+	void PushInput(const InputEvent& event);
+	/// Start a frame: take its time step, apply the input queued since the last frame to the input state and publish
+	/// its events. Called by the application once per frame before the update.
+	void ProcessInput();
 
 	void OnResize(ResizeEventArgs& e);
 	Microsoft::WRL::ComPtr<IDXGISwapChain4> CreateSwapChain();
 	void UpdateRenderTargetViews();
 
+	/// Non blocking check whether the swapchain accepts another frame. Once true it stays true until the next Present.
+	bool IsFrameReady();
+	/// Signaled by DXGI whenever the swapchain can take another frame, lets the application sleep until any window can
+	HANDLE GetFrameLatencyWaitableObject() const;
+	/// Block until the GPU no longer uses the current backbuffer and the frame resources indexed with it
+	void WaitForBackBuffer();
+	bool HasGame() const;
+
 private:
 	Window(const Window& other) = delete;
 	Window& operator=(const Window& other) = delete;
@@ -86,8 +114,27 @@ private:
 	UINT m_currentBackBufferIndex;
 	UINT m_rtvDescriptorSize;
 
+	uint64_t m_fenceValues[BUFFER_COUNT];  // per backbuffer, on the direct queue
+	HANDLE m_frameLatencyWaitableObject;
+	bool m_frameReady;
+
 	RECT m_windowRect;  // saves window size before full screen
 
+	WindowEvents m_events;
+	InputQueue m_inputQueue;
+	InputState m_inputState;
+	// reused every frame, as drained from the queue and as dispatched
+	std::vector<InputEvent> m_rawInput;
+	std::vector<InputEvent> m_inputEvents;
+	uint32_t m_reportedInputDrops;
+	std::unique_ptr<InputRecorder> m_inputRecorder;
+	std::unique_ptr<InputPlayer> m_inputPlayer;
+
+	// time steps in seconds, measured unless a recording is replayed
+	std::chrono::steady_clock::time_point m_lastFrameTime;
+	double m_elapsedTime;
+	double m_totalTime;
+
 	std::weak_ptr<Game> m_game;
 };
 
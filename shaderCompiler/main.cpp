@@ -0,0 +1,141 @@
+#include <shader_compiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+void PrintUsage()
+{
+	std::printf(
+		"usage: shaderCompiler --manifest <file> --output <archive> [options]\n"
+		"  --cache <directory>  compiled shaders are kept here between builds, <archive>.cache by default\n"
+		"  --dxc <path>         dxc executable, looked up on the PATH by default\n"
+		"  --threads <count>    compiler processes at once, one per hardware thread by default\n"
+		"  --debug              compile without optimizations and embed debug information\n"
+		"  -I <directory>       additional include directory\n");
+}
+
+/// Replace the archive through a temporary file, and only if its contents changed, so a build that changed
+/// nothing leaves the archive untouched for anything that depends on its timestamp
+bool WriteArchive(const std::filesystem::path& path, const std::vector<uint8_t>& contents)
+{
+	std::ifstream existing(path, std::ios::binary);
+	if (existing && std::equal(std::istreambuf_iterator<char>(existing), std::istreambuf_iterator<char>(),
+		contents.begin(), contents.end(), [](char a, uint8_t b) { return static_cast<uint8_t>(a) == b; }))
+	{
+		return true;
+	}
+	existing.close();
+
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		if (!file)
+		{
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+}
+
+int main(int argc, char** argv)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	std::filesystem::path manifestPath;
+	std::filesystem::path outputPath;
+	ShaderCompilerOptions options;
+	bool debug = false;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--manifest") == 0 && hasValue)
+		{
+			manifestPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+		{
+			outputPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--cache") == 0 && hasValue)
+		{
+			options.cacheDirectory = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--dxc") == 0 && hasValue)
+		{
+			options.compiler = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+		{
+			options.threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--debug") == 0)
+		{
+			debug = true;
+		}
+		else if (std::strcmp(argv[i], "-I") == 0 && hasValue)
+		{
+			options.includeDirectories.push_back(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (manifestPath.empty() || outputPath.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+	manifestPath = std::filesystem::absolute(manifestPath);
+	if (options.cacheDirectory.empty())
+	{
+		options.cacheDirectory = outputPath;
+		options.cacheDirectory += ".cache";
+	}
+	// shaders include each other relative to the manifest
+	options.includeDirectories.push_back(manifestPath.parent_path());
+	if (debug)
+	{
+		options.arguments = { "-Od", "-Zi", "-Qembed_debug" };
+	}
+	else
+	{
+		options.arguments = { "-O3" };
+	}
+
+	std::vector<ShaderDesc> shaders;
+	std::string error;
+	if (!ReadShaderManifest(manifestPath, shaders, error))
+	{
+		std::fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	ShaderCompiler compiler(options);
+	ShaderArchiveFile archive;
+	if (!compiler.Compile(shaders, archive))
+	{
+		return 1;
+	}
+	if (!WriteArchive(outputPath, archive.Serialize()))
+	{
+		std::fprintf(stderr, "%s: error: shader archive can not be written\n", outputPath.string().c_str());
+		return 1;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::printf("%u shaders compiled, %u from the cache in %.2f s\n", compiler.GetCompiledCount(), compiler.GetCachedCount(), seconds);
+	return 0;
+}
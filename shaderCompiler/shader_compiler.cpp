@@ -0,0 +1,343 @@
+#include "shader_compiler.hpp"
+
+#include <hash.hpp>
+#include <shader_permutation.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+// bump when the way keys are built changes
+const uint32_t g_keyVersion = 1;
+
+// serializes the output of the workers so compiler errors of different shaders do not interleave
+std::mutex g_outputMutex;
+
+bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& contents)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	contents.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+	return static_cast<bool>(file);
+}
+
+/// @returns File name of a cache entry, the key in hex
+std::string GetCacheName(uint64_t key, const char* extension)
+{
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return name + std::string(extension);
+}
+
+std::string Quote(const std::string& argument)
+{
+	return "\"" + argument + "\"";
+}
+
+int RunCommand(const std::string& command)
+{
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of a command that starts with one, which would unquote the compiler path
+	return std::system(Quote(command).c_str());
+#else
+	return std::system(command.c_str());
+#endif
+}
+
+/// Turn a shader of ShaderPermutations into the permutation its feature defines select: every feature is defined to 1
+/// or 0, and the name becomes the one the engine looks the permutation up by. Other shaders are left as they are.
+void SelectPermutation(ShaderDesc& shader)
+{
+	for (const ShaderPermutationDesc& permutation : ShaderPermutations::DESCS)
+	{
+		if (shader.name != permutation.name)
+		{
+			continue;
+		}
+
+		ShaderFeatures features = 0;
+		for (uint32_t i = 0; i < permutation.featureCount; i++)
+		{
+			const auto define = std::find(shader.defines.begin(), shader.defines.end(), permutation.defines[i]);
+			if (define != shader.defines.end())
+			{
+				features |= 1u << i;
+				shader.defines.erase(define);
+			}
+		}
+		for (uint32_t i = 0; i < permutation.featureCount; i++)
+		{
+			shader.defines.push_back(std::string(permutation.defines[i]) + ((features & (1u << i)) ? "=1" : "=0"));
+		}
+		shader.name = GetPermutationName(permutation, features);
+		return;
+	}
+}
+
+/// Hash the contents of a file and, depth first, of every file it includes. Includes are resolved like the compiler
+/// does: next to the including file first, then in the include directories. An include that is not found only adds its
+/// name, the compiler reports it.
+void HashSource(Hasher& hasher, const std::filesystem::path& path, const std::vector<std::filesystem::path>& includeDirectories,
+	std::set<std::filesystem::path>& visited)
+{
+	if (!visited.insert(std::filesystem::weakly_canonical(path)).second)
+	{
+		return;
+	}
+
+	std::vector<uint8_t> contents;
+	if (!ReadFile(path, contents))
+	{
+		hasher.AddString(path.generic_string().c_str());
+		return;
+	}
+	hasher.Add(contents.size()).Add(contents.data(), contents.size());
+
+	// conditional includes are hashed too, which at worst recompiles a shader that did not need it
+	std::istringstream lines(std::string(contents.begin(), contents.end()));
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		const size_t hash = line.find_first_not_of(" \t");
+		if (hash == std::string::npos || line[hash] != '#')
+		{
+			continue;
+		}
+		const size_t directive = line.find_first_not_of(" \t", hash + 1);
+		if (directive == std::string::npos || line.compare(directive, 7, "include") != 0)
+		{
+			continue;
+		}
+		const size_t open = line.find_first_of("\"<", directive + 7);
+		const size_t close = (open != std::string::npos) ? line.find_first_of("\">", open + 1) : std::string::npos;
+		if (close == std::string::npos)
+		{
+			continue;
+		}
+
+		const std::filesystem::path include = line.substr(open + 1, close - open - 1);
+		std::filesystem::path resolved = path.parent_path() / include;
+		for (size_t i = 0; i < includeDirectories.size() && !std::filesystem::exists(resolved); i++)
+		{
+			resolved = includeDirectories[i] / include;
+		}
+		HashSource(hasher, resolved, includeDirectories, visited);
+	}
+}
+}
+
+bool ReadShaderManifest(const std::filesystem::path& path, std::vector<ShaderDesc>& shaders, std::string& error)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = path.string() + ": error: shader manifest can not be read";
+		return false;
+	}
+
+	std::string line;
+	for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream tokens(line);
+		ShaderDesc shader;
+		std::string source;
+		if (!(tokens >> shader.name))
+		{
+			continue;
+		}
+		if (!(tokens >> source >> shader.profile >> shader.entryPoint))
+		{
+			error = path.string() + "(" + std::to_string(lineNumber) + "): error: expected name, source, profile and entry point";
+			return false;
+		}
+		shader.source = path.parent_path() / source;
+		for (std::string define; tokens >> define;)
+		{
+			shader.defines.push_back(define);
+		}
+		SelectPermutation(shader);
+		shaders.push_back(std::move(shader));
+	}
+	return true;
+}
+
+ShaderCompiler::ShaderCompiler(ShaderCompilerOptions options)
+	: m_options(std::move(options))
+	, m_compiledCount(0)
+	, m_cachedCount(0)
+{
+}
+
+bool ShaderCompiler::Compile(const std::vector<ShaderDesc>& shaders, ShaderArchiveFile& archive)
+{
+	m_compiledCount = 0;
+	m_cachedCount = 0;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_options.cacheDirectory, error);
+	const std::string compilerVersion = GetCompilerVersion();
+	if (compilerVersion.empty())
+	{
+		std::fprintf(stderr, "error: %s can not be run\n", m_options.compiler.string().c_str());
+		return false;
+	}
+
+	std::vector<std::vector<uint8_t>> bytecode(shaders.size());
+	std::atomic<size_t> nextShader = 0;
+	std::atomic<uint32_t> compiledCount = 0;
+	std::atomic<bool> failed = false;
+
+	// dxc compiles on a single thread, so one process per core keeps every core busy
+	auto worker = [&]()
+		{
+			for (size_t i = nextShader++; i < shaders.size(); i = nextShader++)
+			{
+				const uint64_t key = GetKey(shaders[i], compilerVersion);
+				if (ReadFile(m_options.cacheDirectory / GetCacheName(key, ".dxil"), bytecode[i]))
+				{
+					continue;
+				}
+				if (!Build(shaders[i], key, i, bytecode[i]))
+				{
+					failed = true;
+				}
+				compiledCount++;
+			}
+		};
+
+	const uint32_t threadCount = std::max(1u, std::min(m_options.threadCount ? m_options.threadCount
+		: std::thread::hardware_concurrency(), static_cast<uint32_t>(shaders.size())));
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	m_compiledCount = compiledCount;
+	m_cachedCount = static_cast<uint32_t>(shaders.size()) - m_compiledCount;
+	if (failed)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		if (!archive.Add(shaders[i].name, std::move(bytecode[i])))
+		{
+			std::fprintf(stderr, "error: shader %s is in the manifest twice, or its name hashes like another one\n",
+				shaders[i].name.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t ShaderCompiler::GetCompiledCount() const
+{
+	return m_compiledCount;
+}
+
+uint32_t ShaderCompiler::GetCachedCount() const
+{
+	return m_cachedCount;
+}
+
+std::string ShaderCompiler::GetCompilerVersion() const
+{
+	const std::filesystem::path output = m_options.cacheDirectory / "compiler_version.txt";
+	if (RunCommand(Quote(m_options.compiler.string()) + " --version > " + Quote(output.string()) + " 2>&1") != 0)
+	{
+		return { };
+	}
+
+	std::vector<uint8_t> version;
+	ReadFile(output, version);
+	return std::string(version.begin(), version.end());
+}
+
+uint64_t ShaderCompiler::GetKey(const ShaderDesc& shader, const std::string& compilerVersion) const
+{
+	Hasher hasher;
+	hasher.Add(g_keyVersion).AddString(compilerVersion.c_str()).AddString(shader.profile.c_str())
+		.AddString(shader.entryPoint.c_str());
+	hasher.Add(shader.defines.size());
+	for (const std::string& define : shader.defines)
+	{
+		hasher.AddString(define.c_str());
+	}
+	hasher.Add(m_options.arguments.size());
+	for (const std::string& argument : m_options.arguments)
+	{
+		hasher.AddString(argument.c_str());
+	}
+
+	std::set<std::filesystem::path> visited;
+	HashSource(hasher, shader.source, m_options.includeDirectories, visited);
+	return hasher.Get();
+}
+
+bool ShaderCompiler::Build(const ShaderDesc& shader, uint64_t key, size_t index, std::vector<uint8_t>& bytecode)
+{
+	// per manifest entry, two entries with the same key may be compiled at the same time
+	const std::string suffix = "." + std::to_string(index);
+	const std::filesystem::path output = m_options.cacheDirectory / GetCacheName(key, ".dxil");
+	const std::filesystem::path temporary = m_options.cacheDirectory / GetCacheName(key, (suffix + ".tmp").c_str());
+	const std::filesystem::path log = m_options.cacheDirectory / GetCacheName(key, (suffix + ".log").c_str());
+
+	std::string command = Quote(m_options.compiler.string()) + " -nologo -T " + shader.profile + " -E " + Quote(shader.entryPoint);
+	for (const std::string& define : shader.defines)
+	{
+		command += " -D " + Quote(define);
+	}
+	for (const std::filesystem::path& directory : m_options.includeDirectories)
+	{
+		command += " -I " + Quote(directory.string());
+	}
+	for (const std::string& argument : m_options.arguments)
+	{
+		command += " " + argument;
+	}
+	command += " -Fo " + Quote(temporary.string()) + " " + Quote(shader.source.string()) + " > " + Quote(log.string()) + " 2>&1";
+
+	const bool succeeded = RunCommand(command) == 0 && ReadFile(temporary, bytecode);
+	std::vector<uint8_t> messages;
+	ReadFile(log, messages);
+	{
+		std::lock_guard<std::mutex> lock(g_outputMutex);
+		// warnings are shown for successful compilations as well
+		FILE* stream = succeeded ? stdout : stderr;
+		std::fprintf(stream, "%s (%s)\n", shader.name.c_str(), shader.source.filename().string().c_str());
+		std::fwrite(messages.data(), 1, messages.size(), stream);
+		std::fflush(stream);
+	}
+
+	std::error_code error;
+	std::filesystem::remove(log, error);
+	if (!succeeded)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	// renamed once complete, so an interrupted build never leaves a truncated shader in the cache
+	std::filesystem::rename(temporary, output, error);
+	return true;
+}
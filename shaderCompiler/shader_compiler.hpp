@@ -0,0 +1,72 @@
+#pragma once
+
+// Offline shader build: compiles the shaders of a manifest with DXC, one compiler process per core, and packs the
+// bytecode into a shader archive. Every output is cached under a hash of everything that affects it (source,
+// included files, profile, entry point, defines, arguments and the compiler version), so only shaders whose inputs
+// changed are compiled again. Plain C++ without platform headers, runs wherever DXC does.
+
+#include <shader_archive_file.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// One entry of the shader manifest
+struct ShaderDesc
+{
+	// the engine looks the bytecode up by this name
+	std::string name;
+	std::filesystem::path source;
+	// target profile, "vs_6_0" for example
+	std::string profile;
+	std::string entryPoint;
+	// NAME or NAME=VALUE
+	std::vector<std::string> defines;
+};
+
+struct ShaderCompilerOptions
+{
+	/// Path of the dxc executable, looked up on the PATH if it has no directory
+	std::filesystem::path compiler = "dxc";
+	std::filesystem::path cacheDirectory;
+	std::vector<std::filesystem::path> includeDirectories;
+	/// Passed to every compilation, part of the cache key
+	std::vector<std::string> arguments;
+	/// 0 uses a compiler process per hardware thread
+	uint32_t threadCount = 0;
+};
+
+/// Read a manifest: one shader per line as "name source profile entryPoint [defines...]", '#' starts a comment.
+/// Sources are relative to the manifest. A shader of ShaderPermutations is listed once per permutation, the defines of
+/// its features select which one, and is named like the engine looks that permutation up.
+/// @returns False with a message in the compiler error format if the manifest can not be read or is malformed
+bool ReadShaderManifest(const std::filesystem::path& path, std::vector<ShaderDesc>& shaders, std::string& error);
+
+class ShaderCompiler
+{
+public:
+	explicit ShaderCompiler(ShaderCompilerOptions options);
+
+	/// Compile the shaders that are not cached yet in parallel and add every shader to the archive. Compiler errors
+	/// are printed as they happen.
+	/// @returns False if the compiler could not be run or any shader failed to compile
+	bool Compile(const std::vector<ShaderDesc>& shaders, ShaderArchiveFile& archive);
+
+	/// @returns Shaders compiled and shaders taken from the cache by the last Compile
+	uint32_t GetCompiledCount() const;
+	uint32_t GetCachedCount() const;
+
+private:
+	/// @returns Output of "dxc --version", empty if the compiler can not be run
+	std::string GetCompilerVersion() const;
+	/// @returns Cache key of a shader, hashing the source and everything it includes
+	uint64_t GetKey(const ShaderDesc& shader, const std::string& compilerVersion) const;
+	/// Compile a shader into the cache unless it is there already
+	/// @returns False if compiling failed, the compiler output is printed
+	bool Build(const ShaderDesc& shader, uint64_t key, size_t index, std::vector<uint8_t>& bytecode);
+
+	ShaderCompilerOptions m_options;
+	uint32_t m_compiledCount;
+	uint32_t m_cachedCount;
+};
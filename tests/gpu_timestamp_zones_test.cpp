@@ -0,0 +1,125 @@
+// Gpu zone bookkeeping without a gpu: zones are begun in fake command lists, submitted with fence values and resolved
+// from synthetic timestamps, then looked up in the profiler's trace.
+
+#include <gpu_timestamp_zones.hpp>
+#include <profiler.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+namespace
+{
+int g_failures = 0;
+
+void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::printf("FAILED: %s\n", what);
+		g_failures++;
+	}
+}
+
+/// @returns Duration in microseconds of the first zone with a name in a Chrome trace, negative if there is none
+double FindZoneDuration(const std::string& trace, const char* name)
+{
+	const size_t zone = trace.find("{\"name\":\"" + std::string(name) + "\",\"ph\":\"X\"");
+	if (zone == std::string::npos)
+	{
+		return -1.;
+	}
+	const size_t duration = trace.find("\"dur\":", zone);
+	return std::atof(trace.c_str() + duration + 6);
+}
+
+void TestCalibration()
+{
+	const GpuClockCalibration calibration = { 1000, 5000, 1e6, 3e6 };
+	Check(ToCpuTimestamp(calibration, 1100) == 5300, "gpu ticks are scaled to cpu ticks");
+	Check(ToCpuTimestamp(calibration, 900) == 4700, "timestamps before the calibration");
+}
+
+void TestRing()
+{
+	// the command lists are only compared, never dereferenced
+	const int commandLists[4] = { };
+	const void* const a = &commandLists[0];
+	const void* const b = &commandLists[1];
+	const void* const c = &commandLists[2];
+	const void* const d = &commandLists[3];
+
+	GpuTimestampZones zones(8, Profiler::AddTrack("Ring test"));
+	Check(zones.Begin("A0", a) == 0 && zones.Begin("A1", a) == 2 && zones.Begin("B0", b) == 4 && zones.Begin("C0", c) == 6,
+		"zones take consecutive pairs of queries");
+	Check(zones.Begin("Full", d) == GpuTimestampZones::INVALID_ZONE, "no zone once every query is in flight");
+	Check(GpuTimestampZones::GetEndQuery(4) == 5, "a zone ends on the query after its first");
+
+	std::vector<GpuQueryRange> ranges;
+	const void* const submitted[] = { a, b };
+	zones.Submit(submitted, 2, 1, ranges);
+	Check(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].count == 6, "consecutive zones are resolved together");
+	Check(!zones.IsResolvable(0) && zones.IsResolvable(1), "zones are resolvable once their fence value completed");
+
+	const uint64_t timestamps[8] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+	const GpuClockCalibration calibration = { 0, Profiler::GetTimestamp(), 1e6, Profiler::GetTimestampFrequency() };
+	zones.Resolve(1, timestamps, calibration);
+	Check(zones.GetPendingCount() == 1, "the executed zones are resolved");
+
+	// the ring wraps, a zone still being recorded in c holds back the zone after it
+	Check(zones.Begin("D0", d) == 0, "released queries are reused from the start of the ring");
+	ranges.clear();
+	zones.Submit(&d, 1, 2, ranges);
+	zones.Resolve(2, timestamps, calibration);
+	Check(zones.GetPendingCount() == 2 && !zones.IsResolvable(2), "queries are released in the order they were handed out");
+	zones.Submit(&c, 1, 3, ranges);
+	Check(ranges.size() == 2 && ranges[1].first == 6 && ranges[1].count == 2, "zones at the end of the ring are resolved on their own");
+	zones.Resolve(3, timestamps, calibration);
+	Check(zones.GetPendingCount() == 0, "all zones are resolved");
+}
+
+void TestTrace()
+{
+	const uint32_t track = Profiler::AddTrack("Graphics queue");
+	GpuTimestampZones zones(16, track);
+	const int commandList = 0;
+	zones.Begin("Shadows", &commandList);
+	zones.Begin("Lighting", &commandList);
+	zones.Begin("Clock jump", &commandList);
+	std::vector<GpuQueryRange> ranges;
+	const void* const submitted = &commandList;
+	zones.Submit(&submitted, 1, 1, ranges);
+
+	// a gpu clock of 1 MHz, so gpu ticks are microseconds; the zones run right after the calibration
+	const GpuClockCalibration calibration = { 1000000, Profiler::GetTimestamp(), 1e6, Profiler::GetTimestampFrequency() };
+	const uint64_t timestamps[6] = { 1000100, 1000350, 1000400, 1001400, 1002000, 1001000 };
+	zones.Resolve(1, timestamps, calibration);
+
+	const std::string trace = Profiler::GetChromeTrace();
+	Check(trace.find("\"args\":{\"name\":\"Graphics queue\"}") != std::string::npos, "the queue has its own track in the trace");
+	const double shadows = FindZoneDuration(trace, "Shadows");
+	const double lighting = FindZoneDuration(trace, "Lighting");
+	// the profiler estimates its frequency again for the export
+	Check(std::fabs(shadows - 250.) < 2.5, "gpu zone duration in the trace");
+	Check(std::fabs(lighting - 1000.) < 10., "gpu zone duration in the trace");
+	Check(FindZoneDuration(trace, "Clock jump") < 0., "zones ending before they start are left out");
+	std::printf("gpu zones in the trace: Shadows %.3f us (250), Lighting %.3f us (1000)\n", shadows, lighting);
+}
+}
+
+int main()
+{
+	// long enough for the profiler to estimate its timestamp frequency
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	Profiler::SetEnabled(true);
+
+	TestCalibration();
+	TestRing();
+	TestTrace();
+
+	std::printf(g_failures ? "%d checks failed\n" : "all checks passed\n", g_failures);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+// Round trips of the quantized vertex encodings against their error bounds.
+
+#include <vertex_quantization.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+int g_failures = 0;
+
+void Check(bool condition, const char* what, double value, double bound)
+{
+	if (!condition)
+	{
+		std::printf("FAILED: %s (%g, bound %g)\n", what, value, bound);
+		g_failures++;
+	}
+}
+
+void TestSnorm16()
+{
+	// rounding to the nearest of 32767 steps per unit
+	const double bound = 0.5 / INT16_MAX + 1e-7;
+	double maxError = 0.;
+	for (int i = -200000; i <= 200000; i++)
+	{
+		const float value = static_cast<float>(i) / 200000.f;
+		maxError = std::max(maxError, static_cast<double>(std::fabs(DecodeSnorm16(EncodeSnorm16(value)) - value)));
+	}
+	Check(maxError <= bound, "snorm16 round trip", maxError, bound);
+
+	Check(EncodeSnorm16(1.f) == INT16_MAX && EncodeSnorm16(-1.f) == -INT16_MAX, "snorm16 encodes the ends exactly", 0., 0.);
+	Check(DecodeSnorm16(INT16_MIN) == -1.f, "snorm16 decodes -32768 to -1", DecodeSnorm16(INT16_MIN), -1.);
+	Check(EncodeSnorm16(2.f) == INT16_MAX && EncodeSnorm16(-2.f) == -INT16_MAX, "snorm16 clamps", 0., 0.);
+	std::printf("snorm16 max error %g (bound %g)\n", maxError, bound);
+}
+
+void TestPositions()
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-100.f, 250.f);
+	std::vector<float> positions(3 * 10000);
+	for (float& coordinate : positions)
+	{
+		coordinate = distribution(random);
+	}
+	// a flat mesh must not divide by zero
+	for (size_t v = 0; v < positions.size(); v += 3)
+	{
+		positions[v + 2] = 5.f;
+	}
+
+	const PositionQuantization quantization = ComputePositionQuantization({ positions.data(), positions.size() / 3, 3 * sizeof(float) });
+	bool withinBound = true;
+	double worstRatio = 0.;
+	for (size_t v = 0; v < positions.size(); v += 3)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float position = positions[v + axis];
+			const int16_t encoded = EncodeSnorm16((position - quantization.bias[axis]) / quantization.scale[axis]);
+			const float decoded = DecodeSnorm16(encoded) * quantization.scale[axis] + quantization.bias[axis];
+			// half a step of the range, plus float rounding of the bias
+			const double bound = quantization.scale[axis] * (0.5 / INT16_MAX) + std::fabs(position) * 1e-6 + 1e-6;
+			const double error = std::fabs(decoded - position);
+			withinBound = withinBound && error <= bound;
+			worstRatio = std::max(worstRatio, error / bound);
+		}
+	}
+	Check(withinBound, "snorm16 positions within half a step of their range", worstRatio, 1.);
+	std::printf("snorm16 positions worst error %.3f of the bound\n", worstRatio);
+}
+
+void TestUnorm8()
+{
+	const double bound = 0.5 / UINT8_MAX + 1e-7;
+	double maxError = 0.;
+	for (int i = 0; i <= 100000; i++)
+	{
+		const float value = static_cast<float>(i) / 100000.f;
+		maxError = std::max(maxError, static_cast<double>(std::fabs(DecodeUnorm8(EncodeUnorm8(value)) - value)));
+	}
+	Check(maxError <= bound, "unorm8 round trip", maxError, bound);
+
+	bool exact = true;
+	for (int stored = 0; stored <= UINT8_MAX; stored++)
+	{
+		exact = exact && EncodeUnorm8(DecodeUnorm8(static_cast<uint8_t>(stored))) == stored;
+	}
+	Check(exact, "unorm8 stored values survive a round trip", 0., 0.);
+	Check(EncodeUnorm8(-1.f) == 0 && EncodeUnorm8(2.f) == UINT8_MAX, "unorm8 clamps", 0., 0.);
+	std::printf("unorm8 max error %g (bound %g)\n", maxError, bound);
+}
+
+double AngleDegrees(const float a[3], const float b[3])
+{
+	// acos of a dot product this close to 1 would measure float rounding, not the encoding
+	const double cross[3] = { static_cast<double>(a[1]) * b[2] - static_cast<double>(a[2]) * b[1],
+		static_cast<double>(a[2]) * b[0] - static_cast<double>(a[0]) * b[2],
+		static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0] };
+	const double dot = static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2];
+	return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180. / 3.14159265358979323846;
+}
+
+void RoundTripOctahedral(const float normal[3], float decoded[3])
+{
+	float octahedral[2];
+	EncodeOctahedral(normal, octahedral);
+	const float stored[2] = { DecodeSnorm16(EncodeSnorm16(octahedral[0])), DecodeSnorm16(EncodeSnorm16(octahedral[1])) };
+	DecodeOctahedral(stored, decoded);
+}
+
+void TestOctahedral()
+{
+	// half a snorm16 step on both axes of the octahedron, stretched where the octahedron is furthest from the sphere,
+	// measures up to about 0.0037 degrees
+	const double bound = 0.005;
+
+	std::mt19937 random(2);
+	std::normal_distribution<float> distribution;
+	double maxAngle = 0.;
+	double maxLengthError = 0.;
+	for (int i = 0; i < 1000000; i++)
+	{
+		float normal[3] = { distribution(random), distribution(random), distribution(random) };
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length < 1e-3f)
+		{
+			continue;
+		}
+		for (float& component : normal)
+		{
+			component /= length;
+		}
+
+		float decoded[3];
+		RoundTripOctahedral(normal, decoded);
+		maxAngle = std::max(maxAngle, AngleDegrees(normal, decoded));
+		maxLengthError = std::max(maxLengthError,
+			std::fabs(std::sqrt(static_cast<double>(decoded[0]) * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2]) - 1.));
+	}
+	Check(maxAngle <= bound, "octahedral normal round trip", maxAngle, bound);
+	Check(maxLengthError <= 1e-6, "octahedral normals decode normalized", maxLengthError, 1e-6);
+
+	// the axes sit on corners and edges of the octahedron, where folding has to be exact
+	const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	double maxAxisAngle = 0.;
+	for (const float* axis : axes)
+	{
+		float decoded[3];
+		RoundTripOctahedral(axis, decoded);
+		maxAxisAngle = std::max(maxAxisAngle, AngleDegrees(axis, decoded));
+	}
+	Check(maxAxisAngle <= 1e-3, "octahedral axes round trip", maxAxisAngle, 1e-3);
+	std::printf("octahedral max error %g degrees (bound %g)\n", maxAngle, bound);
+}
+}
+
+int main()
+{
+	TestSnorm16();
+	TestPositions();
+	TestUnorm8();
+	TestOctahedral();
+
+	std::printf(g_failures ? "%d checks failed\n" : "all checks passed\n", g_failures);
+	return g_failures ? 1 : 0;
+}